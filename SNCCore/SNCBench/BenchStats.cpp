@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "BenchStats.h"
+
+#include <stdio.h>
+#include <algorithm>
+
+volatile quint64 BenchStats::m_sink = 0;
+
+BenchStats::BenchStats(const char *name, qint64 opsPerPass)
+{
+    m_name = name;
+    m_opsPerPass = opsPerPass;
+    m_pass = 0;
+    for (int i = 0; i < BENCHSTATS_PASSES; i++)
+        m_ns[i] = 0;
+}
+
+void BenchStats::printTitle(const char *title)
+{
+    printf("\n%s, median and min of %d passes\n\n", title, BENCHSTATS_PASSES);
+    printf("%-40s %12s %12s %12s\n", "benchmark", "ops/pass", "median ns/op", "min ns/op");
+}
+
+void BenchStats::startPass()
+{
+    m_timer.start();
+}
+
+void BenchStats::endPass()
+{
+    qint64 ns = m_timer.nsecsElapsed();
+
+    if ((m_pass > 0) && (m_pass <= BENCHSTATS_PASSES))
+        m_ns[m_pass - 1] = ns;
+    m_pass++;
+}
+
+void BenchStats::print()
+{
+    qint64 sorted[BENCHSTATS_PASSES];
+
+    for (int i = 0; i < BENCHSTATS_PASSES; i++)
+        sorted[i] = m_ns[i];
+    std::sort(sorted, sorted + BENCHSTATS_PASSES);
+
+    printf("%-40s %12lld %12.2f %12.2f\n", m_name, m_opsPerPass,
+           (double)sorted[BENCHSTATS_PASSES / 2] / (double)m_opsPerPass,
+           (double)sorted[0] / (double)m_opsPerPass);
+    fflush(stdout);
+}
@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef BENCHSTATS_H
+#define BENCHSTATS_H
+
+#include <qglobal.h>
+#include <qelapsedtimer.h>
+
+//  BenchStats times the passes of one microbenchmark and prints a result line. The
+//  first pass is a warm up and isn't counted. The median of the remaining passes is
+//  reported as it is much more stable from run to run than the mean.
+
+#define BENCHSTATS_PASSES               7                   // timed passes after the warm up
+
+class BenchStats
+{
+public:
+    BenchStats(const char *name, qint64 opsPerPass);
+
+    static void printTitle(const char *title);              // prints a section title and the column headers
+
+    int passes() const { return BENCHSTATS_PASSES + 1; }    // loop count including the warm up
+    void startPass();
+    void endPass();
+    void print();
+
+    static volatile quint64 m_sink;                         // results go here so they can't be optimized away
+
+private:
+    const char *m_name;
+    qint64 m_opsPerPass;
+    qint64 m_ns[BENCHSTATS_PASSES];
+    int m_pass;
+    QElapsedTimer m_timer;
+};
+
+#endif // BENCHSTATS_H
@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "ChangeDetectorBench.h"
+#include "ChangeDetector.h"
+#include "BenchStats.h"
+
+#include <qimage.h>
+#include <qbuffer.h>
+
+#include <stdio.h>
+
+void ChangeDetectorBench::run()
+{
+    QByteArray frames[2];
+    ChangeDetector detector;
+    qint64 changed;
+
+    frames[0] = makeFrame(0);
+    frames[1] = makeFrame(16);
+
+    BenchStats::printTitle("ChangeDetector");
+
+    if (frames[0].isEmpty() || frames[1].isEmpty()) {
+        printf("JPEG encoding not available - skipped\n");
+        return;
+    }
+
+    detector.imageChanged(frames[0]);                       // so the first timed compare has a previous frame
+
+    BenchStats stats("imageChanged 640x480 jpeg", CHANGEDETECTORBENCH_FRAMES);
+
+    for (int pass = 0; pass < stats.passes(); pass++) {
+        changed = 0;
+        stats.startPass();
+        for (int i = 0; i < CHANGEDETECTORBENCH_FRAMES; i++) {
+            if (detector.imageChanged(frames[i & 1]))
+                changed++;
+        }
+        stats.endPass();
+        BenchStats::m_sink += changed;
+    }
+    stats.print();
+}
+
+//  The frame is a gradient with a grid of blocks on it, which gives the JPEG a realistic
+//  mix of smooth and detailed areas
+
+QByteArray ChangeDetectorBench::makeFrame(int offset)
+{
+    QImage image(CHANGEDETECTORBENCH_WIDTH, CHANGEDETECTORBENCH_HEIGHT, QImage::Format_RGB888);
+    QByteArray jpeg;
+    QBuffer buffer(&jpeg);
+
+    for (int y = 0; y < CHANGEDETECTORBENCH_HEIGHT; y++) {
+        uchar *line = image.scanLine(y);
+
+        for (int x = 0; x < CHANGEDETECTORBENCH_WIDTH; x++) {
+            int blockX = (x - offset) & 63;
+            int blockY = (y - offset) & 63;
+
+            if ((blockX < 24) && (blockY < 24)) {
+                uchar value = (((x - offset) ^ (y - offset)) & 64) ? 255 : 0;
+
+                *line++ = value;
+                *line++ = value;
+                *line++ = value;
+            } else {
+                *line++ = (uchar)(x * 255 / CHANGEDETECTORBENCH_WIDTH);
+                *line++ = (uchar)(y * 255 / CHANGEDETECTORBENCH_HEIGHT);
+                *line++ = (uchar)((x + y) & 0xff);
+            }
+        }
+    }
+
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, "JPEG", 70))
+        jpeg.clear();
+    return jpeg;
+}
@@ -0,0 +1,46 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef CHANGEDETECTORBENCH_H
+#define CHANGEDETECTORBENCH_H
+
+#include <qbytearray.h>
+
+//  ChangeDetectorBench measures the partial JPEG decode and compare that the cameras run
+//  on every frame when motion detection is enabled. The frames are synthetic so the
+//  results don't depend on a camera.
+
+#define CHANGEDETECTORBENCH_WIDTH       640
+#define CHANGEDETECTORBENCH_HEIGHT      480
+#define CHANGEDETECTORBENCH_FRAMES      50                  // frames compared per pass
+
+class ChangeDetectorBench
+{
+public:
+    void run();
+
+protected:
+    QByteArray makeFrame(int offset);                       // returns a JPEG with the pattern moved by offset pixels
+};
+
+#endif // CHANGEDETECTORBENCH_H
@@ -0,0 +1,228 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "DEParseBench.h"
+#include "BenchStats.h"
+#include "SNCServer.h"
+#include "SNCHello.h"
+#include "SNCUtils.h"
+
+#include <qelapsedtimer.h>
+
+#include <stdio.h>
+
+DEParseBench::DEParseBench(SNCServer *server)
+{
+    m_server = server;
+    for (int i = 0; i < DEPARSEBENCH_COMPONENTS; i++) {
+        m_DE[i] = NULL;
+        m_DELength[i] = 0;
+    }
+}
+
+DEParseBench::~DEParseBench()
+{
+    for (int i = 0; i < DEPARSEBENCH_COMPONENTS; i++) {
+        if (m_DE[i] != NULL)
+            free(m_DE[i]);
+    }
+}
+
+void DEParseBench::run()
+{
+    printf("\nDE processing, %d connected components, average of %d passes\n\n",
+           DEPARSEBENCH_COMPONENTS, DEPARSEBENCH_PASSES);
+    printf("services    storm us/DE  unchanged us/DE  changed us/DE  delete us/DE\n");
+
+    for (int serviceCount = 1; serviceCount <= SNC_MAX_SERVICESPERCOMPONENT; serviceCount *= 2)
+        runServiceCount(serviceCount);
+}
+
+//  runServiceCount times four phases for a set of connected components:
+//
+//  storm - every connected component sends a new DE, as happens when SNCControl restarts
+//  unchanged - every DE is sent again unchanged, the normal steady state case
+//  changed - every DE is sent with one service renamed
+//  delete - every connected component goes away
+
+void DEParseBench::runServiceCount(int serviceCount)
+{
+    DM_CONNECTEDCOMPONENT *connectedComponent[DEPARSEBENCH_COMPONENTS];
+    DirectoryManager *dm = &(m_server->m_dirManager);
+    QElapsedTimer timer;
+    qint64 storm = 0, unchanged = 0, changed = 0, deleted = 0;
+    int i;
+
+    for (int pass = 0; pass < DEPARSEBENCH_PASSES; pass++) {
+        for (i = 0; i < DEPARSEBENCH_COMPONENTS; i++) {
+            connectedComponent[i] = dm->DMAllocateConnectedComponent(m_server->m_components + i);
+            if (connectedComponent[i] == NULL) {
+                printf("Failed to allocate connected component %d\n", i);
+                return;
+            }
+            setUID(i, &(connectedComponent[i]->connectedComponentUID));
+            buildDE(i, serviceCount, false);
+        }
+
+        timer.start();
+        for (i = 0; i < DEPARSEBENCH_COMPONENTS; i++)
+            dm->DMProcessDE(connectedComponent[i], m_DE[i], m_DELength[i]);
+        storm += timer.nsecsElapsed();
+
+        timer.start();
+        for (i = 0; i < DEPARSEBENCH_COMPONENTS; i++)
+            dm->DMProcessDE(connectedComponent[i], m_DE[i], m_DELength[i]);
+        unchanged += timer.nsecsElapsed();
+
+        for (i = 0; i < DEPARSEBENCH_COMPONENTS; i++)
+            buildDE(i, serviceCount, true);
+
+        timer.start();
+        for (i = 0; i < DEPARSEBENCH_COMPONENTS; i++)
+            dm->DMProcessDE(connectedComponent[i], m_DE[i], m_DELength[i]);
+        changed += timer.nsecsElapsed();
+
+        timer.start();
+        for (i = 0; i < DEPARSEBENCH_COMPONENTS; i++)
+            dm->DMDeleteConnectedComponent(connectedComponent[i]);
+        deleted += timer.nsecsElapsed();
+    }
+
+    double scale = 1000.0 * DEPARSEBENCH_COMPONENTS * DEPARSEBENCH_PASSES;
+
+    printf("%8d %14.2f %16.2f %14.2f %13.2f\n", serviceCount,
+           (double)storm / scale, (double)unchanged / scale, (double)changed / scale, (double)deleted / scale);
+}
+
+//  runDirectory loads the directory with DEPARSEBENCH_COMPONENTS components and then times
+//  building the directory sent to components and full (non refresh) E2E service lookups.
+
+void DEParseBench::runDirectory()
+{
+    DM_CONNECTEDCOMPONENT *connectedComponent[DEPARSEBENCH_COMPONENTS];
+    DirectoryManager *dm = &(m_server->m_dirManager);
+    SNC_SERVICE_LOOKUP lookup;
+    SNC_UID sourceUID;
+    char *message;
+    int messageLength;
+    qint64 found;
+    int i;
+
+    for (i = 0; i < DEPARSEBENCH_COMPONENTS; i++) {
+        connectedComponent[i] = dm->DMAllocateConnectedComponent(m_server->m_components + i);
+        if (connectedComponent[i] == NULL) {
+            printf("Failed to allocate connected component %d\n", i);
+            return;
+        }
+        setUID(i, &(connectedComponent[i]->connectedComponentUID));
+        buildDE(i, DEPARSEBENCH_DIR_SERVICES, false);
+        dm->DMProcessDE(connectedComponent[i], m_DE[i], m_DELength[i]);
+    }
+
+    BenchStats::printTitle(qPrintable(QString("DirectoryManager, %1 components with %2 services")
+                           .arg(DEPARSEBENCH_COMPONENTS).arg(DEPARSEBENCH_DIR_SERVICES)));
+
+    BenchStats statsBuild("DMBuildDirectoryMessage", 100);
+
+    for (int pass = 0; pass < statsBuild.passes(); pass++) {
+        statsBuild.startPass();
+        for (i = 0; i < 100; i++) {
+            dm->DMBuildDirectoryMessage(sizeof(SNC_MESSAGE), &message, &messageLength, false);
+            free(message);
+        }
+        statsBuild.endPass();
+        BenchStats::m_sink += messageLength;
+    }
+    statsBuild.print();
+
+    setUID(DEPARSEBENCH_COMPONENTS, &sourceUID);
+    BenchStats statsLookup("DMFindService E2E full lookup", DEPARSEBENCH_LOOKUPS);
+
+    for (int pass = 0; pass < statsLookup.passes(); pass++) {
+        found = 0;
+        statsLookup.startPass();
+        for (i = 0; i < DEPARSEBENCH_LOOKUPS; i++) {
+            memset(&lookup, 0, sizeof(SNC_SERVICE_LOOKUP));
+            sprintf(lookup.servicePath, "bench%d/avmux:%d", i % DEPARSEBENCH_COMPONENTS,
+                    ((i / DEPARSEBENCH_COMPONENTS) % (DEPARSEBENCH_DIR_SERVICES / 2)) * 2 + 1);
+            lookup.serviceType = SERVICETYPE_E2E;
+            lookup.response = SERVICE_LOOKUP_FAIL;
+            if (dm->DMFindService(&sourceUID, &lookup))
+                found++;
+        }
+        statsLookup.endPass();
+        BenchStats::m_sink += found;
+        if (found != DEPARSEBENCH_LOOKUPS)
+            printf("Only %lld of %d lookups succeeded\n", found, DEPARSEBENCH_LOOKUPS);
+    }
+    statsLookup.print();
+
+    for (i = 0; i < DEPARSEBENCH_COMPONENTS; i++)
+        dm->DMDeleteConnectedComponent(connectedComponent[i]);
+}
+
+//  buildDE generates a DE in the same form as SNCEndpoint. Even numbered services are multicast,
+//  odd numbered ones E2E. If changed is true, the last service is renamed.
+
+void DEParseBench::buildDE(int index, int serviceCount, bool changed)
+{
+    SNC_UID UID;
+    SNC_UIDSTR UIDStr;
+    char *DE;
+    int i;
+
+    if (m_DE[index] != NULL)
+        free(m_DE[index]);
+
+    DE = m_DE[index] = (char *)malloc(256 + serviceCount * (SNC_MAX_SERVNAME + 16));
+
+    setUID(index, &UID);
+    SNCUtils::UIDtoUIDSTR(&UID, UIDStr);
+
+    sprintf(DE, "<%s>", DETAG_COMP);
+    sprintf(DE + (int)strlen(DE), "<%s>%s</%s>", DETAG_UID, UIDStr, DETAG_UID);
+    sprintf(DE + (int)strlen(DE), "<%s>bench%d</%s>", DETAG_APPNAME, index, DETAG_APPNAME);
+    sprintf(DE + (int)strlen(DE), "<%s>%s</%s>", DETAG_COMPTYPE, "SNCBench", DETAG_COMPTYPE);
+
+    for (i = 0; i < serviceCount; i++) {
+        const char *tag = (i & 1) ? DETAG_ESERVICE : DETAG_MSERVICE;
+
+        if (changed && (i == serviceCount - 1))
+            sprintf(DE + (int)strlen(DE), "<%s>avmux:%dx</%s>", tag, i, tag);
+        else
+            sprintf(DE + (int)strlen(DE), "<%s>avmux:%d</%s>", tag, i, tag);
+    }
+    sprintf(DE + (int)strlen(DE), "</%s>", DETAG_COMP);
+
+    m_DELength[index] = (int)strlen(DE) + 1;
+}
+
+void DEParseBench::setUID(int index, SNC_UID *UID)
+{
+    memset(UID, 0, sizeof(SNC_UID));
+    UID->macAddr[0] = 0x02;                                 // locally administered address
+    UID->macAddr[4] = (unsigned char)(index >> 8);
+    UID->macAddr[5] = (unsigned char)index;
+    SNCUtils::convertIntToUC2(INSTANCE_COMPONENT, UID->instance);
+}
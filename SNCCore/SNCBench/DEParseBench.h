@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#ifndef DEPARSEBENCH_H
+#define DEPARSEBENCH_H
+
+#include "SNCDefs.h"
+
+#include <qstring.h>
+
+//  DEParseBench measures directory processing in SNCControl. It drives DirectoryManager
+//  directly with synthetic DEs so that no network or SNCServer thread is needed.
+
+#define DEPARSEBENCH_COMPONENTS         256                 // number of connected components in a storm
+#define DEPARSEBENCH_PASSES             10                  // number of passes averaged for each result
+#define DEPARSEBENCH_DIR_SERVICES       16                  // services per component for the directory benchmarks
+#define DEPARSEBENCH_LOOKUPS            16384               // service lookups per pass
+
+class SNCServer;
+
+class DEParseBench
+{
+public:
+    DEParseBench(SNCServer *server);
+    ~DEParseBench();
+
+    void run();                                             // runs the benchmark for all service counts
+    void runDirectory();                                    // directory building and service lookup
+
+protected:
+    void runServiceCount(int serviceCount);                 // runs the benchmark for one service count
+    void buildDE(int index, int serviceCount, bool changed);// builds the DE for a component
+    void setUID(int index, SNC_UID *UID);                   // generates a UID for a component
+
+    SNCServer *m_server;
+    char *m_DE[DEPARSEBENCH_COMPONENTS];                    // the DEs for the storm
+    int m_DELength[DEPARSEBENCH_COMPONENTS];                // and their lengths including the terminating zero
+};
+
+#endif // DEPARSEBENCH_H
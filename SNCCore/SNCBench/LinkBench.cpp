@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "LinkBench.h"
+#include "BenchStats.h"
+#include "SNCUtils.h"
+
+#include <stdio.h>
+
+LinkBench::LinkBench() : SNCLink("LinkBench")
+{
+}
+
+void LinkBench::run()
+{
+    BenchStats::printTitle("SNCLink");
+
+    runChecksum();
+    runSend(64);
+    runSend(1024);
+    runReceive(64);
+    runReceive(1024);
+}
+
+//  Each op computes a header checksum and checks it
+
+void LinkBench::runChecksum()
+{
+    SNC_MESSAGE headers[256];
+    quint64 good;
+
+    for (int i = 0; i < 256; i++) {
+        memset(headers + i, 0, sizeof(SNC_MESSAGE));
+        headers[i].cmd = SNCMSG_MULTICAST_MESSAGE;
+        headers[i].flags = i & SNCLINK_PRI;
+        SNCUtils::convertIntToUC4(sizeof(SNC_MESSAGE) + i * 37, headers[i].len);
+    }
+
+    BenchStats stats("checksum compute+check", LINKBENCH_MESSAGES * 256LL);
+
+    for (int pass = 0; pass < stats.passes(); pass++) {
+        good = 0;
+        stats.startPass();
+        for (int loop = 0; loop < LINKBENCH_MESSAGES; loop++) {
+            for (int i = 0; i < 256; i++) {
+                computeChecksum(headers + i);
+                if (checkChecksum(headers + i))
+                    good++;
+            }
+        }
+        stats.endPass();
+        BenchStats::m_sink += good;
+    }
+    stats.print();
+}
+
+//  Each op is a malloc'd multicast message sent and then taken off the TX queue, which
+//  is everything trySending does apart from the socket write
+
+void LinkBench::runSend(int length)
+{
+    char name[64];
+    SNCMessageWrapper *wrapper;
+    int totalLength = sizeof(SNC_EHEAD) + length;
+
+    sprintf(name, "send+dequeue %d byte multicast", length);
+    BenchStats stats(name, LINKBENCH_MESSAGES);
+
+    for (int pass = 0; pass < stats.passes(); pass++) {
+        stats.startPass();
+        for (int i = 0; i < LINKBENCH_MESSAGES; i++) {
+            SNC_EHEAD *ehead = (SNC_EHEAD *)calloc(1, totalLength);
+
+            SNCUtils::convertIntToUC2(i & 7, ehead->sourcePort);
+            send(SNCMSG_MULTICAST_MESSAGE, totalLength, SNCLINK_LOWPRI, (SNC_MESSAGE *)ehead);
+            wrapper = getTXHead(SNCLINK_LOWPRI);
+            delete wrapper;
+        }
+        stats.endPass();
+    }
+    stats.print();
+}
+
+//  Each op feeds a framed message through processRXHeader and completeRXMessage as
+//  tryReceiving would, then takes it off the RX queue with receive
+
+void LinkBench::runReceive(int length)
+{
+    char name[64];
+    int totalLength = sizeof(SNC_EHEAD) + length;
+    unsigned char *framed = (unsigned char *)calloc(1, totalLength);
+    SNC_MESSAGE *header = (SNC_MESSAGE *)framed;
+    SNC_MESSAGE *message;
+    int cmd, len;
+
+    header->cmd = SNCMSG_MULTICAST_MESSAGE;
+    header->flags = SNCLINK_LOWPRI;
+    SNCUtils::convertIntToUC4(totalLength, header->len);
+    computeChecksum(header);
+
+    sprintf(name, "receive %d byte multicast", length);
+    BenchStats stats(name, LINKBENCH_MESSAGES);
+
+    for (int pass = 0; pass < stats.passes(); pass++) {
+        stats.startPass();
+        for (int i = 0; i < LINKBENCH_MESSAGES; i++) {
+            memcpy(&m_SNCMessage, framed, sizeof(SNC_MESSAGE));
+            if (!processRXHeader()) {
+                printf("Receive header rejected\n");
+                free(framed);
+                return;
+            }
+            SNCMessageWrapper *wrapper = m_RXIP[m_RXIPPriority];
+            memcpy(wrapper->m_ptr, framed + sizeof(SNC_MESSAGE), wrapper->m_bytesLeft);
+            wrapper->m_bytesLeft = 0;
+            completeRXMessage();
+
+            if (receive(SNCLINK_LOWPRI, &cmd, &len, &message))
+                free(message);
+        }
+        stats.endPass();
+    }
+    stats.print();
+    free(framed);
+}
@@ -0,0 +1,102 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "UIDLookupBench.h"
+#include "BenchStats.h"
+#include "FastUIDLookup.h"
+#include "SNCUtils.h"
+
+UIDLookupBench::UIDLookupBench()
+{
+    for (int i = 0; i < UIDLOOKUPBENCH_UIDS; i++) {
+        setUID(i, m_UIDs + i);
+        setUID(i + UIDLOOKUPBENCH_UIDS, m_missUIDs + i);
+    }
+}
+
+//  UIDs are spread over 64 MAC addresses with 64 instances each, which is how they look
+//  on a real network
+
+void UIDLookupBench::setUID(int index, SNC_UID *UID)
+{
+    memset(UID, 0, sizeof(SNC_UID));
+    UID->macAddr[0] = 0x02;                                 // locally administered address
+    UID->macAddr[3] = (unsigned char)(index >> 14);
+    UID->macAddr[4] = (unsigned char)(index >> 6);
+    UID->macAddr[5] = (unsigned char)((index >> 6) * 0x9d);
+    SNCUtils::convertIntToUC2(INSTANCE_COMPONENT + (index & 63), UID->instance);
+}
+
+void UIDLookupBench::run()
+{
+    FastUIDLookup *lookup;
+    qint64 found;
+
+    BenchStats::printTitle("FastUIDLookup");
+
+    BenchStats statsAdd("FULAdd", UIDLOOKUPBENCH_UIDS);
+    BenchStats statsHit("FULLookup hit", (qint64)UIDLOOKUPBENCH_UIDS * UIDLOOKUPBENCH_LOOPS);
+    BenchStats statsMiss("FULLookup miss", (qint64)UIDLOOKUPBENCH_UIDS * UIDLOOKUPBENCH_LOOPS);
+    BenchStats statsDelete("FULDelete", UIDLOOKUPBENCH_UIDS);
+
+    for (int pass = 0; pass < statsAdd.passes(); pass++) {
+        lookup = new FastUIDLookup();
+
+        statsAdd.startPass();
+        for (int i = 0; i < UIDLOOKUPBENCH_UIDS; i++)
+            lookup->FULAdd(m_UIDs + i, m_UIDs + i);
+        statsAdd.endPass();
+
+        found = 0;
+        statsHit.startPass();
+        for (int loop = 0; loop < UIDLOOKUPBENCH_LOOPS; loop++) {
+            for (int i = 0; i < UIDLOOKUPBENCH_UIDS; i++) {
+                if (lookup->FULLookup(m_UIDs + i) != NULL)
+                    found++;
+            }
+        }
+        statsHit.endPass();
+
+        statsMiss.startPass();
+        for (int loop = 0; loop < UIDLOOKUPBENCH_LOOPS; loop++) {
+            for (int i = 0; i < UIDLOOKUPBENCH_UIDS; i++) {
+                if (lookup->FULLookup(m_missUIDs + i) != NULL)
+                    found++;
+            }
+        }
+        statsMiss.endPass();
+
+        statsDelete.startPass();
+        for (int i = 0; i < UIDLOOKUPBENCH_UIDS; i++)
+            lookup->FULDelete(m_UIDs + i);
+        statsDelete.endPass();
+
+        BenchStats::m_sink += found;
+        delete lookup;
+    }
+
+    statsAdd.print();
+    statsHit.print();
+    statsMiss.print();
+    statsDelete.print();
+}
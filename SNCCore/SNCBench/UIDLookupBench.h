@@ -0,0 +1,49 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef UIDLOOKUPBENCH_H
+#define UIDLOOKUPBENCH_H
+
+#include "SNCDefs.h"
+
+//  UIDLookupBench measures FastUIDLookup, which SNCControl uses to find the link for the
+//  destination of every E2E message and multicast ack.
+
+#define UIDLOOKUPBENCH_UIDS             4096                // UIDs in the table
+#define UIDLOOKUPBENCH_LOOPS            64                  // lookup loops per pass
+
+class UIDLookupBench
+{
+public:
+    UIDLookupBench();
+
+    void run();
+
+protected:
+    void setUID(int index, SNC_UID *UID);
+
+    SNC_UID m_UIDs[UIDLOOKUPBENCH_UIDS];
+    SNC_UID m_missUIDs[UIDLOOKUPBENCH_UIDS];                // UIDs that are never added
+};
+
+#endif // UIDLOOKUPBENCH_H
@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "UtilsBench.h"
+#include "BenchStats.h"
+#include "SNCUtils.h"
+
+#include <stdlib.h>
+
+UtilsBench::UtilsBench()
+{
+    quint64 seed = 0x5eed;
+
+    for (int i = 0; i < UTILSBENCH_VALUES; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        m_values[i] = (qint64)(seed >> 1);
+    }
+}
+
+UtilsBench::~UtilsBench()
+{
+}
+
+void UtilsBench::run()
+{
+    BenchStats::printTitle("SNCUtils");
+
+    runConversions();
+    runIsSendOK();
+    runYUYV2RGB();
+}
+
+//  Each op is a convert to wire format and back
+
+void UtilsBench::runConversions()
+{
+    SNC_UC2 uc2[UTILSBENCH_VALUES];
+    SNC_UC4 uc4[UTILSBENCH_VALUES];
+    SNC_UC8 uc8[UTILSBENCH_VALUES];
+    qint64 ops = (qint64)UTILSBENCH_VALUES * UTILSBENCH_LOOPS;
+    quint64 sum;
+
+    BenchStats statsUC2("convertIntToUC2/UC2ToInt", ops);
+
+    for (int pass = 0; pass < statsUC2.passes(); pass++) {
+        sum = 0;
+        statsUC2.startPass();
+        for (int loop = 0; loop < UTILSBENCH_LOOPS; loop++) {
+            for (int i = 0; i < UTILSBENCH_VALUES; i++)
+                SNCUtils::convertIntToUC2((int)m_values[i] & 0xffff, uc2[i]);
+            for (int i = 0; i < UTILSBENCH_VALUES; i++)
+                sum += SNCUtils::convertUC2ToInt(uc2[i]);
+        }
+        statsUC2.endPass();
+        BenchStats::m_sink += sum;
+    }
+    statsUC2.print();
+
+    BenchStats statsUC4("convertIntToUC4/UC4ToInt", ops);
+
+    for (int pass = 0; pass < statsUC4.passes(); pass++) {
+        sum = 0;
+        statsUC4.startPass();
+        for (int loop = 0; loop < UTILSBENCH_LOOPS; loop++) {
+            for (int i = 0; i < UTILSBENCH_VALUES; i++)
+                SNCUtils::convertIntToUC4((int)m_values[i], uc4[i]);
+            for (int i = 0; i < UTILSBENCH_VALUES; i++)
+                sum += SNCUtils::convertUC4ToInt(uc4[i]);
+        }
+        statsUC4.endPass();
+        BenchStats::m_sink += sum;
+    }
+    statsUC4.print();
+
+    BenchStats statsUC8("convertInt64ToUC8/UC8ToInt64", ops);
+
+    for (int pass = 0; pass < statsUC8.passes(); pass++) {
+        sum = 0;
+        statsUC8.startPass();
+        for (int loop = 0; loop < UTILSBENCH_LOOPS; loop++) {
+            for (int i = 0; i < UTILSBENCH_VALUES; i++)
+                SNCUtils::convertInt64ToUC8(m_values[i], uc8[i]);
+            for (int i = 0; i < UTILSBENCH_VALUES; i++)
+                sum += SNCUtils::convertUC8ToInt64(uc8[i]);
+        }
+        statsUC8.endPass();
+        BenchStats::m_sink += sum;
+    }
+    statsUC8.print();
+}
+
+//  Every send/ack sequence number pair, as the window check sees all of them as the
+//  sequence numbers wrap
+
+void UtilsBench::runIsSendOK()
+{
+    qint64 ops = 256 * 256 * 16;
+    quint64 count;
+
+    BenchStats stats("isSendOK", ops);
+
+    for (int pass = 0; pass < stats.passes(); pass++) {
+        count = 0;
+        stats.startPass();
+        for (int loop = 0; loop < 16; loop++) {
+            for (int sendSeq = 0; sendSeq < 256; sendSeq++) {
+                for (int ackSeq = 0; ackSeq < 256; ackSeq++) {
+                    if (SNCUtils::isSendOK((unsigned char)sendSeq, (unsigned char)ackSeq))
+                        count++;
+                }
+            }
+        }
+        stats.endPass();
+        BenchStats::m_sink += count;
+    }
+    stats.print();
+}
+
+//  The frame is a fixed pattern covering the full range of Y, U and V so that the
+//  clamping paths are exercised
+
+void UtilsBench::runYUYV2RGB()
+{
+    int yuyvLength = UTILSBENCH_FRAME_WIDTH * UTILSBENCH_FRAME_HEIGHT * 2;
+    unsigned char *yuyv = (unsigned char *)malloc(yuyvLength);
+    unsigned char *rgb = (unsigned char *)malloc(UTILSBENCH_FRAME_WIDTH * UTILSBENCH_FRAME_HEIGHT * 3);
+
+    for (int i = 0; i < yuyvLength; i += 4) {
+        yuyv[i] = (unsigned char)(i / 4);
+        yuyv[i + 1] = (unsigned char)((i / 4) * 7);
+        yuyv[i + 2] = (unsigned char)(255 - i / 4);
+        yuyv[i + 3] = (unsigned char)((i / 4) * 13);
+    }
+
+    BenchStats stats("YUYV2RGB 640x480 frame", UTILSBENCH_FRAMES);
+
+    for (int pass = 0; pass < stats.passes(); pass++) {
+        stats.startPass();
+        for (int frame = 0; frame < UTILSBENCH_FRAMES; frame++)
+            SNCUtils::YUYV2RGB(yuyv, rgb, UTILSBENCH_FRAME_WIDTH, UTILSBENCH_FRAME_HEIGHT);
+        stats.endPass();
+        BenchStats::m_sink += rgb[pass];
+    }
+    stats.print();
+
+    free(yuyv);
+    free(rgb);
+}
@@ -0,0 +1,55 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef UTILSBENCH_H
+#define UTILSBENCH_H
+
+#include "SNCDefs.h"
+
+//  UtilsBench measures the SNCUtils functions used on every message - the byte order
+//  conversions and the send window check - plus the YUYV to RGB conversion used by
+//  the V4L2 cameras. All inputs are generated from a fixed seed so runs are comparable.
+
+#define UTILSBENCH_VALUES               4096                // values converted per loop
+#define UTILSBENCH_LOOPS                256                 // loops per pass
+#define UTILSBENCH_FRAME_WIDTH          640
+#define UTILSBENCH_FRAME_HEIGHT         480
+#define UTILSBENCH_FRAMES               20                  // frames converted per pass
+
+class UtilsBench
+{
+public:
+    UtilsBench();
+    ~UtilsBench();
+
+    void run();
+
+protected:
+    void runConversions();
+    void runIsSendOK();
+    void runYUYV2RGB();
+
+    qint64 m_values[UTILSBENCH_VALUES];
+};
+
+#endif // UTILSBENCH_H
@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "SNCServer.h"
+#include "DEParseBench.h"
+#include "UtilsBench.h"
+#include "LinkBench.h"
+#include "UIDLookupBench.h"
+#include "ChangeDetectorBench.h"
+#include <QCoreApplication>
+
+#include "SNCUtils.h"
+
+#include <stdio.h>
+
+//  SNCBench runs the SNC benchmarks in-process and prints the results.
+//  The SNCServer is not started - just enough of it is set up for the
+//  directory and multicast managers to work.
+//
+//  Benchmark groups can be named on the command line to run just those:
+//  utils, link, uid, de, directory and changedetector. The default is all of them.
+
+static bool wanted(const QStringList& groups, const char *group)
+{
+    return groups.isEmpty() || groups.contains(group);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList groups;
+
+    for (int i = 1; i < a.arguments().count(); i++) {
+        if (!a.arguments().at(i).startsWith('-'))
+            groups.append(a.arguments().at(i));
+    }
+
+    SNCUtils::loadStandardSettings("SNCBench", a.arguments());
+
+    SNCServer *server = new SNCServer();
+    server->m_myUID = server->m_componentData.getMyUID();
+    server->m_multicastManager.m_server = server;
+    server->m_multicastManager.m_myUID = server->m_myUID;
+    server->m_dirManager.m_server = server;
+
+    if (wanted(groups, "utils")) {
+        UtilsBench utilsBench;
+        utilsBench.run();
+    }
+
+    if (wanted(groups, "link")) {
+        LinkBench linkBench;
+        linkBench.run();
+    }
+
+    if (wanted(groups, "uid")) {
+        UIDLookupBench *uidLookupBench = new UIDLookupBench();
+        uidLookupBench->run();
+        delete uidLookupBench;
+    }
+
+    if (wanted(groups, "de") || wanted(groups, "directory")) {
+        DEParseBench *deParseBench = new DEParseBench(server);
+        if (wanted(groups, "de"))
+            deParseBench->run();
+        if (wanted(groups, "directory"))
+            deParseBench->runDirectory();
+        delete deParseBench;
+    }
+
+    if (wanted(groups, "changedetector")) {
+        ChangeDetectorBench changeDetectorBench;
+        changeDetectorBench.run();
+    }
+
+    server->m_dirManager.DMShutdown();
+    server->m_multicastManager.MMShutdown();
+    delete server;
+    return 0;
+}
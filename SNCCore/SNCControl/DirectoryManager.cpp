@@ -25,6 +25,8 @@
 #include "SNCControl.h"
 #include "SNCServer.h"
 
+#include <stddef.h>
+
 #define TAG "DirectoryManager"
 
 DirectoryManager::DirectoryManager(void)
@@ -38,6 +40,12 @@ DirectoryManager::DirectoryManager(void)
         m_directory[i].valid = false;
         m_directory[i].componentDE = NULL;
     }
+    for (i = 0; i < DM_SERVICE_HASH_SIZE; i++) {
+        m_pathHash[i] = NULL;
+        m_nameHash[i] = NULL;
+    }
+    for (i = 0; i < DM_ATOM_HASH_SIZE; i++)
+        m_atomHash[i] = NULL;
     strcpy(m_lastError, "Undefined error");
     m_sequenceID = 0;
 }
@@ -74,6 +82,9 @@ void DirectoryManager::DMShutdown()
 //	component in the route to the service. pDE is the pointer to the received DE, nLen is the total length of the DE
 //	(which is made up of multiple zero-terminated strings). Returns true if ok, false if an
 //	error occurred.
+//
+//	As before, an entry that is not a component rejects the rest of the DE. A component entry
+//	that fails to parse is not registered and the number of these is logged as a warning.
 
 bool DirectoryManager::DMProcessDE(DM_CONNECTEDCOMPONENT *connectedComponent, char *DE, int len)
 {
@@ -81,14 +92,16 @@ bool DirectoryManager::DMProcessDE(DM_CONNECTEDCOMPONENT *connectedComponent, ch
     int entryLength;
     char *thisEntry, *nextEntry;
 
-    int index;
-    char tag[SNC_MAX_TAG];
-    char nonTag[SNC_MAX_NONTAG];
+    DM_PARSEDDE *parsedDE;									// the zero copy parse of the current entry
     DM_SERVICE *service;
-    DM_COMPONENT *component;								// we extract into this for lookup
+    DM_COMPONENT *component;								// the new component entry
     DM_COMPONENT *componentLookup;							// result of lookup
     DM_COMPONENT *previousComponent;						// for deleting components at end
+    SNC_UIDSTR UIDStr;
+    SNC_UIDSTR canonicalUIDStr;
+    SNC_UID UID;
     int i;
+    int skipped;											// malformed entries that were not registered
     bool changed;											// so we know if something changed
 
     if (DE == NULL)
@@ -100,12 +113,14 @@ bool DirectoryManager::DMProcessDE(DM_CONNECTEDCOMPONENT *connectedComponent, ch
     QMutexLocker locker(&m_lock);
 
     changed = false;
+    skipped = 0;
     component = connectedComponent->componentDE;
     while (component != NULL) {
         component->seenInDE = false;						// set not seen on all components
         component = component->next;
     }
 
+    parsedDE = &m_parsedDE;
     DELength = len;
     thisEntry = DE;
 
@@ -113,124 +128,94 @@ bool DirectoryManager::DMProcessDE(DM_CONNECTEDCOMPONENT *connectedComponent, ch
         entryLength = (int)strlen(thisEntry) + 1;			// find the length of this entry
         nextEntry = thisEntry + entryLength;				// this is where the next entry will start
 
-        m_tagPtr = thisEntry;								// set pointer for tag routines
-        if (!getTag(tag))
-            break;
-        if (strcmp(tag, DETAG_COMP) != 0)
-            return false;
+        if (strchr(thisEntry, '<') == NULL)
+            break;											// no more entries
 
-//	Read in endpoint component header. See if this already exists in directory
+        if (!parseDE(thisEntry, parsedDE)) {
+            SNCUtils::logError(TAG, m_lastError);
+            if (!parsedDE->componentTag)
+                return false;								// not a component entry - reject the whole DE
+            skipped++;
+            goto nextde;									// give up on this and go to next
+        }
 
-        component = (DM_COMPONENT *)calloc(1, sizeof(DM_COMPONENT));
-        if (!getSimpleValue(DETAG_UID, component->UIDStr, sizeof(SNC_UIDSTR)))
-            goto deerr;
-        if (!getSimpleValue(DETAG_APPNAME, component->appName, SNC_MAX_APPNAME))
-            goto deerr;
-        if (!getSimpleValue(DETAG_COMPTYPE, component->componentType))
-            goto deerr;
-        SNCUtils::UIDSTRtoUID(component->UIDStr, &(component->componentUID));
-        if ((componentLookup = findComponent(connectedComponent, &(component->componentUID),
-                            component->appName, component->componentType)) != NULL) {	// this component already exists in directory
+//	See if this already exists in directory. This is done before allocating anything so that
+//	unchanged components cost no more than the parse.
+
+        memcpy(UIDStr, parsedDE->UID.ptr, parsedDE->UID.length);
+        UIDStr[parsedDE->UID.length] = 0;
+        SNCUtils::UIDSTRtoUID(UIDStr, &UID);
+        if ((componentLookup = findComponent(connectedComponent, &UID,
+                            findAtom(&parsedDE->appName), findAtom(&parsedDE->componentType))) != NULL) {	// this component already exists in directory
             if(componentLookup->originalDE == NULL) {			// should never happen but just in case
-                SNCUtils::logError(TAG, QString("DirectoryManager found NULL origde when processing ") + SNCUtils::displayUID(&(component->componentUID)));
-                free(component);
+                SNCUtils::logError(TAG, QString("DirectoryManager found NULL origde when processing ") + SNCUtils::displayUID(&UID));
                 goto nextde;
             }
             if (strcmp(thisEntry, componentLookup->originalDE) == 0) {		// DE hasn't changed - can terminate processing
-                free(component);
                 componentLookup->seenInDE = true;			// flag as seen
                 goto nextde;								// nothing more to do for this one
             }
             //	if we get here, DE has changed so we need to continue processing
             deleteComponent(connectedComponent, componentLookup);// clear down old entry
         }
+
+        component = (DM_COMPONENT *)calloc(1, sizeof(DM_COMPONENT));
+        memcpy(component->UIDStr, UIDStr, sizeof(SNC_UIDSTR));
+        component->componentUID = UID;
+        memcpy(component->appName, parsedDE->appName.ptr, parsedDE->appName.length);
+        memcpy(component->componentType, parsedDE->componentType.ptr, parsedDE->componentType.length);
+        component->appNameAtom = internAtom(&parsedDE->appName);
+        component->componentTypeAtom = internAtom(&parsedDE->componentType);
         component->seenInDE = true;							// indicate this component has been seen in DE
         changed = true;
 
-//	Now read in the service entries and add them to the service array
-
-        index = 0;											// generates port numbers
-        component->serviceCount = 0;							// clear services count
-        while(1) {
-            if (!getTag(tag))
-                break;										// finished
-            if (strcmp(tag, DETAG_COMP_END) == 0) {			// hit end of component
-                break;
-            }
-            if (component->serviceCount == SNC_MAX_SERVICESPERCOMPONENT) {
-                strcpy(m_lastError, "Too many services in DE");
-                goto deerr;
-            }
-            service = component->services + index;			// this is where the new one goes
-
-            if (!getNonTag(nonTag))						// get the value
-                goto deerr;
-
-            if (strcmp(tag, DETAG_MSERVICE) == 0) {		// multicast service
-                service->serviceType = SERVICETYPE_MULTICAST;
-            } else {
-                if (strcmp(tag, DETAG_ESERVICE) == 0) {
-                    service->serviceType = SERVICETYPE_E2E;
-                } else {
-                    if (strcmp(tag, DETAG_NOSERVICE) == 0) {
-                        service->serviceType = SERVICETYPE_NOSERVICE;
-                    } else {
-                        strcpy(m_lastError, "Incorrect service type in DE");
-                        goto deerr;
-                    }
-                }
-            }
-            if (strlen(nonTag) >= SNC_MAX_SERVNAME) {
-                strcpy(m_lastError, "Service name too long in DE");
-                goto deerr;
-            }
-            strcpy(service->serviceName, nonTag);
-            service->port = index++;
-            service->valid = true;
-
-//	Get closing tag - don't really need to be fussy here
-
-            if (!getTag(tag))
-                goto deerr;
-
-            component->serviceCount++;						// accept this one and move on
-            continue;
-
-deerr:
-            SNCUtils::logError(TAG, m_lastError);
-            free(component);
-            goto nextde;									// give up on this and go to next
-        }
-
-        // if get here, processed component
+//	Now fill in the service array, allocating multicast maps as needed
 
+        component->serviceCount = parsedDE->serviceCount;
         service = component->services;
-        for (i = 0; i < component->serviceCount; i++, service++) {
-            if ((component->services[i].serviceType == SERVICETYPE_E2E) ||
-                (component->services[i].serviceType == SERVICETYPE_NOSERVICE)) {
-                component->services[i].multicastMap = NULL;
-            } else {										// need to allocate a multicast map
-                component->services[i].multicastMap = m_server->m_multicastManager.MMAllocateMMap(
+        for (i = 0; i < parsedDE->serviceCount; i++, service++) {
+            memcpy(service->serviceName, parsedDE->serviceName[i].ptr, parsedDE->serviceName[i].length);
+            service->serviceType = parsedDE->serviceType[i];
+            service->port = i;
+            service->valid = true;
+            service->component = component;
+            if (service->serviceType == SERVICETYPE_MULTICAST)
+                service->multicastMap = m_server->m_multicastManager.MMAllocateMMap(
                             &(connectedComponent->connectedComponentUID),
                             &(component->componentUID),
                             component->appName,
                             service->serviceName,
                             service->port);
-            }
+            else
+                service->multicastMap = NULL;
         }
-        component->originalDE = (char *)malloc(strlen(thisEntry) + 1);
-        strcpy(component->originalDE, thisEntry);			// record the original DE
-        buildLocalDE(component);							// generate a new DE with adjusted port numbers
+        component->originalDE = (char *)malloc(entryLength);
+        memcpy(component->originalDE, thisEntry, entryLength);	// record the original DE
+
+        //	a DE in canonical form is identical to the one buildLocalDE would generate so just share it
+
+        SNCUtils::UIDtoUIDSTR(&UID, canonicalUIDStr);
+        if (parsedDE->canonical && (strcmp(canonicalUIDStr, UIDStr) == 0))
+            component->localDE = component->originalDE;
+        else
+            buildLocalDE(component);
+
         m_server->m_fastUIDLookup.FULAdd(&(component->componentUID), connectedComponent->data);
         component->sequenceID = m_sequenceID++;				// alocate new ID
+        component->connectedComponentIndex = connectedComponent->index;
         component->next = connectedComponent->componentDE;	// link in new component
         connectedComponent->componentDE = component;		// save it
+        indexComponent(component);							// make services visible to queries
 
 nextde:
         thisEntry = nextEntry;								// set up for next entry
         DELength -= entryLength;							// and take off length of last entry
     }
 
+    if (skipped > 0)
+        SNCUtils::logWarn(TAG, QString("Skipped %1 malformed component entries in DE from %2")
+            .arg(skipped).arg(SNCUtils::displayUID(&(connectedComponent->connectedComponentUID))));
+
 //	Finally, check to see if any components missing
 
     component = connectedComponent->componentDE;
@@ -261,28 +246,55 @@ nextde:
 //	If the incoming lookup indicates success, the routine checks if the
 //	existing response is still valid. If so, this is a quick process and
 //	just returns success. If the incoming indicated fail or it did not match
-//	the previously successful lookup, a full lookup takes place.
+//	the previously successful lookup, a full lookup takes place using the
+//	service hash tables so that the cost does not depend on the directory size.
+//	The region part of the path is not used for lookups.
+//
+//	A lookup from a batch with an empty service path is a compact refresh. Only the
+//	expedited check is possible for these - if it fails, the lookup fails and the
+//	requestor goes back to a full lookup. batched must only be true for entries from a
+//	batch so that single lookups keep their original meaning.
 //
 //	sourceUID is the UID of the endpoint being registered
 
-bool DirectoryManager::DMFindService(SNC_UID *sourceUID, SNC_SERVICE_LOOKUP *serviceLookup)
+bool DirectoryManager::DMFindService(SNC_UID *sourceUID, SNC_SERVICE_LOOKUP *serviceLookup, bool batched)
 {
-    QString componentName;
-    QString serviceName;
-    QString regionName;
+    SNC_REGIONNAME regionName;
+    SNC_APPNAME componentName;
+    SNC_SERVNAME serviceName;
+    SNC_SERVPATH lookupPath;
     int componentIndex;
     int servicePort;
     int serviceIndex;
+    int minInterval = 0;
+    int everyNth = 0;
+    bool noCache = false;
 
     DM_CONNECTEDCOMPONENT *connectedComponent;
     DM_COMPONENT *component;
     DM_SERVICE *service;
+    bool compact;
+
+    serviceLookup->servicePath[SNC_MAX_SERVPATH - 1] = 0;	// make sure string is 0 terminated
+    compact = batched && (serviceLookup->servicePath[0] == 0);
 
     QMutexLocker locker(&m_lock);
-    if (!SNCUtils::crackServicePath(serviceLookup->servicePath, regionName, componentName, serviceName)) {
-        serviceLookup->response = SERVICE_LOOKUP_FAIL;
-        SNCUtils::logDebug(TAG, QString("Path %1 is invalid").arg(serviceLookup->servicePath));
-        return false;
+    if (compact) {
+        if (serviceLookup->response != SERVICE_LOOKUP_SUCCEED) {
+            serviceLookup->response = SERVICE_LOOKUP_FAIL;
+            SNCUtils::logDebug(TAG, "Compact lookup that is not a refresh");
+            return false;
+        }
+        componentName[0] = 0;
+        serviceName[0] = 0;
+    } else {
+        strcpy(lookupPath, serviceLookup->servicePath);     // take off any subscriber rate spec
+        if (!SNCUtils::removeRateFromPath(lookupPath, &minInterval, &everyNth, &noCache) ||
+                    !SNCUtils::crackServicePath(lookupPath, regionName, componentName, serviceName)) {
+            serviceLookup->response = SERVICE_LOOKUP_FAIL;
+            SNCUtils::logDebug(TAG, QString("Path %1 is invalid").arg(serviceLookup->servicePath));
+            return false;
+        }
     }
 
     if (serviceLookup->response == SERVICE_LOOKUP_SUCCEED) {	// this is a refresh - check all important fields for validity
@@ -296,7 +308,7 @@ bool DirectoryManager::DMFindService(SNC_UID *sourceUID, SNC_SERVICE_LOOKUP *ser
         component = connectedComponent->componentDE;
         while (component != NULL)
         {
-            if ((componentName.length() > 0) && (strcmp(qPrintable(componentName), component->appName) != 0)) {
+            if ((componentName[0] != 0) && (strcmp(componentName, component->appName) != 0)) {
                 component = component->next;
                 continue;									// require a specific component but not this one
             }
@@ -333,7 +345,7 @@ bool DirectoryManager::DMFindService(SNC_UID *sourceUID, SNC_SERVICE_LOOKUP *ser
                 component = component->next;
                 continue;
             }
-            if (strcmp(service->serviceName, qPrintable(serviceName)) != 0) {
+            if (!compact && (strcmp(service->serviceName, serviceName) != 0)) {
                 component = component->next;
                 continue;
             }
@@ -357,74 +369,81 @@ bool DirectoryManager::DMFindService(SNC_UID *sourceUID, SNC_SERVICE_LOOKUP *ser
 
 fullLookup:
 
-    connectedComponent = m_directory;
-    for (componentIndex = 0; componentIndex < SNC_MAX_CONNECTEDCOMPONENTS; componentIndex++, connectedComponent++) {
-        component = connectedComponent->componentDE;
-        while (component != NULL)
-        {
-            if ((componentName.length() > 0) && (strcmp(qPrintable(componentName), component->appName) != 0)) {
-                component = component->next;
-                continue;							// require a specific component but not this one
-            }
-            service = component->services;
-            for (servicePort = 0; servicePort < component->serviceCount; servicePort++, service++) {
-                if (serviceLookup->serviceType != service->serviceType)
-                    continue;
-                if (strcmp(service->serviceName, qPrintable(serviceName)) != 0)
-                    continue;
-
-                // found it - but it could be a registration request or removal
-
-                if (serviceLookup->response == SERVICE_LOOKUP_REMOVE) { // this is a removal request
-                    m_server->m_multicastManager.MMDeleteRegistered(sourceUID, SNCUtils::convertUC2ToUInt(serviceLookup->localPort));
-                    SNCUtils::logDebug(TAG, QString("Removed reg from component %1 to source %2 port %3")
-                        .arg(SNCUtils::displayUID(sourceUID))
-                        .arg(SNCUtils::displayUID(&component->componentUID)).arg(SNCUtils::convertUC2ToInt(serviceLookup->localPort)));
-                    return true;
-                }
-
-                memcpy(&(serviceLookup->lookupUID), &(component->componentUID), sizeof(SNC_UID));
-                SNCUtils::convertIntToUC4(component->sequenceID, serviceLookup->ID);
-                if (serviceLookup->serviceType == SERVICETYPE_MULTICAST)
-                    SNCUtils::convertIntToUC2(service->multicastMap->index, serviceLookup->remotePort);
-                else
-                    SNCUtils::convertIntToUC2(service->port, serviceLookup->remotePort);
-                SNCUtils::convertIntToUC2(componentIndex, serviceLookup->componentIndex);
-                if (serviceLookup->serviceType == SERVICETYPE_MULTICAST) {		// must add this to the registered components list
-                    if (m_server->m_multicastManager.MMCheckRegistered(service->multicastMap,
-                                sourceUID, SNCUtils::convertUC2ToInt(serviceLookup->localPort))) { // already there - just a refresh
-                        SNCUtils::logDebug(TAG, QString("Refreshed reg from component %1 to source %2 port %3")
-                            .arg(SNCUtils::displayUID(sourceUID)).arg(SNCUtils::displayUID(&component->componentUID))
-                            .arg(SNCUtils::convertUC2ToInt(serviceLookup->localPort)));
-                        serviceLookup->response = SERVICE_LOOKUP_SUCCEED;
-                        return true;
-                    }
-                    //	Must add as this is a new one
-                    m_server->m_multicastManager.MMAddRegistered(service->multicastMap, sourceUID,
-                                SNCUtils::convertUC2ToInt(serviceLookup->localPort));
-                    SNCUtils::logDebug(TAG, QString("Added reg request from component %1 to source %2 port %3")
-                        .arg(SNCUtils::displayUID(sourceUID))
-                        .arg(SNCUtils::displayUID(&component->componentUID))
-                        .arg(SNCUtils::convertUC2ToInt(serviceLookup->localPort)));
+    if (compact) {
+        serviceLookup->response = SERVICE_LOOKUP_FAIL;
+        SNCUtils::logDebug(TAG, QString("Compact refresh from %1 port %2 failed")
+            .arg(SNCUtils::displayUID(sourceUID)).arg(SNCUtils::convertUC2ToInt(serviceLookup->localPort)));
+        return false;
+    }
 
-                    serviceLookup->response = SERVICE_LOOKUP_SUCCEED;
-                    return true;
-                } else {
-                    SNCUtils::logDebug(TAG, QString("Refreshed E2E lookup from component %1 to source %2 port %3")
-                        .arg(SNCUtils::displayUID(sourceUID)).arg(SNCUtils::displayUID(&component->componentUID))
-                        .arg(SNCUtils::convertUC2ToInt(serviceLookup->localPort)));
-                    serviceLookup->response = SERVICE_LOOKUP_SUCCEED;
-                    return true;
-                }
-            }
-            component = component->next;
+    if (componentName[0] != 0) {
+        service = m_pathHash[serviceHash(componentName, serviceName)];
+        while (service != NULL) {
+            if ((service->serviceType == serviceLookup->serviceType) &&
+                    (strcmp(service->serviceName, serviceName) == 0) &&
+                    (strcmp(service->component->appName, componentName) == 0))
+                break;
+            service = service->pathHashNext;
+        }
+    } else {
+        service = m_nameHash[serviceHash("", serviceName)];
+        while (service != NULL) {
+            if ((service->serviceType == serviceLookup->serviceType) &&
+                    (strcmp(service->serviceName, serviceName) == 0))
+                break;
+            service = service->nameHashNext;
         }
     }
-    //	not found
 
-    serviceLookup->response = SERVICE_LOOKUP_FAIL;
-    SNCUtils::logDebug(TAG, QString("Lookup for %1 failed").arg(serviceLookup->servicePath));
-    return false;
+    if (service == NULL) {
+        serviceLookup->response = SERVICE_LOOKUP_FAIL;
+        SNCUtils::logDebug(TAG, QString("Lookup for %1 failed").arg(serviceLookup->servicePath));
+        return false;
+    }
+
+    component = service->component;
+    componentIndex = component->connectedComponentIndex;
+
+    // found it - but it could be a registration request or removal
+
+    if (serviceLookup->response == SERVICE_LOOKUP_REMOVE) { // this is a removal request
+        m_server->m_multicastManager.MMDeleteRegistered(sourceUID, SNCUtils::convertUC2ToUInt(serviceLookup->localPort));
+        SNCUtils::logDebug(TAG, QString("Removed reg from component %1 to source %2 port %3")
+            .arg(SNCUtils::displayUID(sourceUID))
+            .arg(SNCUtils::displayUID(&component->componentUID)).arg(SNCUtils::convertUC2ToInt(serviceLookup->localPort)));
+        return true;
+    }
+
+    memcpy(&(serviceLookup->lookupUID), &(component->componentUID), sizeof(SNC_UID));
+    SNCUtils::convertIntToUC4(component->sequenceID, serviceLookup->ID);
+    if (serviceLookup->serviceType == SERVICETYPE_MULTICAST)
+        SNCUtils::convertIntToUC2(service->multicastMap->index, serviceLookup->remotePort);
+    else
+        SNCUtils::convertIntToUC2(service->port, serviceLookup->remotePort);
+    SNCUtils::convertIntToUC2(componentIndex, serviceLookup->componentIndex);
+    if (serviceLookup->serviceType == SERVICETYPE_MULTICAST) {		// must add this to the registered components list
+        if (m_server->m_multicastManager.MMCheckRegistered(service->multicastMap,
+                    sourceUID, SNCUtils::convertUC2ToInt(serviceLookup->localPort))) { // already there - just a refresh
+            SNCUtils::logDebug(TAG, QString("Refreshed reg from component %1 to source %2 port %3")
+                .arg(SNCUtils::displayUID(sourceUID)).arg(SNCUtils::displayUID(&component->componentUID))
+                .arg(SNCUtils::convertUC2ToInt(serviceLookup->localPort)));
+            serviceLookup->response = SERVICE_LOOKUP_SUCCEED;
+            return true;
+        }
+        //	Must add as this is a new one
+        m_server->m_multicastManager.MMAddRegistered(service->multicastMap, sourceUID,
+                    SNCUtils::convertUC2ToInt(serviceLookup->localPort), minInterval, everyNth, noCache);
+        SNCUtils::logDebug(TAG, QString("Added reg request from component %1 to source %2 port %3")
+            .arg(SNCUtils::displayUID(sourceUID))
+            .arg(SNCUtils::displayUID(&component->componentUID))
+            .arg(SNCUtils::convertUC2ToInt(serviceLookup->localPort)));
+    } else {
+        SNCUtils::logDebug(TAG, QString("Refreshed E2E lookup from component %1 to source %2 port %3")
+            .arg(SNCUtils::displayUID(sourceUID)).arg(SNCUtils::displayUID(&component->componentUID))
+            .arg(SNCUtils::convertUC2ToInt(serviceLookup->localPort)));
+    }
+    serviceLookup->response = SERVICE_LOOKUP_SUCCEED;
+    return true;
 }
 
 
@@ -509,6 +528,55 @@ void DirectoryManager::DMBuildDirectoryMessage(int offset, char **message, int *
     *messageLength = length + offset;								// total length of returned buffer
 }
 
+//	DMBuildServiceQueryResponse - generates a list of service paths that match a query filter
+//
+//	If the query specifies a stream type, only services in that stream's index bucket are checked.
+//	Otherwise every indexed service is checked - still much cheaper than sending the whole directory.
+
+void DirectoryManager::DMBuildServiceQueryResponse(SNC_SERVICE_QUERY *query, char **message, int *messageLength)
+{
+    SNC_SERVICE_QUERY *response;
+    DM_SERVICE *service;
+    QList<DM_SERVICE *> candidates;
+    QByteArray paths;
+    QByteArray path;
+    int count;
+
+    query->streamName[SNC_MAX_SERVNAME - 1] = 0;			// make sure strings are 0 terminated
+    query->appNamePrefix[SNC_MAX_APPNAME - 1] = 0;
+    query->regionName[SNC_MAX_REGIONNAME - 1] = 0;
+
+    QMutexLocker locker(&m_lock);
+
+    if (query->streamName[0] != 0)
+        candidates = m_streamIndex.values(streamType(query->streamName));
+    else
+        candidates = m_streamIndex.values();
+
+    count = 0;
+    for (int i = 0; i < candidates.count(); i++) {
+        service = candidates.at(i);
+        if (!matchServiceQuery(query, service))
+            continue;
+        path = QByteArray(service->component->appName) + SNC_SERVICEPATH_SEP + service->serviceName;
+        if ((count == 0xffff) ||
+                ((int)(sizeof(SNC_SERVICE_QUERY) + paths.length() + path.length() + 1) > SNC_MESSAGE_MAX_LENGTH)) {
+            SNCUtils::logWarn(TAG, QString("Service query response truncated at %1 paths").arg(count));
+            break;
+        }
+        paths.append(path);
+        paths.append((char)0);
+        count++;
+    }
+
+    *messageLength = sizeof(SNC_SERVICE_QUERY) + paths.length();
+    response = (SNC_SERVICE_QUERY *)malloc(*messageLength);
+    memcpy(response, query, sizeof(SNC_SERVICE_QUERY));
+    SNCUtils::convertIntToUC2(count, response->count);
+    memcpy(response + 1, paths.constData(), paths.length());
+    *message = (char *)response;
+}
+
 //
 //	End of public function section
 //
@@ -520,10 +588,9 @@ void	DirectoryManager::buildLocalDE(DM_COMPONENT *component)
     int i;
     char *DE;
 
-    if (component->localDE != NULL) {
+    if ((component->localDE != NULL) && (component->localDE != component->originalDE))
         free(component->localDE);
-        component->localDE = NULL;
-    }
+    component->localDE = NULL;
     DE = component->localDE = (char *)malloc(strlen(component->originalDE)*2+1);	// pretty much worst case
 
     DE[0] = 0;
@@ -561,25 +628,189 @@ char *DirectoryManager::DMGetLastErr()
 }
 
 
-DM_COMPONENT *DirectoryManager::findComponent(DM_CONNECTEDCOMPONENT *connectedComponent, SNC_UID *UID, char *name, char *type)
+//	findComponent compares interned names and types by pointer. A NULL atom means that
+//	the string has never been seen so it can't match an existing component.
+
+DM_COMPONENT *DirectoryManager::findComponent(DM_CONNECTEDCOMPONENT *connectedComponent, SNC_UID *UID, const char *nameAtom, const char *typeAtom)
 {
     DM_COMPONENT *component;
+    DM_COMPONENT *nextComponent;
 
     component = connectedComponent->componentDE;
     while (component != NULL) {
+        nextComponent = component->next;					// component may be deleted below
         if (SNCUtils::compareUID(UID, &(component->componentUID))) {	// found correct UID
-            if ((strcmp(name, component->appName) == 0) && (strcmp(type, component->componentType) == 0))
+            if ((nameAtom == component->appNameAtom) && (typeAtom == component->componentTypeAtom))
                 return component;							// found it
             //	Correct UID but mismatch on name or type. Implies a new component on same instance.
             //	Delete this old entry and carry on looking - there can't be two components on the same UID!
             deleteComponent(connectedComponent, component);
         }
-        component = component->next;
+        component = nextComponent;
     }
     return NULL;									// not there
 }
 
 
+//	indexComponent adds all multicast and E2E services of a component to the stream index
+//	and the service hash tables. It must be called after the services array is complete, the
+//	component is linked into its connected component and with the lock held.
+
+void DirectoryManager::indexComponent(DM_COMPONENT *component)
+{
+    DM_SERVICE *service;
+    int i;
+
+    service = component->services;
+    for (i = 0; i < component->serviceCount; i++, service++) {
+        if (!service->valid || (service->serviceType == SERVICETYPE_NOSERVICE))
+            continue;
+        m_streamIndex.insert(streamType(service->serviceName), service);
+        linkServiceHash(m_pathHash + serviceHash(component->appName, service->serviceName), service, true);
+        linkServiceHash(m_nameHash + serviceHash("", service->serviceName), service, false);
+    }
+}
+
+void DirectoryManager::unindexComponent(DM_COMPONENT *component)
+{
+    DM_SERVICE *service;
+    int i;
+
+    service = component->services;
+    for (i = 0; i < component->serviceCount; i++, service++) {
+        if (!service->valid || (service->serviceType == SERVICETYPE_NOSERVICE))
+            continue;
+        m_streamIndex.remove(streamType(service->serviceName), service);
+        unlinkServiceHash(m_pathHash + serviceHash(component->appName, service->serviceName), service, true);
+        unlinkServiceHash(m_nameHash + serviceHash("", service->serviceName), service, false);
+    }
+}
+
+//	serviceHash is FNV-1a over appName, a separator and serviceName. An empty appName
+//	is used for the serviceName only table.
+
+unsigned int DirectoryManager::serviceHash(const char *appName, const char *serviceName)
+{
+    unsigned int hash = 2166136261u;
+
+    while (*appName != 0)
+        hash = (hash ^ (unsigned char)*appName++) * 16777619u;
+    hash = (hash ^ (unsigned char)SNC_SERVICEPATH_SEP) * 16777619u;
+    while (*serviceName != 0)
+        hash = (hash ^ (unsigned char)*serviceName++) * 16777619u;
+    return hash & (DM_SERVICE_HASH_SIZE - 1);
+}
+
+//	linkServiceHash keeps each chain in the order that a scan of the whole directory would
+//	find the services, so that a lookup matching more than one component gets the same
+//	one as before there were hash tables
+
+void DirectoryManager::linkServiceHash(DM_SERVICE **chain, DM_SERVICE *service, bool pathChain)
+{
+    while ((*chain != NULL) && !servicePrecedes(service, *chain))
+        chain = pathChain ? &((*chain)->pathHashNext) : &((*chain)->nameHashNext);
+
+    if (pathChain)
+        service->pathHashNext = *chain;
+    else
+        service->nameHashNext = *chain;
+    *chain = service;
+}
+
+//	servicePrecedes returns true if a full scan would reach service before other - connected
+//	components in index order, then each connected component's list and then port order
+
+bool DirectoryManager::servicePrecedes(DM_SERVICE *service, DM_SERVICE *other)
+{
+    DM_COMPONENT *component;
+
+    if (service->component->connectedComponentIndex != other->component->connectedComponentIndex)
+        return service->component->connectedComponentIndex < other->component->connectedComponentIndex;
+
+    if (service->component == other->component)
+        return service->port < other->port;
+
+    component = m_directory[service->component->connectedComponentIndex].componentDE;
+    while (component != NULL) {
+        if (component == service->component)
+            return true;
+        if (component == other->component)
+            return false;
+        component = component->next;
+    }
+    return false;
+}
+
+void DirectoryManager::unlinkServiceHash(DM_SERVICE **chain, DM_SERVICE *service, bool pathChain)
+{
+    while (*chain != NULL) {
+        if (*chain == service) {
+            *chain = pathChain ? service->pathHashNext : service->nameHashNext;
+            return;
+        }
+        chain = pathChain ? &((*chain)->pathHashNext) : &((*chain)->nameHashNext);
+    }
+}
+
+//	streamType returns the part of the service name before the stream type separator
+//	so that "avmux:lr" is indexed with "avmux"
+
+QString DirectoryManager::streamType(const char *serviceName)
+{
+    const char *sep;
+
+    sep = strchr(serviceName, SNC_STREAM_TYPE_SEP);
+    if (sep == NULL)
+        return QString(serviceName);
+    return QString::fromLatin1(serviceName, (int)(sep - serviceName));
+}
+
+bool DirectoryManager::matchServiceQuery(SNC_SERVICE_QUERY *query, DM_SERVICE *service)
+{
+    if ((query->serviceType != SERVICE_QUERY_ANYTYPE) && (query->serviceType != service->serviceType))
+        return false;
+
+    if (strchr(query->streamName, SNC_STREAM_TYPE_SEP) != NULL) {
+        if (strcmp(query->streamName, service->serviceName) != 0)
+            return false;								// fully qualified stream name must match exactly
+    }
+
+    if (strncmp(query->appNamePrefix, service->component->appName, strlen(query->appNamePrefix)) != 0)
+        return false;
+
+    if ((query->regionName[0] != 0) && (strcmp(query->regionName, "*") != 0))
+        return matchRegion(query->regionName, service->component->connectedComponentIndex);
+
+    return true;
+}
+
+//	matchRegion checks the region of the SNCControl through which a connected component is reached.
+//	Directly connected components are in this SNCControl's region. Components received over a tunnel
+//	are in the region of the SNCControl at the other end, which is in the tunnel's own DE.
+
+bool DirectoryManager::matchRegion(const char *region, int connectedComponentIndex)
+{
+    DM_CONNECTEDCOMPONENT *connectedComponent;
+    DM_COMPONENT *component;
+    SNC_HEARTBEAT heartbeat;
+
+    connectedComponent = m_directory + connectedComponentIndex;
+
+    if (SNCUtils::convertUC2ToInt(connectedComponent->connectedComponentUID.instance) >= INSTANCE_COMPONENT) {
+        heartbeat = m_server->m_componentData.getMyHeartbeat();
+        return strcmp(region, heartbeat.hello.appName) == 0;
+    }
+
+    component = connectedComponent->componentDE;
+    while (component != NULL) {
+        if (SNCUtils::compareUID(&(component->componentUID), &(connectedComponent->connectedComponentUID)))
+            return strcmp(region, component->appName) == 0;
+        component = component->next;
+    }
+    return false;
+}
+
+
 void DirectoryManager::freeConnectedComponent(DM_CONNECTEDCOMPONENT *connectedComponent)
 {
     if (connectedComponent == NULL || !connectedComponent->valid)
@@ -627,6 +858,12 @@ void	DirectoryManager::deleteComponent(DM_CONNECTEDCOMPONENT *connectedComponent
 
 //	pDMC is now off the list
 
+    unindexComponent(component);
+    releaseAtom(component->appNameAtom);
+    releaseAtom(component->componentTypeAtom);
+    component->appNameAtom = NULL;
+    component->componentTypeAtom = NULL;
+
     component->componentType[0] = 0;
     component->appName[0] = 0;
     component->UIDStr[0] = 0;
@@ -640,204 +877,256 @@ void	DirectoryManager::deleteComponent(DM_CONNECTEDCOMPONENT *connectedComponent
             service->multicastMap = NULL;
         }
     }
+    if ((component->localDE != NULL) && (component->localDE != component->originalDE))
+        free(component->localDE);
+    component->localDE = NULL;
+
     if (component->originalDE != NULL) {
         free(component->originalDE);
         component->originalDE = NULL;
     }
-
-    if (component->localDE != NULL) {
-        free(component->localDE);
-        component->localDE = NULL;
-    }
     free(component);
 }
 
 
 //---------------------------------------------------------------------------
 //
-//	Tag read related routines
-
-//	getStartTag  - used to get a specific next start tag
+//	Zero copy DE parser
+//
+//	parseDE makes a single pass over a component DE, recording views into the DE buffer
+//	rather than copying values. Characters outside of tags are skipped as the tag routines
+//	below do but clear canonical, as does a mismatched closing service tag.
 
-bool DirectoryManager::getStartTag(const char *startTag)
+bool DirectoryManager::parseDE(const char *DE, DM_PARSEDDE *parsedDE)
 {
-    char tag[SNC_MAX_TAG];
-
-    if (!getTag(tag))
+    const char *ptr;
+    DM_DEVIEW tag;
+    DM_DEVIEW closeTag;
+    DM_DEVIEW *value;
+    int serviceType;
+
+    ptr = DE;
+    parsedDE->serviceCount = 0;
+    parsedDE->canonical = true;
+    parsedDE->componentTag = false;
+
+    if (!parseDETag(&ptr, &tag, &parsedDE->canonical))
         return false;
-    if (strcmp(tag, startTag) == 0)
-        return true;
-    else {
-        sprintf(m_lastError, "getStartTag - wrong start tag %s instead of %s", tag, startTag);
+    if (!viewEquals(&tag, DETAG_COMP)) {
+        strcpy(m_lastError, "DE does not start with component tag");
         return false;
     }
-}
+    parsedDE->componentTag = true;
 
-//	skipToStartTag  - used to skip until a specific start tag is found
+    if (!parseDEValue(&ptr, DETAG_UID, &parsedDE->UID, &parsedDE->canonical))
+        return false;
+    if (!parseDEValue(&ptr, DETAG_APPNAME, &parsedDE->appName, &parsedDE->canonical))
+        return false;
+    if (!parseDEValue(&ptr, DETAG_COMPTYPE, &parsedDE->componentType, &parsedDE->canonical))
+        return false;
 
-bool DirectoryManager::skipToStartTag(const char *startTag)
-{
-    char tag[SNC_MAX_TAG];
+    if ((parsedDE->UID.length >= (int)sizeof(SNC_UIDSTR)) || (parsedDE->appName.length >= SNC_MAX_APPNAME) ||
+            (parsedDE->componentType.length >= SNC_MAX_COMPTYPE)) {
+        strcpy(m_lastError, "Component header value too long in DE");
+        return false;
+    }
 
     while (1) {
-        if (!getTag(tag))
-            return false;
-        if (strcmp(tag, startTag) == 0)
+        if (!parseDETag(&ptr, &tag, &parsedDE->canonical)) {
+            parsedDE->canonical = false;					// no component end tag but accept what we have
             return true;
+        }
+        if (viewEquals(&tag, DETAG_COMP_END))
+            return true;									// hit end of component
+
+        if (parsedDE->serviceCount == SNC_MAX_SERVICESPERCOMPONENT) {
+            strcpy(m_lastError, "Too many services in DE");
+            return false;
+        }
+
+        if (viewEquals(&tag, DETAG_MSERVICE)) {
+            serviceType = SERVICETYPE_MULTICAST;
+        } else if (viewEquals(&tag, DETAG_ESERVICE)) {
+            serviceType = SERVICETYPE_E2E;
+        } else if (viewEquals(&tag, DETAG_NOSERVICE)) {
+            serviceType = SERVICETYPE_NOSERVICE;
+        } else {
+            strcpy(m_lastError, "Incorrect service type in DE");
+            return false;
+        }
+
+        value = parsedDE->serviceName + parsedDE->serviceCount;
+        value->ptr = ptr;
+        while ((*ptr != 0) && (*ptr != '<'))
+            ptr++;
+        if (*ptr == 0) {
+            strcpy(m_lastError, "parseDE - hit end of directory before closing tag");
+            return false;
+        }
+        value->length = (int)(ptr - value->ptr);
+        if (value->length >= SNC_MAX_SERVNAME) {
+            strcpy(m_lastError, "Service name too long in DE");
+            return false;
+        }
+        if ((serviceType == SERVICETYPE_NOSERVICE) && (value->length > 0))
+            parsedDE->canonical = false;					// buildLocalDE doesn't keep this
+
+//	Get closing tag - don't really need to be fussy here
+
+        if (!parseDETag(&ptr, &closeTag, &parsedDE->canonical))
+            return false;
+        if ((closeTag.length != tag.length + 1) || (closeTag.ptr[0] != '/') ||
+                (memcmp(closeTag.ptr + 1, tag.ptr, tag.length) != 0))
+            parsedDE->canonical = false;
+
+        parsedDE->serviceType[parsedDE->serviceCount++] = serviceType;
     }
 }
 
+//	parseDETag returns the next tag in the DE as a view and leaves ptr after the closing '>'
 
-//	getEndTag  - used to get a specific end tag
-
-bool DirectoryManager::getEndTag(const char *endTag)
+bool DirectoryManager::parseDETag(const char **ptr, DM_DEVIEW *tag, bool *canonical)
 {
-    char tag[SNC_MAX_TAG];
+    const char *p;
 
-    if (!getTag(tag))
+    p = *ptr;
+    while ((*p != 0) && (*p != '<')) {
+        p++;
+        *canonical = false;
+    }
+    if (*p == 0) {
+        strcpy(m_lastError, "parseDETag - hit end of directory before tag");
+        *ptr = p;
         return false;
-    if (tag[0] != '/') {
-        sprintf(m_lastError, "getEndTag - not end tag %s", tag);
-        return false;							// not an end tag
     }
-    if (strcmp(tag+1, endTag) == 0)
-        return true;
-    else {
-        sprintf(m_lastError, "getEndTag - wrong tag %s instead of %s", tag, endTag);
-        return false;							// not an end tag
+    tag->ptr = ++p;
+    while ((*p != 0) && (*p != '>'))
+        p++;
+    if (*p == 0) {
+        strcpy(m_lastError, "parseDETag - hit end of directory before tag");
+        *ptr = p;
+        return false;
     }
+    tag->length = (int)(p - tag->ptr);
+    *ptr = p + 1;
+    return true;
 }
 
-//	skipToEndTag  - used to skip until a specific end tag is found
+//	parseDEValue gets a view of the value of a <tag>value</tag> sequence
 
-bool	DirectoryManager::skipToEndTag(const char *endTag)
+bool DirectoryManager::parseDEValue(const char **ptr, const char *tag, DM_DEVIEW *value, bool *canonical)
 {
-    char tag[SNC_MAX_TAG];
+    DM_DEVIEW tagView;
+    const char *p;
 
-    while (1) {
-        if (!getTag(tag))
-            return false;
-        if (tag[0] != '/')
-            continue;
-        if (strcmp(tag+1, endTag) == 0)
-            return true;
+    if (!parseDETag(ptr, &tagView, canonical))
+        return false;
+    if (!viewEquals(&tagView, tag)) {
+        sprintf(m_lastError, "parseDEValue - wrong start tag instead of %s", tag);
+        return false;
     }
-}
-
 
-//	Gets a non-tag string. pStr must point to an array of size at least SNC_MAX_NONTAG
-
-bool DirectoryManager::getNonTag(char *str)
-{
-    char c;
-    int pos;
+    p = value->ptr = *ptr;
+    while ((*p != 0) && (*p != '<'))
+        p++;
+    if (*p == 0) {
+        strcpy(m_lastError, "parseDEValue - hit end of directory before closing tag");
+        return false;
+    }
+    value->length = (int)(p - value->ptr);
+    *ptr = p;
 
-    pos = 0;
-    while ((c = *m_tagPtr) != 0) {
-        if (c == '<') {										// hit start of tag
-            str[pos] = 0;
-            return true;
-        }
-        str[pos++] = c;
-        if (pos == SNC_MAX_NONTAG)
-            pos--;
-        m_tagPtr++;
+    if (!parseDETag(ptr, &tagView, canonical))
+        return false;
+    if ((tagView.length < 1) || (tagView.ptr[0] != '/')) {
+        sprintf(m_lastError, "parseDEValue - not end tag for %s", tag);
+        return false;
     }
-    strcpy(m_lastError, "getNonTag - hit end of directory before closing tag");
-    return false;
+    tagView.ptr++;
+    tagView.length--;
+    if (!viewEquals(&tagView, tag)) {
+        sprintf(m_lastError, "parseDEValue - wrong end tag instead of %s", tag);
+        return false;
+    }
+    return true;
 }
 
-//	Gets the next tag in the config file. pTag must point to an array of size at least SNC_MAX_TAG
-
-bool DirectoryManager::getTag(char *tag)
+bool DirectoryManager::viewEquals(DM_DEVIEW *view, const char *str)
 {
-    int pos;
-    char c;
-    bool intag;
-
-    pos = 0;
-    intag = false;
-    while ((c = *m_tagPtr) != 0) {
-        m_tagPtr++;
-        if (intag) {
-            if (c == '>') {									// end of tag
-                tag[pos] = 0;
-                return true;
-            }
-            tag[pos++] = c;
-            if (pos == SNC_MAX_TAG)
-                pos--;
-        } else {
-            if (c == '<')
-                intag = true;
-        }
-    }
-    strcpy(m_lastError, "getTag - hit end of directory before tag");
-    return false;
+    return (strncmp(view->ptr, str, view->length) == 0) && (str[view->length] == 0);
 }
 
+//---------------------------------------------------------------------------
+//
+//	String interning for app names and component types
 
-//		Value reading routines
+unsigned int DirectoryManager::atomHash(const char *str, int length)
+{
+    unsigned int hash = 2166136261u;
 
-//	GetSimpleBool gets a bool value with the specified tag (in pValueTag) using the current position
+    while (length-- > 0)
+        hash = (hash ^ (unsigned char)*str++) * 16777619u;
+    return hash & (DM_ATOM_HASH_SIZE - 1);
+}
 
-bool	DirectoryManager::getSimpleBool(const char *valueTag, bool *boolValue)
+const char *DirectoryManager::findAtom(DM_DEVIEW *view)
 {
-    char value[SNC_MAX_NONTAG];
+    DM_ATOM *atom;
 
-    if (!getSimpleValue(valueTag, value))
-        return false;
-    if (strcmp(value, "Y") == 0) {
-        *boolValue = true;
-        return true;
-    }
-    if (strcmp(value, "N") == 0) {
-        *boolValue = false;
-        return true;
+    atom = m_atomHash[atomHash(view->ptr, view->length)];
+    while (atom != NULL) {
+        if ((atom->length == view->length) && (memcmp(atom->str, view->ptr, view->length) == 0))
+            return atom->str;
+        atom = atom->next;
     }
-    return false;
+    return NULL;
 }
 
-//	GetSimpleInt gets an int value with the specified tag (in pValueTag) using the current position
-
-bool DirectoryManager::getSimpleInt(const char *valueTag, int *intValue)
+const char *DirectoryManager::internAtom(DM_DEVIEW *view)
 {
-    char value[SNC_MAX_NONTAG];
+    DM_ATOM *atom;
+    unsigned int hash;
+
+    hash = atomHash(view->ptr, view->length);
+    atom = m_atomHash[hash];
+    while (atom != NULL) {
+        if ((atom->length == view->length) && (memcmp(atom->str, view->ptr, view->length) == 0)) {
+            atom->refCount++;
+            return atom->str;
+        }
+        atom = atom->next;
+    }
 
-    if (!getSimpleValue(valueTag, value))
-        return false;
-    sscanf(value, "%d", intValue);
-    return true;
+    atom = (DM_ATOM *)malloc(sizeof(DM_ATOM) + view->length);
+    memcpy(atom->str, view->ptr, view->length);
+    atom->str[view->length] = 0;
+    atom->length = view->length;
+    atom->refCount = 1;
+    atom->next = m_atomHash[hash];
+    m_atomHash[hash] = atom;
+    return atom->str;
 }
 
-//	getSimpleValue gets an stringe with the specified tag (in pValueTag) using the current position.
-//	pValue must point to an array of at least SNC_MAX_NONTAG in size.
-
-bool DirectoryManager::getSimpleValue(const char *valueTag, char *value)
+void DirectoryManager::releaseAtom(const char *atomStr)
 {
-    if (!getStartTag(valueTag))
-        return false;
-    if (!getNonTag(value))
-        return false;
-    return getEndTag(valueTag);
-}
+    DM_ATOM *atom;
+    DM_ATOM **chain;
 
-//	getSimpleValue gets a string with the specified tag (in valueTag) using the current position.
-//	pValue must point to an array of at least maxLen in size.
+    if (atomStr == NULL)
+        return;
 
-bool DirectoryManager::getSimpleValue(const char *valueTag, char *value, int maxLen)
-{
-    char temp[SNC_MAX_NONTAG];
+    atom = (DM_ATOM *)(atomStr - offsetof(DM_ATOM, str));
+    if (--atom->refCount > 0)
+        return;
 
-    if (!getStartTag(valueTag))
-        return false;
-    if (!getNonTag(temp))
-        return false;
-    if (((int)strlen(temp) >= maxLen) || (maxLen >= SNC_MAX_NONTAG)){
-        strcpy(m_lastError, "getSimpleValue - value too long");
-        return false;
+    chain = m_atomHash + atomHash(atom->str, atom->length);
+    while (*chain != NULL) {
+        if (*chain == atom) {
+            *chain = atom->next;
+            break;
+        }
+        chain = &((*chain)->next);
     }
-    strcpy(value, temp);
-    return getEndTag(valueTag);
+    free(atom);
 }
 
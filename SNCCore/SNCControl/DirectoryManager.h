@@ -26,20 +26,29 @@
 
 #include "MulticastManager.h"
 
+#include <qhash.h>
+
 //  This is the DM_SERVICE data structure. It captures the service path for each service that has been advertised.
 //
 //  It also includes the UID and sequence of the component so that this structure can be used by a client
 //  to identify the host component for the service
 
-typedef struct
+struct _DM_COMPONENT;
+
+typedef struct _DM_SERVICE
 {
     bool valid;                                             // if this service port number is in use
     char serviceName[SNC_MAX_SERVNAME];                     // the service's name
     int port;                                               // the service port number (i.e. the service's index in the component DE)
     int serviceType;                                        // the type of service
     MM_MMAP *multicastMap;                                  // the multicast map entry (not used for end to end services)
+    struct _DM_COMPONENT *component;                        // the component that owns this service
+    struct _DM_SERVICE *pathHashNext;                       // next in the appName/serviceName hash chain
+    struct _DM_SERVICE *nameHashNext;                       // next in the serviceName hash chain
 } DM_SERVICE;
 
+#define DM_SERVICE_HASH_SIZE    8192                        // number of buckets in each service hash table (must be a power of 2)
+
 
 //  This is the DM_COMPONENT data structure. It contains information relevant to a component's services
 
@@ -55,9 +64,48 @@ typedef struct _DM_COMPONENT
     SNC_UIDSTR UIDStr;                                      // the string version
     DM_SERVICE services[SNC_MAX_SERVICESPERCOMPONENT];      // the actual service array
     int serviceCount;                                       // number of entries in array
+    int connectedComponentIndex;                            // index of the connected component that supplied the DE
+    const char *appNameAtom;                                // interned app name (allows pointer compares)
+    const char *componentTypeAtom;                          // interned component type
     struct _DM_COMPONENT *next;
 } DM_COMPONENT;
 
+//  DM_DEVIEW is a reference to a value inside a received DE buffer so that DEs can be parsed
+//  without copying
+
+typedef struct
+{
+    const char *ptr;                                        // start of the value in the DE
+    int length;                                             // length of the value
+} DM_DEVIEW;
+
+//  DM_PARSEDDE is the result of parsing a single component's DE
+
+typedef struct
+{
+    DM_DEVIEW UID;                                          // the UID string
+    DM_DEVIEW appName;                                      // the app name
+    DM_DEVIEW componentType;                                // the component type
+    DM_DEVIEW serviceName[SNC_MAX_SERVICESPERCOMPONENT];    // the service names
+    int serviceType[SNC_MAX_SERVICESPERCOMPONENT];          // the service types
+    int serviceCount;                                       // number of services in the DE
+    bool canonical;                                         // true if the DE is exactly as buildLocalDE would generate it
+    bool componentTag;                                      // true if the entry started with a component tag
+} DM_PARSEDDE;
+
+//  DM_ATOM is an interned string. Components with the same app name or component type share
+//  the same atom so that they can be compared by pointer.
+
+typedef struct _DM_ATOM
+{
+    struct _DM_ATOM *next;                                  // next in hash chain
+    int refCount;                                           // number of components using this atom
+    int length;                                             // length of the string
+    char str[1];                                            // the string itself (allocated to length + 1)
+} DM_ATOM;
+
+#define DM_ATOM_HASH_SIZE       1024                        // number of buckets in the atom hash table (must be a power of 2)
+
 //  DM_CONNECTEDCOMPONENT - contains information about each directly connected component
 
 typedef struct
@@ -99,7 +147,7 @@ public:
 //  If found, returns true and sets the service and component pointers appropriately.
 //  If not, returns false and sets the pointers to NULL.
 
-    bool DMFindService(SNC_UID *sourceUID, SNC_SERVICE_LOOKUP *serviceLookup);
+    bool DMFindService(SNC_UID *sourceUID, SNC_SERVICE_LOOKUP *serviceLookup, bool batched = false);
 
 //  DMAllocateConnectedComponent finds a spare slot in the connected component array. pData is
 //  what is used for related FUL entries and is normally a pointer to the associated SS_COMPONENT.
@@ -119,6 +167,12 @@ public:
 
     void DMBuildDirectoryMessage(int offset, char **message, int *messageLength, bool trunk);
 
+//  DMBuildServiceQueryResponse builds a SERVICE_QUERY_RESPONSE message containing the paths of
+//  the services that match the filter in query. The returned buffer starts with a copy of
+//  query with the count field filled in.
+
+    void DMBuildServiceQueryResponse(SNC_SERVICE_QUERY *query, char **message, int *messageLength);
+
 //	DMDisplay - displays directory
 //	m_pLB must be set to the display dialog for Windows.
 
@@ -126,22 +180,6 @@ public:
 
     char *DMGetLastErr();                                   // returns a string diagnostic
 
-//  Tag read related routines
-
-    bool getStartTag(const char *startTag);                 // get next tag and check that it is the one expected
-    bool skipToStartTag(const char *startTag);              // get next specified start tag
-    bool getEndTag(const char *endTag);                     // same for the end tag
-    bool skipToEndTag(const char *endTag);                  // skip to the desired end tag
-    bool getNonTag(char *str);                              // gets the  non-tag value
-    bool getTag(char *tag);                                 // returns the next tag (any tag)
-
-//  Value reading routines
-
-    bool getSimpleBool(const char *tag, bool *boolValue);   // gets a bool value
-    bool getSimpleInt(const char *tag, int *intValue);      // gets an integer value
-    bool getSimpleValue(const char *tag, char *value);      // gets a string value (pValue should be of size SNC_MAX_NONTAG)
-    bool getSimpleValue(const char *tag, char *value, int maxLen);  // gets a string value (value should be of size nMaxLen)
-
 //  m_directory accesses should always use the lock
 
     DM_CONNECTEDCOMPONENT m_directory[SNC_MAX_CONNECTEDCOMPONENTS]; // the directory array
@@ -158,10 +196,33 @@ protected:
     void deleteComponent(DM_CONNECTEDCOMPONENT *connectedComponent, DM_COMPONENT *component); // frees up a component entry
     void buildLocalDE(DM_COMPONENT *component);
 
-    DM_COMPONENT *findComponent(DM_CONNECTEDCOMPONENT *connectedComponent, SNC_UID *UID, char *name, char *type);// finds a component in the directory given its UID
+    DM_COMPONENT *findComponent(DM_CONNECTEDCOMPONENT *connectedComponent, SNC_UID *UID, const char *nameAtom, const char *typeAtom);// finds a component in the directory given its UID
+
+    bool parseDE(const char *DE, DM_PARSEDDE *parsedDE);    // parses a component DE in a single pass without copying
+    bool parseDETag(const char **ptr, DM_DEVIEW *tag, bool *canonical); // gets the next tag as a view
+    bool parseDEValue(const char **ptr, const char *tag, DM_DEVIEW *value, bool *canonical); // gets <tag>value</tag>
+    bool viewEquals(DM_DEVIEW *view, const char *str);      // compares a view with a string
+    unsigned int atomHash(const char *str, int length);     // hash for the atom table
+    const char *findAtom(DM_DEVIEW *view);                  // returns the atom for a view or NULL if not interned
+    const char *internAtom(DM_DEVIEW *view);                // returns the atom for a view, creating it if necessary
+    void releaseAtom(const char *atom);                     // drops a reference to an atom
+
+    void indexComponent(DM_COMPONENT *component);           // adds a component's services to the stream index
+    void unindexComponent(DM_COMPONENT *component);         // removes a component's services from the stream index
+    QString streamType(const char *serviceName);            // returns the stream type part of a service name
+    bool matchServiceQuery(SNC_SERVICE_QUERY *query, DM_SERVICE *service); // checks a service against a query filter
+    bool matchRegion(const char *region, int connectedComponentIndex); // checks the region of a connected component
+    unsigned int serviceHash(const char *appName, const char *serviceName); // hash for the service hash tables
+    void linkServiceHash(DM_SERVICE **chain, DM_SERVICE *service, bool pathChain); // adds a service to a hash chain in scan order
+    void unlinkServiceHash(DM_SERVICE **chain, DM_SERVICE *service, bool pathChain); // removes a service from a hash chain
+    bool servicePrecedes(DM_SERVICE *service, DM_SERVICE *other); // true if a directory scan finds service first
 
     int m_sequenceID;                                       // used to uniquely identify DEs in case they are updated in place
-    char *m_tagPtr;                                         // the current pointer into the DE
+    QMultiHash<QString, DM_SERVICE *> m_streamIndex;        // multicast and E2E services indexed by stream type
+    DM_PARSEDDE m_parsedDE;                                 // the DE currently being processed
+    DM_ATOM *m_atomHash[DM_ATOM_HASH_SIZE];                 // the interned app names and component types
+    DM_SERVICE *m_pathHash[DM_SERVICE_HASH_SIZE];           // services hashed on appName and serviceName
+    DM_SERVICE *m_nameHash[DM_SERVICE_HASH_SIZE];           // services hashed on serviceName alone
     char m_lastError[SNC_MAX_TAG+SNC_MAX_NONTAG];           // a diagnostic string if an error occurs
 };
 
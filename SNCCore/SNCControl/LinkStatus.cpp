@@ -43,9 +43,9 @@ void LinkStatus::getDialog(QJsonObject& newDialog)
     QString e2e;
 
     headers << "App name" << "Component type" << "Unique ID" << "IP Address" << "HB interval" << "Link type"
-                        << "RX bytes" << "TX bytes" << "RX rate" << "TX rate";
+                        << "RX bytes" << "TX bytes" << "RX rate" << "TX rate" << "TX queued" << "TX dropped (bytes)";
 
-    widths << 120 << 120 << 120 << 100 << 80 << 120 << 100 << 100 << 100 << 100;
+    widths << 120 << 120 << 120 << 100 << 80 << 120 << 100 << 100 << 100 << 100 << 100 << 140;
 
     clearDialog();
     getLinkStatusTable(data);
@@ -24,25 +24,36 @@
 #include "MulticastManager.h"
 #include "SNCControl.h"
 #include "SNCServer.h"
+#include "SNCTrace.h"
+
+#include <qelapsedtimer.h>
 
 #define TAG "MulticastManager"
 
 MulticastManager::MulticastManager(void)
 {
-    int		i;
-
-    for (i = 0; i < SNCSERVER_MAX_MMAPS; i++) {
-        memset(m_multicastMap+i, 0, sizeof(MM_MMAP));
-        m_multicastMap[i].index = i;
-        m_multicastMap[i].valid = false;
-        m_multicastMap[i].head = NULL;
-    }
-    m_multicastMapSize = 0;
+    for (int i = 0; i < MM_MAX_SLABS; i++)
+        m_slabs[i] = NULL;
+    m_slabCount = 0;
+    m_freeHead = NULL;
+    m_activeHead = NULL;
+    m_activeCount = 0;
     m_lastBackground = SNCUtils::clock();
+    m_batchLookups = false;
+    m_cacheLimit = MM_CACHE_LIMIT_DEFAULT;
+    m_cacheMaxRecord = MM_CACHE_MAXRECORD_DEFAULT;
+    m_cacheBytes = 0;
+    m_cachePendingCount = 0;
+    m_heldAckCount = 0;
+    m_metricsEnabled = false;
+    m_fanoutTime = NULL;
 }
 
 MulticastManager::~MulticastManager(void)
 {
+    MMShutdown();
+    for (int i = 0; i < m_slabCount; i++)
+        free(m_slabs[i]);
 }
 
 
@@ -54,15 +65,29 @@ MulticastManager::~MulticastManager(void)
 
 void MulticastManager::MMShutdown()
 {
-    int i;
+    while (m_activeHead != NULL)
+        MMFreeMMap(m_activeHead);
+}
+
+//  MMGetMap must be called with the lock held
+
+MM_MMAP *MulticastManager::MMGetMap(int index)
+{
+    MM_MMAP *multicastMap;
 
-    for (i = 0; i < SNCSERVER_MAX_MMAPS; i++)
-        MMFreeMMap(m_multicastMap+i);
+    if ((index < 0) || ((index >> MM_SLAB_SHIFT) >= m_slabCount))
+        return NULL;
+    multicastMap = m_slabs[index >> MM_SLAB_SHIFT] + (index & (MM_SLAB_SIZE - 1));
+    if (!multicastMap->valid)
+        return NULL;
+    return multicastMap;
 }
 
-bool MulticastManager::MMAddRegistered(MM_MMAP *multicastMap, SNC_UID *UID, int port)
+bool MulticastManager::MMAddRegistered(MM_MMAP *multicastMap, SNC_UID *UID, int port, int minInterval,
+                    int everyNth, bool noCache)
 {
     MM_REGISTEREDCOMPONENT *registeredComponent;
+    QList<MM_FLOWWEIGHT> flowWeights;
 
     QMutexLocker locker(&m_lock);
     if (!multicastMap->valid) {
@@ -70,21 +95,41 @@ bool MulticastManager::MMAddRegistered(MM_MMAP *multicastMap, SNC_UID *UID, int
         return false;
     }
 
+    //  make sure there's space in the array for the new registration
+
+    if (multicastMap->registeredCount == multicastMap->registeredSize) {
+        multicastMap->registeredSize = (multicastMap->registeredSize == 0) ? MM_REGISTERED_INITIAL : multicastMap->registeredSize * 2;
+        multicastMap->registeredComponents = (MM_REGISTEREDCOMPONENT *)realloc(multicastMap->registeredComponents,
+                    multicastMap->registeredSize * sizeof(MM_REGISTEREDCOMPONENT));
+    }
+
     //  build REGISTEREDCOMPONENT for new registration
 
-    registeredComponent = (MM_REGISTEREDCOMPONENT *)malloc(sizeof(MM_REGISTEREDCOMPONENT));
+    registeredComponent = multicastMap->registeredComponents + multicastMap->registeredCount++;
     registeredComponent->sendSeq = 0;
     registeredComponent->lastAckSeq = 0;
+    registeredComponent->lastSendTime = 0;
+    registeredComponent->pendingMsg = NULL;
+    registeredComponent->pendingLen = 0;
+    registeredComponent->pendingCmd = 0;
+    registeredComponent->skipped = 0;
+    registeredComponent->cachePending = !noCache && (multicastMap->cachedMsg != NULL);
+    if (registeredComponent->cachePending)
+        m_cachePendingCount++;
+    registeredComponent->minInterval = minInterval;
+    registeredComponent->everyNth = everyNth;
+    registeredComponent->recordCount = 0;
+    registeredComponent->lastDeliveryTime = 0;
     memcpy(&(registeredComponent->registeredUID), UID, sizeof(SNC_UID));
     registeredComponent->port = port;
+    if (multicastMap->flowWeight != SNCLINK_FLOW_WEIGHT_DEFAULT)
+        addFlowWeight(flowWeights, UID, multicastMap, multicastMap->flowWeight);
 
-    //  Now safe to link in the new one
-
-    registeredComponent->next = multicastMap->head;
-    multicastMap->head = registeredComponent;
     multicastMap->lastLookupRefresh = SNCUtils::clock();    // don't time it out straightaway
     sendLookupRequest(multicastMap, true);                  // make sure there's a lookup request for the service
     emit MMRegistrationChanged(multicastMap->index);
+    locker.unlock();
+    applyFlowWeights(flowWeights);
     return true;
 }
 
@@ -92,6 +137,7 @@ bool MulticastManager::MMAddRegistered(MM_MMAP *multicastMap, SNC_UID *UID, int
 bool MulticastManager::MMCheckRegistered(MM_MMAP *multicastMap, SNC_UID *UID, int port)
 {
     MM_REGISTEREDCOMPONENT	*registeredComponent;
+    int i;
 
     QMutexLocker locker(&m_lock);
 
@@ -99,134 +145,306 @@ bool MulticastManager::MMCheckRegistered(MM_MMAP *multicastMap, SNC_UID *UID, in
         SNCUtils::logError(TAG, "Invalid MMAP referenced in CheckRegistered");
         return false;
     }
-    registeredComponent = multicastMap->head;
-    while (registeredComponent != NULL) {
+    registeredComponent = multicastMap->registeredComponents;
+    for (i = 0; i < multicastMap->registeredCount; i++, registeredComponent++) {
         if (SNCUtils::compareUID(UID, &(registeredComponent->registeredUID)) && (registeredComponent->port == port)) {
             multicastMap->lastLookupRefresh = SNCUtils::clock();// somebody still wants it
             return true;                                    // it is there
         }
-        registeredComponent = registeredComponent->next;
     }
     return false;                                           // not found
 }
 
 void MulticastManager::MMDeleteRegistered(SNC_UID *UID, int port)
 {
-    MM_REGISTEREDCOMPONENT *registeredComponent, *previousRegisteredComponent, *deletedRegisteredComponent;
-    int i;
+    MM_REGISTEREDCOMPONENT *registeredComponent;
     MM_MMAP *multicastMap;
+    QList<MM_FLOWWEIGHT> flowWeights;
+    int from, to;
 
     QMutexLocker locker(&m_lock);
-    multicastMap = m_multicastMap;
 
-    for (i = 0; i < m_multicastMapSize; i++, multicastMap++) {
-        if (!multicastMap->valid)
-            continue;
-        registeredComponent = multicastMap->head;
-        previousRegisteredComponent = NULL;
-        while (registeredComponent != NULL) {
-            if (SNCUtils::compareUID(UID, &(registeredComponent->registeredUID))) {
-                if ((port == -1) || (port == registeredComponent->port)) {  // this is a matched entry
-                    SNCUtils::logDebug(TAG, QString("Deleting multicast registration on %1 port %2 for %3")
-                        .arg(SNCUtils::displayUID(&registeredComponent->registeredUID)).arg(registeredComponent->port)
-                            .arg(SNCUtils::displayUID(UID)));
-                    if (previousRegisteredComponent == NULL) {  // its the head of the list
-                        multicastMap->head = registeredComponent->next;
-                    } else {                                // not the head so relink around
-                        previousRegisteredComponent->next = registeredComponent->next;
-                    }
-                    deletedRegisteredComponent = registeredComponent;
-                    registeredComponent = registeredComponent->next;
-                    free(deletedRegisteredComponent);
-                    emit MMRegistrationChanged(multicastMap->index);
-                    continue;
-                }
+    for (multicastMap = m_activeHead; multicastMap != NULL; multicastMap = multicastMap->nextActive) {
+
+        //  compact the array in place so that the remaining entries stay in order
+
+        registeredComponent = multicastMap->registeredComponents;
+        for (from = 0, to = 0; from < multicastMap->registeredCount; from++) {
+            if (SNCUtils::compareUID(UID, &(registeredComponent[from].registeredUID)) &&
+                    ((port == -1) || (port == registeredComponent[from].port))) {  // this is a matched entry
+                SNCUtils::logDebug(TAG, QString("Deleting multicast registration on %1 port %2 for %3")
+                    .arg(SNCUtils::displayUID(&registeredComponent[from].registeredUID)).arg(registeredComponent[from].port)
+                        .arg(SNCUtils::displayUID(UID)));
+                if (multicastMap->flowWeight != SNCLINK_FLOW_WEIGHT_DEFAULT)
+                    addFlowWeight(flowWeights, UID, multicastMap, SNCLINK_FLOW_WEIGHT_DEFAULT);
+                freePending(registeredComponent + from);
+                continue;
             }
-            previousRegisteredComponent = registeredComponent;
-            registeredComponent = registeredComponent->next;
+            if (to != from)
+                registeredComponent[to] = registeredComponent[from];
+            to++;
+        }
+        if (to != multicastMap->registeredCount) {
+            multicastMap->registeredCount = to;
+            emit MMRegistrationChanged(multicastMap->index);
         }
     }
+    locker.unlock();
+    applyFlowWeights(flowWeights);
 }
 
 
 void MulticastManager::MMForwardMulticastMessage(int cmd, SNC_MESSAGE *message, int len)
 {
     MM_REGISTEREDCOMPONENT *registeredComponent;
-    SNC_EHEAD *inEhead, *outEhead, *ackEhead;
+    SNC_EHEAD *inEhead, *ackEhead;
     unsigned char *msgCopy;
     int multicastMapIndex;
     MM_MMAP *multicastMap;
+    int i;
+
+    QElapsedTimer fanoutTimer;
 
     QMutexLocker locker (&m_lock);
     inEhead = (SNC_EHEAD *)message;
     multicastMapIndex = SNCUtils::convertUC2ToUInt(inEhead->destPort);  // get the dest port number (i.e. my slot number)
-    if (multicastMapIndex >= m_multicastMapSize) {
-        SNCUtils::logWarn(TAG, QString("Multicast message with illegal DPort %1").arg(multicastMapIndex));
-        return;
-    }
-    multicastMap = m_multicastMap + multicastMapIndex;      // get pointer to entry
-    if (!multicastMap->valid) {
-        SNCUtils::logWarn(TAG, QString("Multicast message on not in use map slot %1").arg(multicastMap->index));
+    multicastMap = MMGetMap(multicastMapIndex);             // get pointer to entry
+    if (multicastMap == NULL) {
+        SNCUtils::logWarn(TAG, QString("Multicast message on not in use map slot %1").arg(multicastMapIndex));
+        free(message);
         return;                                             // not in use - hmmm. Should not happen!
     }
     if (len < (int)sizeof(SNC_EHEAD)) {
         SNCUtils::logWarn(TAG, QString("Multicast message is too short %1").arg(len));
+        free(message);
         return;
     }
     if (!SNCUtils::compareUID(&(multicastMap->sourceUID), &(inEhead->sourceUID))) {
         SNCUtils::logWarn(TAG, QString("UID %1 of incoming multicast didn't match UID of slot %2")
             .arg(SNCUtils::displayUID(&inEhead->sourceUID)).arg(SNCUtils::displayUID(&multicastMap->sourceUID)));
-
+        free(message);
         return;
     }
+
+    // The source's window ends here - ack straightaway (unless the source is us) so that
+    // the source's send rate doesn't depend on how fast the subscribers are. The exception
+    // is a subscriber link that is blocked under the block policy. Then the ack is held so
+    // that the source's window closes until the link drains.
+
+    if (!SNCUtils::compareUID(&m_myUID, &multicastMap->sourceUID)) {
+        ackEhead = (SNC_EHEAD *)malloc(sizeof(SNC_EHEAD));
+        ackEhead->sourceUID = m_myUID;
+        ackEhead->destUID = multicastMap->sourceUID;
+        SNCUtils::copyUC2(ackEhead->sourcePort, inEhead->destPort);
+        SNCUtils::copyUC2(ackEhead->destPort, inEhead->sourcePort);
+        ackEhead->seq = inEhead->seq + 1;
+
+        if (subscriberBlocked(multicastMap))
+            holdAck(multicastMap, ackEhead);
+        else if (!m_server->sendSNCMessage(&(multicastMap->prevHopUID), SNCMSG_MULTICAST_ACK,
+                (SNC_MESSAGE *)ackEhead, sizeof(SNC_EHEAD), SNCLINK_MEDHIGHPRI)) {
+            SNCUtils::logWarn(TAG, QString("Failed mcast ack to %1").arg(SNCUtils::displayUID(&multicastMap->prevHopUID)));
+        }
+    }
+
+    if (m_fanoutTime != NULL)
+        fanoutTimer.start();
+
+    SNCTrace::stampMessage(message, cmd, len, SNC_TRACE_STAGE_CONTROL_RX);
+
+    bool standalone = isCacheable(message, len);
+
     qint64 now = SNCUtils::clock();
     m_server->m_multicastIn++;
     m_server->m_multicastInRate++;
+    multicastMap->received++;
+
+    registeredComponent = multicastMap->registeredComponents;
+    for (i = 0; i < multicastMap->registeredCount; i++, registeredComponent++) {
+        if (decimate(registeredComponent, standalone, now))
+            continue;                                       // subscriber asked for a lower rate
+
+        msgCopy = (unsigned char *)malloc(len);
+        memcpy(msgCopy, message, len);
 
-    registeredComponent = multicastMap->head;
-    while (registeredComponent != NULL) {
         if (!SNCUtils::isSendOK(registeredComponent->sendSeq, registeredComponent->lastAckSeq)) {   // see if we have timed out waiting for ack
             if (!SNCUtils::timerExpired(now, registeredComponent->lastSendTime, EXCHANGE_TIMEOUT)){
-                registeredComponent = registeredComponent->next;
-                continue;                                   // not yet long enough to declare a timeout
+
+                // window still closed - this message replaces anything already held for this subscriber
+
+                if (registeredComponent->pendingMsg != NULL) {
+                    freePending(registeredComponent);
+                    registeredComponent->skipped++;
+                }
+                multicastMap->stalls++;
+                registeredComponent->pendingMsg = msgCopy;
+                registeredComponent->pendingLen = len;
+                registeredComponent->pendingCmd = cmd;
+                continue;
             } else {
                 registeredComponent->lastAckSeq = registeredComponent->sendSeq;
                 SNCUtils::logWarn(TAG, QString("WFAck timeout on %1").arg(SNCUtils::displayUID(&registeredComponent->registeredUID)));
             }
         }
-        msgCopy = (unsigned char *)malloc(len);
-        memcpy(msgCopy, message, len);
-        outEhead = (SNC_EHEAD *)msgCopy;
-        SNCUtils::convertIntToUC2(registeredComponent->port, outEhead->destPort);// this is the receiver's service index that was requested
-        SNCUtils::convertIntToUC2(multicastMapIndex, outEhead->sourcePort); // this is my slot number (needed for the ack)
-        outEhead->destUID = registeredComponent->registeredUID;
-        outEhead->sourceUID = multicastMap->sourceUID;
-        outEhead->seq = registeredComponent->sendSeq;
-        registeredComponent->sendSeq++;
-        SNCUtils::logDebug(TAG, QString("Forwarding mcast from component %1 to %2")
-                .arg(SNCUtils::displayUID(&outEhead->sourceUID)).arg(SNCUtils::displayUID(&registeredComponent->registeredUID)));
-        m_server->sendSNCMessage(&(registeredComponent->registeredUID), cmd, (SNC_MESSAGE *)msgCopy,
-                    len, SNCLINK_LOWPRI);
-        m_server->m_multicastOut++;
-        m_server->m_multicastOutRate++;
-        registeredComponent->lastSendTime = now;
-        registeredComponent = registeredComponent->next;
-    }
-
-    // send an ACK unless the recipient is us
-    if (!SNCUtils::compareUID(&m_myUID, &multicastMap->sourceUID)) {
-        ackEhead = (SNC_EHEAD *)malloc(sizeof(SNC_EHEAD));
-        ackEhead->sourceUID = m_myUID;
-        ackEhead->destUID = multicastMap->sourceUID;
-        SNCUtils::copyUC2(ackEhead->sourcePort, inEhead->destPort);
-        SNCUtils::copyUC2(ackEhead->destPort, inEhead->sourcePort);
-        ackEhead->seq = inEhead->seq + 1;
+        if (registeredComponent->pendingMsg != NULL) {      // superseded by this one
+            freePending(registeredComponent);
+            registeredComponent->skipped++;
+        }
+        sendToRegistered(multicastMap, registeredComponent, cmd, msgCopy, len, now);
+    }
 
-        if (!m_server->sendSNCMessage(&(multicastMap->prevHopUID), SNCMSG_MULTICAST_ACK,
-                (SNC_MESSAGE *)ackEhead, sizeof(SNC_EHEAD), SNCLINK_MEDHIGHPRI)) {
-            SNCUtils::logWarn(TAG, QString("Failed mcast ack to %1").arg(SNCUtils::displayUID(&multicastMap->prevHopUID)));
+    //  the subscribers all have their own copies so the message itself can become the cached record
+
+    if (!standalone || !cacheRecord(multicastMap, cmd, message, len))
+        free(message);
+
+    if (m_fanoutTime != NULL)
+        m_fanoutTime->observe(fanoutTimer.nsecsElapsed() / 1000);
+}
+
+void MulticastManager::sendToRegistered(MM_MMAP *multicastMap, MM_REGISTEREDCOMPONENT *registeredComponent,
+                    int cmd, unsigned char *msgCopy, int len, qint64 now)
+{
+    SNC_EHEAD *outEhead;
+
+    outEhead = (SNC_EHEAD *)msgCopy;
+    SNCUtils::convertIntToUC2(registeredComponent->port, outEhead->destPort);// this is the receiver's service index that was requested
+    SNCUtils::convertIntToUC2(multicastMap->index, outEhead->sourcePort); // this is my slot number (needed for the ack)
+    outEhead->destUID = registeredComponent->registeredUID;
+    outEhead->sourceUID = multicastMap->sourceUID;
+    outEhead->seq = registeredComponent->sendSeq;
+    registeredComponent->sendSeq++;
+    SNCTrace::stampMessage((SNC_MESSAGE *)msgCopy, cmd, len, SNC_TRACE_STAGE_FANOUT);
+    SNCUtils::logDebug(TAG, QString("Forwarding mcast from component %1 to %2")
+            .arg(SNCUtils::displayUID(&outEhead->sourceUID)).arg(SNCUtils::displayUID(&registeredComponent->registeredUID)));
+    m_server->sendSNCMessage(&(registeredComponent->registeredUID), cmd, (SNC_MESSAGE *)msgCopy,
+                len, SNCLINK_LOWPRI);
+    m_server->m_multicastOut++;
+    m_server->m_multicastOutRate++;
+    registeredComponent->lastSendTime = now;
+}
+
+//  decimate applies a subscriber's rate spec. A thinned out stream only makes sense
+//  with records that stand alone so anything else is not sent to those subscribers.
+
+bool MulticastManager::decimate(MM_REGISTEREDCOMPONENT *registeredComponent, bool standalone, qint64 now)
+{
+    if ((registeredComponent->minInterval <= 0) && (registeredComponent->everyNth <= 1))
+        return false;                                       // wants everything
+
+    if (!standalone)
+        return true;
+
+    if (registeredComponent->everyNth > 1) {
+        if ((registeredComponent->recordCount++ % registeredComponent->everyNth) != 0)
+            return true;
+    }
+    if (registeredComponent->minInterval > 0) {
+        if ((registeredComponent->lastDeliveryTime != 0) &&
+                !SNCUtils::timerExpired(now, registeredComponent->lastDeliveryTime, registeredComponent->minInterval))
+            return true;
+    }
+    registeredComponent->lastDeliveryTime = now;
+    return false;
+}
+
+void MulticastManager::MMSendCachedRecords()
+{
+    MM_MMAP *multicastMap;
+    MM_REGISTEREDCOMPONENT *registeredComponent;
+    unsigned char *msgCopy;
+    int i;
+
+    QMutexLocker locker(&m_lock);
+
+    if (m_cachePendingCount == 0)
+        return;
+
+    qint64 now = SNCUtils::clock();
+
+    for (multicastMap = m_activeHead; multicastMap != NULL; multicastMap = multicastMap->nextActive) {
+        registeredComponent = multicastMap->registeredComponents;
+        for (i = 0; i < multicastMap->registeredCount; i++, registeredComponent++) {
+            if (!registeredComponent->cachePending)
+                continue;
+            registeredComponent->cachePending = false;
+
+            //  don't bother if live data has got there first
+
+            if ((multicastMap->cachedMsg == NULL) || (registeredComponent->sendSeq != 0))
+                continue;
+            msgCopy = (unsigned char *)malloc(multicastMap->cachedLen);
+            memcpy(msgCopy, multicastMap->cachedMsg, multicastMap->cachedLen);
+            sendToRegistered(multicastMap, registeredComponent, multicastMap->cachedCmd,
+                    msgCopy, multicastMap->cachedLen, now);
         }
     }
+    m_cachePendingCount = 0;
+}
+
+bool MulticastManager::isCacheable(SNC_MESSAGE *message, int len)
+{
+    SNC_RECORD_HEADER *recordHeader;
+    SNC_RECORD_AVMUX *avmux;
+
+    if (len < (int)(sizeof(SNC_EHEAD) + sizeof(SNC_RECORD_HEADER)))
+        return true;                                        // not a record so just keep the latest
+
+    recordHeader = (SNC_RECORD_HEADER *)((SNC_EHEAD *)message + 1);
+
+    switch (SNCUtils::convertUC2ToUInt(recordHeader->type)) {
+        case SNC_RECORD_TYPE_AVMUX:
+            if (len < (int)(sizeof(SNC_EHEAD) + sizeof(SNC_RECORD_AVMUX)))
+                return false;
+            avmux = (SNC_RECORD_AVMUX *)recordHeader;
+            if (SNCUtils::convertUC2ToInt(recordHeader->subType) != SNC_RECORD_TYPE_AVMUX_MJPPCM)
+                return false;
+            if (SNCUtils::convertUC2ToInt(recordHeader->param) == SNC_RECORDHEADER_PARAM_NOOP)
+                return false;
+            return SNCUtils::convertUC4ToInt(avmux->videoSize) > 0;  // only keep records with a frame
+
+        case SNC_RECORD_TYPE_VIDEO:
+            return SNCUtils::convertUC2ToInt(recordHeader->subType) == SNC_RECORD_TYPE_VIDEO_MJPEG;
+
+        case SNC_RECORD_TYPE_AUDIO:
+            return false;
+
+        default:
+            return true;
+    }
+}
+
+bool MulticastManager::cacheRecord(MM_MMAP *multicastMap, int cmd, SNC_MESSAGE *message, int len)
+{
+    len = SNCTrace::removeTrace((SNC_EHEAD *)message, len); // the trace would be stale when the record is sent
+
+    if ((len > m_cacheMaxRecord) || (m_cacheBytes - multicastMap->cachedLen + len > m_cacheLimit)) {
+        freeCachedRecord(multicastMap);                     // can't keep it so the old one is now stale
+        return false;
+    }
+    freeCachedRecord(multicastMap);
+    multicastMap->cachedMsg = (unsigned char *)message;
+    m_cacheBytes += len;
+    multicastMap->cachedLen = len;
+    multicastMap->cachedCmd = cmd;
+    return true;
+}
+
+void MulticastManager::freeCachedRecord(MM_MMAP *multicastMap)
+{
+    if (multicastMap->cachedMsg != NULL)
+        free(multicastMap->cachedMsg);
+    m_cacheBytes -= multicastMap->cachedLen;
+    multicastMap->cachedMsg = NULL;
+    multicastMap->cachedLen = 0;
+}
+
+void MulticastManager::freePending(MM_REGISTEREDCOMPONENT *registeredComponent)
+{
+    if (registeredComponent->pendingMsg != NULL)
+        free(registeredComponent->pendingMsg);
+    registeredComponent->pendingMsg = NULL;
+    registeredComponent->pendingLen = 0;
 }
 
 
@@ -235,6 +453,7 @@ void	MulticastManager::MMProcessMulticastAck(SNC_EHEAD *ehead, int len)
     MM_MMAP *multicastMap;
     MM_REGISTEREDCOMPONENT *registeredComponent;
     int slot;
+    int i;
 
     if (len < (int)sizeof(SNC_EHEAD)) {
         SNCUtils::logWarn(TAG, QString("Multicast ack is too short %1").arg(len));
@@ -242,14 +461,10 @@ void	MulticastManager::MMProcessMulticastAck(SNC_EHEAD *ehead, int len)
     }
 
     slot = SNCUtils::convertUC2ToUInt(ehead->destPort);     // get the port number
-    if (slot >= m_multicastMapSize) {
-        SNCUtils::logWarn(TAG, QString("Invalid dest port %1 for multicast ack from %2").arg(slot).arg(SNCUtils::displayUID(&ehead->sourceUID)));
-        return;
-    }
     QMutexLocker locker(&m_lock);
 
-    multicastMap = m_multicastMap + slot;
-    if (!multicastMap->valid)
+    multicastMap = MMGetMap(slot);
+    if (multicastMap == NULL)
         return;                                             // probably disconnected or something
     if (!SNCUtils::compareUID(&(multicastMap->sourceUID), &(ehead->destUID))) {
         SNCUtils::logWarn(TAG, QString("Multicast ack dest %1 doesn't match source %2")
@@ -259,16 +474,25 @@ void	MulticastManager::MMProcessMulticastAck(SNC_EHEAD *ehead, int len)
         return;
     }
 
-    registeredComponent = multicastMap->head;
-    while (registeredComponent != NULL) {
+    registeredComponent = multicastMap->registeredComponents;
+    for (i = 0; i < multicastMap->registeredCount; i++, registeredComponent++) {
         if (SNCUtils::compareUID(&(ehead->sourceUID), &(registeredComponent->registeredUID)) &&
                     (SNCUtils::convertUC2ToInt(ehead->sourcePort) == registeredComponent->port)) {
             SNCUtils::logDebug(TAG, QString("Matched ack from remote component %1 port %2")
                     .arg(SNCUtils::displayUID(&ehead->sourceUID)).arg(registeredComponent->port));
             registeredComponent->lastAckSeq = ehead->seq;
+
+            //  if something was held while the window was closed, send it now
+
+            if ((registeredComponent->pendingMsg != NULL) &&
+                    SNCUtils::isSendOK(registeredComponent->sendSeq, registeredComponent->lastAckSeq)) {
+                sendToRegistered(multicastMap, registeredComponent, registeredComponent->pendingCmd,
+                        registeredComponent->pendingMsg, registeredComponent->pendingLen, SNCUtils::clock());
+                registeredComponent->pendingMsg = NULL;
+                registeredComponent->pendingLen = 0;
+            }
             return;
         }
-        registeredComponent = registeredComponent->next;
     }
 
     SNCUtils::logWarn(TAG, QString("Failed to match ack from %1 port %2").arg(SNCUtils::displayUID(&ehead->sourceUID))
@@ -280,53 +504,107 @@ void	MulticastManager::MMProcessMulticastAck(SNC_EHEAD *ehead, int len)
 MM_MMAP	*MulticastManager::MMAllocateMMap(SNC_UID *prevHopUID, SNC_UID *sourceUID,
                                 const char *componentName, const char *serviceName, int port)
 {
-    int i;
     MM_MMAP *multicastMap;
 
     QMutexLocker locker(&m_lock);
-    multicastMap = m_multicastMap;
-    for (i = 0; i < SNCSERVER_MAX_MMAPS; i++, multicastMap++) {
-        if (!multicastMap->valid)
-            break;
-    }
-    if (i == SNCSERVER_MAX_MMAPS) {
+    if ((m_freeHead == NULL) && !addSlab()) {
         SNCUtils::logError(TAG, "No more multicast maps");
         return NULL;
     }
-    if (i >= m_multicastMapSize)
-        m_multicastMapSize = i+1;                           // update the in use map array size
-    multicastMap->head = NULL;
+    multicastMap = m_freeHead;
+    m_freeHead = multicastMap->nextActive;
+
+    //  link onto the active list
+
+    multicastMap->prevActive = NULL;
+    multicastMap->nextActive = m_activeHead;
+    if (m_activeHead != NULL)
+        m_activeHead->prevActive = multicastMap;
+    m_activeHead = multicastMap;
+    m_activeCount++;
+
+    multicastMap->registeredCount = 0;
     multicastMap->valid = true;
     multicastMap->prevHopUID = *prevHopUID;                 // this is the previous hop UID for the service (i.e. where the data comes from)
     multicastMap->sourceUID = *sourceUID;                   // this is the original source of the stream
     sprintf(multicastMap->serviceLookup.servicePath, "%s%c%s", componentName, SNC_SERVICEPATH_SEP, serviceName);
     SNCUtils::convertIntToUC2(port, multicastMap->serviceLookup.remotePort);// this is the target port (the service port)
-    SNCUtils::convertIntToUC2(i, multicastMap->serviceLookup.localPort);    // this is the index into the MMap array
+    SNCUtils::convertIntToUC2(multicastMap->index, multicastMap->serviceLookup.localPort);    // this is the index of the map
     multicastMap->serviceLookup.response = SERVICE_LOOKUP_FAIL;// indicate lookup response not valid
     multicastMap->serviceLookup.serviceType = SERVICETYPE_MULTICAST;// indicate multicast
     multicastMap->registered = false;                       // indicate not registered
+    multicastMap->received = 0;
+    multicastMap->stalls = 0;
+    multicastMap->ackHeld = false;
+    multicastMap->flowWeight = m_server->streamWeight(componentName, serviceName);
     multicastMap->lookupSent = SNCUtils::clock();           // not important until something registered on it
-    SNCUtils::logDebug(TAG, QString("Added %1 from slot %2 to multicast table in slot %3").arg(serviceName).arg(port).arg(i));
-    emit MMNewEntry(i);
+    SNCUtils::logDebug(TAG, QString("Added %1 from slot %2 to multicast table in slot %3").arg(serviceName).arg(port).arg(multicastMap->index));
+    emit MMNewEntry(multicastMap->index);
     return multicastMap;
 }
 
 void MulticastManager::MMFreeMMap(MM_MMAP *multicastMap)
 {
-    MM_REGISTEREDCOMPONENT	*registeredComponent;
+    QList<MM_FLOWWEIGHT> flowWeights;
 
     QMutexLocker locker(&m_lock);
     if (!multicastMap->valid)
         return;
     emit MMDeleteEntry(multicastMap->index);
+    if (m_metricsEnabled)
+        SNCMetrics::removeLabelled(mapLabels(multicastMap));
     multicastMap->valid = false;
-    while (multicastMap->head != NULL) {
-        registeredComponent = multicastMap->head;
-        SNCUtils::logDebug(TAG, QString("Freeing MMap %1, component %2 port %3")
-            .arg(multicastMap->serviceLookup.servicePath)
-            .arg(SNCUtils::displayUID(&registeredComponent->registeredUID)).arg(registeredComponent->port));
-        multicastMap->head = registeredComponent->next;
-        free(registeredComponent);
+
+    for (int i = 0; i < multicastMap->registeredCount; i++) {
+        freePending(multicastMap->registeredComponents + i);
+        if (multicastMap->flowWeight != SNCLINK_FLOW_WEIGHT_DEFAULT)
+            addFlowWeight(flowWeights, &(multicastMap->registeredComponents[i].registeredUID),
+                    multicastMap, SNCLINK_FLOW_WEIGHT_DEFAULT);
+    }
+    free(multicastMap->registeredComponents);
+    multicastMap->registeredComponents = NULL;
+    if (multicastMap->ackHeld) {
+        multicastMap->ackHeld = false;
+        m_heldAckCount--;
+    }
+    multicastMap->registeredCount = 0;
+    multicastMap->registeredSize = 0;
+    freeCachedRecord(multicastMap);
+
+    //  unlink from the active list and put on the free list
+
+    if (multicastMap->prevActive != NULL)
+        multicastMap->prevActive->nextActive = multicastMap->nextActive;
+    else
+        m_activeHead = multicastMap->nextActive;
+    if (multicastMap->nextActive != NULL)
+        multicastMap->nextActive->prevActive = multicastMap->prevActive;
+    m_activeCount--;
+
+    multicastMap->prevActive = NULL;
+    multicastMap->nextActive = m_freeHead;
+    m_freeHead = multicastMap;
+    locker.unlock();
+    applyFlowWeights(flowWeights);
+}
+
+void MulticastManager::addFlowWeight(QList<MM_FLOWWEIGHT>& updates, SNC_UID *UID, MM_MMAP *multicastMap, int weight)
+{
+    MM_FLOWWEIGHT update;
+
+    memcpy(&(update.UID), UID, sizeof(SNC_UID));
+    memcpy(&(update.sourceUID), &(multicastMap->sourceUID), sizeof(SNC_UID));
+    update.sourcePort = multicastMap->index;
+    update.weight = weight;
+    updates.append(update);
+}
+
+void MulticastManager::applyFlowWeights(const QList<MM_FLOWWEIGHT>& updates)
+{
+    for (int i = 0; i < updates.count(); i++) {
+        MM_FLOWWEIGHT update = updates.at(i);
+
+        m_server->setFlowWeight(&(update.UID), &(update.sourceUID), update.sourcePort, update.weight);
     }
 }
 
@@ -341,48 +619,109 @@ void MulticastManager::MMProcessLookupResponse(SNC_SERVICE_LOOKUP *serviceLookup
         return;
     }
     index = SNCUtils::convertUC2ToUInt(serviceLookup->localPort);   // get the local port
-    if (index >= m_multicastMapSize) {
-        SNCUtils::logWarn(TAG, QString("Lookup response from %1 port %2 to incorrect local port %3")
+
+    QMutexLocker locker(&m_lock);
+    multicastMap = MMGetMap(index);
+    if (multicastMap == NULL) {
+        SNCUtils::logWarn(TAG, QString("Lookup response from %1 port %2 to unused local mmap %3")
             .arg(SNCUtils::displayUID(&serviceLookup->lookupUID))
             .arg(SNCUtils::convertUC2ToInt(serviceLookup->remotePort))
-            .arg(SNCUtils::convertUC2ToInt(serviceLookup->localPort)));
-
+            .arg(index));
         return;
     }
 
-    QMutexLocker locker(&m_lock);
-    multicastMap = m_multicastMap + index;
-    if (!multicastMap->valid) {
-        SNCUtils::logWarn(TAG, QString("Lookup response to unused local mmap from %1").arg(serviceLookup->servicePath));
+    if (processLookupResponse(multicastMap, serviceLookup))
+        emit MMDisplay();
+}
+
+//  MMProcessLookupBatchResponse handles the compact entries of a batch response. Each one is
+//  overlaid on a copy of the map's own lookup so that the service path is preserved.
+
+void MulticastManager::MMProcessLookupBatchResponse(SNC_SERVICE_LOOKUP_BATCH *batch, int len)
+{
+    SNC_SERVICE_LOOKUP serviceLookup;
+    SNC_SERVICE_LOOKUP_ENTRY *entry;
+    MM_MMAP *multicastMap;
+    unsigned char *ptr;
+    int count;
+    int index;
+    int entryLength;
+    bool registered = false;
+
+    if (len < (int)sizeof(SNC_SERVICE_LOOKUP_BATCH)) {
+        SNCUtils::logWarn(TAG, QString("Lookup batch response too short %1").arg(len));
         return;
     }
+    count = SNCUtils::convertUC2ToInt(batch->count);
+    ptr = (unsigned char *)(batch + 1);
+    len -= sizeof(SNC_SERVICE_LOOKUP_BATCH);
 
-    if (serviceLookup->response == SERVICE_LOOKUP_FAIL) {   // the endpoint is not there!
-        if (multicastMap->serviceLookup.response == SERVICE_LOOKUP_SUCCEED) {	// was ok but went away
-            SNCUtils::logDebug(TAG, QString("Service %1 no longer available").arg(multicastMap->serviceLookup.servicePath));
-        } else {
-            SNCUtils::logDebug(TAG, QString("Service %s unavailable").arg(multicastMap->serviceLookup.servicePath));
+    QMutexLocker locker(&m_lock);
+    for (; count > 0; count--, ptr += entryLength, len -= entryLength) {
+        if (len < (int)sizeof(SNC_SERVICE_LOOKUP_ENTRY)) {
+            SNCUtils::logWarn(TAG, "Lookup batch response truncated");
+            break;
         }
-        multicastMap->serviceLookup.response = SERVICE_LOOKUP_FAIL;	// indicate that the entry is invalid
-        multicastMap->registered = false;                   // and we can't be registere
-        return;
+        entry = (SNC_SERVICE_LOOKUP_ENTRY *)ptr;
+        entryLength = sizeof(SNC_SERVICE_LOOKUP_ENTRY) + entry->pathLength;
+        index = SNCUtils::convertUC2ToUInt(entry->localPort);
+        if ((multicastMap = MMGetMap(index)) == NULL)
+            continue;                                       // probably freed since the request was sent
+        serviceLookup = multicastMap->serviceLookup;
+        if ((entryLength = SNCUtils::getLookupBatchEntry(ptr, len, &serviceLookup)) < 0) {
+            SNCUtils::logWarn(TAG, "Malformed lookup batch response entry");
+            break;
+        }
+        registered |= processLookupResponse(multicastMap, &serviceLookup);
     }
-    if (multicastMap->serviceLookup.response == SERVICE_LOOKUP_SUCCEED) {	// we had a previously valid entry
-        if ((SNCUtils::convertUC4ToInt(serviceLookup->ID) == SNCUtils::convertUC4ToInt(multicastMap->serviceLookup.ID))
-            && (SNCUtils::compareUID(&(serviceLookup->lookupUID), &(multicastMap->serviceLookup.lookupUID)))
-            && (SNCUtils::convertUC2ToInt(serviceLookup->remotePort) == SNCUtils::convertUC2ToInt(multicastMap->serviceLookup.remotePort))) {
-                SNCUtils::logDebug(TAG, QString("Reconfirmed %1").arg(serviceLookup->servicePath));
+    if (registered)
+        emit MMDisplay();
+}
+
+void MulticastManager::MMReleaseHeldAcks()
+{
+    MM_MMAP *multicastMap;
+    SNC_EHEAD *ackEhead;
+
+    QMutexLocker locker(&m_lock);
+    if (m_heldAckCount == 0)
+        return;
+
+    for (multicastMap = m_activeHead; multicastMap != NULL; multicastMap = multicastMap->nextActive) {
+        if (!multicastMap->ackHeld || subscriberBlocked(multicastMap))
+            continue;
+        multicastMap->ackHeld = false;
+        m_heldAckCount--;
+        ackEhead = (SNC_EHEAD *)malloc(sizeof(SNC_EHEAD));
+        memcpy(ackEhead, &(multicastMap->heldAck), sizeof(SNC_EHEAD));
+        if (!m_server->sendSNCMessage(&(multicastMap->prevHopUID), SNCMSG_MULTICAST_ACK,
+                (SNC_MESSAGE *)ackEhead, sizeof(SNC_EHEAD), SNCLINK_MEDHIGHPRI)) {
+            SNCUtils::logWarn(TAG, QString("Failed held mcast ack to %1").arg(SNCUtils::displayUID(&multicastMap->prevHopUID)));
         }
-    } else {
-//	If we get here, something changed
-        SNCUtils::logDebug(TAG, QString("Service %1 mapped to %2 port %3").arg(serviceLookup->servicePath)
-            .arg(SNCUtils::displayUID(&serviceLookup->lookupUID)).arg(SNCUtils::convertUC2ToInt(serviceLookup->remotePort)));
-        multicastMap->serviceLookup = *serviceLookup;       // record data
     }
-    multicastMap->registered = true;
-    emit MMDisplay();
 }
 
+bool MulticastManager::subscriberBlocked(MM_MMAP *multicastMap)
+{
+    for (int i = 0; i < multicastMap->registeredCount; i++) {
+        if (m_server->isTXBlocked(&(multicastMap->registeredComponents[i].registeredUID),
+                SNCMSG_MULTICAST_MESSAGE, SNCLINK_LOWPRI))
+            return true;
+    }
+    return false;
+}
+
+//  holdAck keeps only the latest ack as it covers everything before it
+
+void MulticastManager::holdAck(MM_MMAP *multicastMap, SNC_EHEAD *ackEhead)
+{
+    memcpy(&(multicastMap->heldAck), ackEhead, sizeof(SNC_EHEAD));
+    free(ackEhead);
+    if (!multicastMap->ackHeld) {
+        multicastMap->ackHeld = true;
+        m_heldAckCount++;
+    }
+}
 
 void MulticastManager::MMBackground()
 {
@@ -396,25 +735,92 @@ void MulticastManager::MMBackground()
 
     m_lastBackground = now;
     emit MMDisplay();
+    MMSendCachedRecords();                                  // in case anything registered other than by lookup
     QMutexLocker locker(&m_lock);
-    multicastMap = m_multicastMap;
-    for (index = 0; index < m_multicastMapSize; index++, multicastMap++) {
-        if (!multicastMap->valid)
-            continue;
+    m_batchLookups = true;                                  // collect lookups into one message per previous hop
+    for (multicastMap = m_activeHead; multicastMap != NULL; multicastMap = multicastMap->nextActive) {
         if (SNCUtils::compareUID(&(multicastMap->sourceUID), &m_myUID))
             continue;                                       // don't do anything more for SyntroCOntrol services
-        if (multicastMap->head == NULL)
+        if (multicastMap->registeredCount == 0)
             continue;                                       // no registrations so don't refresh
         // Note - this timer check is only if there's a stuck registration for some reason - it
         // stops continual data transfer when nobody really wants it. Hopefully someone will time the
         // stuck registration out!
         if (SNCUtils::timerExpired(SNCUtils::clock(), multicastMap->lastLookupRefresh, MULTICAST_REFRESH_TIMEOUT)) {
             SNCUtils::logDebug(TAG, QString("Too long since last incoming lookup request on %1 local port %2")
-                    .arg(SNCUtils::displayUID(&multicastMap->sourceUID)).arg(index));
+                    .arg(SNCUtils::displayUID(&multicastMap->sourceUID)).arg(multicastMap->index));
             continue;                                       // don't send a lookup request as nobody interested
         }
         sendLookupRequest(multicastMap);
     }
+    for (index = 0; index < m_lookupBatches.count(); index++) {
+        flushLookupBatch(&m_lookupBatches[index]);
+        if (m_lookupBatches[index].batch != NULL)
+            free(m_lookupBatches[index].batch);
+    }
+    m_lookupBatches.clear();
+    m_batchLookups = false;
+}
+
+
+void MulticastManager::MMEnableMetrics()
+{
+    static const qint64 bounds[] = {10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 100000};
+
+    QMutexLocker locker(&m_lock);
+
+    m_metricsEnabled = true;
+    m_fanoutTime = SNCMetrics::histogram("snc_multicast_fanout_us", "Time to forward a multicast record to all subscribers",
+                QString(), bounds, sizeof(bounds) / sizeof(qint64));
+}
+
+void MulticastManager::MMUpdateMetrics()
+{
+    MM_MMAP *multicastMap;
+    MM_REGISTEREDCOMPONENT *registeredComponent;
+    qint64 skipped;
+    int pending;
+    int i;
+
+    QMutexLocker locker(&m_lock);
+
+    if (!m_metricsEnabled)
+        return;
+
+    SNCMetrics::gauge("snc_multicast_maps", "Active multicast maps")->set(m_activeCount);
+    SNCMetrics::gauge("snc_multicast_cache_bytes", "Bytes used by cached multicast records")->set(m_cacheBytes);
+
+    for (multicastMap = m_activeHead; multicastMap != NULL; multicastMap = multicastMap->nextActive) {
+        skipped = 0;
+        pending = 0;
+        registeredComponent = multicastMap->registeredComponents;
+        for (i = 0; i < multicastMap->registeredCount; i++, registeredComponent++) {
+            skipped += registeredComponent->skipped;
+            if (registeredComponent->pendingMsg != NULL)
+                pending++;
+        }
+
+        QString labels = mapLabels(multicastMap);
+
+        SNCMetrics::gauge("snc_multicast_map_subscribers", "Subscribers registered on a multicast map",
+                labels)->set(multicastMap->registeredCount);
+        SNCMetrics::counter("snc_multicast_map_records_total", "Records received on a multicast map",
+                labels)->set(multicastMap->received);
+        SNCMetrics::counter("snc_multicast_map_stalls_total", "Records held because a subscriber window was closed",
+                labels)->set(multicastMap->stalls);
+        SNCMetrics::gauge("snc_multicast_map_skipped", "Held records replaced by newer ones for current subscribers",
+                labels)->set(skipped);
+        SNCMetrics::gauge("snc_multicast_map_pending", "Subscribers with a held record",
+                labels)->set(pending);
+        SNCMetrics::gauge("snc_multicast_map_cached_bytes", "Size of the cached record for a multicast map",
+                labels)->set(multicastMap->cachedMsg != NULL ? multicastMap->cachedLen : 0);
+    }
+}
+
+QString MulticastManager::mapLabels(MM_MMAP *multicastMap)
+{
+    return SNCMetrics::label("map", QString::number(multicastMap->index)) + ","
+            + SNCMetrics::label("service", multicastMap->serviceLookup.servicePath);
 }
 
 
@@ -435,6 +841,10 @@ void MulticastManager::sendLookupRequest(MM_MMAP *multicastMap, bool rightNow)
         return;											// too early to send again
 
     if (SNCUtils::convertUC2ToInt(multicastMap->prevHopUID.instance) < INSTANCE_COMPONENT) {
+        if (m_batchLookups && addToLookupBatch(multicastMap)) {
+            multicastMap->lookupSent = now;
+            return;
+        }
         serviceLookup = (SNC_SERVICE_LOOKUP *)malloc(sizeof(SNC_SERVICE_LOOKUP));
         *serviceLookup = multicastMap->serviceLookup;
         SNCUtils::logDebug(TAG, QString("Sending lookup request for %1 from port %2").arg(serviceLookup->servicePath)
@@ -459,5 +869,118 @@ void MulticastManager::sendLookupRequest(MM_MMAP *multicastMap, bool rightNow)
     multicastMap->lookupSent = now;
 }
 
+//  processLookupResponse updates a multicast map from a lookup response. The lock must be held.
+
+bool MulticastManager::processLookupResponse(MM_MMAP *multicastMap, SNC_SERVICE_LOOKUP *serviceLookup)
+{
+    if (serviceLookup->response == SERVICE_LOOKUP_FAIL) {   // the endpoint is not there!
+        if (multicastMap->serviceLookup.response == SERVICE_LOOKUP_SUCCEED) {	// was ok but went away
+            SNCUtils::logDebug(TAG, QString("Service %1 no longer available").arg(multicastMap->serviceLookup.servicePath));
+        } else {
+            SNCUtils::logDebug(TAG, QString("Service %s unavailable").arg(multicastMap->serviceLookup.servicePath));
+        }
+        multicastMap->serviceLookup.response = SERVICE_LOOKUP_FAIL;	// indicate that the entry is invalid
+        multicastMap->registered = false;                   // and we can't be registere
+        return false;
+    }
+    if (multicastMap->serviceLookup.response == SERVICE_LOOKUP_SUCCEED) {	// we had a previously valid entry
+        if ((SNCUtils::convertUC4ToInt(serviceLookup->ID) == SNCUtils::convertUC4ToInt(multicastMap->serviceLookup.ID))
+            && (SNCUtils::compareUID(&(serviceLookup->lookupUID), &(multicastMap->serviceLookup.lookupUID)))
+            && (SNCUtils::convertUC2ToInt(serviceLookup->remotePort) == SNCUtils::convertUC2ToInt(multicastMap->serviceLookup.remotePort))) {
+                SNCUtils::logDebug(TAG, QString("Reconfirmed %1").arg(serviceLookup->servicePath));
+        }
+    } else {
+//	If we get here, something changed
+        SNCUtils::logDebug(TAG, QString("Service %1 mapped to %2 port %3").arg(serviceLookup->servicePath)
+            .arg(SNCUtils::displayUID(&serviceLookup->lookupUID)).arg(SNCUtils::convertUC2ToInt(serviceLookup->remotePort)));
+        multicastMap->serviceLookup = *serviceLookup;       // record data
+    }
+    multicastMap->registered = true;
+    return true;
+}
+
+//  addToLookupBatch adds the map's lookup to the batch for its previous hop. A refresh of a
+//  successful lookup is sent without the service path. Returns false if the previous hop
+//  doesn't understand batches.
+
+bool MulticastManager::addToLookupBatch(MM_MMAP *multicastMap)
+{
+    MM_LOOKUPBATCH *lookupBatch = NULL;
+    MM_LOOKUPBATCH newBatch;
+    int i;
+
+    for (i = 0; i < m_lookupBatches.count(); i++) {
+        if (SNCUtils::compareUID(&(m_lookupBatches[i].prevHopUID), &(multicastMap->prevHopUID))) {
+            lookupBatch = &m_lookupBatches[i];
+            break;
+        }
+    }
+
+    if (lookupBatch == NULL) {
+        newBatch.prevHopUID = multicastMap->prevHopUID;
+        newBatch.count = 0;
+        if (m_server->lookupBatchSupported(&(multicastMap->prevHopUID))) {
+            newBatch.batch = (SNC_SERVICE_LOOKUP_BATCH *)malloc(MM_LOOKUPBATCH_LENGTH);
+            newBatch.ptr = (unsigned char *)(newBatch.batch + 1);
+        } else {
+            newBatch.batch = NULL;
+            newBatch.ptr = NULL;
+        }
+        m_lookupBatches.append(newBatch);
+        lookupBatch = &m_lookupBatches.last();
+    }
+
+    if (lookupBatch->batch == NULL)
+        return false;
+
+    lookupBatch->ptr += SNCUtils::putLookupBatchEntry(lookupBatch->ptr, &(multicastMap->serviceLookup),
+                multicastMap->serviceLookup.response != SERVICE_LOOKUP_SUCCEED);
+    if (++lookupBatch->count == SNC_SERVICE_LOOKUP_BATCH_MAX)
+        flushLookupBatch(lookupBatch);
+    return true;
+}
+
+void MulticastManager::flushLookupBatch(MM_LOOKUPBATCH *lookupBatch)
+{
+    int length;
+
+    if ((lookupBatch->batch == NULL) || (lookupBatch->count == 0))
+        return;
+
+    length = (int)(lookupBatch->ptr - (unsigned char *)lookupBatch->batch);
+    SNCUtils::convertIntToUC2(lookupBatch->count, lookupBatch->batch->count);
+    SNCUtils::logDebug(TAG, QString("Sending lookup batch of %1 to %2").arg(lookupBatch->count)
+                       .arg(SNCUtils::displayUID(&lookupBatch->prevHopUID)));
+
+    //  sendSNCMessage takes ownership so hand over this buffer and start another
+
+    if (!m_server->sendSNCMessage(&(lookupBatch->prevHopUID), SNCMSG_SERVICE_LOOKUP_BATCH_REQUEST,
+            (SNC_MESSAGE *)lookupBatch->batch, length, SNCLINK_MEDHIGHPRI)) {
+        SNCUtils::logWarn(TAG, QString("Failed sending lookup batch to %1").arg(SNCUtils::displayUID(&lookupBatch->prevHopUID)));
+    }
+    lookupBatch->batch = (SNC_SERVICE_LOOKUP_BATCH *)malloc(MM_LOOKUPBATCH_LENGTH);
+    lookupBatch->ptr = (unsigned char *)(lookupBatch->batch + 1);
+    lookupBatch->count = 0;
+}
+
+//  addSlab allocates another slab of maps and puts them on the free list so that the lowest
+//  index is used first. The lock must be held.
 
+bool MulticastManager::addSlab()
+{
+    MM_MMAP *slab;
+    int i;
 
+    if (m_slabCount == MM_MAX_SLABS)
+        return false;
+
+    slab = (MM_MMAP *)calloc(MM_SLAB_SIZE, sizeof(MM_MMAP));
+    for (i = MM_SLAB_SIZE - 1; i >= 0; i--) {
+        slab[i].index = (m_slabCount << MM_SLAB_SHIFT) + i;
+        slab[i].valid = false;
+        slab[i].nextActive = m_freeHead;
+        m_freeHead = slab + i;
+    }
+    m_slabs[m_slabCount++] = slab;
+    return true;
+}
@@ -25,41 +25,109 @@
 #define MULTICASTMANAGER_H
 
 #include "SNCDefs.h"
+#include "SNCMetrics.h"
 
 #include <qobject.h>
 #include <qmutex.h>
+#include <qlist.h>
 
-#define SNCSERVER_MAX_MMAPS		100000                      // max simultaneous multicast registrations
+//  Multicast maps are allocated in slabs as needed. The map index is sent as a SNC_UC2 port
+//  number so there can't be more than 65536 of them.
+
+#define MM_SLAB_SHIFT           8                           // 256 maps per slab
+#define MM_SLAB_SIZE            (1 << MM_SLAB_SHIFT)
+#define MM_MAX_SLABS            256
+
+#define SNCSERVER_MAX_MMAPS		(MM_SLAB_SIZE * MM_MAX_SLABS) // max simultaneous multicast registrations
 
 #define MM_REFRESH_INTERVAL		(SNC_CLOCKS_PER_SEC * 5)    // multicast refresh interval
 
-//  MM_REGISTEREDCOMPONENT is used to record who has requested multicast data
+#define MM_REGISTERED_INITIAL   4                           // initial size of a registered component array
+
+//  Each map keeps its most recent record so that a new subscriber gets something
+//  straightaway. For MJPEG video only records containing a frame are kept, and other
+//  video formats are not cached as a single record can't be decoded on its own. The
+//  cached record is the received message itself rather than a copy, and subscribers
+//  that registered with the "c0" rate spec option (recorders) are not sent it.
+
+#define MM_CACHE_LIMIT_DEFAULT      (32 * 1024 * 1024)      // default total bytes for all cached records
+#define MM_CACHE_MAXRECORD_DEFAULT  (2 * 1024 * 1024)       // default largest record that will be cached
 
-typedef struct _REGISTEREDCOMPONENT
+//  MM_REGISTEREDCOMPONENT is used to record who has requested multicast data.
+//  If a subscriber's window is closed, the most recent message is held in its pending
+//  slot (replacing any older one) and sent as soon as an ack opens the window again.
+
+typedef struct
 {
     SNC_UID registeredUID;                                  // the registered UID
     int port;                                               // the registered port to send data to
     unsigned char sendSeq;                                  // the next send sequence number
     unsigned char lastAckSeq;                               // last received ack sequence number
     qint64 lastSendTime;                                    // in order to timeout the WFAck condition
-    struct _REGISTEREDCOMPONENT	*next;                      // so they can be linked together
+    unsigned char *pendingMsg;                              // latest message held while the window is closed
+    int pendingLen;                                         // its length
+    int pendingCmd;                                         // and its command
+    qint64 skipped;                                         // messages replaced in the pending slot
+    bool cachePending;                                      // true if the cached record is still to be delivered
+    int minInterval;                                        // minimum time between delivered records (0 = no limit)
+    int everyNth;                                           // deliver every nth record (0 or 1 = all)
+    int recordCount;                                        // records seen for everyNth
+    qint64 lastDeliveryTime;                                // time last record was accepted for delivery
 } MM_REGISTEREDCOMPONENT;
 
-//  MM_MMAP records info about a multicast service
+//  MM_MMAP records info about a multicast service. Valid maps are linked on the active list,
+//  free ones on the free list.
 
-typedef struct
+typedef struct _MM_MMAP
 {
     bool valid;                                             // true if the entry is in use
     int index;                                              // index of entry
     SNC_UID sourceUID;                                      // the original UID (i.e. where message came from)
     SNC_UID prevHopUID;                                     // previous hop UID (which may be different if via tunnel(s))
-    MM_REGISTEREDCOMPONENT *head;                           // head of the registered component list
+    MM_REGISTEREDCOMPONENT *registeredComponents;           // the registered component array
+    int registeredCount;                                    // number of entries in use in the array
+    int registeredSize;                                     // allocated size of the array
     SNC_SERVICE_LOOKUP serviceLookup;                       // the lookup structure
     bool registered;                                        // true if successfully registered for a service
     qint64 lookupSent;                                      // time last lookup was sent
     qint64 lastLookupRefresh;                               // last time a subscriber refreshed its lookup
+    int flowWeight;                                         // SNCLink DRR weight on the links to subscribers
+    unsigned char *cachedMsg;                               // the most recent cacheable message itself (owned) or NULL
+    int cachedLen;                                          // its length
+    int cachedCmd;                                          // and its command
+    qint64 received;                                        // records received for fan-out
+    qint64 stalls;                                          // records held because a subscriber's window was closed
+    SNC_EHEAD heldAck;                                      // ack withheld from the source while a subscriber's link is blocked
+    bool ackHeld;                                           // true if heldAck is waiting to be sent
+    struct _MM_MMAP *nextActive;                            // active list link or free list link if not valid
+    struct _MM_MMAP *prevActive;                            // active list back link
 } MM_MMAP;
 
+//  MM_FLOWWEIGHT is a link flow weight change. These are collected while m_lock is held and
+//  applied after it is released so that MulticastManager never holds its lock while taking
+//  an SNCLink's.
+
+typedef struct
+{
+    SNC_UID UID;                                            // the subscriber whose link has the flow
+    SNC_UID sourceUID;                                      // the flow's source
+    int sourcePort;                                         // and port
+    int weight;                                             // the new weight
+} MM_FLOWWEIGHT;
+
+//  MM_LOOKUPBATCH is used while building batched lookup requests to a previous hop
+
+typedef struct
+{
+    SNC_UID prevHopUID;                                     // where the batch is going
+    SNC_SERVICE_LOOKUP_BATCH *batch;                        // the message being built or NULL if prevHop can't take batches
+    unsigned char *ptr;                                     // where the next entry goes
+    int count;                                              // entries so far
+} MM_LOOKUPBATCH;
+
+#define MM_LOOKUPBATCH_LENGTH   (sizeof(SNC_SERVICE_LOOKUP_BATCH) + \
+            SNC_SERVICE_LOOKUP_BATCH_MAX * (sizeof(SNC_SERVICE_LOOKUP_ENTRY) + SNC_MAX_SERVPATH))
+
 class SNCServer;
 
 class MulticastManager : public QObject
@@ -85,9 +153,12 @@ public:
 
     void MMFreeMMap(MM_MMAP *pM);					// frees a multicast map entry
 
-//  MMAddRegistered adds a new registration for a service
+//  MMAddRegistered adds a new registration for a service. minInterval and everyNth
+//  thin out the stream for this subscriber and noCache stops the cached record being
+//  sent - see SNCUtils::insertRateInPath.
 
-    bool MMAddRegistered(MM_MMAP *multicastMap, SNC_UID *UID, int port);
+    bool MMAddRegistered(MM_MMAP *multicastMap, SNC_UID *UID, int port, int minInterval = 0,
+                    int everyNth = 0, bool noCache = false);
 
 //  MMCheckRegistered checks to see if an endpoint is already registered for a service
 
@@ -98,7 +169,8 @@ public:
 
     void MMDeleteRegistered(SNC_UID *UID, int port);
 
-//  MMForwardMulticastMessage forwards a message to all registered endpoints
+//  MMForwardMulticastMessage forwards a message to all registered endpoints. It takes
+//  ownership of message.
 
     void MMForwardMulticastMessage(int cmd, SNC_MESSAGE *message, int len);
 
@@ -110,17 +182,45 @@ public:
 
     void MMProcessLookupResponse(SNC_SERVICE_LOOKUP *serviceLookup, int len);
 
+//  MMProcessLookupBatchResponse - handles batched lookup responses
+
+    void MMProcessLookupBatchResponse(SNC_SERVICE_LOOKUP_BATCH *batch, int len);
+
+//  MMSendCachedRecords - sends cached records to new registrations. This is called after
+//  lookup responses have been sent so that the subscriber knows the source port first.
+
+    void MMSendCachedRecords();
+
+//  MMReleaseHeldAcks - sends acks that were held back while a subscriber's link was blocked
+//  under the block policy, once all of the map's subscribers have drained. Called every
+//  background pass so that the source restarts as soon as possible.
+
+    void MMReleaseHeldAcks();
+
 //  MMBackground - must be called once per second
 
     void MMBackground();
 
-//  Access to m_MMap should only be made while locked
+//  MMEnableMetrics turns on fan-out timing and per map metrics. MMUpdateMetrics
+//  refreshes the per map metrics and is called at the metrics interval.
+
+    void MMEnableMetrics();
+    void MMUpdateMetrics();
+
+//  MMGetMap returns the valid map with the specified index or NULL
 
-    MM_MMAP	m_multicastMap[SNCSERVER_MAX_MMAPS];            // the multicast map array
-    int m_multicastMapSize;                                 // size of the array actually used
+    MM_MMAP *MMGetMap(int index);
+
+//  Access to the active list should only be made while locked
+
+    MM_MMAP *m_activeHead;                                  // the list of valid maps
+    int m_activeCount;                                      // number of maps on the active list
     QMutex m_lock;
     SNC_UID m_myUID;
 
+    qint64 m_cacheLimit;                                    // total bytes allowed for cached records (0 = no cache)
+    int m_cacheMaxRecord;                                   // largest record that will be cached
+
 signals:
     void MMDisplay();
     void MMNewEntry(int index);
@@ -129,7 +229,37 @@ signals:
 
 protected:
     void sendLookupRequest(MM_MMAP *multicastMap, bool rightNow = false);   // sends a multicast service lookup request
+    bool processLookupResponse(MM_MMAP *multicastMap, SNC_SERVICE_LOOKUP *serviceLookup); // returns true if registered
+    void sendToRegistered(MM_MMAP *multicastMap, MM_REGISTEREDCOMPONENT *registeredComponent,
+                    int cmd, unsigned char *msgCopy, int len, qint64 now);   // sends a copy, taking ownership of it
+    void freePending(MM_REGISTEREDCOMPONENT *registeredComponent); // discards any held message
+    bool isCacheable(SNC_MESSAGE *message, int len);        // true if record can be used by a new subscriber
+    bool decimate(MM_REGISTEREDCOMPONENT *registeredComponent, bool standalone, qint64 now); // true if record not wanted
+    bool cacheRecord(MM_MMAP *multicastMap, int cmd, SNC_MESSAGE *message, int len); // true if message was kept
+    void freeCachedRecord(MM_MMAP *multicastMap);
+    void addFlowWeight(QList<MM_FLOWWEIGHT>& updates, SNC_UID *UID, MM_MMAP *multicastMap, int weight);
+    void applyFlowWeights(const QList<MM_FLOWWEIGHT>& updates); // must be called without m_lock held
+    bool subscriberBlocked(MM_MMAP *multicastMap);          // true if any subscriber's link is blocked
+    void holdAck(MM_MMAP *multicastMap, SNC_EHEAD *ackEhead); // keeps the ack until the subscribers drain
+    QString mapLabels(MM_MMAP *multicastMap);               // metric labels for a map
+    bool addToLookupBatch(MM_MMAP *multicastMap);           // returns false if the lookup must be sent on its own
+    void flushLookupBatch(MM_LOOKUPBATCH *lookupBatch);     // sends a batch if it has any entries
+    bool addSlab();                                         // adds a slab of maps to the free list
     qint64 m_lastBackground;                                // keeps track of interval between backgrounds
 
+    MM_MMAP *m_slabs[MM_MAX_SLABS];                         // the allocated slabs
+    int m_slabCount;                                        // number of slabs allocated
+    MM_MMAP *m_freeHead;                                    // the list of free maps
+
+    bool m_batchLookups;                                    // true while MMBackground is collecting lookups
+    QList<MM_LOOKUPBATCH> m_lookupBatches;                  // one for each previous hop during MMBackground
+
+    qint64 m_cacheBytes;                                    // bytes currently used by cached records
+    int m_cachePendingCount;                                // registrations waiting for a cached record
+    int m_heldAckCount;                                     // maps with an ack held back from the source
+
+    bool m_metricsEnabled;                                  // true if metrics are being exported
+    SNCMetric *m_fanoutTime;                                // fan-out time histogram in microseconds
+
 };
 #endif // MULTICASTMANAGER_H
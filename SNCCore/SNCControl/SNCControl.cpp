@@ -148,12 +148,9 @@ void SNCControl::displayMulticast()
 
     QMutexLocker locker(&(m_server->m_multicastManager.m_lock));
 
-    MM_MMAP *multicastMap = m_server->m_multicastManager.m_multicastMap;
-
-    for (int i = 0; i < SNCSERVER_MAX_MMAPS; i++, multicastMap++) {
-        if (!multicastMap->valid)
-            continue;
+    MM_MMAP *multicastMap = m_server->m_multicastManager.m_activeHead;
 
+    for (; multicastMap != NULL; multicastMap = multicastMap->nextActive) {
         if (!first)
             printf("------------------------");
 
@@ -165,13 +162,12 @@ void SNCControl::displayMulticast()
                 SNCUtils::convertUC2ToUInt(multicastMap->serviceLookup.localPort),
                 SNCUtils::convertUC2ToUInt(multicastMap->serviceLookup.remotePort));
 
-        MM_REGISTEREDCOMPONENT *registeredComponent = multicastMap->head;
+        MM_REGISTEREDCOMPONENT *registeredComponent = multicastMap->registeredComponents;
 
-        while (registeredComponent != NULL) {
-            printf("          RC: UID=%s, port=%d, seq=%d, ack=%d\n",
+        for (int i = 0; i < multicastMap->registeredCount; i++, registeredComponent++) {
+            printf("          RC: UID=%s, port=%d, seq=%d, ack=%d, skipped=%lld\n",
                 qPrintable(SNCUtils::displayUID(&registeredComponent->registeredUID)), registeredComponent->port,
-                registeredComponent->sendSeq, registeredComponent->lastAckSeq);
-            registeredComponent = registeredComponent->next;
+                registeredComponent->sendSeq, registeredComponent->lastAckSeq, registeredComponent->skipped);
         }
     }
 
@@ -58,6 +58,33 @@ SNCServer::SNCServer() : SNCThread(TAG)
     if (!settings->contains(SNCSERVER_PARAMS_ENCRYPT_LOCAL))
         settings->setValue(SNCSERVER_PARAMS_ENCRYPT_LOCAL, false);
 
+    if (!settings->contains(SNCSERVER_PARAMS_TX_QUEUE_LIMIT))
+        settings->setValue(SNCSERVER_PARAMS_TX_QUEUE_LIMIT, SNCLINK_TX_LIMIT_DEFAULT);
+
+    if (!settings->contains(SNCSERVER_PARAMS_TX_POLICY_MULTICAST))
+        settings->setValue(SNCSERVER_PARAMS_TX_POLICY_MULTICAST, SNCLINK_TXPOLICY_NAME_DROP_OLDEST);
+
+    if (!settings->contains(SNCSERVER_PARAMS_TX_POLICY_E2E))
+        settings->setValue(SNCSERVER_PARAMS_TX_POLICY_E2E, SNCLINK_TXPOLICY_NAME_BLOCK);
+
+    if (!settings->contains(SNCSERVER_PARAMS_MULTICAST_CACHE_LIMIT))
+        settings->setValue(SNCSERVER_PARAMS_MULTICAST_CACHE_LIMIT, MM_CACHE_LIMIT_DEFAULT);
+
+    if (!settings->contains(SNCSERVER_PARAMS_MULTICAST_CACHE_MAXRECORD))
+        settings->setValue(SNCSERVER_PARAMS_MULTICAST_CACHE_MAXRECORD, MM_CACHE_MAXRECORD_DEFAULT);
+
+    if (!settings->contains(SNCSERVER_PARAMS_METRICS_INTERVAL))
+        settings->setValue(SNCSERVER_PARAMS_METRICS_INTERVAL, SNCMETRICS_INTERVAL_DEFAULT);
+
+    if (!settings->contains(SNCSERVER_PARAMS_METRICS_FILE))
+        settings->setValue(SNCSERVER_PARAMS_METRICS_FILE, "");
+
+    if (!settings->contains(SNCSERVER_PARAMS_METRICS_PORT))
+        settings->setValue(SNCSERVER_PARAMS_METRICS_PORT, 0);
+
+    if (!settings->contains(SNCSERVER_PARAMS_METRICS_ADDRESS))
+        settings->setValue(SNCSERVER_PARAMS_METRICS_ADDRESS, SNCMETRICS_ADDRESS_DEFAULT);
+
     if (!settings->contains(SNCSERVER_PARAMS_ENCRYPT_STATICTUNNEL_SERVER))
         settings->setValue(SNCSERVER_PARAMS_ENCRYPT_STATICTUNNEL_SERVER, false);
 
@@ -84,6 +111,34 @@ SNCServer::SNCServer() : SNCThread(TAG)
 
     int priority = settings->value(SNCSERVER_PARAMS_PRIORITY).toInt();
 
+    m_TXQueueLimit = settings->value(SNCSERVER_PARAMS_TX_QUEUE_LIMIT).toInt();
+    if (m_TXQueueLimit <= 0)
+        m_TXQueueLimit = SNCLINK_TX_LIMIT_DEFAULT;
+
+    m_multicastTXPolicy = SNCLink::TXPolicyFromName(settings->value(SNCSERVER_PARAMS_TX_POLICY_MULTICAST).toString());
+    if (m_multicastTXPolicy == -1) {
+        SNCUtils::logWarn(TAG, "Unknown multicast TX policy, using dropOldest");
+        m_multicastTXPolicy = SNCLINK_TXPOLICY_DROP_OLDEST;
+    }
+
+    m_E2ETXPolicy = SNCLink::TXPolicyFromName(settings->value(SNCSERVER_PARAMS_TX_POLICY_E2E).toString());
+    if (m_E2ETXPolicy == -1) {
+        SNCUtils::logWarn(TAG, "Unknown E2E TX policy, using block");
+        m_E2ETXPolicy = SNCLINK_TXPOLICY_BLOCK;
+    }
+
+    m_multicastManager.m_cacheLimit = settings->value(SNCSERVER_PARAMS_MULTICAST_CACHE_LIMIT).toLongLong();
+    m_multicastManager.m_cacheMaxRecord = settings->value(SNCSERVER_PARAMS_MULTICAST_CACHE_MAXRECORD).toInt();
+
+    m_metricsInterval = settings->value(SNCSERVER_PARAMS_METRICS_INTERVAL).toInt() * SNC_CLOCKS_PER_SEC;
+    if (m_metricsInterval < 0)
+        m_metricsInterval = 0;
+    m_metricsFile = settings->value(SNCSERVER_PARAMS_METRICS_FILE).toString();
+    m_metricsPort = settings->value(SNCSERVER_PARAMS_METRICS_PORT).toInt();
+    m_metricsAddress = settings->value(SNCSERVER_PARAMS_METRICS_ADDRESS).toString();
+    if (m_metricsInterval > 0)
+        m_multicastManager.MMEnableMetrics();
+
     settings->endGroup();
 
     // use some standard settings also
@@ -93,6 +148,7 @@ SNCServer::SNCServer() : SNCThread(TAG)
     m_listSyntroLinkSock = NULL;
     m_listStaticTunnelSock = NULL;
     m_hello = NULL;
+    m_metricsServer = NULL;
 
     delete settings;
 }
@@ -119,6 +175,7 @@ void SNCServer::initThread()
 
     loadStaticTunnels(settings);
     loadValidTunnelSources(settings);
+    loadStreamWeights(settings);
 
     m_nextConnectionID = 0;
 
@@ -134,6 +191,12 @@ void SNCServer::initThread()
     m_myUID = m_componentData.getMyUID();
     m_appName = settings->value(SNC_PARAMS_APPNAME).toString();
 
+    m_lastMetricsUpdate = SNCUtils::clock();
+    if ((m_metricsInterval > 0) && (m_metricsPort > 0)) {
+        m_metricsServer = new SNCMetricsServer(this);
+        m_metricsServer->start(m_metricsPort, m_metricsAddress);
+    }
+
     m_timer = startTimer(SNCSERVER_INTERVAL);
     m_lastOpenSocketsTime = SNCUtils::clock();
 
@@ -158,6 +221,8 @@ void SNCServer::finishThread()
         delete m_listSyntroLinkSock;
     if (m_listStaticTunnelSock != NULL)
         delete m_listStaticTunnelSock;
+    if (m_metricsServer != NULL)
+        delete m_metricsServer;
 }
 
 void SNCServer::loadStaticTunnels(QSettings *settings)
@@ -253,6 +318,94 @@ void SNCServer::loadValidTunnelSources(QSettings *settings)
     settings->endGroup();
 }
 
+void SNCServer::loadStreamWeights(QSettings *settings)
+{
+    settings->beginGroup(SNCSERVER_PARAMS_GROUP);
+
+    int	size = settings->beginReadArray(SNCSERVER_PARAMS_STREAM_WEIGHTS);
+    settings->endArray();
+
+    if (size == 0) {                                        // set a dummy entry for convenience
+        settings->beginWriteArray(SNCSERVER_PARAMS_STREAM_WEIGHTS);
+        settings->setArrayIndex(0);
+        settings->setValue(SNCSERVER_PARAMS_STREAM_WEIGHT_SERVICE, "");
+        settings->setValue(SNCSERVER_PARAMS_STREAM_WEIGHT, SNCLINK_FLOW_WEIGHT_DEFAULT);
+        settings->endArray();
+        settings->endGroup();
+        return;
+    }
+
+    settings->beginReadArray(SNCSERVER_PARAMS_STREAM_WEIGHTS);
+    for (int i = 0; i < size; i++) {
+        settings->setArrayIndex(i);
+        QString service = settings->value(SNCSERVER_PARAMS_STREAM_WEIGHT_SERVICE).toString();
+        int weight = settings->value(SNCSERVER_PARAMS_STREAM_WEIGHT).toInt();
+        if (service.length() == 0)
+            continue;
+        if ((weight < 1) || (weight > SNCLINK_FLOW_WEIGHT_MAX)) {
+            SNCUtils::logWarn(TAG, QString("Ignoring illegal weight %1 for stream %2").arg(weight).arg(service));
+            continue;
+        }
+        m_streamWeights.insert(service, weight);
+    }
+    settings->endArray();
+    SNCUtils::logInfo(TAG, QString("Loaded %1 stream weights").arg(m_streamWeights.count()));
+
+    settings->endGroup();
+}
+
+//  streamWeight returns the weight for a stream. A full service path entry takes
+//  precedence over a service name entry.
+
+int SNCServer::streamWeight(const char *componentName, const char *serviceName)
+{
+    QString servicePath;
+
+    if (m_streamWeights.isEmpty())
+        return SNCLINK_FLOW_WEIGHT_DEFAULT;
+
+    servicePath = QString(componentName) + SNC_SERVICEPATH_SEP + serviceName;
+    if (m_streamWeights.contains(servicePath))
+        return m_streamWeights.value(servicePath);
+    return m_streamWeights.value(serviceName, SNCLINK_FLOW_WEIGHT_DEFAULT);
+}
+
+//  setFlowWeight sets the weight of a flow on the link to a directly connected component
+
+void SNCServer::setFlowWeight(SNC_UID *uid, SNC_UID *sourceUID, int sourcePort, int weight)
+{
+    SS_COMPONENT *SNCComponent = m_components;
+
+    for (int i = 0; i < SNC_MAX_CONNECTEDCOMPONENTS; i++, SNCComponent++) {
+        if (SNCComponent->inUse && (SNCComponent->state >= ConnWFHeartbeat)) {
+            if (!SNCUtils::compareUID(uid, &(SNCComponent->heartbeat.hello.componentUID)))
+                continue;
+            if (SNCComponent->link != NULL)
+                SNCComponent->link->setFlowWeight(sourceUID, sourcePort, weight);
+            return;
+        }
+    }
+}
+
+//  isTXBlocked checks the link to a directly connected component. Like sendSNCMessage it
+//  doesn't take m_lock so MulticastManager can call it.
+
+bool SNCServer::isTXBlocked(SNC_UID *uid, int cmd, int priority)
+{
+    SS_COMPONENT *SNCComponent = m_components;
+
+    for (int i = 0; i < SNC_MAX_CONNECTEDCOMPONENTS; i++, SNCComponent++) {
+        if (SNCComponent->inUse && (SNCComponent->state >= ConnWFHeartbeat)) {
+            if (!SNCUtils::compareUID(uid, &(SNCComponent->heartbeat.hello.componentUID)))
+                continue;
+            if (SNCComponent->link != NULL)
+                return SNCComponent->link->isTXBlocked(cmd, priority);
+            return false;
+        }
+    }
+    return false;
+}
+
 bool SNCServer::openSockets()
 {
     int ret;
@@ -312,6 +465,17 @@ void SNCServer::setComponentSocket(SS_COMPONENT *SNCComponent, SNCSocket *sock)
     m_connectionIDMap[SNCComponent->connectionID] = SNCComponent->index;    // set the map entry
 }
 
+SNCLink *SNCServer::createLink()
+{
+    SNCLink *link = new SNCLink(TAG);
+
+    for (int priority = SNCLINK_HIGHPRI; priority <= SNCLINK_LOWPRI; priority++)
+        link->setTXLimit(priority, m_TXQueueLimit);
+    link->setTXPolicy(SERVICETYPE_MULTICAST, m_multicastTXPolicy);
+    link->setTXPolicy(SERVICETYPE_E2E, m_E2ETXPolicy);
+    return link;
+}
+
 SS_COMPONENT *SNCServer::getComponentFromConnectionID(int connectionID)
 {
     int componentIndex;
@@ -439,7 +603,7 @@ bool	SNCServer::syAccept(bool staticTunnel)
         }
         memcpy(component->compIPAddr, componentIPAddr, SNC_IPADDR_LEN);
         component->compPort = componentPort;
-        component->link = new SNCLink(TAG);
+        component->link = createLink();
     } else {
         component = getFreeComponent();
         if (component == NULL) {                            // too many components!
@@ -448,7 +612,7 @@ bool	SNCServer::syAccept(bool staticTunnel)
         }
         memcpy(component->compIPAddr, componentIPAddr, SNC_IPADDR_LEN);
         component->compPort = componentPort;
-        component->link = new SNCLink(TAG);
+        component->link = createLink();
     }
     component->inUse = true;
     setComponentSocket(component, sock);                    // configure component to use this socket
@@ -481,6 +645,11 @@ void	SNCServer::syCleanup(SS_COMPONENT *SNCComponent)
         if (SNCComponent->inUse) {
             m_dirManager.DMDeleteConnectedComponent(SNCComponent->dirManagerConnComp);
             SNCComponent->dirManagerConnComp = NULL;
+            SNCComponent->E2EBlockedOn = -1;
+            for (int i = 0; i < SNC_MAX_CONNECTEDCOMPONENTS; i++) {
+                if (m_components[i].E2EBlockedOn == SNCComponent->index)
+                    m_components[i].E2EBlockedOn = -1;     // nothing left to wait for
+            }
             if (SNCComponent->dirEntry != NULL) {
                 free(SNCComponent->dirEntry);
                 SNCComponent->dirEntry = NULL;
@@ -494,6 +663,8 @@ void	SNCServer::syCleanup(SS_COMPONENT *SNCComponent)
                 delete SNCComponent->link;
                 SNCComponent->link = NULL;
             }
+            if (m_metricsInterval > 0)
+                SNCMetrics::removeLabelled(SNCMetrics::label("slot", QString::number(SNCComponent->index)) + ",");
             if (SNCComponent->sock != NULL) {
                 delete SNCComponent->sock;
                 if ((SNCComponent->connectionID >= 0) && (SNCComponent->connectionID < SNC_MAX_CONNECTIONIDS))
@@ -531,6 +702,7 @@ SS_COMPONENT	*SNCServer::getFreeComponent()
             component->dirEntryLength = 0;
             component->index = i;
             component->dirManagerConnComp = m_dirManager.DMAllocateConnectedComponent(component);
+            component->E2EBlockedOn = -1;
 
             component->tempRXByteCount = 0;
             component->tempTXByteCount = 0;
@@ -583,6 +755,67 @@ bool SNCServer::sendSNCMessage(SNC_UID *uid, int cmd, SNC_MESSAGE *message, int
     return false;
 }
 
+//	lookupBatchSupported checks the flags in the last heartbeat from a directly connected component
+
+bool SNCServer::lookupBatchSupported(SNC_UID *uid)
+{
+    SS_COMPONENT *SNCComponent = m_components;
+
+    for (int i = 0; i < SNC_MAX_CONNECTEDCOMPONENTS; i++, SNCComponent++) {
+        if (SNCComponent->inUse && (SNCComponent->state == ConnNormal)) {
+            if (SNCUtils::compareUID(uid, &(SNCComponent->heartbeat.hello.componentUID)))
+                return (SNCComponent->heartbeat.hello.flags & SNCHELLO_FLAG_LOOKUP_BATCH) != 0;
+        }
+    }
+    return false;
+}
+
+//	processLookupBatchRequest runs each entry of a batched lookup through the directory
+//	and sends back a batch response with one compact entry per request entry.
+
+void SNCServer::processLookupBatchRequest(SS_COMPONENT *SNCComponent, SNC_SERVICE_LOOKUP_BATCH *batch, int length)
+{
+    SNC_SERVICE_LOOKUP_BATCH *response;
+    SNC_SERVICE_LOOKUP serviceLookup;
+    unsigned char *src;
+    unsigned char *dest;
+    int count;
+    int entryLength;
+    int i;
+
+    count = SNCUtils::convertUC2ToInt(batch->count);
+    if ((count <= 0) || (count > SNC_SERVICE_LOOKUP_BATCH_MAX)) {
+        SNCUtils::logWarn(TAG, QString("Service lookup batch with illegal count %1").arg(count));
+        return;
+    }
+
+    response = (SNC_SERVICE_LOOKUP_BATCH *)malloc(sizeof(SNC_SERVICE_LOOKUP_BATCH) + count * sizeof(SNC_SERVICE_LOOKUP_ENTRY));
+    src = (unsigned char *)(batch + 1);
+    dest = (unsigned char *)(response + 1);
+    length -= sizeof(SNC_SERVICE_LOOKUP_BATCH);
+
+    for (i = 0; i < count; i++) {
+        serviceLookup.servicePath[0] = 0;
+        if ((entryLength = SNCUtils::getLookupBatchEntry(src, length, &serviceLookup)) < 0) {
+            SNCUtils::logWarn(TAG, QString("Malformed service lookup batch entry %1 from %2")
+                .arg(i).arg(SNCUtils::displayUID(&SNCComponent->heartbeat.hello.componentUID)));
+            break;
+        }
+        src += entryLength;
+        length -= entryLength;
+        m_dirManager.DMFindService(&(SNCComponent->heartbeat.hello.componentUID), &serviceLookup, true);
+        dest += SNCUtils::putLookupBatchEntry(dest, &serviceLookup, false);
+    }
+    if (i == 0) {
+        free(response);
+        return;
+    }
+    SNCUtils::convertIntToUC2(i, response->count);
+    sendSNCMessage(&(SNCComponent->heartbeat.hello.componentUID), SNCMSG_SERVICE_LOOKUP_BATCH_RESPONSE,
+                (SNC_MESSAGE *)response, (int)(dest - (unsigned char *)response), SNCLINK_MEDHIGHPRI);
+    m_multicastManager.MMSendCachedRecords();               // new subscribers can now use cached records
+}
+
 //	processReceivedData - handles data received from SNCLinks
 //
 
@@ -600,6 +833,8 @@ void	SNCServer::processReceivedData(SS_COMPONENT *SNCComponent)
         SNCUtils::logWarn(TAG, "Received data on socket with no SCL");
         return;
     }
+    if (E2EHeld(SNCComponent))
+        return;                                             // leave it in the socket until the destination drains
     SNCComponent->link->tryReceiving(SNCComponent->sock);
 
     for (priority = SNCLINK_HIGHPRI; priority <= SNCLINK_LOWPRI; priority++) {
@@ -630,6 +865,7 @@ void SNCServer::processReceivedDataDemux(SS_COMPONENT *SNCComponent, int cmd, in
 {
     SNC_HEARTBEAT *heartbeat;
     SNC_SERVICE_LOOKUP *serviceLookup;
+    SNC_MESSAGE *serviceQueryResponse;
 
     switch (cmd) {
         case SNCMSG_HEARTBEAT:                              // SNC client heartbeat
@@ -693,12 +929,11 @@ void SNCServer::processReceivedDataDemux(SS_COMPONENT *SNCComponent, int cmd, in
             break;
 
         case SNCMSG_E2E:
-            forwardE2EMessage(message, length);
+            forwardE2EMessage(SNCComponent, message, length);
             break;
 
         case SNCMSG_MULTICAST_MESSAGE:                  // a multicast message
             forwardMulticastMessage(SNCComponent, cmd, message, length);    // forward on to the interested remotes
-            free(message);
             break;
 
         case SNCMSG_MULTICAST_ACK:                      // message is multicast header
@@ -718,6 +953,7 @@ void SNCServer::processReceivedDataDemux(SS_COMPONENT *SNCComponent, int cmd, in
             m_dirManager.DMFindService(&(SNCComponent->heartbeat.hello.componentUID), serviceLookup);
             sendSNCMessage(&(SNCComponent->heartbeat.hello.componentUID),
                         SNCMSG_SERVICE_LOOKUP_RESPONSE, message, length, SNCLINK_MEDHIGHPRI);
+            m_multicastManager.MMSendCachedRecords();       // new subscribers can now use cached records
             break;
 
         case SNCMSG_SERVICE_LOOKUP_RESPONSE:
@@ -725,6 +961,21 @@ void SNCServer::processReceivedDataDemux(SS_COMPONENT *SNCComponent, int cmd, in
             free(message);
             break;
 
+        case SNCMSG_SERVICE_LOOKUP_BATCH_REQUEST:       // a Component has requested a number of service lookups
+            if (length < (int)sizeof(SNC_SERVICE_LOOKUP_BATCH)) {
+                SNCUtils::logWarn(TAG, QString("Wrong size service lookup batch request %1").arg(length));
+                free(message);
+                break;
+            }
+            processLookupBatchRequest(SNCComponent, (SNC_SERVICE_LOOKUP_BATCH *)message, length);
+            free(message);
+            break;
+
+        case SNCMSG_SERVICE_LOOKUP_BATCH_RESPONSE:
+            m_multicastManager.MMProcessLookupBatchResponse((SNC_SERVICE_LOOKUP_BATCH *)message, length);
+            free(message);
+            break;
+
         case SNCMSG_DIRECTORY_REQUEST:
             free(message);                                  // nothing useful in the request itself
             m_dirManager.DMBuildDirectoryMessage(sizeof(SNC_DIRECTORY_RESPONSE), (char **)&message, &length, false);
@@ -732,6 +983,18 @@ void SNCServer::processReceivedDataDemux(SS_COMPONENT *SNCComponent, int cmd, in
                         SNCMSG_DIRECTORY_RESPONSE, message, length, SNCLINK_LOWPRI);
             break;
 
+        case SNCMSG_SERVICE_QUERY_REQUEST:
+            if (length != sizeof(SNC_SERVICE_QUERY)) {
+                SNCUtils::logWarn(TAG, QString("Wrong size service query request %1").arg(length));
+                free(message);
+                break;
+            }
+            m_dirManager.DMBuildServiceQueryResponse((SNC_SERVICE_QUERY *)message, (char **)&serviceQueryResponse, &length);
+            free(message);
+            sendSNCMessage(&(SNCComponent->heartbeat.hello.componentUID),
+                        SNCMSG_SERVICE_QUERY_RESPONSE, serviceQueryResponse, length, SNCLINK_LOWPRI);
+            break;
+
         default:
             if (message != NULL) {
                 SNCUtils::logWarn(TAG, QString("Unrecognized message %1 from %2")
@@ -1044,7 +1307,8 @@ void	SNCServer::SNCBackground()
                     SNCComponent->link->trySending(SNCComponent->sock);
                 }
 
-                if (SNCComponent->tunnel->m_connectInProgress || SNCComponent->tunnel->m_connected) {
+                if ((SNCComponent->tunnel->m_connectInProgress || SNCComponent->tunnel->m_connected) &&
+                        (SNCComponent->E2EBlockedOn == -1)) {
                     if (SNCUtils::timerExpired(now, SNCComponent->lastHeartbeatReceived,	m_heartbeatTimeoutCount * SNCComponent->heartbeatInterval)) {
                         if (!SNCComponent->tunnelStatic) {
                             SNCUtils::logWarn(TAG, QString("Timeout on tunnel source to %1").arg(SNCComponent->tunnel->m_helloEntry.hello.appName));
@@ -1061,7 +1325,8 @@ void	SNCServer::SNCBackground()
                     SNCComponent->link->trySending(SNCComponent->sock);
                 }
 
-                if (SNCUtils::timerExpired(SNCUtils::clock(), SNCComponent->lastHeartbeatReceived, m_heartbeatTimeoutCount * SNCComponent->heartbeatInterval)) {
+                if ((SNCComponent->E2EBlockedOn == -1) &&   // heartbeats are unread while held
+                        SNCUtils::timerExpired(SNCUtils::clock(), SNCComponent->lastHeartbeatReceived, m_heartbeatTimeoutCount * SNCComponent->heartbeatInterval)) {
                     SNCUtils::logWarn(TAG, QString("Timeout on %1").arg(SNCComponent->index));
                     syCleanup(SNCComponent);
                     updateSNCStatus(SNCComponent);
@@ -1069,11 +1334,19 @@ void	SNCServer::SNCBackground()
             }
         }
     }
+    m_multicastManager.MMReleaseHeldAcks();
     m_multicastManager.MMBackground();
+
+    if ((m_metricsInterval > 0) && SNCUtils::timerExpired(now, m_lastMetricsUpdate, m_metricsInterval)) {
+        m_lastMetricsUpdate = now;
+        updateMetrics();
+    }
 }
 
-void	SNCServer::forwardE2EMessage(SNC_MESSAGE *SNCMessage, int len)
+void	SNCServer::forwardE2EMessage(SS_COMPONENT *SNCComponent, SNC_MESSAGE *SNCMessage, int len)
 {
+    int priority;
+
     SNC_EHEAD *ehead;
     SS_COMPONENT *component;
 
@@ -1091,11 +1364,16 @@ void	SNCServer::forwardE2EMessage(SNC_MESSAGE *SNCMessage, int len)
         if (component->inUse && (component->state >= ConnWFHeartbeat)) {
             if (component->link != NULL) {
                 SNCUtils::logDebug(TAG, QString("Send to ") + SNCUtils::displayUID(&component->heartbeat.hello.componentUID));
-                component->link->send(SNCMSG_E2E, len, SNCMessage->flags & SNCLINK_PRI, SNCMessage);
+                priority = SNCMessage->flags & SNCLINK_PRI;
+                component->link->send(SNCMSG_E2E, len, priority, SNCMessage);
                 updateTXStats(component, len);
                 component->link->trySending(component->sock);
                 m_E2EOut++;
                 m_E2EOutRate++;
+                if (component->link->isTXBlocked(SNCMSG_E2E, priority)) {
+                    SNCComponent->E2EBlockedOn = component->index;
+                    SNCComponent->E2EBlockedPriority = priority;
+                }
             } else {
                 free(SNCMessage);
             }
@@ -1110,14 +1388,36 @@ void	SNCServer::forwardE2EMessage(SNC_MESSAGE *SNCMessage, int len)
 }
 
 
+//  E2EHeld checks whether a component is still held off by a blocked E2E destination.
+//  The heartbeat timer restarts on release as the component's heartbeats were left unread.
+
+bool SNCServer::E2EHeld(SS_COMPONENT *SNCComponent)
+{
+    SS_COMPONENT *dest;
+
+    if (SNCComponent->E2EBlockedOn == -1)
+        return false;
+
+    dest = m_components + SNCComponent->E2EBlockedOn;
+    if (dest->inUse && (dest->link != NULL) && dest->link->isTXBlocked(SNCMSG_E2E, SNCComponent->E2EBlockedPriority))
+        return true;
+
+    SNCComponent->E2EBlockedOn = -1;
+    SNCComponent->lastHeartbeatReceived = SNCUtils::clock();
+    return false;
+}
+
+
 void	SNCServer::forwardMulticastMessage(SS_COMPONENT *SNCComponent, int cmd, SNC_MESSAGE *message, int length)
 {
     if (!SNCComponent->inUse) {
         SNCUtils::logWarn(TAG, QString("ForwardMessage on not in use component %1").arg(SNCUtils::displayUID(&SNCComponent->heartbeat.hello.componentUID)));
+        free(message);
         return;												// not in use - hmmm. Should not happen!
     }
     if (length < (int)sizeof(SNC_EHEAD)) {
         SNCUtils::logWarn(TAG, QString("ForwardMessage is too short %1").arg(length));
+        free(message);
         return;												// not in use - hmmm. Should not happen!
     }
     m_multicastManager.MMForwardMulticastMessage(cmd, message, length);
@@ -1243,5 +1543,73 @@ void SNCServer::updateSNCData(SS_COMPONENT *SNCComponent)
     list.append(TXByteCount);
     list.append(RXByteRate);
     list.append(TXByteRate);
+
+    // add link queue state summed over priorities
+
+    qint64 queued = 0, droppedMessages = 0, droppedBytes = 0;
+    qint64 priQueued, priDroppedMessages, priDroppedBytes;
+
+    if (SNCComponent->link != NULL) {
+        for (int priority = SNCLINK_HIGHPRI; priority <= SNCLINK_LOWPRI; priority++) {
+            SNCComponent->link->getTXStats(priority, priQueued, priDroppedMessages, priDroppedBytes);
+            queued += priQueued;
+            droppedMessages += priDroppedMessages;
+            droppedBytes += priDroppedBytes;
+        }
+    }
+    list.append(QString::number(queued));
+    list.append(QString("%1 (%2)").arg(droppedMessages).arg(droppedBytes));
     emit updateSNCDataBox(SNCComponent->index, list);
 }
+
+void SNCServer::updateMetrics()
+{
+    SS_COMPONENT *SNCComponent;
+    qint64 queued, droppedMessages, droppedBytes;
+    int components = 0;
+
+    SNCMetrics::counter("snc_multicast_in_total", "Multicast messages received")->set(m_multicastIn);
+    SNCMetrics::counter("snc_multicast_out_total", "Multicast messages sent")->set(m_multicastOut);
+    SNCMetrics::counter("snc_e2e_in_total", "E2E messages received")->set(m_E2EIn);
+    SNCMetrics::counter("snc_e2e_out_total", "E2E messages sent")->set(m_E2EOut);
+
+    SNCComponent = m_components;
+    for (int i = 0; i < SNC_MAX_CONNECTEDCOMPONENTS; i++, SNCComponent++) {
+        if (!SNCComponent->inUse || (SNCComponent->link == NULL) || (SNCComponent->state != ConnNormal))
+            continue;
+        components++;
+
+        QString labels = linkLabels(SNCComponent);
+
+        SNCMetrics::counter("snc_link_rx_bytes_total", "Bytes received on a link", labels)->set(SNCComponent->RXByteCount);
+        SNCMetrics::counter("snc_link_tx_bytes_total", "Bytes sent on a link", labels)->set(SNCComponent->TXByteCount);
+        SNCMetrics::counter("snc_link_rx_messages_total", "Messages received on a link", labels)->set(SNCComponent->RXPacketCount);
+        SNCMetrics::counter("snc_link_tx_messages_total", "Messages sent on a link", labels)->set(SNCComponent->TXPacketCount);
+
+        for (int priority = SNCLINK_HIGHPRI; priority <= SNCLINK_LOWPRI; priority++) {
+            SNCComponent->link->getTXStats(priority, queued, droppedMessages, droppedBytes);
+            QString priLabels = labels + "," + SNCMetrics::label("priority", QString::number(priority));
+            SNCMetrics::gauge("snc_link_tx_queued_bytes", "Bytes waiting in a link priority queue",
+                    priLabels)->set(queued);
+            SNCMetrics::counter("snc_link_tx_dropped_messages_total", "Messages dropped by a link priority queue",
+                    priLabels)->set(droppedMessages);
+            SNCMetrics::counter("snc_link_tx_dropped_bytes_total", "Bytes dropped by a link priority queue",
+                    priLabels)->set(droppedBytes);
+        }
+    }
+    SNCMetrics::gauge("snc_links", "Connected links")->set(components);
+
+    m_multicastManager.MMUpdateMetrics();
+
+    if (!m_metricsFile.isEmpty())
+        SNCMetrics::writeFile(m_metricsFile);
+}
+
+//  The slot comes first so that all of a component's metrics can be removed by prefix
+
+QString SNCServer::linkLabels(SS_COMPONENT *SNCComponent)
+{
+    return SNCMetrics::label("slot", QString::number(SNCComponent->index)) + ","
+            + SNCMetrics::label("uid", SNCUtils::displayUID(&SNCComponent->heartbeat.hello.componentUID)) + ","
+            + SNCMetrics::label("app", SNCComponent->heartbeat.hello.appName);
+}
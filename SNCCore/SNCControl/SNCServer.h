@@ -29,6 +29,7 @@
 #include "FastUIDLookup.h"
 #include "SNCComponentData.h"
 #include "SNCLink.h"
+#include "SNCMetrics.h"
 
 #include <qstringlist.h>
 
@@ -49,9 +50,29 @@
 
 #define SNCSERVER_PARAMS_PRIORITY                               "controlPriority"       // priority of this SNCControl
 
+#define SNCSERVER_PARAMS_TX_QUEUE_LIMIT                         "TXQueueLimit"          // byte limit of each link priority queue
+#define SNCSERVER_PARAMS_TX_POLICY_MULTICAST                    "TXPolicyMulticast"     // queue policy for multicast messages
+#define SNCSERVER_PARAMS_TX_POLICY_E2E                          "TXPolicyE2E"           // queue policy for E2E messages
+
+#define SNCSERVER_PARAMS_MULTICAST_CACHE_LIMIT                  "MulticastCacheLimit"   // total bytes of cached multicast records (0 = off)
+#define SNCSERVER_PARAMS_MULTICAST_CACHE_MAXRECORD              "MulticastCacheMaxRecord" // largest multicast record that is cached
+
+#define SNCSERVER_PARAMS_METRICS_INTERVAL                       "MetricsInterval"       // seconds between metrics updates (0 = off)
+#define SNCSERVER_PARAMS_METRICS_FILE                           "MetricsFile"           // Prometheus text file to write (empty = none)
+#define SNCSERVER_PARAMS_METRICS_PORT                           "MetricsPort"           // TCP port for Prometheus scrapes (0 = none)
+#define SNCSERVER_PARAMS_METRICS_ADDRESS                        "MetricsAddress"        // address the scrape port listens on
+
 #define SNCSERVER_PARAMS_VALID_TUNNEL_SOURCES   "ValidTunnelSources"    // UIDs of valid tunnel sources
 #define SNCSERVER_PARAMS_VALID_TUNNEL_UID       "ValidTunnelUID"        // the array entry
 
+//  Stream weights set the SNCLink DRR weight of multicast streams on the links to their
+//  subscribers. The service is either a full service path (component/service) or just a
+//  service name that applies to that service of every component.
+
+#define SNCSERVER_PARAMS_STREAM_WEIGHTS         "StreamWeights" // the array name
+#define SNCSERVER_PARAMS_STREAM_WEIGHT_SERVICE  "StreamWeightService" // service path or name
+#define SNCSERVER_PARAMS_STREAM_WEIGHT          "StreamWeight"  // weight from 1 to SNCLINK_FLOW_WEIGHT_MAX
+
 //  Static tunnel settings defs
 
 #define SNCSERVER_PARAMS_STATIC_TUNNELS         "StaticTunnels" // the group name
@@ -117,6 +138,8 @@ typedef struct
     char *dirEntry;                                         // this is the currently in use DE
     int dirEntryLength;                                     // and its length (can't use strlen as may have multiple components)
     DM_CONNECTEDCOMPONENT *dirManagerConnComp;              // this is the directory manager entry for this connection
+    int E2EBlockedOn;                                       // index of the E2E destination holding off reads from this one or -1
+    int E2EBlockedPriority;                                 // and the priority that is blocked there
 
     quint64 tempRXByteCount;                                // for receive byte rate calculation
     quint64 tempTXByteCount;                                // for transmit byte rate calculation
@@ -167,7 +190,12 @@ public:
     FastUIDLookup m_fastUIDLookup;                          // the fast UID lookup object
 
     bool sendSNCMessage(SNC_UID *uid, int cmd, SNC_MESSAGE *message, int length, int priority);
+    bool lookupBatchSupported(SNC_UID *uid);                // true if the connected component understands batched lookups
     void setComponentSocket(SS_COMPONENT *SNCComponent, SNCSocket *sock); // allocate a socket to this component
+    SNCLink *createLink();                                  // creates a link with the configured queue limits and policies
+    int streamWeight(const char *componentName, const char *serviceName); // configured DRR weight for a stream
+    void setFlowWeight(SNC_UID *uid, SNC_UID *sourceUID, int sourcePort, int weight); // sets a weight on the link to uid
+    bool isTXBlocked(SNC_UID *uid, int cmd, int priority);  // true if the link to uid is holding off cmd under the block policy
 
     qint64 m_multicastIn;                                   // total multicast in count
     unsigned m_multicastInRate;                             // rate accumulator
@@ -192,6 +220,7 @@ protected:
     void timerEvent(QTimerEvent *event);
     void loadStaticTunnels(QSettings *settings);
     void loadValidTunnelSources(QSettings *settings);
+    void loadStreamWeights(QSettings *settings);
     bool processMessage(SNCThreadMsg* msg);
     bool openSockets();                                     // open the sockets SNCControl needs
     int getNextConnectionID();                              // gets the next free connection ID
@@ -214,13 +243,17 @@ protected:
     void syCleanup(SS_COMPONENT *pSC);
     void updateSNCStatus(SS_COMPONENT *SNCComponent);
     void updateSNCData(SS_COMPONENT *SNCComponent);
+    void updateMetrics();                                   // refreshes the metrics registry and writes the file
+    QString linkLabels(SS_COMPONENT *SNCComponent);         // metric labels for a component's link
 
 
-//  forwardE2EMessage - forward an endpoint to endpoint message
+//  forwardE2EMessage - forward an endpoint to endpoint message. If the destination's link is
+//  then blocked, reads from the source component stop until it drains.
 
-    void forwardE2EMessage(SNC_MESSAGE *message, int length);
+    void forwardE2EMessage(SS_COMPONENT *SNCComponent, SNC_MESSAGE *message, int length);
+    bool E2EHeld(SS_COMPONENT *SNCComponent);               // true while the component's E2E destination is blocked
 
-//  forwardMulticastMessage - forwards a multicastmessage to the registered remote Components
+//  forwardMulticastMessage - forwards a multicastmessage to the registered remote Components. Takes ownership of message.
 
     void forwardMulticastMessage(SS_COMPONENT *SNCComponent, int cmd, SNC_MESSAGE *message, int length);
 
@@ -238,9 +271,21 @@ protected:
     SS_COMPONENT *getComponentFromConnectionID(int connectionID); // uses m_connectioIDMap to get a component pointer
     void processReceivedData(SS_COMPONENT *SNCComponent);
     void processReceivedDataDemux(SS_COMPONENT *SNCComponent, int cmd, int length, SNC_MESSAGE *message);
+    void processLookupBatchRequest(SS_COMPONENT *SNCComponent, SNC_SERVICE_LOOKUP_BATCH *batch, int length);
     qint64 m_heartbeatSendInterval;                         // the initial interval for apps and the send interval for tunnel sources
     int m_heartbeatTimeoutCount;                            // number of heartbeat periods before SNCLink timed out
 
+    int m_TXQueueLimit;                                     // byte limit of each link priority queue
+    int m_multicastTXPolicy;                                // link queue policy for multicast messages
+    int m_E2ETXPolicy;                                      // link queue policy for E2E messages
+
+    qint64 m_metricsInterval;                               // interval between metrics updates (0 = off)
+    QString m_metricsFile;                                  // the Prometheus text file or empty
+    int m_metricsPort;                                      // the Prometheus scrape port or 0
+    QString m_metricsAddress;                               // the address the scrape port listens on
+    qint64 m_lastMetricsUpdate;                             // when the metrics were last updated
+    SNCMetricsServer *m_metricsServer;                      // serves scrapes if m_metricsPort set
+
     int m_connectionIDMap[SNC_MAX_CONNECTIONIDS];           // maps connection IDs to component index
     int m_nextConnectionID;                                 // used to allocate unique IDs to socket connections
 
@@ -256,6 +301,7 @@ protected:
     qint64 m_lastOpenSocketsTime;                           // last time open sockets failed
 
     QList<SNC_UID> m_validTunnelSources;                    // list of valid UIDs that can be tunnel sources
+    QHash<QString, int> m_streamWeights;                    // configured stream weights keyed by service path or name
 
 private:
 
@@ -92,12 +92,13 @@ bool SNCTunnel::connect()
     else
         m_comp->sock = new SNCSocket(m_server, id, m_server->m_encryptLocal);
     m_server->setComponentSocket(m_comp, m_comp->sock);
-    m_comp->link = new SNCLink(TAG);
+    m_comp->link = m_server->createLink();
     returnValue = m_comp->sock->sockCreate(0, SOCK_STREAM);
 
     m_comp->sock->sockSetConnectMsg(SNCSERVER_ONCONNECT_MESSAGE);
     m_comp->sock->sockSetCloseMsg(SNCSERVER_ONCLOSE_MESSAGE);
     m_comp->sock->sockSetReceiveMsg(SNCSERVER_ONRECEIVE_MESSAGE);
+    m_comp->sock->sockSetSendMsg(SNCSERVER_ONSEND_MESSAGE);
 
     m_comp->sock->sockSetReceiveBufSize(bufSize);
     m_comp->sock->sockSetSendBufSize(bufSize);
@@ -100,12 +100,114 @@ void SNCCFSClient::getTimestamp(int sessionId, QString source, qint64 ts)
             return;
         }
 
-        if (!CFSReadAtIndex(si->m_activeCFS->port, si->m_handle, si->m_recordIndex)) {
-            SNCUtils::logWarn(m_tag, QString("Read at index %1 for timestamp %2 failed").arg(si->m_recordIndex).arg(ts));
-            return;
+        // records are normally already in the cache from the read ahead. If not, and the record
+        // isn't in a read that's still in progress, this must be a seek so restart the read ahead.
+
+        if (!si->m_cache.contains(si->m_recordIndex)) {
+            if ((si->m_readsOutstanding == 0) || ((unsigned int)si->m_recordIndex < si->m_readStart) ||
+                    ((unsigned int)si->m_recordIndex >= si->m_nextReadIndex))
+                resetReadAhead(si, si->m_recordIndex);
         }
-        si->m_readOutstanding = true;
+
+        si->m_waitingForRecord = true;
+        deliverRecord(si);
+        readAhead(si);
+    }
+}
+
+void SNCCFSClient::resetReadAhead(CFSSessionInfo *si, unsigned int index)
+{
+    si->m_cache.clear();
+    si->m_readStart = index;
+    si->m_nextReadIndex = index;
+}
+
+void SNCCFSClient::readAhead(CFSSessionInfo *si)
+{
+    // keep the pipeline full so that playback isn't limited by the round trip time to the store
+
+    while ((si->m_readsOutstanding < SNCCFS_MAX_READS_OUTSTANDING) && (si->m_nextReadIndex < si->m_dataFileLength) &&
+           (si->m_nextReadIndex < (unsigned int)si->m_recordIndex + SNCCFSCLIENT_READ_AHEAD)) {
+        if (!CFSReadMulti(si->m_activeCFS->port, si->m_handle, si->m_nextReadIndex, SNCCFSCLIENT_READ_RECORDS))
+            break;
+
+        si->m_readsOutstanding++;
+        si->m_nextReadIndex = qMin(si->m_nextReadIndex + SNCCFSCLIENT_READ_RECORDS, si->m_dataFileLength);
+    }
+}
+
+void SNCCFSClient::deliverRecord(CFSSessionInfo *si)
+{
+    if (!si->m_waitingForRecord || !si->m_cache.contains(si->m_recordIndex))
+        return;
+
+    si->m_waitingForRecord = false;
+
+    // drop anything that playback has passed
+
+    si->m_readStart = qMax(si->m_readStart, (unsigned int)si->m_recordIndex);
+
+    QMutableHashIterator<int, QByteArray> entry(si->m_cache);
+    while (entry.hasNext()) {
+        entry.next();
+        if (entry.key() < si->m_recordIndex)
+            entry.remove();
     }
+
+    // the decoders only read the record so decode straight from the cache
+
+    const QByteArray& record = si->m_cache[si->m_recordIndex];
+
+    if (si->m_isSensor)
+        sensorDecode(si, (SNC_RECORD_HEADER *)record.constData(), record.length());
+    else
+        videoDecode(si, (SNC_RECORD_HEADER *)record.constData(), record.length());
+}
+
+void SNCCFSClient::CFSReadMultiResponse(int, int handle, unsigned int index,
+        unsigned int responseCode, QList<QByteArray> records)
+{
+    CFSSessionInfo *si = lookUpHandle(handle);
+
+    if (si == NULL) {
+        SNCUtils::logError(m_tag, QString("CFSReadMultiResponse - failed to find session for handle %1").arg(handle));
+        return;
+    }
+
+    if (si->m_readsOutstanding > 0)
+        si->m_readsOutstanding--;
+
+    if (si->m_state != SNCCFSCLIENT_STATE_SFOPEN)
+        return;
+
+    if (responseCode != SNCCFS_SUCCESS) {
+        // the next request for a missing record will restart the read ahead
+        SNCUtils::logWarn(m_tag, QString("Read multi response - got error code %1 from %2").arg(responseCode).arg(si->m_activeFile));
+        return;
+    }
+
+    for (int i = 0; i < records.count(); i++) {
+        unsigned int recordIndex = index + i;
+
+        // ignore records from before a seek
+        if ((recordIndex >= si->m_readStart) && (recordIndex < si->m_nextReadIndex))
+            si->m_cache.insert(recordIndex, records.at(i));
+    }
+
+    // the store may return fewer records than requested if they are large so fill in the gap
+
+    unsigned int nextIndex = index + records.count();
+
+    if ((records.count() > 0) && (records.count() < SNCCFSCLIENT_READ_RECORDS) &&
+            (nextIndex >= si->m_readStart) && (nextIndex < si->m_nextReadIndex) && !si->m_cache.contains(nextIndex)) {
+        if (CFSReadMulti(si->m_activeCFS->port, si->m_handle, nextIndex, SNCCFSCLIENT_READ_RECORDS - records.count()))
+            si->m_readsOutstanding++;
+        else
+            si->m_nextReadIndex = nextIndex;                // read ahead will pick it up again
+    }
+
+    deliverRecord(si);
+    readAhead(si);
 }
 
 void SNCCFSClient::newCFSList()
@@ -187,32 +289,26 @@ bool SNCCFSClient::openSource(CFSSessionInfo *si, qint64 ts)
 
     si->m_activeCFS = serverInfo;
 
-    if ((si->m_handle = CFSOpenRawFile(si->m_activeCFS->port, si->m_indexFile, si->m_blockSize)) == -1) {
-        emit newCFSState(si->m_sessionId, "index file open failed - now idle");
+    // the index is fetched in bulk through the data file handle so there's no need to open the index file
+
+    if ((si->m_handle = CFSOpenStructuredFile(si->m_activeCFS->port, si->m_dataFile)) == -1) {
+        emit newCFSState(si->m_sessionId, "data file open failed - now idle");
         return false;												// open failed
     }
 
     si->m_activeFile = fileName;
-    si->m_state = SNCCFSCLIENT_STATE_IXOPENING;
+    si->m_state = SNCCFSCLIENT_STATE_SFOPENING;
     si->m_readOutstanding = false;
-    emit newCFSState(si->m_sessionId, "opening index file");
+    si->m_readsOutstanding = 0;
+    si->m_waitingForRecord = false;
+    resetReadAhead(si, 0);
+    emit newCFSState(si->m_sessionId, "data file opening");
     return true;
 }
 
 void SNCCFSClient::closeSource(CFSSessionInfo *si)
 {
-    if (si->m_state == SNCCFSCLIENT_STATE_IXOPEN) {
-        if (CFSClose(si->m_activeCFS->port, si->m_handle)) {
-           si->m_state = SNCCFSCLIENT_STATE_IXCLOSING;
-           emit newCFSState(si->m_sessionId, "index file closing");
-        } else {
-           si->m_state = SNCCFSCLIENT_STATE_IDLE;
-           emit newCFSState(si->m_sessionId, "index file close failed - now idle");
-           openSource(si, si->m_ts);
-        }
-    }
-
-    if (si->m_state == SNCCFSCLIENT_STATE_SFOPEN) {
+    if ((si->m_state == SNCCFSCLIENT_STATE_SFINDEXING) || (si->m_state == SNCCFSCLIENT_STATE_SFOPEN)) {
         if (CFSClose(si->m_activeCFS->port, si->m_handle)) {
            si->m_state = SNCCFSCLIENT_STATE_SFCLOSING;
            emit newCFSState(si->m_sessionId, "data file file closing");
@@ -300,32 +396,86 @@ void SNCCFSClient::CFSOpenResponse(int remoteServiceEP, unsigned int responseCod
         emit newCFSState(si->m_sessionId, "open error - now idle");
         return;
     }
-    if (si->m_state == SNCCFSCLIENT_STATE_IXOPENING) {
-        si->m_state = SNCCFSCLIENT_STATE_IXOPEN;
-        SNCUtils::logDebug(m_tag, QString("Opened %1 on port %2, handle %3").arg(si->m_activeFile).arg(remoteServiceEP).arg(handle));
-        si->m_indexFileLength = fileLength;
+    if (si->m_state == SNCCFSCLIENT_STATE_SFOPENING) {
+        si->m_state = SNCCFSCLIENT_STATE_SFINDEXING;
+        si->m_dataFileLength = fileLength;
+        SNCUtils::logDebug(m_tag, QString("Opened %1 on port %2, handle %3")
+                           .arg(si->m_activeFile).arg(remoteServiceEP).arg(handle));
+        si->m_index.clear();
+        si->m_index.reserve(fileLength);
         si->m_indexIndex = 0;
-        CFSReadAtIndex(remoteServiceEP, handle, si->m_indexIndex, 1);
-        si->m_readOutstanding = true;
-        emit newCFSState(si->m_sessionId, "index file open");
+        si->m_indexRetries = 0;
+        emit newCFSState(si->m_sessionId, "reading index");
+        readIndexRange(si);
     } else {
-        if (si->m_state == SNCCFSCLIENT_STATE_SFOPENING) {
-            si->m_state = SNCCFSCLIENT_STATE_SFOPEN;
-            emit newCFSState(si->m_sessionId, "data file open");
-            si->m_dataFileLength = fileLength;
-            SNCUtils::logDebug(m_tag, QString("Opened %1 on port %2, handle %3")
-                               .arg(si->m_activeFile).arg(remoteServiceEP).arg(handle));
-            getTimestamp(si->m_sessionId, si->m_source, si->m_ts);
-        } else {
-            SNCUtils::logWarn(m_tag, QString("Open response - incorrect state from %2").arg(si->m_activeFile));
-            si->m_state = SNCCFSCLIENT_STATE_IDLE;
-            emit newCFSState(si->m_sessionId, "data file open failed - now idle");
+        SNCUtils::logWarn(m_tag, QString("Open response - incorrect state from %2").arg(si->m_activeFile));
+        si->m_state = SNCCFSCLIENT_STATE_IDLE;
+        emit newCFSState(si->m_sessionId, "data file open failed - now idle");
+        return;
+    }
+}
+
+void SNCCFSClient::CFSReadIndexRangeResponse(int remoteServiceEP, int handle, unsigned int nextIndex,
+        unsigned int responseCode, unsigned char *indexData, int length)
+{
+    CFSSessionInfo *si = lookUpHandle(handle);
+
+    if (si == NULL) {
+        SNCUtils::logError(m_tag, QString("CFSReadIndexRangeResponse - failed to find session for handle %1").arg(handle));
+        if (indexData != NULL)
+            free(indexData);
+        return;
+    }
+
+    si->m_readOutstanding = false;
+
+    if ((responseCode != SNCCFS_SUCCESS) && (si->m_state == SNCCFSCLIENT_STATE_SFINDEXING)) {
+        if (indexData != NULL)
+            free(indexData);
+        SNCUtils::logWarn(m_tag, QString("Index range response - got error code %1 at %2 from %3")
+                          .arg(responseCode).arg(si->m_indexIndex).arg(si->m_activeFile));
+        if (++si->m_indexRetries > SNCCFSCLIENT_INDEX_RETRIES) {
+            indexFailed(si, QString("Index range read at %1 from %2 failed").arg(si->m_indexIndex).arg(si->m_activeFile));
             return;
         }
+        readIndexRange(si);                                 // try the same range again
+        return;
     }
+
+    if (si->m_state != SNCCFSCLIENT_STATE_SFINDEXING) {
+        SNCUtils::logWarn(m_tag, QString("Got index range in incorrect state %1").arg(si->m_state));
+        if (indexData != NULL)
+            free(indexData);
+        return;
+    }
+
+    int entryCount = length / sizeof(SNC_CFSRANGEENTRY);
+    SNC_CFSRANGEENTRY *entry = reinterpret_cast<SNC_CFSRANGEENTRY *>(indexData);
+
+    for (int i = 0; i < entryCount; i++, entry++)
+        si->m_index.append(SNCUtils::convertUC8ToInt64(entry->cfsTimestamp));
+
+    if (indexData != NULL)
+        free(indexData);
+
+    si->m_indexIndex = nextIndex;
+    si->m_indexRetries = 0;
+
+    if ((entryCount > 0) && (si->m_indexIndex < si->m_dataFileLength)) {
+        readIndexRange(si);
+        return;
+    }
+
+    // index transfer complete
+
+    createIndexDir(si);
+
+    si->m_state = SNCCFSCLIENT_STATE_SFOPEN;
+    emit newCFSState(si->m_sessionId, "data file open");
+    getTimestamp(si->m_sessionId, si->m_source, si->m_ts);
 }
 
-void SNCCFSClient::CFSReadAtIndexResponse(int remoteServiceEP, int handle, unsigned int recordIndex,
+void SNCCFSClient::CFSReadAtIndexResponse(int, int handle, unsigned int recordIndex,
         unsigned int responseCode, unsigned char *fileData, int length)
 {
     CFSSessionInfo *si = lookUpHandle(handle);
@@ -345,45 +495,7 @@ void SNCCFSClient::CFSReadAtIndexResponse(int remoteServiceEP, int handle, unsig
         return;
     }
 
-    if (si->m_state == SNCCFSCLIENT_STATE_IXOPEN) {
-        if (recordIndex != si->m_indexIndex) {
-             SNCUtils::logWarn(m_tag, QString("Got read at %1, expected %2").arg(recordIndex).arg(si->m_indexIndex));
-             free(fileData);
-             return;
-        }
-        int indexCount = length / sizeof(SNC_CFSINDEX);
-        unsigned char *fp = fileData;
-
-        for (int index = 0; index < indexCount; index++) {
-            si->m_index.append(*((qint64 *)(fp + 8)));
-            fp += sizeof(SNC_CFSINDEX);
-        }
-        free(fileData);
-
-        if (++si->m_indexIndex == si->m_indexFileLength) {
-            // index file transfer complete
-
-            createIndexDir(si);
-
-            if (CFSClose(si->m_activeCFS->port, si->m_handle)) {
-                si->m_state = SNCCFSCLIENT_STATE_IXCLOSING;
-                emit newCFSState(si->m_sessionId, "index file closing");
-            } else {
-                emit newCFSState(si->m_sessionId, "index file close error - now idle");
-                si->m_state = SNCCFSCLIENT_STATE_IDLE;
-            }
-        } else {
-            if (!CFSReadAtIndex(remoteServiceEP, handle, si->m_indexIndex, 1)) {
-                SNCUtils::logWarn(m_tag, QString("Index read at index for record %1 from %2 failed")
-                                  .arg(si->m_indexIndex).arg(si->m_activeFile));
-                emit newCFSState(si->m_sessionId, QString("Index read at index for record %1 from %2 failed")
-                                 .arg(si->m_indexIndex).arg(si->m_activeFile));
-            } else {
-                si->m_readOutstanding = true;
-            }
-        }
-
-    } else if (si->m_state == SNCCFSCLIENT_STATE_SFOPEN) {
+    if (si->m_state == SNCCFSCLIENT_STATE_SFOPEN) {
        if ((int)recordIndex != si->m_recordIndex) {
             SNCUtils::logWarn(m_tag, QString("Got read at %1, expected %2").arg(recordIndex).arg(si->m_recordIndex));
             free(fileData);
@@ -397,6 +509,36 @@ void SNCCFSClient::CFSReadAtIndexResponse(int remoteServiceEP, int handle, unsig
     } else {
         SNCUtils::logWarn(m_tag, QString("Got read at %1 in incorrect state %2").arg(recordIndex).arg(si->m_state));
     }
+    free(fileData);
+}
+
+void SNCCFSClient::readIndexRange(CFSSessionInfo *si)
+{
+    if (!CFSReadIndexRange(si->m_activeCFS->port, si->m_handle, si->m_indexIndex)) {
+        indexFailed(si, QString("Index range read at %1 from %2 failed").arg(si->m_indexIndex).arg(si->m_activeFile));
+        return;
+    }
+    si->m_readOutstanding = true;
+}
+
+//  indexFailed gives up on a file whose index can't be read. The source is forgotten as
+//  well so that the close response leaves the session idle rather than opening the file
+//  again. The next getTimestamp starts over.
+
+void SNCCFSClient::indexFailed(CFSSessionInfo *si, const QString& reason)
+{
+    SNCUtils::logWarn(m_tag, reason);
+    si->m_source = "";
+    si->m_index.clear();
+    si->m_readOutstanding = false;
+
+    if (CFSClose(si->m_activeCFS->port, si->m_handle)) {
+        si->m_state = SNCCFSCLIENT_STATE_SFCLOSING;
+        emit newCFSState(si->m_sessionId, reason + " - closing");
+    } else {
+        si->m_state = SNCCFSCLIENT_STATE_IDLE;
+        emit newCFSState(si->m_sessionId, reason + " - now idle");
+    }
 }
 
 void SNCCFSClient::CFSCloseResponse(int , unsigned int responseCode, int handle)
@@ -408,15 +550,6 @@ void SNCCFSClient::CFSCloseResponse(int , unsigned int responseCode, int handle)
         return;
     }
 
-    if (si->m_state == SNCCFSCLIENT_STATE_IXCLOSING) {
-        if ((si->m_handle = CFSOpenStructuredFile(si->m_activeCFS->port, si->m_dataFile)) == -1) {
-            setCFSStateIdle(si);
-            return;												// structured open failed
-        }
-        si->m_state = SNCCFSCLIENT_STATE_SFOPENING;
-        emit newCFSState(si->m_sessionId, "data file opening");
-        return;
-    }
     setCFSStateIdle(si);
     SNCUtils::logWarn(m_tag, QString("Close response - got response code %1 from %2").arg(responseCode).arg(si->m_activeFile));
     responseCode += 0;										// to keep compiler happy
@@ -508,14 +641,12 @@ void SNCCFSClient::videoDecode(CFSSessionInfo *si, SNC_RECORD_HEADER *header, in
 
 
     }
-    free(header);
 }
 
 void SNCCFSClient::sensorDecode(CFSSessionInfo *si, SNC_RECORD_HEADER *header, int length)
 {
     if (length < (int)sizeof(SNC_RECORD_HEADER)) {
         SNCUtils::logWarn(m_tag, QString("Received sensor record that was too short: ") + QString::number(length));
-        free(header);
         return;
     }
     length -= sizeof(SNC_RECORD_HEADER);
@@ -524,8 +655,6 @@ void SNCCFSClient::sensorDecode(CFSSessionInfo *si, SNC_RECORD_HEADER *header, i
     QJsonObject json = doc.object();
     qint64 ts = SNCUtils::convertUC8ToInt64(header->timestamp);
     emit newSensorData(si->m_sessionId, json, ts);
-
-    free(header);
 }
 
 void SNCCFSClient::setCFSStateIdle(CFSSessionInfo *si)
@@ -642,7 +771,12 @@ CFSSessionInfo::CFSSessionInfo(int sessionId)
     m_sessionId = sessionId;
     m_source = "";
     m_readOutstanding = false;
-    m_blockSize = sizeof(SNC_CFSINDEX) * 3000;
+    m_readsOutstanding = 0;
+    m_readStart = 0;
+    m_nextReadIndex = 0;
+    m_indexIndex = 0;
+    m_indexRetries = 0;
+    m_waitingForRecord = false;
     m_state = SNCCFSCLIENT_STATE_IDLE;
     m_isSensor = false;
 }
@@ -29,16 +29,17 @@
 #include <qjsonobject.h>
 
 #define	SNCCFSCLIENT_DIR_INTERVAL		(SNC_CLOCKS_PER_SEC * 4)	// directory refresh interval
+#define SNCCFSCLIENT_READ_RECORDS       16                          // records requested by each read ahead
+#define SNCCFSCLIENT_READ_AHEAD         (SNCCFSCLIENT_READ_RECORDS * SNCCFS_MAX_READS_OUTSTANDING)  // records read ahead of playback
+#define SNCCFSCLIENT_INDEX_RETRIES      3                           // retries of a failed index range before giving up
 
 //	CFS interface states
 
 enum
 {
     SNCCFSCLIENT_STATE_IDLE = 0,                        // no open file
-    SNCCFSCLIENT_STATE_IXOPENING,                       // opening index file
-    SNCCFSCLIENT_STATE_IXOPEN,                          // index file is open
-    SNCCFSCLIENT_STATE_IXCLOSING,                       // infex file in process of being closed
     SNCCFSCLIENT_STATE_SFOPENING,                       // opening structured file
+    SNCCFSCLIENT_STATE_SFINDEXING,                      // reading the index of the structured file
     SNCCFSCLIENT_STATE_SFOPEN,                          // structured file is open
     SNCCFSCLIENT_STATE_SFCLOSING                        // structured file in process of being closed
 };
@@ -64,14 +65,13 @@ public:
     QString m_activeFile;									// the name of the active file
     int m_handle;											// the file handle
     int m_state;											// the CFS interface state
-    unsigned int m_blockSize;                               // block size for raw file transfer
 
     QString m_source;                                       // name of source
     QString m_dataFile;                                     // the data file part (.srf)
     QString m_indexFile;                                    // the index file path (.srx)
-    unsigned int m_indexFileLength;                         // length of the index file
     unsigned int m_dataFileLength;                          // length of the data file
-    unsigned int m_indexIndex;                              // where we are in the index file
+    unsigned int m_indexIndex;                              // where we are in the index
+    int m_indexRetries;                                     // retries of the current index range
     QList<qint64> m_index;                                  // index file timestamps indexed by record index
     QHash<qint64, int> m_indexDir;                          // index directory (timestamp -> record index) each second
     int m_recordIndex;                                      // where we are in the file
@@ -83,6 +83,11 @@ public:
     QByteArray m_frameCompressed;							// the compressed version
 
     bool m_readOutstanding;									// if there's a CFS read outstanding
+    int m_readsOutstanding;                                 // number of read aheads outstanding
+    unsigned int m_readStart;                               // first record of the current read ahead
+    unsigned int m_nextReadIndex;                           // next record to be read ahead
+    bool m_waitingForRecord;                                // if m_recordIndex is still to be delivered
+    QHash<int, QByteArray> m_cache;                         // records read ahead indexed by record index
 
 };
 
@@ -122,6 +127,10 @@ protected:
     void CFSKeepAliveTimeout(int remoteServiceEP, int handle) override;
     void CFSReadAtIndexResponse(int remoteServiceEP, int handle, unsigned int recordIndex,
         unsigned int responseCode, unsigned char *fileData, int length) override;
+    void CFSReadIndexRangeResponse(int remoteServiceEP, int handle, unsigned int nextIndex,
+        unsigned int responseCode, unsigned char *indexData, int length) override;
+    void CFSReadMultiResponse(int remoteServiceEP, int handle, unsigned int index,
+        unsigned int responseCode, QList<QByteArray> records) override;
 
 private:
     qint64	m_lastDirReq;									// when the last directory request was obtained
@@ -129,6 +138,8 @@ private:
     QHash<int, CFSSessionInfo *> m_sessions;
 
     void setCFSStateIdle(CFSSessionInfo *si);
+    void readIndexRange(CFSSessionInfo *si);                // requests the index range at m_indexIndex
+    void indexFailed(CFSSessionInfo *si, const QString& reason); // closes the file and leaves the session idle
     void emitUpdatedDirectory();
     void createIndexDir(CFSSessionInfo *si);
     int getRecordIndex(CFSSessionInfo *si, qint64 ts);
@@ -137,6 +148,9 @@ private:
     void openNewSource(CFSSessionInfo *si);
     void videoDecode(CFSSessionInfo *si, SNC_RECORD_HEADER *pSRH, int length);
     void sensorDecode(CFSSessionInfo *si, SNC_RECORD_HEADER *pSRH, int length);
+    void resetReadAhead(CFSSessionInfo *si, unsigned int index);
+    void readAhead(CFSSessionInfo *si);
+    void deliverRecord(CFSSessionInfo *si);
 
     CFSSessionInfo *lookUpHandle(int handle);
 };
@@ -57,6 +57,14 @@ typedef struct
     SNC_UC8 cfsTimestamp;                                   // timestamp of record
 } SNC_CFSINDEX;
 
+//  Index range entries returned by SNCCFS_TYPE_READ_INDEX_RANGE_RES
+
+typedef struct
+{
+    SNC_UC4 cfsRecordIndex;                                 // index of the record in the record file
+    SNC_UC8 cfsTimestamp;                                   // timestamp of record
+} SNC_CFSRANGEENTRY;
+
 //  SNCCFS message type codes
 //
 //  Note: cfsLength is alsways used and must be set to zero if the message is just the SNC_CFSHEADER
@@ -164,11 +172,15 @@ typedef struct
 
 #define SNCCFS_TYPE_WRITE_INDEX_RES     19                  // response to a write at index n - contains success or error code
 
-//  SNCCFS_TYPE_READ_INDEX_INTERVAL_REQ is sent to the SNCCFS to request the recordat the index specified
-//  cfsParam contains the time interval requested.
+//  SNCCFS_TYPE_READ_TIME_INTERVAL_REQ is sent to the SNCCFS to request the first record at or after a time
+//  cfsParam contains the time interval requested in ms (0 means no limit).
 //  cfsClientHandle contains the handle assigned to this file.
 //  cfsStoreHandle contains the handle assigned to this file.
-//  cfsTime is the timestamp requested. The record(s) with the nearest greater time will be returned.
+//  cfsIndex is the time offset in ms from the first record in the file if cfsLength is 0.
+//  cfsLength is 0 or sizeof(SNC_UC8). In the second case the SNC_UC8 that follows the header
+//  is the absolute timestamp requested and cfsIndex is ignored.
+//  The record with the nearest time at or after the requested time will be returned as long as it
+//  lies within the interval.
 
 #define	SNCCFS_TYPE_READ_TIME_INTERVAL_REQ   20             // requests a read of record or block starting at time n
 
@@ -176,16 +188,19 @@ typedef struct
 //  cfsParam contains the file handle if successful, an error code otherwise.
 //  cfsClientHandle contains the handle assigned to this file.
 //  cfsStoreHandle contains the handle assigned to this file.
-//  cfsTime contains the record time requested.
+//  cfsIndex contains the index of the record that was found.
 //  cfsLength indicates the total length of the record following the header
+//  If an absolute time falls in another file of the same stream, cfsParam is
+//  SNCCFS_ERROR_TIME_IN_OTHER_FILE and the name of that file, which is in the same directory
+//  as this one, follows the header instead. cfsLength is the length of the name.
 
-#define SNCCFS_TYPE_READ_TIME_INTERVAL_RES 21               // response to a read at index n - contains record or error code
+#define SNCCFS_TYPE_READ_TIME_INTERVAL_RES 21               // response to a read at time n - contains record or error code
 
-//  SNCCFS_TYPE_READ_INDEX_COUNT_REQ is sent to the SNCCFS to request the recordat the index specified
-//  cfsParam contains the records requested.
+//  SNCCFS_TYPE_READ_TIME_COUNT_REQ is sent to the SNCCFS to request the first record at or after a time
+//  cfsParam contains the records requested. If 0, only the record index is returned.
 //  cfsClientHandle contains the handle assigned to this file.
 //  cfsStoreHandle contains the handle assigned to this file.
-//  cfsTime is the timestamp requested. The record(s) with the nearest greater time will be returned.
+//  cfsIndex and cfsLength are used as for SNCCFS_TYPE_READ_TIME_INTERVAL_REQ.
 
 #define	SNCCFS_TYPE_READ_TIME_COUNT_REQ   22                // requests a read of record or block starting at time n
 
@@ -193,10 +208,11 @@ typedef struct
 //  cfsParam contains the file handle if successful, an error code otherwise.
 //  cfsClientHandle contains the handle assigned to this file.
 //  cfsStoreHandle contains the handle assigned to this file.
-//  cfsTime contains the record time requested.
-//  cfsLength indicates the total length of the record following the header
+//  cfsIndex contains the index of the record that was found.
+//  cfsLength indicates the total length of the record following the header (0 if no records requested)
+//  SNCCFS_ERROR_TIME_IN_OTHER_FILE is returned as for SNCCFS_TYPE_READ_TIME_INTERVAL_RES.
 
-#define SNCCFS_TYPE_READ_TIME_COUNT_RES   23                // response to a read at index n - contains record or error code
+#define SNCCFS_TYPE_READ_TIME_COUNT_RES   23                // response to a read at time n - contains record or error code
 
 //  SNCCFS_TYPE_DATAGRAM is a simple means for sending custom messages
 //  between client and server. The CFS header must be present but only
@@ -204,10 +220,54 @@ typedef struct
 
 #define SNCCFS_TYPE_DATAGRAM            24
 
+//  SNCCFS_TYPE_READ_INDEX_RANGE_REQ is sent to the SNCCFS to read a range of index entries from a structured file
+//  cfsParam contains the decimation interval in seconds. 0 means every entry is returned, otherwise
+//  only the first entry in each interval is returned.
+//  cfsClientHandle contains the handle assigned to this file.
+//  cfsStoreHandle contains the handle assigned to this file.
+//  cfsIndex contains the index of the first entry to be read.
+
+#define SNCCFS_TYPE_READ_INDEX_RANGE_REQ    25              // requests a read of index entries starting at index n
+
+//  SNCCFS_TYPE_READ_INDEX_RANGE_RES is send from the SNCCFS in response to a request.
+//  cfsParam contains SNCCFS_SUCCESS if successful, an error code otherwise.
+//  cfsClientHandle contains the handle assigned to this file.
+//  cfsStoreHandle contains the handle assigned to this file.
+//  cfsIndex contains the index at which the next range request should start. This is
+//  the record count of the file when the end of the index has been reached. With decimation
+//  it is the first record of the next interval so that consecutive requests don't repeat one.
+//  cfsLength indicates the total length of the SNC_CFSRANGEENTRY array following the header.
+//  The response is limited to SNC_MESSAGE_MAX_LENGTH.
+
+#define SNCCFS_TYPE_READ_INDEX_RANGE_RES    26              // response to an index range read - contains entries or error code
+
+//  SNCCFS_TYPE_READ_MULTI_REQ is sent to the SNCCFS to read consecutive records from a structured file
+//  cfsParam contains the maximum number of records to be read.
+//  cfsClientHandle contains the handle assigned to this file.
+//  cfsStoreHandle contains the handle assigned to this file.
+//  cfsIndex contains the index of the first record to be read.
+//  cfsLength is 0 or sizeof(SNC_UC4). In the second case the SNC_UC4 that follows the header
+//  is the maximum number of bytes to be returned. The response is always limited to SNC_MESSAGE_MAX_LENGTH.
+//  Several of these requests may be outstanding for an open file. The SNCCFS handles them in order.
+
+#define SNCCFS_TYPE_READ_MULTI_REQ          27              // requests a read of up to n records starting at index
+
+//  SNCCFS_TYPE_READ_MULTI_RES is send from the SNCCFS in response to a request.
+//  cfsParam contains SNCCFS_SUCCESS if successful, an error code otherwise.
+//  cfsClientHandle contains the handle assigned to this file.
+//  cfsStoreHandle contains the handle assigned to this file.
+//  cfsIndex contains the index of the first record from the request.
+//  cfsLength indicates the total length of the records that follow the header. Each record is
+//  preceded by an SNC_UC4 containing its length. At least one record is returned if successful
+//  but there may be fewer than requested if the byte limit or the end of the file is reached.
+
+#define SNCCFS_TYPE_READ_MULTI_RES          28              // response to a multi-record read - contains records or error code
+
 
 //  SNCCFS Size Defines
 
 #define SNCCFS_MAX_CLIENT_FILES         32                  // max files a client can have open at one time per EP
+#define SNCCFS_MAX_READS_OUTSTANDING    8                   // max multi-record reads outstanding per open file
 
 //  SNCCFS Error Response codes
 
@@ -237,6 +297,8 @@ typedef struct
 #define SNCCFS_ERROR_INVALID_REQUEST_TYPE   (SNCCFS_ERROR_CODE + 20)    // request type not valid for this cfs mode
 #define SNCCFS_ERROR_WRITE_TOO_SHORT        (SNCCFS_ERROR_CODE + 21)    // if not enough bytes for SNC record header
 #define SNCCFS_ERROR_INDEX_SEEK             (SNCCFS_ERROR_CODE + 22)    // if seek in index file failed
+#define SNCCFS_ERROR_TIME_NOT_FOUND         (SNCCFS_ERROR_CODE + 23)    // no record at or after the requested time
+#define SNCCFS_ERROR_TIME_IN_OTHER_FILE     (SNCCFS_ERROR_CODE + 24)    // the requested time is in another file of the stream
 
 //  SNCCFS Timer Values
 
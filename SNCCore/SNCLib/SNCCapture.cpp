@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "SNCCapture.h"
+#include "SNCTrace.h"
+#include "SNCUtils.h"
+
+#define TAG "SNCCapture"
+
+QMutex SNCCapture::m_lock;
+QFile *SNCCapture::m_file = NULL;
+QAtomicInt SNCCapture::m_active = 0;
+bool SNCCapture::m_captureTX = false;
+qint64 SNCCapture::m_startTime = 0;
+qint64 SNCCapture::m_lastFlush = 0;
+qint64 SNCCapture::m_limit = 0;
+
+void SNCCapture::setCaptureFile(const QString& path, int limitMB, bool captureTX)
+{
+    SNC_CAPTURE_HEADER header;
+
+    QMutexLocker locker(&m_lock);
+
+    closeFile();
+
+    if (path.isEmpty())
+        return;
+
+    m_file = new QFile(path);
+    if (!m_file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        SNCUtils::logWarn(TAG, QString("Failed to open capture file %1").arg(path));
+        delete m_file;
+        m_file = NULL;
+        return;
+    }
+
+    memcpy(header.magic, SNC_CAPTURE_MAGIC, SNC_CAPTURE_MAGIC_LEN);
+    SNCUtils::convertInt64ToUC8(SNCUtils::clock(), header.startTime);
+    m_file->write((const char *)&header, sizeof(SNC_CAPTURE_HEADER));
+
+    m_captureTX = captureTX;
+    m_limit = (qint64)limitMB * 1024 * 1024;
+    m_startTime = m_lastFlush = SNCTrace::now();
+    m_active.storeRelease(1);
+    SNCUtils::logInfo(TAG, QString("Capturing link traffic to %1").arg(path));
+}
+
+void SNCCapture::capture(int linkID, int direction, const SNC_MESSAGE *message, int length)
+{
+    SNC_CAPTURE_RECORD record;
+    qint64 now = SNCTrace::now();
+
+    QMutexLocker locker(&m_lock);
+
+    if (m_file == NULL)
+        return;
+
+    SNCUtils::convertInt64ToUC8(now - m_startTime, record.time);
+    SNCUtils::convertIntToUC4(length, record.length);
+    SNCUtils::convertIntToUC2(linkID, record.linkID);
+    record.direction = direction;
+    record.spare = 0;
+
+    m_file->write((const char *)&record, sizeof(SNC_CAPTURE_RECORD));
+    m_file->write((const char *)message, length);
+
+    if ((m_limit > 0) && (m_file->pos() >= m_limit)) {
+        SNCUtils::logInfo(TAG, QString("Capture file %1 reached its limit").arg(m_file->fileName()));
+        closeFile();
+        return;
+    }
+
+    if ((now - m_lastFlush) >= SNC_CAPTURE_FLUSH_INTERVAL) {
+        m_file->flush();
+        m_lastFlush = now;
+    }
+}
+
+void SNCCapture::closeFile()
+{
+    m_active.storeRelease(0);
+
+    if (m_file == NULL)
+        return;
+
+    m_file->close();
+    delete m_file;
+    m_file = NULL;
+}
+
+bool SNCCapture::readHeader(QIODevice *file, SNC_CAPTURE_HEADER *header)
+{
+    if (file->read((char *)header, sizeof(SNC_CAPTURE_HEADER)) != sizeof(SNC_CAPTURE_HEADER))
+        return false;
+
+    return memcmp(header->magic, SNC_CAPTURE_MAGIC, SNC_CAPTURE_MAGIC_LEN) == 0;
+}
+
+bool SNCCapture::readRecord(QIODevice *file, SNC_CAPTURE_RECORD *record, QByteArray& message)
+{
+    int length;
+
+    if (file->read((char *)record, sizeof(SNC_CAPTURE_RECORD)) != sizeof(SNC_CAPTURE_RECORD))
+        return false;
+
+    length = SNCUtils::convertUC4ToInt(record->length);
+    if ((length < (int)sizeof(SNC_MESSAGE)) || (length > SNC_MESSAGE_MAX_LENGTH))
+        return false;
+
+    message = file->read(length);
+    return message.length() == length;
+}
@@ -0,0 +1,101 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _SNCCAPTURE_H_
+#define _SNCCAPTURE_H_
+
+#include "SNCDefs.h"
+
+#include <qstring.h>
+#include <qbytearray.h>
+#include <qmutex.h>
+#include <qatomic.h>
+#include <qfile.h>
+
+//  SNCCapture writes the SNC_MESSAGEs passing through every SNCLink in the process to a
+//  capture file so that the traffic can be replayed later by SNCReplay.
+//
+//  The file starts with an SNC_CAPTURE_HEADER. Each message follows as an SNC_CAPTURE_RECORD
+//  and then the complete framed message (SNC_MESSAGE header included) exactly as it was on
+//  the link.
+
+#define SNC_CAPTURE_MAGIC               "SNCCAP01"          // 8 bytes, no terminator in the file
+#define SNC_CAPTURE_MAGIC_LEN           8
+
+#define SNC_CAPTURE_RX                  0                   // message received on the link
+#define SNC_CAPTURE_TX                  1                   // message queued for sending on the link
+
+#define SNC_CAPTURE_LIMIT_DEFAULT       1024                // default capture file limit in MB
+#define SNC_CAPTURE_FLUSH_INTERVAL      1000000             // us between flushes of the capture file
+
+typedef struct
+{
+    char magic[SNC_CAPTURE_MAGIC_LEN];                      // SNC_CAPTURE_MAGIC
+    SNC_UC8 startTime;                                      // wall clock time of the start of the capture in ms
+} SNC_CAPTURE_HEADER;
+
+typedef struct
+{
+    SNC_UC8 time;                                           // monotonic us since the start of the capture
+    SNC_UC4 length;                                         // length of the framed message that follows
+    SNC_UC2 linkID;                                         // which link in the capturing process
+    unsigned char direction;                                // SNC_CAPTURE_RX or SNC_CAPTURE_TX
+    unsigned char spare;
+} SNC_CAPTURE_RECORD;
+
+class SNCCapture
+{
+public:
+
+//  setCaptureFile starts a new capture, replacing any existing file. An empty path stops
+//  capturing. The capture stops when the file reaches limitMB. TX messages are only
+//  captured if captureTX is true.
+
+    static void setCaptureFile(const QString& path, int limitMB, bool captureTX);
+
+    static inline bool active() { return m_active.loadAcquire() != 0; }
+    static inline bool captureTX() { return m_captureTX; }
+
+//  capture adds a message to the capture file. message is the framed message, length its total length.
+
+    static void capture(int linkID, int direction, const SNC_MESSAGE *message, int length);
+
+//  readHeader and readRecord are for tools reading capture files. readRecord returns false
+//  at the end of the file or if the file is truncated or corrupt.
+
+    static bool readHeader(QIODevice *file, SNC_CAPTURE_HEADER *header);
+    static bool readRecord(QIODevice *file, SNC_CAPTURE_RECORD *record, QByteArray& message);
+
+private:
+    static void closeFile();
+
+    static QMutex m_lock;
+    static QFile *m_file;                                   // the capture file or NULL
+    static QAtomicInt m_active;                             // non-zero while capturing
+    static bool m_captureTX;
+    static qint64 m_startTime;                              // SNCTrace::now() at the start of the capture
+    static qint64 m_lastFlush;
+    static qint64 m_limit;                                  // byte limit of the file
+};
+
+#endif // _SNCCAPTURE_H_
@@ -85,7 +85,7 @@ void SNCComponentData::init(const char *compType, int hbInterval, int priority)
     SNCUtils::convertIntToUC2(hbInterval, hello->interval);
 
     hello->priority = priority;
-    hello->unused1 = 1;
+    hello->flags = SNCHELLO_FLAG_LEGACY | SNCHELLO_FLAG_LOOKUP_BATCH;
 
     // generate empty DE
     DESetup();
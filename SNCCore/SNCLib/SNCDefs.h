@@ -42,6 +42,7 @@
 
 #define	SNC_SERVICEPATH_SEP     '/'                         // the path component separator character
 #define	SNC_STREAM_TYPE_SEP     ':'                         // used to delimit a stream type ina path
+#define	SNC_SERVICEPATH_RATE_SEP '@'                        // starts a subscriber rate spec at the end of a multicast lookup path
 #define	SNCCFS_FILENAME_SEP     ';'                         // used to separate file paths in a directory string
 
 //-------------------------------------------------------------------------------------------
@@ -74,6 +75,7 @@
 //	SNC message size maximums
 
 #define SNC_MESSAGE_MAX                 0x80000
+#define SNC_MESSAGE_MAX_LENGTH          (SNC_MESSAGE_MAX - 1) // longest legal message, including the SNC_MESSAGE header
 
 //-------------------------------------------------------------------------------------------
 //  IP related definitions
@@ -264,6 +266,32 @@ typedef char SNC_SERVPATH[SNC_MAX_SERVPATH];                // the service path
 
 #define SNCMSG_SERVICE_ACTIVATE         6
 
+//  SERVICE_QUERY_REQUEST
+//  An application can ask SNCControl for the paths of the services that match a filter
+//  rather than requesting the complete directory. The message is a SNC_SERVICE_QUERY structure.
+
+#define SNCMSG_SERVICE_QUERY_REQUEST    7
+
+//  SERVICE_QUERY_RESPONSE
+//  This message is sent back to the application with the results of the query. It consists of
+//  the original SNC_SERVICE_QUERY structure with count filled in, followed by count
+//  zero terminated service paths of the form appName/serviceName.
+
+#define SNCMSG_SERVICE_QUERY_RESPONSE   8
+
+//  SERVICE_LOOKUP_BATCH_REQUEST
+//  This message carries a number of service lookups in one message. It is only sent to
+//  an SNCControl that sets SNCHELLO_FLAG_LOOKUP_BATCH in its heartbeat. The message is a
+//  SNC_SERVICE_LOOKUP_BATCH structure followed by count SNC_SERVICE_LOOKUP_ENTRY structures.
+
+#define SNCMSG_SERVICE_LOOKUP_BATCH_REQUEST  9
+
+//  SERVICE_LOOKUP_BATCH_RESPONSE
+//  This message is sent back with the results of a batch request. It has one entry for
+//  each entry in the request, none of which carry a service path.
+
+#define SNCMSG_SERVICE_LOOKUP_BATCH_RESPONSE 10
+
 //  MULTICAST_FRAME
 //  Multicast frames are sent using this message. The data is the parameter
 
@@ -319,6 +347,49 @@ typedef struct
     unsigned char par2;                                     // make a multiple of 32 bits
 } SNC_EHEAD;
 
+//-------------------------------------------------------------------------------------------
+//  SNC_TRACE - multicast latency trace trailer
+//
+//  A sampled multicast message can carry a SNC_TRACE at the very end of the message. Its
+//  presence is flagged by SNC_EHEAD_PAR0_TRACE in the EHEAD's par0 and confirmed by the
+//  magic number. Each hop adds a stamp with a monotonic microsecond time and a host ID -
+//  stamps are only comparable with others from the same host. The receiving SNCEndpoint
+//  removes the trailer before the record is passed to the app.
+
+#define SNC_EHEAD_PAR0_TRACE            0x01                // par0 flag - a SNC_TRACE trailer is present
+
+#define SNC_TRACE_MAGIC                 0x53545243          // "STRC"
+#define SNC_TRACE_MAX_STAMPS            16                  // max stamps in a trace (enough for two SNCControls)
+
+//  Trace stage codes
+
+#define SNC_TRACE_STAGE_CAPTURE         0                   // record timestamp (converted to monotonic)
+#define SNC_TRACE_STAGE_SOURCE_SEND     1                   // sent by the source endpoint
+#define SNC_TRACE_STAGE_LINK_TX         2                   // left a SNCLink send queue
+#define SNC_TRACE_STAGE_LINK_RX         3                   // completely received by a SNCLink
+#define SNC_TRACE_STAGE_CONTROL_RX      4                   // reached SNCControl multicast fan-out
+#define SNC_TRACE_STAGE_FANOUT          5                   // copy sent to a subscriber by SNCControl
+#define SNC_TRACE_STAGE_ENDPOINT_RX     6                   // reached the sink endpoint
+
+#define SNC_TRACE_STAGE_COUNT           7                   // number of stage codes
+
+typedef struct
+{
+    SNC_UC8 time;                                           // monotonic time in microseconds
+    SNC_UC4 host;                                           // ID of the host that made the stamp
+    SNC_UC2 stage;                                          // SNC_TRACE_STAGE code
+    SNC_UC2 spare;                                          // make a multiple of 64 bits
+} SNC_TRACE_STAMP;
+
+typedef struct
+{
+    SNC_TRACE_STAMP stamps[SNC_TRACE_MAX_STAMPS];           // the stamps in hop order
+    SNC_UC4 traceID;                                        // source assigned ID of this trace
+    SNC_UC2 count;                                          // number of stamps in use
+    SNC_UC2 spare;
+    SNC_UC4 magic;                                          // SNC_TRACE_MAGIC
+} SNC_TRACE;
+
 //-------------------------------------------------------------------------------------------
 //  The SNC_SERVICE_LOOKUP structure
 
@@ -345,6 +416,34 @@ typedef struct
     unsigned char response;                                 // the response code
 } SNC_SERVICE_LOOKUP;
 
+//  SNC_SERVICE_LOOKUP_BATCH is the header of a batched lookup message.
+//
+//  Each SNC_SERVICE_LOOKUP_ENTRY has the same meaning as the corresponding fields of
+//  SNC_SERVICE_LOOKUP. A refresh of a successful lookup is sent without the service path
+//  as the SNCControl can check it using componentIndex, remotePort, ID and lookupUID.
+//  Otherwise pathLength bytes of zero terminated service path follow the entry.
+
+#define SNC_SERVICE_LOOKUP_BATCH_MAX    256                 // max entries in a batch message
+
+typedef struct
+{
+    SNC_MESSAGE SNCMessage;                                 // the SNCLink header
+    SNC_UC2 count;                                          // number of entries that follow
+    SNC_UC2 spare;                                          // to put on 32 bit boundary
+} SNC_SERVICE_LOOKUP_BATCH;
+
+typedef struct
+{
+    SNC_UID lookupUID;                                      // the returned UID of the service
+    SNC_UC4 ID;                                             // the returned ID for this entry
+    SNC_UC2 remotePort;                                     // the returned port to use for the service
+    SNC_UC2 componentIndex;                                 // the returned component index on SNCControl
+    SNC_UC2 localPort;                                      // the port number of the requestor
+    unsigned char serviceType;                              // the service type requested
+    unsigned char response;                                 // the response code
+    unsigned char pathLength;                               // length of the service path that follows (0 if none)
+} SNC_SERVICE_LOOKUP_ENTRY;
+
 typedef struct
 {
     SNC_MESSAGE SNCMessage;                                 // the message header
@@ -355,6 +454,30 @@ typedef struct
 } SNC_SERVICE_ACTIVATE;
 
 
+//-------------------------------------------------------------------------------------------
+//  The SNC_SERVICE_QUERY structure
+//
+//  Empty strings in the filter fields match anything. streamName is matched against the
+//  stream type part of the service name so that "avmux" matches both "avmux" and "avmux:lr" -
+//  if streamName contains a stream type separator, the match must be exact. appNamePrefix
+//  matches the start of the app name. regionName matches the app name of the SNCControl
+//  through which the service is reached.
+
+#define SERVICE_QUERY_ANYTYPE           0xff                // serviceType value that matches multicast and E2E services
+
+typedef struct
+{
+    SNC_MESSAGE SNCMessage;                                 // the SNCLink header
+    SNC_UC4 queryID;                                        // set by the requestor and returned in the response
+    SNC_UC2 count;                                          // the returned number of service paths that follow
+    unsigned char serviceType;                              // the service type to match or SERVICE_QUERY_ANYTYPE
+    unsigned char spare;                                    // to put on 32 bit boundary
+    SNC_SERVNAME streamName;                                // the stream type to match
+    SNC_APPNAME appNamePrefix;                              // the app name prefix to match
+    SNC_REGIONNAME regionName;                              // the region to match
+} SNC_SERVICE_QUERY;
+
+
 //  SNCMESSAGE nFlags masks
 
 #define SNCLINK_PRI                     0x03                // bits 0 and 1 are priority bits
@@ -386,6 +509,7 @@ typedef struct
 #define SNC_STREAMNAME_IMAGE            "image"
 #define SNC_STREAMNAME_SENSORSTATS      "sensor_stats"
 #define SNC_STREAMNAME_PACKETCAPTURE    "packet_capture"
+#define SNC_STREAMNAME_METRICS          "metrics"
 
 //  Standard E2E stream names
 
@@ -24,6 +24,9 @@
 #include "SNCEndpoint.h"
 #include "SNCUtils.h"
 #include "SNCSocket.h"
+#include "SNCJSONRecordDefs.h"
+
+#include <qjsondocument.h>
 
 //#define ENDPOINT_TRACE
 //#define CFS_TRACE
@@ -99,6 +102,9 @@ int SNCEndpoint::clientAddService(QString servicePath, int serviceType, bool loc
     service->state = SNC_LOCAL_SERVICE_STATE_INACTIVE;
     service->serviceData = -1;
     service->serviceDataPointer = NULL;
+    service->flowWeight = SNCLINK_FLOW_WEIGHT_DEFAULT;
+    service->TXMessages = service->TXBytes = 0;
+    service->RXMessages = service->RXBytes = 0;
     if (!local) {
         strcpy(service->serviceLookup.servicePath, qPrintable(servicePath));
         service->serviceLookup.serviceType = serviceType;
@@ -259,6 +265,8 @@ bool SNCEndpoint::clientRemoveService(int servicePort)
         SNCUtils::logWarn(TAG, QString("Tried to remove a service on not in use port %1").arg(servicePort));
         return false;
     }
+    if (m_metricsInterval > 0)
+        SNCMetrics::removeLabelled(serviceLabels(servicePort));
     if (!service->enabled) {
         service->inUse = false;								// if not enabled, just mark as not in use
         return true;
@@ -439,6 +447,31 @@ bool SNCEndpoint::clientSetServiceData(int servicePort, int value)
     return true;
 }
 
+bool SNCEndpoint::clientSetServiceWeight(int servicePort, int weight)
+{
+    SNC_SERVICE_INFO *service;
+
+    QMutexLocker locker(&m_serviceLock);
+
+    if ((servicePort < 0) || (servicePort >= SNC_MAX_SERVICESPERCOMPONENT)) {
+        SNCUtils::logWarn(TAG, QString("Tried to set weight for service in out of range port %1").arg(servicePort));
+        return false;
+    }
+    service = m_serviceInfo + servicePort;
+    if (!service->inUse) {
+        SNCUtils::logWarn(TAG, QString("Tried to set weight on not in use port %1").arg(servicePort));
+        return false;
+    }
+    if ((weight < 1) || (weight > SNCLINK_FLOW_WEIGHT_MAX)) {
+        SNCUtils::logWarn(TAG, QString("Weight %1 out of range on port %2").arg(weight).arg(servicePort));
+        return false;
+    }
+    service->flowWeight = weight;
+    if (m_connected)
+        m_SNCLink->setFlowWeight(&m_UID, servicePort, weight);
+    return true;
+}
+
 int SNCEndpoint::clientGetServiceData(int servicePort)
 {
     SNC_SERVICE_INFO *service;
@@ -542,6 +575,10 @@ bool SNCEndpoint::clientClearToSend(int servicePort)
         return false;
     }
 
+    // hold off while the link's queue is over its limit at the default send priority
+    if ((m_SNCLink != NULL) && m_SNCLink->isTXBlocked(SNCMSG_MULTICAST_MESSAGE, SNCLINK_LOWPRI))
+        return false;
+
     // within the send/ack window ?
     if (SNCUtils::isSendOK(service->nextSendSeqNo, service->lastReceivedAck)) {
         return true;
@@ -695,6 +732,15 @@ bool SNCEndpoint::clientSendMessage(int servicePort, SNC_EHEAD *message, int len
             return false;
         }
         message->seq = service->nextSendSeqNo++;
+        if ((m_traceSampleInterval > 0) && (++m_traceSampleCount >= m_traceSampleInterval)) {
+            m_traceSampleCount = 0;
+            SNC_EHEAD *traced = SNCTrace::addTrace(message, sizeof(SNC_EHEAD) + length, m_nextTraceID++);
+            if (traced != NULL) {
+                message = traced;
+                traceSource(message, length);
+                length += sizeof(SNC_TRACE);
+            }
+        }
         sendSNCMessage(SNCMSG_MULTICAST_MESSAGE, (SNC_MESSAGE *)message, sizeof(SNC_EHEAD) + length, priority);
     } else {
         if (!service->local && (service->state != SNC_REMOTE_SERVICE_STATE_REGISTERED)) {
@@ -705,6 +751,8 @@ bool SNCEndpoint::clientSendMessage(int servicePort, SNC_EHEAD *message, int len
         sendSNCMessage(SNCMSG_E2E, (SNC_MESSAGE *)message, sizeof(SNC_EHEAD) + length, priority);
     }
     service->lastSendTime = SNCUtils::clock();
+    service->TXMessages++;
+    service->TXBytes += length;
     return true;
 }
 
@@ -779,6 +827,11 @@ void SNCEndpoint::appClientReceiveDirectory(QStringList)
     SNCUtils::logWarn(TAG, QString("Unexpected directory response reported by SNCEndpoint"));
 }
 
+void SNCEndpoint::appClientReceiveServiceQuery(int queryID, QStringList)
+{
+    SNCUtils::logWarn(TAG, QString("Unexpected service query response %1 reported by SNCEndpoint").arg(queryID));
+}
+
 
 //----------------------------------------------------------
 
@@ -794,11 +847,24 @@ SNCEndpoint::SNCEndpoint(qint64 backgroundInterval, const char *compType)
     m_connectInProgress = false;
     m_beaconDelay = false;
     m_backgroundInterval = backgroundInterval;
+    m_controlLookupBatch = false;
+    m_batchLookups = false;
+    m_lookupBatch = NULL;
+    m_lookupBatchPtr = NULL;
+    m_lookupBatchCount = 0;
+    m_lastLookupBatchRefresh = m_background;
 
     QSettings *settings = SNCUtils::getSettings();
 
     m_configHeartbeatInterval = settings->value(SNC_PARAMS_HBINTERVAL, SNC_HEARTBEAT_INTERVAL).toInt();
     m_configHeartbeatTimeout = settings->value(SNC_PARAMS_HBTIMEOUT, SNC_HEARTBEAT_TIMEOUT).toInt();
+    m_metricsInterval = settings->value(SNC_PARAMS_METRICS_INTERVAL, SNCMETRICS_INTERVAL_DEFAULT).toInt() * SNC_CLOCKS_PER_SEC;
+    m_metricsPort = -1;
+    m_metricsRecordIndex = 0;
+    m_traceSampleInterval = settings->value(SNC_PARAMS_TRACE_SAMPLE, 0).toInt();
+    m_traceSampleCount = 0;
+    m_nextTraceID = 0;
+    SNCTrace::setTraceFile(settings->value(SNC_PARAMS_TRACE_FILE).toString());
 
     delete settings;
 }
@@ -863,6 +929,10 @@ void SNCEndpoint::initThread()
     m_connWait = SNCUtils::clock();
     appClientInit();
 
+    m_lastMetricsUpdate = SNCUtils::clock();
+    if (m_metricsInterval > 0)
+        m_metricsPort = clientAddService(SNC_STREAMNAME_METRICS, SERVICETYPE_MULTICAST, true);
+
     m_timer = startTimer(m_backgroundInterval);
 
     delete settings;
@@ -877,6 +947,8 @@ void SNCEndpoint::setHeartbeatTimers(int interval, int timeout)
 void SNCEndpoint::timerEvent(QTimerEvent *)
 {
     endpointBackground();
+    if (m_metricsInterval > 0)
+        metricsBackground();
     appClientBackground();
 }
 
@@ -1002,6 +1074,7 @@ bool SNCEndpoint::endpointSocketMessage(SNCThreadMsg *msg)
             m_connected = true;
             m_connectInProgress = false;
             m_gotHeartbeat = false;
+            m_controlLookupBatch = false;
             m_lastHeartbeatReceived = m_lastHeartbeatSent = m_lastReversionBeacon = SNCUtils::clock();
             SNCUtils::logInfo(TAG, QString("SNCLink connected"));
             forceDE();
@@ -1093,6 +1166,7 @@ void SNCEndpoint::processReceivedDataDemux(int cmd, int len, SNC_MESSAGE*SNCMess
             }
             heartbeat = (SNC_HEARTBEAT *)SNCMessage;
             m_gotHeartbeat = true;
+            m_controlLookupBatch = (heartbeat->hello.flags & SNCHELLO_FLAG_LOOKUP_BATCH) != 0;
             m_lastHeartbeatReceived = now;
             endpointHeartbeat(heartbeat, len);
             break;
@@ -1169,11 +1243,31 @@ void SNCEndpoint::processReceivedDataDemux(int cmd, int len, SNC_MESSAGE*SNCMess
             free(SNCMessage);
             break;
 
+        case SNCMSG_SERVICE_LOOKUP_BATCH_RESPONSE:
+            if (len < (int)sizeof(SNC_SERVICE_LOOKUP_BATCH)) {
+                SNCUtils::logWarn(TAG, QString("Service lookup batch size error %1").arg(len));
+                free(SNCMessage);
+                break;
+            }
+            processLookupBatchResponse((SNC_SERVICE_LOOKUP_BATCH *)SNCMessage, len);
+            free(SNCMessage);
+            break;
+
         case SNCMSG_DIRECTORY_RESPONSE:
             processDirectoryResponse((SNC_DIRECTORY_RESPONSE *)SNCMessage, len);
             free(SNCMessage);
             break;
 
+        case SNCMSG_SERVICE_QUERY_RESPONSE:
+            if (len < (int)sizeof(SNC_SERVICE_QUERY)) {
+                SNCUtils::logWarn(TAG, QString("Service query response size error %1").arg(len));
+                free(SNCMessage);
+                break;
+            }
+            processServiceQueryResponse((SNC_SERVICE_QUERY *)SNCMessage, len);
+            free(SNCMessage);
+            break;
+
         case SNCMSG_E2E:
             if (len < (int)sizeof(SNC_EHEAD)) {
                 SNCUtils::logWarn(TAG, QString("E2E size error %1").arg(len));
@@ -1246,14 +1340,38 @@ void SNCEndpoint::requestDirectory()
     sendSNCMessage(SNCMSG_DIRECTORY_REQUEST, message, sizeof(SNC_MESSAGE), SNCLINK_LOWPRI);
 }
 
+void SNCEndpoint::requestServiceQuery(int queryID, int serviceType, const QString& streamName,
+                                      const QString& appNamePrefix, const QString& regionName)
+{
+    SNC_SERVICE_QUERY *serviceQuery;
+
+    serviceQuery = (SNC_SERVICE_QUERY *)calloc(1, sizeof(SNC_SERVICE_QUERY));
+    SNCUtils::convertIntToUC4(queryID, serviceQuery->queryID);
+    serviceQuery->serviceType = serviceType;
+    strncpy(serviceQuery->streamName, qPrintable(streamName), SNC_MAX_SERVNAME - 1);
+    strncpy(serviceQuery->appNamePrefix, qPrintable(appNamePrefix), SNC_MAX_APPNAME - 1);
+    strncpy(serviceQuery->regionName, qPrintable(regionName), SNC_MAX_REGIONNAME - 1);
+    sendSNCMessage(SNCMSG_SERVICE_QUERY_REQUEST, (SNC_MESSAGE *)serviceQuery, sizeof(SNC_SERVICE_QUERY), SNCLINK_LOWPRI);
+}
+
 void SNCEndpoint::serviceBackground()
 {
     SNC_SERVICE_INFO *service;
     int servicePort;
     qint64 now;
+    bool refreshAll;
 
     QMutexLocker locker(&m_serviceLock);
     now = SNCUtils::clock();
+
+    //  If the SNCControl takes batches, all registered services are refreshed together so
+    //  that the refreshes go in one message.
+
+    m_batchLookups = m_controlLookupBatch;
+    refreshAll = m_batchLookups && SNCUtils::timerExpired(now, m_lastLookupBatchRefresh, SERVICE_REFRESH_INTERVAL);
+    if (refreshAll)
+        m_lastLookupBatchRefresh = now;
+
     service = m_serviceInfo;
     for (servicePort = 0; servicePort < SNC_MAX_SERVICESPERCOMPONENT; servicePort++, service++) {
         if (!service->inUse)
@@ -1288,7 +1406,7 @@ void SNCEndpoint::serviceBackground()
                         service->state = SNC_REMOTE_SERVICE_STATE_LOOK;	// go back to looking
                         break;
                     }
-                    if (SNCUtils::timerExpired(now, service->tLastLookup, SERVICE_REFRESH_INTERVAL))
+                    if (m_batchLookups ? refreshAll : SNCUtils::timerExpired(now, service->tLastLookup, SERVICE_REFRESH_INTERVAL))
                         sendRemoteServiceLookup(service);	// do a refresh
                     break;
 
@@ -1323,6 +1441,8 @@ void SNCEndpoint::serviceBackground()
             }
         }
     }
+    sendLookupBatch();
+    m_batchLookups = false;
 }
 
 
@@ -1343,12 +1463,15 @@ void SNCEndpoint::serviceInit()
         service->serviceLookup.servicePath[0] = 0;			 // no service path
         service->serviceData = -1;
         service->serviceDataPointer = NULL;
+        service->flowWeight = SNCLINK_FLOW_WEIGHT_DEFAULT;
         SNCUtils::convertIntToUC2(i, service->serviceLookup.localPort); // this is my local port index
 
         service->lastReceivedSeqNo = -1;
         service->nextSendSeqNo = 0;
         service->lastReceivedAck = 0;
         service->lastSendTime = 0;
+        service->TXMessages = service->TXBytes = 0;
+        service->RXMessages = service->RXBytes = 0;
     }
 }
 
@@ -1394,6 +1517,20 @@ void SNCEndpoint::sendRemoteServiceLookup(SNC_SERVICE_INFO *remoteService)
         return;
     }
 
+    if (m_batchLookups) {
+        if (m_lookupBatch == NULL) {
+            m_lookupBatch = (SNC_SERVICE_LOOKUP_BATCH *)malloc(sizeof(SNC_SERVICE_LOOKUP_BATCH) +
+                    SNC_MAX_SERVICESPERCOMPONENT * (sizeof(SNC_SERVICE_LOOKUP_ENTRY) + SNC_MAX_SERVPATH));
+            m_lookupBatchPtr = (unsigned char *)(m_lookupBatch + 1);
+            m_lookupBatchCount = 0;
+        }
+        m_lookupBatchPtr += SNCUtils::putLookupBatchEntry(m_lookupBatchPtr, &(remoteService->serviceLookup),
+                remoteService->serviceLookup.response != SERVICE_LOOKUP_SUCCEED);
+        m_lookupBatchCount++;
+        remoteService->tLastLookup = SNCUtils::clock();
+        return;
+    }
+
     serviceLookup = (SNC_SERVICE_LOOKUP *)malloc(sizeof(SNC_SERVICE_LOOKUP));
     *serviceLookup = remoteService->serviceLookup;
 #ifdef ENDPOINT_TRACE
@@ -1404,6 +1541,59 @@ void SNCEndpoint::sendRemoteServiceLookup(SNC_SERVICE_INFO *remoteService)
 }
 
 
+//	sendLookupBatch sends the lookups collected during serviceBackground as one message.
+//	A refresh of a successful lookup is sent without its service path.
+
+void SNCEndpoint::sendLookupBatch()
+{
+    if (m_lookupBatch == NULL)
+        return;
+
+    SNCUtils::convertIntToUC2(m_lookupBatchCount, m_lookupBatch->count);
+    sendSNCMessage(SNCMSG_SERVICE_LOOKUP_BATCH_REQUEST, (SNC_MESSAGE *)m_lookupBatch,
+                (int)(m_lookupBatchPtr - (unsigned char *)m_lookupBatch), SNCLINK_MEDHIGHPRI);
+    m_lookupBatch = NULL;
+    m_lookupBatchPtr = NULL;
+    m_lookupBatchCount = 0;
+}
+
+//	processLookupBatchResponse overlays each entry on a copy of the local lookup for that
+//	port so that processLookupResponse sees a complete SNC_SERVICE_LOOKUP.
+
+void SNCEndpoint::processLookupBatchResponse(SNC_SERVICE_LOOKUP_BATCH *batch, int len)
+{
+    SNC_SERVICE_LOOKUP serviceLookup;
+    SNC_SERVICE_LOOKUP_ENTRY *entry;
+    unsigned char *ptr;
+    int count;
+    int index;
+    int entryLength;
+
+    count = SNCUtils::convertUC2ToInt(batch->count);
+    ptr = (unsigned char *)(batch + 1);
+    len -= sizeof(SNC_SERVICE_LOOKUP_BATCH);
+
+    for (; count > 0; count--, ptr += entryLength, len -= entryLength) {
+        if (len < (int)sizeof(SNC_SERVICE_LOOKUP_ENTRY)) {
+            SNCUtils::logWarn(TAG, "Service lookup batch response truncated");
+            return;
+        }
+        entry = (SNC_SERVICE_LOOKUP_ENTRY *)ptr;
+        index = SNCUtils::convertUC2ToInt(entry->localPort);
+        if ((index < 0) || (index >= SNC_MAX_SERVICESPERCOMPONENT)) {
+            SNCUtils::logWarn(TAG, QString("Lookup batch response to incorrect local port %1").arg(index));
+            entryLength = sizeof(SNC_SERVICE_LOOKUP_ENTRY) + entry->pathLength;
+            continue;
+        }
+        serviceLookup = m_serviceInfo[index].serviceLookup;
+        if ((entryLength = SNCUtils::getLookupBatchEntry(ptr, len, &serviceLookup)) < 0) {
+            SNCUtils::logWarn(TAG, "Malformed service lookup batch response entry");
+            return;
+        }
+        processLookupResponse(&serviceLookup);
+    }
+}
+
 //	processLookupResponse handles the response to a lookup request,
 //	recording the result as required.
 
@@ -1538,6 +1728,22 @@ void SNCEndpoint::processDirectoryResponse(SNC_DIRECTORY_RESPONSE *directoryResp
     appClientReceiveDirectory(dirList);
 }
 
+void SNCEndpoint::processServiceQueryResponse(SNC_SERVICE_QUERY *serviceQuery, int len)
+{
+    QStringList pathList;
+
+    QByteArray data(reinterpret_cast<char *>(serviceQuery + 1), len - sizeof(SNC_SERVICE_QUERY));
+
+    QList<QByteArray> list = data.split(0);
+
+    for (int i = 0; i < list.count(); i++) {
+        if (list.at(i).length() > 0)
+            pathList << list.at(i);
+    }
+
+    appClientReceiveServiceQuery(SNCUtils::convertUC4ToInt(serviceQuery->queryID), pathList);
+}
+
 void SNCEndpoint::buildDE()
 {
     int servicePort;
@@ -1665,6 +1871,7 @@ bool SNCEndpoint::SNCConnect()
     m_sock->sockSetConnectMsg(SNCENDPOINT_ONCONNECT_MESSAGE);
     m_sock->sockSetCloseMsg(SNCENDPOINT_ONCLOSE_MESSAGE);
     m_sock->sockSetReceiveMsg(SNCENDPOINT_ONRECEIVE_MESSAGE);
+    m_sock->sockSetSendMsg(SNCENDPOINT_ONSEND_MESSAGE);
     m_sock->sockSetReceiveBufSize(size);
 
     if (m_useTunnel) {
@@ -1755,6 +1962,9 @@ void SNCEndpoint::endpointConnected()
         service->nextSendSeqNo = 0;
         service->lastReceivedAck = 0;
         service->lastSendTime = SNCUtils::clock();
+
+        if (service->flowWeight != SNCLINK_FLOW_WEIGHT_DEFAULT)
+            m_SNCLink->setFlowWeight(&m_UID, i, service->flowWeight);
     }
 
     appClientConnected();
@@ -1802,6 +2012,15 @@ void SNCEndpoint::processMulticast(SNC_EHEAD *message, int length, int destPort)
             .arg(SNCUtils::displayUID(&message->destUID)));
 
     service->lastReceivedSeqNo = message->seq;
+    service->RXMessages++;
+    service->RXBytes += length;
+
+    SNC_TRACE *trace = SNCTrace::getTrace(message, sizeof(SNC_EHEAD) + length);
+    if (trace != NULL) {
+        SNCTrace::stamp(trace, SNC_TRACE_STAGE_ENDPOINT_RX);
+        SNCTrace::record(service->servicePath, trace);
+        length = SNCTrace::removeTrace(message, sizeof(SNC_EHEAD) + length) - sizeof(SNC_EHEAD);
+    }
 
     appClientReceiveMulticast(destPort, message, length);
 }
@@ -1843,11 +2062,127 @@ void SNCEndpoint::processE2E(SNC_EHEAD *message, int length, int destPort)
         free(message);
         return;
     }
+    service->RXMessages++;
+    service->RXBytes += length;
 
     appClientReceiveE2E(destPort, message, length);
 }
 
 
+//  traceSource stamps a newly traced message. If the message is a record, its timestamp
+//  gives the capture stamp so that the time spent before sending shows up too.
+
+void SNCEndpoint::traceSource(SNC_EHEAD *message, int length)
+{
+    SNC_TRACE *trace = SNCTrace::getTrace(message, sizeof(SNC_EHEAD) + length + sizeof(SNC_TRACE));
+    qint64 now = SNCTrace::now();
+
+    if (trace == NULL)
+        return;
+
+    if (length >= (int)sizeof(SNC_RECORD_HEADER)) {
+        SNC_RECORD_HEADER *record = (SNC_RECORD_HEADER *)(message + 1);
+        qint64 age = SNCUtils::clock() - SNCUtils::getTimestamp(record->timestamp);
+
+        if ((age >= 0) && (age < SNCENDPOINT_TRACE_MAX_CAPTURE_AGE))
+            SNCTrace::stamp(trace, SNC_TRACE_STAGE_CAPTURE, now - age * 1000);
+    }
+    SNCTrace::stamp(trace, SNC_TRACE_STAGE_SOURCE_SEND, now);
+}
+
+
+//-------------------------------------------------------------------------------------------
+//	Metrics
+
+void SNCEndpoint::metricsBackground()
+{
+    qint64 now = SNCUtils::clock();
+
+    if (!SNCUtils::timerExpired(now, m_lastMetricsUpdate, m_metricsInterval))
+        return;
+    m_lastMetricsUpdate = now;
+
+    updateMetrics();
+    sendMetrics();
+}
+
+void SNCEndpoint::updateMetrics()
+{
+    SNC_SERVICE_INFO *service;
+    qint64 queued, droppedMessages, droppedBytes;
+
+    QMutexLocker locker(&m_serviceLock);
+
+    service = m_serviceInfo;
+    for (int servicePort = 0; servicePort < SNC_MAX_SERVICESPERCOMPONENT; servicePort++, service++) {
+        if (!service->inUse)
+            continue;
+
+        QString labels = serviceLabels(servicePort);
+
+        SNCMetrics::counter("snc_service_tx_messages_total", "Messages sent on a service", labels)->set(service->TXMessages);
+        SNCMetrics::counter("snc_service_tx_bytes_total", "Bytes sent on a service", labels)->set(service->TXBytes);
+        SNCMetrics::counter("snc_service_rx_messages_total", "Messages received on a service", labels)->set(service->RXMessages);
+        SNCMetrics::counter("snc_service_rx_bytes_total", "Bytes received on a service", labels)->set(service->RXBytes);
+    }
+    locker.unlock();
+
+    if (m_SNCLink == NULL)
+        return;
+
+    for (int priority = SNCLINK_HIGHPRI; priority <= SNCLINK_LOWPRI; priority++) {
+        m_SNCLink->getTXStats(priority, queued, droppedMessages, droppedBytes);
+        QString labels = SNCMetrics::label("priority", QString::number(priority));
+        SNCMetrics::gauge("snc_link_tx_queued_bytes", "Bytes waiting in a link priority queue", labels)->set(queued);
+        SNCMetrics::counter("snc_link_tx_dropped_messages_total", "Messages dropped by a link priority queue",
+                labels)->set(droppedMessages);
+        SNCMetrics::counter("snc_link_tx_dropped_bytes_total", "Bytes dropped by a link priority queue",
+                labels)->set(droppedBytes);
+    }
+}
+
+void SNCEndpoint::sendMetrics()
+{
+    if ((m_metricsPort == -1) || !clientIsServiceActive(m_metricsPort) || !clientClearToSend(m_metricsPort))
+        return;
+
+    QJsonObject json;
+
+    json[SNCJSONRECORD_MESSAGE_TYPE] = SNCJSONRECORD_MESSAGE_TYPE_METRICS;
+    json[SNCJSONRECORD_MESSAGE_TIMESTAMP] = (double)SNCUtils::clock() / 1000.0;
+    json[SNCJSONRECORD_MESSAGE_SOURCEMODULE] = QString(m_componentData.getMyHeartbeat().hello.appName);
+    json[SNCJSONRECORD_METRICS_METRICS] = SNCMetrics::toJson();
+
+    QByteArray jsonData = QJsonDocument(json).toJson(QJsonDocument::Compact);
+    int length = sizeof(SNC_RECORD_JSON) + jsonData.size();
+
+    SNC_EHEAD *multiCast = clientBuildMessage(m_metricsPort, length);
+    if (multiCast == NULL)
+        return;
+
+    SNC_RECORD_JSON *record = (SNC_RECORD_JSON *)(multiCast + 1);
+    SNCUtils::convertIntToUC2(SNC_RECORD_TYPE_JSON, record->recordHeader.type);
+    SNCUtils::convertIntToUC2(0, record->recordHeader.subType);
+    SNCUtils::convertIntToUC2(sizeof(SNC_RECORD_JSON), record->recordHeader.headerLength);
+    SNCUtils::convertIntToUC2(0, record->recordHeader.param);
+    SNCUtils::convertIntToUC4(m_metricsRecordIndex++, record->recordHeader.recordIndex);
+    SNCUtils::setTimestamp(record->recordHeader.timestamp);
+    SNCUtils::convertIntToUC4(jsonData.size(), record->jsonSize);
+    SNCUtils::convertIntToUC4(0, record->binSize);
+    memcpy(record + 1, jsonData.constData(), jsonData.size());
+
+    clientSendMessage(m_metricsPort, multiCast, length, SNCLINK_LOWPRI);
+}
+
+//  The port comes first so that a service's metrics can be removed by prefix
+
+QString SNCEndpoint::serviceLabels(int servicePort)
+{
+    return SNCMetrics::label("port", QString::number(servicePort)) + ","
+            + SNCMetrics::label("service", m_serviceInfo[servicePort].servicePath);
+}
+
+
 //-------------------------------------------------------------------------------------------
 //	SNCCFS API functions
 //
@@ -1977,6 +2312,9 @@ int SNCEndpoint::CFSOpen(int serviceEP, QString filePath, int cfsMode, int block
     scf->inUse = true;
     scf->open = false;
     scf->readInProgress = false;
+    scf->readType = SNCCFS_TYPE_READ_INDEX_REQ;
+    scf->multiHead = 0;
+    scf->multiCount = 0;
     scf->writeInProgress = false;
     scf->queryInProgress = false;
     scf->fetchQueryInProgress = false;
@@ -2109,15 +2447,16 @@ bool SNCEndpoint::CFSReadAtIndex(int serviceEP, int handle, unsigned int index,
         SNCCFS_E2E_PRIORITY);
     scf->readReqTime = SNCUtils::clock();
     scf->readInProgress = true;
+    scf->readType = SNCCFS_TYPE_READ_INDEX_REQ;
     return true;
 }
 
 /*!
-    CFSReadAtTime can be called to read a record \a timeOffset from the file associated
-    with \a handle on service port \a serviceEP.
+    CFSReadAtTime can be called to read the first record at or after \a timeOffset ms from the first record
+    in the file associated with \a handle on service port \a serviceEP.
 
-    The function returns true if the read request was issued and a call to CFSReadAtIndexResponse()
-    will be made or false if the read was not issued and there will not be a subsequent call to CFSReadAtIndexResponse().
+    The function returns true if the read request was issued and a call to CFSReadAtTimeResponse()
+    will be made or false if the read was not issued and there will not be a subsequent call to CFSReadAtTimeResponse().
 */
 
 bool SNCEndpoint::CFSReadAtTime(int serviceEP, int handle, unsigned int timeOffset, int intervalOrCount, bool isInterval)
@@ -2149,7 +2488,7 @@ bool SNCEndpoint::CFSReadAtTime(int serviceEP, int handle, unsigned int timeOffs
     }
 
     requestHdr = reinterpret_cast<SNC_CFSHEADER *>(requestE2E+1);	// pointer to the new SNCCFS header
-    SNCUtils::convertIntToUC2(isInterval ? SNCCFS_TYPE_READ_TIME_INTERVAL_REQ : SNCCFS_TYPE_READ_TIME_COUNT_RES, requestHdr->cfsType);
+    SNCUtils::convertIntToUC2(isInterval ? SNCCFS_TYPE_READ_TIME_INTERVAL_REQ : SNCCFS_TYPE_READ_TIME_COUNT_REQ, requestHdr->cfsType);
     SNCUtils::convertIntToUC2(scf->clientHandle, requestHdr->cfsClientHandle);
     SNCUtils::convertIntToUC2(scf->storeHandle, requestHdr->cfsStoreHandle);
     SNCUtils::convertIntToUC4(timeOffset, requestHdr->cfsIndex);
@@ -2160,6 +2499,183 @@ bool SNCEndpoint::CFSReadAtTime(int serviceEP, int handle, unsigned int timeOffs
         SNCCFS_E2E_PRIORITY);
     scf->readReqTime = SNCUtils::clock();
     scf->readInProgress = true;
+    scf->readType = isInterval ? SNCCFS_TYPE_READ_TIME_INTERVAL_REQ : SNCCFS_TYPE_READ_TIME_COUNT_REQ;
+    return true;
+}
+
+/*!
+    CFSReadAtTimestamp can be called to read the first record at or after the absolute time \a timestamp
+    from the file associated with \a handle on service port \a serviceEP. \a intervalOrCount is the
+    maximum distance in ms to the record found if \a isInterval is true or else the number of records
+    to be read. A count of zero just returns the record index of the record found.
+
+    The function returns true if the read request was issued and a call to CFSReadAtTimeResponse()
+    will be made or false if the read was not issued and there will not be a subsequent call to CFSReadAtTimeResponse().
+*/
+
+bool SNCEndpoint::CFSReadAtTimestamp(int serviceEP, int handle, qint64 timestamp, int intervalOrCount, bool isInterval)
+{
+    SNC_CFS_FILE *scf;
+    SNCCFS_CLIENT_EPINFO *EP;
+    SNC_EHEAD *requestE2E;
+    SNC_CFSHEADER *requestHdr;
+
+    EP = cfsEPInfo + serviceEP;
+    if (!EP->inUse) {
+        SNCUtils::logWarn(TAG, QString("CFSReadAtTimestamp attempted on not in use port %1").arg(serviceEP));
+        return false;													// the endpoint isn't a SNCCFS one!
+    }
+
+    if ((handle < 0) || (handle >= SNCCFS_MAX_CLIENT_FILES)) {
+        SNCUtils::logWarn(TAG, QString("CFSReadAtTimestamp attempted on out of range handle %1 on port %2").arg(handle).arg(serviceEP));
+        return false;
+    }
+    scf = EP->cfsFile + handle;
+    if (!scf->inUse || !scf->open) {
+        SNCUtils::logWarn(TAG, QString("CFSReadAtTimestamp attempted on not open handle %1 on port %2").arg(handle).arg(serviceEP));
+        return false;
+    }
+    requestE2E = CFSBuildRequest(serviceEP, sizeof(SNC_UC8));
+    if (requestE2E == NULL) {
+        SNCUtils::logWarn(TAG, QString("CFSReadAtTimestamp attempted on unavailable service handle %1 on port %2").arg(handle).arg(serviceEP));
+        return false;
+    }
+
+    requestHdr = reinterpret_cast<SNC_CFSHEADER *>(requestE2E+1);	// pointer to the new SNCCFS header
+    SNCUtils::convertIntToUC2(isInterval ? SNCCFS_TYPE_READ_TIME_INTERVAL_REQ : SNCCFS_TYPE_READ_TIME_COUNT_REQ, requestHdr->cfsType);
+    SNCUtils::convertIntToUC2(scf->clientHandle, requestHdr->cfsClientHandle);
+    SNCUtils::convertIntToUC2(scf->storeHandle, requestHdr->cfsStoreHandle);
+    SNCUtils::convertIntToUC4(0, requestHdr->cfsIndex);
+    SNCUtils::convertInt64ToUC8(timestamp, reinterpret_cast<unsigned char *>(requestHdr + 1));
+    SNCUtils::convertIntToUC2(intervalOrCount, requestHdr->cfsParam);
+    sendSNCMessage(SNCMSG_E2E,
+        (SNC_MESSAGE *)requestE2E,
+        sizeof(SNC_EHEAD) + sizeof(SNC_CFSHEADER) + sizeof(SNC_UC8),
+        SNCCFS_E2E_PRIORITY);
+    scf->readReqTime = SNCUtils::clock();
+    scf->readInProgress = true;
+    scf->readType = isInterval ? SNCCFS_TYPE_READ_TIME_INTERVAL_REQ : SNCCFS_TYPE_READ_TIME_COUNT_REQ;
+    return true;
+}
+
+/*!
+    CFSReadIndexRange can be called to read a range of index entries starting at record \a index from the
+    structured file associated with \a handle on service port \a serviceEP. As many entries as will fit
+    in a single message are returned. If \a decimation is non-zero, only the first entry in each
+    \a decimation second interval is returned.
+
+    The function returns true if the read request was issued and a call to CFSReadIndexRangeResponse()
+    will be made or false if the read was not issued and there will not be a subsequent call to CFSReadIndexRangeResponse().
+*/
+
+bool SNCEndpoint::CFSReadIndexRange(int serviceEP, int handle, unsigned int index, int decimation)
+{
+    SNC_CFS_FILE *scf;
+    SNCCFS_CLIENT_EPINFO *EP;
+    SNC_EHEAD *requestE2E;
+    SNC_CFSHEADER *requestHdr;
+
+    EP = cfsEPInfo + serviceEP;
+    if (!EP->inUse) {
+        SNCUtils::logWarn(TAG, QString("CFSReadIndexRange attempted on not in use port %1").arg(serviceEP));
+        return false;													// the endpoint isn't a SNCCFS one!
+    }
+
+    if ((handle < 0) || (handle >= SNCCFS_MAX_CLIENT_FILES)) {
+        SNCUtils::logWarn(TAG, QString("CFSReadIndexRange attempted on out of range handle %1 on port %2").arg(handle).arg(serviceEP));
+        return false;
+    }
+    scf = EP->cfsFile + handle;
+    if (!scf->inUse || !scf->open) {
+        SNCUtils::logWarn(TAG, QString("CFSReadIndexRange attempted on not open handle %1 on port %2").arg(handle).arg(serviceEP));
+        return false;
+    }
+    requestE2E = CFSBuildRequest(serviceEP, 0);
+    if (requestE2E == NULL) {
+        SNCUtils::logWarn(TAG, QString("CFSReadIndexRange attempted on unavailable service handle %1 on port %2").arg(handle).arg(serviceEP));
+        return false;
+    }
+
+    requestHdr = reinterpret_cast<SNC_CFSHEADER *>(requestE2E+1);	// pointer to the new SNCCFS header
+    SNCUtils::convertIntToUC2(SNCCFS_TYPE_READ_INDEX_RANGE_REQ, requestHdr->cfsType);
+    SNCUtils::convertIntToUC2(scf->clientHandle, requestHdr->cfsClientHandle);
+    SNCUtils::convertIntToUC2(scf->storeHandle, requestHdr->cfsStoreHandle);
+    SNCUtils::convertIntToUC4(index, requestHdr->cfsIndex);
+    SNCUtils::convertIntToUC2(decimation, requestHdr->cfsParam);       // decimation interval in seconds
+    sendSNCMessage(SNCMSG_E2E,
+        (SNC_MESSAGE *)requestE2E,
+        sizeof(SNC_EHEAD) + sizeof(SNC_CFSHEADER),
+        SNCCFS_E2E_PRIORITY);
+    scf->readReqTime = SNCUtils::clock();
+    scf->readInProgress = true;
+    scf->readType = SNCCFS_TYPE_READ_INDEX_RANGE_REQ;
+    return true;
+}
+
+/*!
+    CFSReadMulti can be called to read up to \a maxRecords consecutive records starting at record \a index
+    from the structured file associated with \a handle on service port \a serviceEP. If \a maxBytes is non-zero,
+    the response is limited to that many bytes of record data. At least one record is returned if successful.
+
+    Unlike CFSReadAtIndex(), up to SNCCFS_MAX_READS_OUTSTANDING multi-record reads can be outstanding
+    on a file at the same time so that the round trip time to the store can be hidden. Responses are
+    delivered through CFSReadMultiResponse() in the order that the reads were issued.
+
+    The function returns true if the read request was issued and a call to CFSReadMultiResponse()
+    will be made or false if the read was not issued and there will not be a subsequent call to CFSReadMultiResponse().
+*/
+
+bool SNCEndpoint::CFSReadMulti(int serviceEP, int handle, unsigned int index, int maxRecords, int maxBytes)
+{
+    SNC_CFS_FILE *scf;
+    SNCCFS_CLIENT_EPINFO *EP;
+    SNC_EHEAD *requestE2E;
+    SNC_CFSHEADER *requestHdr;
+    int length;
+
+    EP = cfsEPInfo + serviceEP;
+    if (!EP->inUse) {
+        SNCUtils::logWarn(TAG, QString("CFSReadMulti attempted on not in use port %1").arg(serviceEP));
+        return false;													// the endpoint isn't a SNCCFS one!
+    }
+
+    if ((handle < 0) || (handle >= SNCCFS_MAX_CLIENT_FILES)) {
+        SNCUtils::logWarn(TAG, QString("CFSReadMulti attempted on out of range handle %1 on port %2").arg(handle).arg(serviceEP));
+        return false;
+    }
+    scf = EP->cfsFile + handle;
+    if (!scf->inUse || !scf->open) {
+        SNCUtils::logWarn(TAG, QString("CFSReadMulti attempted on not open handle %1 on port %2").arg(handle).arg(serviceEP));
+        return false;
+    }
+    if (scf->multiCount >= SNCCFS_MAX_READS_OUTSTANDING)
+        return false;                                                   // caller must wait for a response
+
+    length = (maxBytes > 0) ? sizeof(SNC_UC4) : 0;
+
+    requestE2E = CFSBuildRequest(serviceEP, length);
+    if (requestE2E == NULL) {
+        SNCUtils::logWarn(TAG, QString("CFSReadMulti attempted on unavailable service handle %1 on port %2").arg(handle).arg(serviceEP));
+        return false;
+    }
+
+    requestHdr = reinterpret_cast<SNC_CFSHEADER *>(requestE2E+1);	// pointer to the new SNCCFS header
+    SNCUtils::convertIntToUC2(SNCCFS_TYPE_READ_MULTI_REQ, requestHdr->cfsType);
+    SNCUtils::convertIntToUC2(scf->clientHandle, requestHdr->cfsClientHandle);
+    SNCUtils::convertIntToUC2(scf->storeHandle, requestHdr->cfsStoreHandle);
+    SNCUtils::convertIntToUC4(index, requestHdr->cfsIndex);
+    SNCUtils::convertIntToUC2(maxRecords, requestHdr->cfsParam);        // max number of records to read
+    if (maxBytes > 0)
+        SNCUtils::convertIntToUC4(maxBytes, reinterpret_cast<unsigned char *>(requestHdr + 1));
+    sendSNCMessage(SNCMSG_E2E,
+        (SNC_MESSAGE *)requestE2E,
+        sizeof(SNC_EHEAD) + sizeof(SNC_CFSHEADER) + length,
+        SNCCFS_E2E_PRIORITY);
+
+    int slot = (scf->multiHead + scf->multiCount) % SNCCFS_MAX_READS_OUTSTANDING;
+    scf->multiIndex[slot] = index;
+    scf->multiReqTime[slot] = SNCUtils::clock();
+    scf->multiCount++;
     return true;
 }
 
@@ -2315,10 +2831,32 @@ void SNCEndpoint::CFSBackground()
                 if (scf->readInProgress) {
                     if (SNCUtils::timerExpired(now, scf->readReqTime, SNCCFS_READREQ_TIMEOUT)) {
                         SNCUtils::logDebug(TAG, QString("Timed out read request on port %1 slot %2").arg(i).arg(j));
-                        CFSReadAtIndexResponse(i, j, 0, SNCCFS_ERROR_REQUEST_TIMEOUT, NULL, 0);	// tell client
                         scf->readInProgress = false;
+                        switch (scf->readType) {            // tell client
+                            case SNCCFS_TYPE_READ_TIME_INTERVAL_REQ:
+                            case SNCCFS_TYPE_READ_TIME_COUNT_REQ:
+                                CFSReadAtTimeResponse(i, j, 0, SNCCFS_ERROR_REQUEST_TIMEOUT, NULL, 0);
+                                break;
+
+                            case SNCCFS_TYPE_READ_INDEX_RANGE_REQ:
+                                CFSReadIndexRangeResponse(i, j, 0, SNCCFS_ERROR_REQUEST_TIMEOUT, NULL, 0);
+                                break;
+
+                            default:
+                                CFSReadAtIndexResponse(i, j, 0, SNCCFS_ERROR_REQUEST_TIMEOUT, NULL, 0);
+                                break;
+                        }
                     }
                 }
+                while (scf->multiCount > 0) {                   // time out multi-record reads in order
+                    if (!SNCUtils::timerExpired(now, scf->multiReqTime[scf->multiHead], SNCCFS_READREQ_TIMEOUT))
+                        break;
+                    SNCUtils::logDebug(TAG, QString("Timed out multi-record read on port %1 slot %2").arg(i).arg(j));
+                    unsigned int index = scf->multiIndex[scf->multiHead];
+                    scf->multiHead = (scf->multiHead + 1) % SNCCFS_MAX_READS_OUTSTANDING;
+                    scf->multiCount--;
+                    CFSReadMultiResponse(i, j, index, SNCCFS_ERROR_REQUEST_TIMEOUT, QList<QByteArray>());
+                }
                 if (scf->writeInProgress) {
                     if (SNCUtils::timerExpired(now, scf->writeReqTime, SNCCFS_WRITEREQ_TIMEOUT)) {
                         SNCUtils::logDebug(TAG, QString("Timed out write request on port %1 slot %2").arg(i).arg(j));
@@ -2394,6 +2932,14 @@ bool SNCEndpoint::CFSProcessMessage(SNC_EHEAD *pE2E, int nLen, int dstPort)
             CFSProcessReadAtTimeResponse(cfsHdr, dstPort);
             break;
 
+        case SNCCFS_TYPE_READ_INDEX_RANGE_RES:
+            CFSProcessReadIndexRangeResponse(cfsHdr, dstPort);
+            break;
+
+        case SNCCFS_TYPE_READ_MULTI_RES:
+            CFSProcessReadMultiResponse(cfsHdr, dstPort);
+            break;
+
         case SNCCFS_TYPE_WRITE_INDEX_RES:
             CFSProcessWriteAtIndexResponse(cfsHdr, dstPort);
             break;
@@ -2666,11 +3212,14 @@ void SNCEndpoint::CFSProcessReadAtTimeResponse(SNC_CFSHEADER *cfsHdr, int dstPor
 #ifdef CFS_TRACE
     TRACE3("Got ReadAtTime response on handle %d port %d code %d", handle, dstPort, responseCode);
 #endif
-    if (responseCode == SNCCFS_SUCCESS) {
+    if ((responseCode == SNCCFS_SUCCESS) || (responseCode == SNCCFS_ERROR_TIME_IN_OTHER_FILE)) {
         length = SNCUtils::convertUC4ToInt(cfsHdr->cfsLength);
-        fileData = reinterpret_cast<unsigned char *>(malloc(length));
-        memcpy(fileData, cfsHdr + 1, length);				// make a copy of the record to give to the client
-        CFSReadAtIndexResponse(dstPort, handle, SNCUtils::convertUC4ToInt(cfsHdr->cfsIndex), responseCode, fileData, length);
+        fileData = NULL;
+        if (length > 0) {                                   // a count of zero just returns the index
+            fileData = reinterpret_cast<unsigned char *>(malloc(length));
+            memcpy(fileData, cfsHdr + 1, length);			// make a copy of the record (or file name) to give to the client
+        }
+        CFSReadAtTimeResponse(dstPort, handle, SNCUtils::convertUC4ToInt(cfsHdr->cfsIndex), responseCode, fileData, length);
     } else {
         CFSReadAtTimeResponse(dstPort, handle,SNCUtils:: convertUC4ToInt(cfsHdr->cfsIndex), responseCode, NULL, 0);
     }
@@ -2680,9 +3229,11 @@ void SNCEndpoint::CFSProcessReadAtTimeResponse(SNC_CFSHEADER *cfsHdr, int dstPor
     This client app override is called when a read response for the file associated with handle on service
     port \a serviceEP has been received or else has timed out. \a responseCode indicates the result.
     SNCCFS_SUCCESS indicates that the request was successful and fileData contains the file
-    data with length bytes. Any other value means that the read request failed.
+    data with length bytes. SNCCFS_ERROR_TIME_IN_OTHER_FILE means that the absolute time requested
+    is in another file of the same stream and fileData contains that file's name (not terminated).
+    Any other value means that the read request failed.
 
-    If the request was successful, the memory associated with fileData must be freed at some point by the client app.
+    If fileData is not NULL, the memory associated with it must be freed at some point by the client app.
 */
 
 void SNCEndpoint::CFSReadAtTimeResponse(int serviceEP, int handle, unsigned int, unsigned int, unsigned char *fileData, int)
@@ -2696,6 +3247,161 @@ void SNCEndpoint::CFSReadAtTimeResponse(int serviceEP, int handle, unsigned int,
     \internal
 */
 
+void SNCEndpoint::CFSProcessReadIndexRangeResponse(SNC_CFSHEADER *cfsHdr, int dstPort)
+{
+    SNC_CFS_FILE *scf;
+    SNCCFS_CLIENT_EPINFO *EP;
+    int handle;
+    int responseCode;
+    int length;
+    unsigned char *indexData;
+
+    EP = cfsEPInfo + dstPort;
+    handle = SNCUtils::convertUC2ToUInt(cfsHdr->cfsClientHandle);		// get the client handle
+
+    if (handle >= SNCCFS_MAX_CLIENT_FILES) {
+        SNCUtils::logWarn(TAG, QString("ReadIndexRange response with invalid handle %1 on port %2").arg(handle).arg(dstPort));
+        return;
+    }
+    scf = EP->cfsFile + handle;								// get the file slot pointer
+    if (!scf->open) {
+        SNCUtils::logWarn(TAG, QString("ReadIndexRange response with not open handle %1 on port %2").arg(handle).arg(dstPort));
+        return;
+    }
+    if (!scf->readInProgress) {
+        SNCUtils::logWarn(TAG, QString("ReadIndexRange response but no read in progress on handle %1 port %2").arg(handle).arg(dstPort));
+        return;
+    }
+    scf->readInProgress = false;
+    responseCode = SNCUtils::convertUC2ToUInt(cfsHdr->cfsParam);		// get the response code
+#ifdef CFS_TRACE
+    TRACE3("Got ReadIndexRange response on handle %d port %d code %d", handle, dstPort, responseCode);
+#endif
+    length = SNCUtils::convertUC4ToInt(cfsHdr->cfsLength);
+    if ((responseCode == SNCCFS_SUCCESS) && (length > 0)) {
+        indexData = reinterpret_cast<unsigned char *>(malloc(length));
+        memcpy(indexData, cfsHdr + 1, length);				// make a copy of the entries to give to the client
+        CFSReadIndexRangeResponse(dstPort, handle, SNCUtils::convertUC4ToInt(cfsHdr->cfsIndex), responseCode, indexData, length);
+    } else {
+        CFSReadIndexRangeResponse(dstPort, handle, SNCUtils::convertUC4ToInt(cfsHdr->cfsIndex), responseCode, NULL, 0);
+    }
+}
+
+/*!
+    This client app override is called when an index range response for the file associated with handle on service
+    port \a serviceEP has been received or else has timed out. \a responseCode indicates the result.
+    SNCCFS_SUCCESS indicates that the request was successful and indexData contains an array of
+    SNC_CFSRANGEENTRY structures with length bytes in total. \a nextIndex is the index to use for the next request.
+
+    If indexData is not NULL, the memory associated with it must be freed at some point by the client app.
+*/
+
+void SNCEndpoint::CFSReadIndexRangeResponse(int serviceEP, int handle, unsigned int, unsigned int, unsigned char *indexData, int)
+{
+    SNCUtils::logDebug(TAG, QString("Default CFSReadIndexRangeResponse called %1 %2").arg(serviceEP).arg(handle));
+    if (indexData != NULL)
+        free(indexData);
+}
+
+/*!
+    \internal
+*/
+
+void SNCEndpoint::CFSProcessReadMultiResponse(SNC_CFSHEADER *cfsHdr, int dstPort)
+{
+    SNC_CFS_FILE *scf;
+    SNCCFS_CLIENT_EPINFO *EP;
+    int handle;
+    int responseCode;
+    int length;
+    int pos;
+    unsigned int index;
+    unsigned char *data;
+    QList<QByteArray> records;
+
+    EP = cfsEPInfo + dstPort;
+    handle = SNCUtils::convertUC2ToUInt(cfsHdr->cfsClientHandle);		// get the client handle
+
+    if (handle >= SNCCFS_MAX_CLIENT_FILES) {
+        SNCUtils::logWarn(TAG, QString("ReadMulti response with invalid handle %1 on port %2").arg(handle).arg(dstPort));
+        return;
+    }
+    scf = EP->cfsFile + handle;								// get the file slot pointer
+    if (!scf->open) {
+        SNCUtils::logWarn(TAG, QString("ReadMulti response with not open handle %1 on port %2").arg(handle).arg(dstPort));
+        return;
+    }
+
+    index = SNCUtils::convertUC4ToInt(cfsHdr->cfsIndex);
+
+    // the store answers in order so this should match the oldest outstanding read
+
+    for (pos = 0; pos < scf->multiCount; pos++) {
+        if (scf->multiIndex[(scf->multiHead + pos) % SNCCFS_MAX_READS_OUTSTANDING] == index)
+            break;
+    }
+
+    if (pos == scf->multiCount) {
+        SNCUtils::logWarn(TAG, QString("ReadMulti response but no matching read in progress on handle %1 port %2").arg(handle).arg(dstPort));
+        return;
+    }
+
+    // any older reads must have been lost - fail them first to keep the responses in order
+
+    while (pos-- > 0) {
+        unsigned int lostIndex = scf->multiIndex[scf->multiHead];
+        scf->multiHead = (scf->multiHead + 1) % SNCCFS_MAX_READS_OUTSTANDING;
+        scf->multiCount--;
+        CFSReadMultiResponse(dstPort, handle, lostIndex, SNCCFS_ERROR_REQUEST_TIMEOUT, QList<QByteArray>());
+    }
+
+    scf->multiHead = (scf->multiHead + 1) % SNCCFS_MAX_READS_OUTSTANDING;
+    scf->multiCount--;
+
+    responseCode = SNCUtils::convertUC2ToUInt(cfsHdr->cfsParam);		// get the response code
+#ifdef CFS_TRACE
+    TRACE3("Got ReadMulti response on handle %d port %d code %d", handle, dstPort, responseCode);
+#endif
+    if (responseCode == SNCCFS_SUCCESS) {
+        length = SNCUtils::convertUC4ToInt(cfsHdr->cfsLength);
+        data = reinterpret_cast<unsigned char *>(cfsHdr + 1);
+
+        while (length >= (int)sizeof(SNC_UC4)) {
+            int recordLength = SNCUtils::convertUC4ToInt(data);
+
+            data += sizeof(SNC_UC4);
+            length -= sizeof(SNC_UC4);
+
+            if ((recordLength < 0) || (recordLength > length)) {
+                SNCUtils::logWarn(TAG, QString("ReadMulti response with invalid record length %1 on handle %2 port %3")
+                                  .arg(recordLength).arg(handle).arg(dstPort));
+                break;
+            }
+
+            records.append(QByteArray(reinterpret_cast<const char *>(data), recordLength));
+            data += recordLength;
+            length -= recordLength;
+        }
+    }
+    CFSReadMultiResponse(dstPort, handle, index, responseCode, records);
+}
+
+/*!
+    This client app override is called when a multi-record read response for the file associated with handle on service
+    port \a serviceEP has been received or else has timed out. \a responseCode indicates the result.
+    SNCCFS_SUCCESS indicates that the request was successful and \a records contains the records read
+    starting at \a index. Responses are delivered in the order that the reads were issued.
+*/
+
+void SNCEndpoint::CFSReadMultiResponse(int serviceEP, int handle, unsigned int, unsigned int, QList<QByteArray>)
+{
+    SNCUtils::logDebug(TAG, QString("Default CFSReadMultiResponse called %1 %2").arg(serviceEP).arg(handle));
+}
+
+/*!
+    \internal
+*/
+
 void SNCEndpoint::CFSProcessWriteAtIndexResponse(SNC_CFSHEADER *cfsHdr, int dstPort)
 {
     SNC_CFS_FILE *scf;
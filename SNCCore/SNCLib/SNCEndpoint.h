@@ -29,6 +29,8 @@
 #include "SNCLink.h"
 #include "SNCCFSDefs.h"
 #include "SNCComponentData.h"
+#include "SNCMetrics.h"
+#include "SNCTrace.h"
 
 #define	SNCENDPOINT_STATE_MAX                   256                         // max bytes in state message (including trailing zero)
 
@@ -40,6 +42,8 @@
 
 #define SNCENDPOINT_MAX_SNCCONTROLS	3                       // max number of SNCControls in priority list
 
+#define SNCENDPOINT_TRACE_MAX_CAPTURE_AGE       (60 * SNC_CLOCKS_PER_SEC)   // older record timestamps aren't used for traces
+
 
 //-------------------------------------------------------------------------------------------
 //	Service structure defs
@@ -54,6 +58,7 @@ typedef struct
     int serviceType;                                        // service type code
     int serviceData;                                        // the int value that the appClient can set
     void *serviceDataPointer;                               // the pointer that the appClient can set
+    int flowWeight;                                         // SNCLink DRR weight for messages sent by this service
 
     bool removingService;                                   // true if disabling due to service removal
     SNC_SERVPATH	servicePath;                            // the path of the service
@@ -68,6 +73,11 @@ typedef struct
     unsigned char nextSendSeqNo;                            // the number to use on the next sent multicast message
     unsigned char lastReceivedAck;                          // the last ack received
     qint64 lastSendTime;                                    // time the last multicast frame was sent
+
+    qint64 TXMessages;                                      // messages sent on this service
+    qint64 TXBytes;                                         // bytes sent on this service
+    qint64 RXMessages;                                      // messages received on this service
+    qint64 RXBytes;                                         // bytes received on this service
 } SNC_SERVICE_INFO;
 
 //	local service state defs
@@ -103,6 +113,11 @@ typedef struct
     qint64 openReqTime;                                     // when the open request was sent
     bool open;                                              // true if file open
     bool readInProgress;                                    // true if a read has been issued
+    int readType;                                           // the request type of the read in progress
+    int multiHead;                                          // oldest multi-record read outstanding
+    int multiCount;                                         // number of multi-record reads outstanding
+    unsigned int multiIndex[SNCCFS_MAX_READS_OUTSTANDING];  // first record index of each outstanding multi-record read
+    qint64 multiReqTime[SNCCFS_MAX_READS_OUTSTANDING];      // when each multi-record read was sent
     bool writeInProgress;                                   // true if a write has been issued
     bool queryInProgress;
     bool cancelQueryInProgress;
@@ -152,6 +167,12 @@ public:
 
     void requestDirectory();
 
+//	requestServiceQuery asks SNCControl for the paths of services that match a filter. queryID is
+//	returned with the response. serviceType can be SERVICE_QUERY_ANYTYPE and empty strings match anything.
+
+    void requestServiceQuery(int queryID, int serviceType, const QString& streamName,
+                             const QString& appNamePrefix = QString(), const QString& regionName = QString());
+
 //	setHeartbeatTimers allows control over the default heartbeat system parameters
 
     void setHeartbeatTimers(int interval, int timeout);
@@ -205,6 +226,11 @@ protected:
 
     void *clientGetServiceDataPointer(int servicePort);
 
+//	clientSetServiceWeight sets the link scheduling weight for messages sent on a service.
+//	Services at the same priority share the link in proportion to their weights (default 1).
+
+    bool clientSetServiceWeight(int servicePort, int weight);
+
 //	clientEnableService activates a previously stopped service. Returns false if error.
 
     bool clientEnableService(int servicePort);
@@ -323,6 +349,10 @@ protected:
 
     virtual void appClientReceiveDirectory(QStringList directory);
 
+//	appClientReceiveServiceQuery is able to process a service query response
+
+    virtual void appClientReceiveServiceQuery(int queryID, QStringList servicePaths);
+
 //	appClientBackground is called every background interval timer tick and
 //	can be used for any background processing that may be necessary
 
@@ -420,19 +450,53 @@ protected:
     virtual void CFSReadAtIndexResponse(int serviceEP, int handle, unsigned int index,
         unsigned int responseCode, unsigned char *fileData, int length);
 
-//	CFSReadAtTime is called to read the record at the specified time offset
+//	CFSReadAtTime is called to read the first record at or after the specified time offset (ms from the first record)
 //	It will return true if the read was issued or else return false if
 //	the read could not be issued.
 
     bool CFSReadAtTime(int serviceEP, int handle, unsigned int timeOffset, int intervalOrCount, bool isInterval);
 
+//	CFSReadAtTimestamp is the same as CFSReadAtTime except that the time is an absolute timestamp
+
+    bool CFSReadAtTimestamp(int serviceEP, int handle, qint64 timestamp, int intervalOrCount, bool isInterval);
+
 //	CFSReadAtTimeResponse is called when a CFSReadAtTime completes or else returns an error
 //	fileData is a pointer to returned data (if the responseCode is SNCCFS_SUCCESS) and the
-//	client must free this memory when it no longer needs it.
+//	client must free this memory when it no longer needs it. If responseCode is
+//	SNCCFS_ERROR_TIME_IN_OTHER_FILE, fileData is the name of the stream's file that holds the time.
 
     virtual void CFSReadAtTimeResponse(int serviceEP, int handle, unsigned int recordIndex,
         unsigned int responseCode, unsigned char *fileData, int length);
 
+//	CFSReadIndexRange is called to read as many index entries from a structured file as will fit in
+//	one message, starting at the specified index. If decimation is non-zero, only the first entry in each
+//	decimation second interval is returned. It will return true if the read was issued or else return false if
+//	the read could not be issued.
+
+    bool CFSReadIndexRange(int serviceEP, int handle, unsigned int index, int decimation = 0);
+
+//	CFSReadIndexRangeResponse is called when a CFSReadIndexRange completes or else returns an error.
+//	indexData points to an array of SNC_CFSRANGEENTRY structures with length bytes in total and
+//	the client must free this memory when it no longer needs it. nextIndex is the index to use
+//	for the next range request and is equal to the record count once the end of the index has been reached.
+
+    virtual void CFSReadIndexRangeResponse(int serviceEP, int handle, unsigned int nextIndex,
+        unsigned int responseCode, unsigned char *indexData, int length);
+
+//	CFSReadMulti is called to read up to maxRecords consecutive records from a structured file starting
+//	at the specified index. maxBytes limits the size of the response if non-zero. Up to
+//	SNCCFS_MAX_READS_OUTSTANDING of these reads can be outstanding for each open file and
+//	the responses are delivered in the order that the reads were issued.
+//	It will return true if the read was issued or else return false if the read could not be issued.
+
+    bool CFSReadMulti(int serviceEP, int handle, unsigned int index, int maxRecords, int maxBytes = 0);
+
+//	CFSReadMultiResponse is called when a CFSReadMulti completes or else returns an error.
+//	records contains the records read starting at index.
+
+    virtual void CFSReadMultiResponse(int serviceEP, int handle, unsigned int index,
+        unsigned int responseCode, QList<QByteArray> records);
+
 //	CFSWriteAtIndex is called to write the record or block(s) at the appropriate place in the file
 //	It will return true if the write was issued or else return false if
 //	the write could not be issued. The length field is the total length of the data pointed to by
@@ -480,6 +544,12 @@ private:
     SNC_SERVICE_INFO m_serviceInfo[SNC_MAX_SERVICESPERCOMPONENT];	// my service array
     QMutex m_serviceLock;                                   // to control access to the service array
 
+    bool m_batchLookups;                                    // true while serviceBackground is collecting lookups
+    SNC_SERVICE_LOOKUP_BATCH *m_lookupBatch;                // the batch being built or NULL
+    unsigned char *m_lookupBatchPtr;                        // where the next entry goes
+    int m_lookupBatchCount;                                 // entries so far
+    qint64 m_lastLookupBatchRefresh;                        // time registered services were last refreshed in a batch
+
     char m_IPAddr[SNC_IPSTR_LEN];                           // the IP address string for the target SNCControl
     int m_port;                                             // the port to use for the connection
     char m_controlName[SNCENDPOINT_MAX_SNCCONTROLS][SNC_MAX_APPNAME];  // app names for the target SNCControls
@@ -502,6 +572,7 @@ private:
     bool m_connectInProgress;                               // true if in middle of connecting the SNCLink
     bool m_beaconDelay;                                     // if waiting for beacon to take effect
     bool m_gotHeartbeat;                                    // true if at least one heartbeat received
+    bool m_controlLookupBatch;                              // true if the SNCControl understands batched lookups
     SNCSocket *m_sock;
     SNCLink	*m_SNCLink;
     QMutex m_RXLock;                                        // receive data processing lock
@@ -527,9 +598,12 @@ private:
     bool endpointSocketMessage(SNCThreadMsg *msg);
     void serviceBackground();                               // background processing for services
     void sendRemoteServiceLookup(SNC_SERVICE_INFO *remoteService); // send a lookup request message
+    void sendLookupBatch();                                 // sends the lookups collected by serviceBackground
     void processServiceActivate(SNC_SERVICE_ACTIVATE *serviceActivate);// handles a service activate request
     void processLookupResponse(SNC_SERVICE_LOOKUP *serviceLookup);// handles the response to a service lookup
+    void processLookupBatchResponse(SNC_SERVICE_LOOKUP_BATCH *batch, int len);// handles a batch of lookup responses
     void processDirectoryResponse(SNC_DIRECTORY_RESPONSE *directoryResponse, int len);
+    void processServiceQueryResponse(SNC_SERVICE_QUERY *serviceQuery, int len);
 
     void processMulticast(SNC_EHEAD *ehead, int len, int destPort); // process a multicast message
     void processMulticastAck(SNC_EHEAD *ehead, int len, int destPort);// process a multicast ack message
@@ -537,6 +611,25 @@ private:
     void endpointConnected();                               // called when connection is made
     void endpointClosed();                                  // called when the connection has been closed
     void endpointHeartbeat(SNC_HEARTBEAT *pSH, int nLen);   // called when a heartbeat is received
+    void traceSource(SNC_EHEAD *message, int length);       // adds the source stamps to a traced message
+
+//  If metricsInterval is set, service and link counters are copied into the metrics
+//  registry at that interval and the whole registry is published as JSON records on
+//  the local "metrics" multicast service.
+
+    void metricsBackground();
+    void updateMetrics();
+    void sendMetrics();
+    QString serviceLabels(int servicePort);                 // metric labels for a service
+
+    qint64 m_metricsInterval;                               // interval between metrics records (0 = off)
+    qint64 m_lastMetricsUpdate;                             // when metrics were last updated
+    int m_metricsPort;                                      // the metrics service port or -1
+    int m_metricsRecordIndex;                               // record index for metrics records
+
+    int m_traceSampleInterval;                              // trace one in this many sent multicast records (0 = off)
+    int m_traceSampleCount;                                 // records sent since the last trace
+    unsigned int m_nextTraceID;                             // ID for the next trace
 
     qint64 m_backgroundInterval;                            // the background interval to use
 
@@ -564,6 +657,8 @@ private:
     void CFSProcessKeepAliveResponse(SNC_CFSHEADER *cfsHdr, int dstPort);   // process a keep alive response
     void CFSProcessReadAtIndexResponse(SNC_CFSHEADER *cfsHdr, int dstPort); // process a read at index response
     void CFSProcessReadAtTimeResponse(SNC_CFSHEADER *cfsHdr, int dstPort); // process a read at time response
+    void CFSProcessReadIndexRangeResponse(SNC_CFSHEADER *cfsHdr, int dstPort); // process an index range response
+    void CFSProcessReadMultiResponse(SNC_CFSHEADER *cfsHdr, int dstPort); // process a multi-record read response
     void CFSProcessWriteAtIndexResponse(SNC_CFSHEADER *cfsHdr, int dstPort);    // process a write at index response
     void CFSProcessReceiveDatagram(SNC_CFSHEADER *cfsHdr, int dstPort);    // process a receive datagram
 
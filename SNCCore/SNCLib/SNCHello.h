@@ -55,6 +55,11 @@
 #define	SNCHELLO_UP		1									// state in hello state message
 #define	SNCHELLO_DOWN		0									// as above
 
+//	SNCHELLO flags. Bit 0 was always set by earlier versions so the capability bits start at bit 1.
+
+#define	SNCHELLO_FLAG_LEGACY		0x01						// always set
+#define	SNCHELLO_FLAG_LOOKUP_BATCH	0x02						// understands SERVICE_LOOKUP_BATCH messages
+
 class SNCComponentData;
 
 typedef struct
@@ -65,7 +70,7 @@ typedef struct
     SNC_APPNAME appName;									// the app name of the sender
     SNC_COMPTYPE componentType;							// the component type of the sender
     unsigned char priority;									// priority of SNCControl
-    unsigned char unused1;									// was operating mode
+    unsigned char flags;									// was operating mode - now SNCHELLO_FLAG bits
     SNC_UC2 interval;									// heartbeat send interval
 } SNCHELLO;
 
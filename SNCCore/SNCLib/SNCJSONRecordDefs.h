@@ -48,6 +48,7 @@ typedef struct
 #define SNCJSONRECORD_MESSAGE_TYPE_TEXT               "text"          // arbitrary text
 #define SNCJSONRECORD_MESSAGE_TYPE_OPENPOSE           "openpose"      // OpenPose metadata
 #define SNCJSONRECORD_MESSAGE_TYPE_UNITYOPENPOSE      "unityopenpose" // Unity OpenPose metadata
+#define SNCJSONRECORD_MESSAGE_TYPE_METRICS            "metrics"       // metrics snapshot
 
 // variables used in JSON video records
 
@@ -97,5 +98,9 @@ typedef struct
 
 #define SNCJSONRECORD_TEXT_TEXT                       "text"          // an arbitrary string
 
+// variables used in JSON metrics records
+
+#define SNCJSONRECORD_METRICS_METRICS                 "metrics"       // object of series name to value or histogram
+
 
 #endif // _SNCJSONRECORDDEFS_H_
@@ -37,6 +37,9 @@ HEADERS += $$PWD/SNCEndpoint.h \
     $$PWD/SNCAVDefs.h \
     $$PWD/SNCCFSClient.h \
     $$PWD/SNCJSONRecordDefs.h \
+    $$PWD/SNCMetrics.h \
+    $$PWD/SNCTrace.h \
+    $$PWD/SNCCapture.h \
 
 
 SOURCES += $$PWD/SNCEndpoint.cpp \
@@ -48,5 +51,8 @@ SOURCES += $$PWD/SNCEndpoint.cpp \
     $$PWD/SNCComponentData.cpp \
     $$PWD/SNCDirectoryEntry.cpp \
     $$PWD/SNCCFSClient.cpp \
+    $$PWD/SNCMetrics.cpp \
+    $$PWD/SNCTrace.cpp \
+    $$PWD/SNCCapture.cpp \
 
 
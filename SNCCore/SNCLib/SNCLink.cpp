@@ -23,6 +23,8 @@
 
 #include "SNCDefs.h"
 #include "SNCLink.h"
+#include "SNCTrace.h"
+#include "SNCCapture.h"
 
 //#define SNCLINK_TRACE
 
@@ -65,6 +67,7 @@ void SNCLink::send(int cmd, int len, int priority, SNC_MESSAGE *SNCMessage)
     wrapper->m_msg = SNCMessage;
     wrapper->m_ptr = (unsigned char *)SNCMessage;
     wrapper->m_bytesLeft = len;
+    wrapper->m_cmd = cmd;
 
 //	set up SNCMESSAGE header
 
@@ -74,6 +77,9 @@ void SNCLink::send(int cmd, int len, int priority, SNC_MESSAGE *SNCMessage)
     SNCUtils::convertIntToUC4(len, SNCMessage->len);
     computeChecksum(SNCMessage);
 
+    if (SNCCapture::active() && SNCCapture::captureTX())
+        SNCCapture::capture(m_captureID, SNC_CAPTURE_TX, SNCMessage, len);
+
     addToTXQueue(wrapper, priority);
 }
 
@@ -100,7 +106,6 @@ bool SNCLink::receive(int priority, int *cmd, int *len, SNC_MESSAGE **SNCMessage
 int SNCLink::tryReceiving(SNCSocket *sock)
 {
     int bytesRead;
-    int len;
     SNCMessageWrapper *wrapper;
 
     QMutexLocker locker(&m_RXLock);
@@ -112,54 +117,8 @@ int SNCLink::tryReceiving(SNCSocket *sock)
                 return 0;
             m_RXIPBytesLeft -= bytesRead;
             if (m_RXIPBytesLeft == 0) {						// got complete SNC_MESSAGE header
-                if (!checkChecksum(&m_SNCMessage)) {
-                    SNCUtils::logError(TAG, QString("Incorrect header cksm"));
+                if (!processRXHeader())
                     flushReceive(sock);
-                    continue;
-                }
-#ifdef SNCLINK_TRACE
-                TRACE2("Received hdr %d %d", m_SNCMessage.cmd, SNCUtils::convertUC4ToInt(m_SNCMessage.len));
-#endif
-                m_RXIPPriority = m_SNCMessage.flags & SNCLINK_PRI;
-                len = SNCUtils::convertUC4ToInt(m_SNCMessage.len);
-                if (m_RXIP[m_RXIPPriority] == NULL) {		// nothing in progress at this priority
-                    m_RXIP[m_RXIPPriority] = new SNCMessageWrapper();
-                    m_RXIP[m_RXIPPriority]->m_cmd = m_SNCMessage.cmd;
-                    m_RXIP[m_RXIPPriority]->m_msg = (SNC_MESSAGE *)malloc(len);
-                    if (len > (int)sizeof(SNC_MESSAGE)) {
-                        m_RXIP[m_RXIPPriority]->m_ptr = (unsigned char *)m_RXIP[m_RXIPPriority]->m_msg + sizeof(SNC_MESSAGE); // we've already received that
-                    }
-                }
-                wrapper = m_RXIP[m_RXIPPriority];
-                memcpy(wrapper->m_msg, &m_SNCMessage, sizeof(SNC_MESSAGE));
-                wrapper->m_len = len;
-                if (len == sizeof(SNC_MESSAGE)) {		// no message part
-                    addToRXQueue(wrapper, m_RXIPPriority);
-                    m_RXIP[m_RXIPPriority] = NULL;
-                    resetReceive(m_RXIPPriority);
-                    continue;
-                }
-                else
-                {											// is a message part
-                    if ((m_SNCMessage.cmd < SNCMSG_HEARTBEAT) || (m_SNCMessage.cmd > SNCMSG_MAX)) {
-                        SNCUtils::logError(TAG, QString("Illegal cmd %1").arg(m_SNCMessage.cmd));
-                        flushReceive(sock);
-                        free(wrapper->m_msg);
-                        wrapper->m_msg = NULL;
-                        resetReceive(m_RXIPPriority);
-                        continue;
-                    }
-                    if (len >= SNC_MESSAGE_MAX) {
-                        SNCUtils::logError(TAG, QString("Illegal length message cmd %1, len %2").arg(m_SNCMessage.cmd).arg(len));
-                        flushReceive(sock);
-                        free(wrapper->m_msg);
-                        wrapper->m_msg = NULL;
-                        resetReceive(m_RXIPPriority);
-                        continue;
-                    }
-                    wrapper->m_bytesLeft = len - sizeof(SNC_MESSAGE);	// since we've already received that
-                    m_RXSM = false;
-                }
             }
         } else {											// now waiting for data
             wrapper = m_RXIP[m_RXIPPriority];
@@ -168,17 +127,87 @@ int SNCLink::tryReceiving(SNCSocket *sock)
                 return 0;
             wrapper->m_bytesLeft -= bytesRead;
             wrapper->m_ptr += bytesRead;
-            if (wrapper->m_bytesLeft == 0) {				// got complete message
-                addToRXQueue(m_RXIP[m_RXIPPriority], m_RXIPPriority);
-                m_RXIP[m_RXIPPriority] = NULL;
-                m_RXSM = true;
-                m_RXIPMsgPtr = (unsigned char *)&m_SNCMessage;
-                m_RXIPBytesLeft = sizeof(SNC_MESSAGE);
-            }
+            if (wrapper->m_bytesLeft == 0)					// got complete message
+                completeRXMessage();
         }
     }
 }
 
+//  processRXHeader handles a complete SNC_MESSAGE header in m_SNCMessage. A header-only message
+//  is queued straight away, otherwise the wrapper is set up for the data. Returns false if the
+//  header is bad, in which case the caller should flush the socket.
+
+bool SNCLink::processRXHeader()
+{
+    int len;
+    SNCMessageWrapper *wrapper;
+
+    if (!checkChecksum(&m_SNCMessage)) {
+        SNCUtils::logError(TAG, QString("Incorrect header cksm"));
+        return false;
+    }
+#ifdef SNCLINK_TRACE
+    TRACE2("Received hdr %d %d", m_SNCMessage.cmd, SNCUtils::convertUC4ToInt(m_SNCMessage.len));
+#endif
+    m_RXIPPriority = m_SNCMessage.flags & SNCLINK_PRI;
+    len = SNCUtils::convertUC4ToInt(m_SNCMessage.len);
+    if (m_RXIP[m_RXIPPriority] == NULL) {		// nothing in progress at this priority
+        m_RXIP[m_RXIPPriority] = new SNCMessageWrapper();
+        m_RXIP[m_RXIPPriority]->m_cmd = m_SNCMessage.cmd;
+        m_RXIP[m_RXIPPriority]->m_msg = (SNC_MESSAGE *)malloc(len);
+        if (len > (int)sizeof(SNC_MESSAGE)) {
+            m_RXIP[m_RXIPPriority]->m_ptr = (unsigned char *)m_RXIP[m_RXIPPriority]->m_msg + sizeof(SNC_MESSAGE); // we've already received that
+        }
+    }
+    wrapper = m_RXIP[m_RXIPPriority];
+    memcpy(wrapper->m_msg, &m_SNCMessage, sizeof(SNC_MESSAGE));
+    wrapper->m_len = len;
+    if (len == sizeof(SNC_MESSAGE)) {		// no message part
+        if (SNCCapture::active())
+            SNCCapture::capture(m_captureID, SNC_CAPTURE_RX, wrapper->m_msg, len);
+        addToRXQueue(wrapper, m_RXIPPriority);
+        m_RXIP[m_RXIPPriority] = NULL;
+        resetReceive(m_RXIPPriority);
+        return true;
+    }
+
+    // is a message part
+
+    if ((m_SNCMessage.cmd < SNCMSG_HEARTBEAT) || (m_SNCMessage.cmd > SNCMSG_MAX)) {
+        SNCUtils::logError(TAG, QString("Illegal cmd %1").arg(m_SNCMessage.cmd));
+        free(wrapper->m_msg);
+        wrapper->m_msg = NULL;
+        resetReceive(m_RXIPPriority);
+        return false;
+    }
+    if (len > SNC_MESSAGE_MAX_LENGTH) {
+        SNCUtils::logError(TAG, QString("Illegal length message cmd %1, len %2").arg(m_SNCMessage.cmd).arg(len));
+        free(wrapper->m_msg);
+        wrapper->m_msg = NULL;
+        resetReceive(m_RXIPPriority);
+        return false;
+    }
+    wrapper->m_bytesLeft = len - sizeof(SNC_MESSAGE);	// since we've already received that
+    m_RXSM = false;
+    return true;
+}
+
+//  completeRXMessage queues the in progress message once all its data has arrived
+
+void SNCLink::completeRXMessage()
+{
+    SNCMessageWrapper *wrapper = m_RXIP[m_RXIPPriority];
+
+    SNCTrace::stampMessage(wrapper->m_msg, wrapper->m_cmd, wrapper->m_len, SNC_TRACE_STAGE_LINK_RX);
+    if (SNCCapture::active())
+        SNCCapture::capture(m_captureID, SNC_CAPTURE_RX, wrapper->m_msg, wrapper->m_len);
+    addToRXQueue(wrapper, m_RXIPPriority);
+    m_RXIP[m_RXIPPriority] = NULL;
+    m_RXSM = true;
+    m_RXIPMsgPtr = (unsigned char *)&m_SNCMessage;
+    m_RXIPBytesLeft = sizeof(SNC_MESSAGE);
+}
+
 int SNCLink::trySending(SNCSocket *sock)
 {
     int bytesSent;
@@ -204,10 +233,15 @@ int SNCLink::trySending(SNCSocket *sock)
 
                 continue;
             }
+            SNCTrace::stampMessage(m_TXIP[priority]->m_msg, m_TXIP[priority]->m_cmd,
+                        m_TXIP[priority]->m_len, SNC_TRACE_STAGE_LINK_TX);
         }
 
         wrapper = m_TXIP[priority];
 
+        if (sock->sockBytesToWrite() >= SNCLINK_SOCKET_HIGHWATER)
+            return 0;                                       // let the socket drain first
+
         bytesSent = sock->sockSend(wrapper->m_ptr, wrapper->m_bytesLeft);
         if (bytesSent <= 0)
             return 0;										// assume buffer full
@@ -222,19 +256,117 @@ int SNCLink::trySending(SNCSocket *sock)
     }
 }
 
+void SNCLink::setFlowWeight(SNC_UID *sourceUID, int sourcePort, int weight)
+{
+    SNCLinkFlowKey key;
+    quint64 uid;
+    SNCLinkFlow *flow;
+
+    QMutexLocker locker(&m_TXLock);
+
+    if (weight < 1)
+        weight = 1;
+    if (weight > SNCLINK_FLOW_WEIGHT_MAX)
+        weight = SNCLINK_FLOW_WEIGHT_MAX;
+
+    memcpy(&uid, sourceUID, sizeof(quint64));
+    key = SNCLinkFlowKey(uid, sourcePort);
+
+    if (weight == SNCLINK_FLOW_WEIGHT_DEFAULT)
+        m_flowWeights.remove(key);
+    else
+        m_flowWeights.insert(key, weight);
+
+    for (int i = 0; i < SNCLINK_PRIORITIES; i++) {
+        flow = m_TXFlows[i].value(key, NULL);
+        if (flow != NULL)
+            flow->m_quantum = SNCLINK_DRR_QUANTUM * weight;
+    }
+}
+
+
+void SNCLink::setTXLimit(int priority, int limit)
+{
+    QMutexLocker locker(&m_TXLock);
+
+    if ((priority < SNCLINK_HIGHPRI) || (priority > SNCLINK_LOWPRI) || (limit <= 0))
+        return;
+    m_TXLimit[priority] = limit;
+}
+
+void SNCLink::setTXPolicy(int serviceType, int policy)
+{
+    QMutexLocker locker(&m_TXLock);
+
+    if ((policy < SNCLINK_TXPOLICY_BLOCK) || (policy > SNCLINK_TXPOLICY_KEEP_LATEST))
+        return;
+
+    if (serviceType == SERVICETYPE_MULTICAST)
+        m_multicastPolicy = policy;
+    else if (serviceType == SERVICETYPE_E2E)
+        m_E2EPolicy = policy;
+}
+
+bool SNCLink::isTXQueueFull(int priority)
+{
+    QMutexLocker locker(&m_TXLock);
+
+    return m_TXQueuedBytes[priority & SNCLINK_PRI] >= m_TXLimit[priority & SNCLINK_PRI];
+}
+
+bool SNCLink::isTXBlocked(int cmd, int priority)
+{
+    QMutexLocker locker(&m_TXLock);
+
+    if (TXPolicyFor(cmd) != SNCLINK_TXPOLICY_BLOCK)
+        return false;
+    return m_TXQueuedBytes[priority & SNCLINK_PRI] >= m_TXLimit[priority & SNCLINK_PRI];
+}
+
+void SNCLink::getTXStats(int priority, qint64& queuedBytes, qint64& droppedMessages, qint64& droppedBytes)
+{
+    QMutexLocker locker(&m_TXLock);
+
+    priority &= SNCLINK_PRI;
+    queuedBytes = m_TXQueuedBytes[priority];
+    droppedMessages = m_TXDroppedMessages[priority];
+    droppedBytes = m_TXDroppedBytes[priority];
+}
+
+int SNCLink::TXPolicyFromName(const QString& name)
+{
+    if (name == SNCLINK_TXPOLICY_NAME_BLOCK)
+        return SNCLINK_TXPOLICY_BLOCK;
+    if (name == SNCLINK_TXPOLICY_NAME_DROP_OLDEST)
+        return SNCLINK_TXPOLICY_DROP_OLDEST;
+    if (name == SNCLINK_TXPOLICY_NAME_KEEP_LATEST)
+        return SNCLINK_TXPOLICY_KEEP_LATEST;
+    return -1;
+}
+
+
+static QAtomicInt linkCount;                                // numbers the links for capture files
 
 SNCLink::SNCLink(const QString& logTag)
 {
     m_logTag = logTag;
+    m_captureID = linkCount.fetchAndAddRelaxed(1);
     for (int i = 0; i < SNCLINK_PRIORITIES; i++) {
-        m_TXHead[i] = NULL;
-        m_TXTail[i] = NULL;
+        m_TXActiveHead[i] = NULL;
+        m_TXActiveTail[i] = NULL;
+        m_TXQueuedBytes[i] = 0;
+        m_TXLimit[i] = SNCLINK_TX_LIMIT_DEFAULT;
+        m_TXDroppedMessages[i] = 0;
+        m_TXDroppedBytes[i] = 0;
         m_RXHead[i] = NULL;
         m_RXTail[i] = NULL;
         m_RXIP[i] = NULL;
         m_TXIP[i] = NULL;
     }
 
+    m_multicastPolicy = SNCLINK_TXPOLICY_BLOCK;
+    m_E2EPolicy = SNCLINK_TXPOLICY_BLOCK;
+
     m_RXSM = true;
     m_RXIPMsgPtr = (unsigned char *)&m_SNCMessage;
     m_RXIPBytesLeft = sizeof(SNC_MESSAGE);
@@ -249,16 +381,166 @@ SNCLink::~SNCLink(void)
 
 void SNCLink::addToTXQueue(SNCMessageWrapper *wrapper, int priority)
 {
-    if (m_TXHead[priority] == NULL) {
-        m_TXHead[priority] = wrapper;
-        m_TXTail[priority] = wrapper;
-        wrapper->m_next = NULL;
-        return;
+    SNCLinkFlowKey key;
+    SNCLinkFlow *flow;
+
+    key = getFlowKey(wrapper->m_msg, wrapper->m_cmd, wrapper->m_len);
+    flow = m_TXFlows[priority].value(key, NULL);
+
+    if (flow == NULL) {
+        if (m_TXFlows[priority].count() >= SNCLINK_MAX_IDLE_FLOWS)
+            pruneIdleFlows(priority);
+        flow = new SNCLinkFlow();
+        flow->m_key = key;
+        flow->m_quantum = flowQuantum(key);
+        flow->m_deficit = 0;
+        flow->m_head = NULL;
+        flow->m_tail = NULL;
+        flow->m_queuedBytes = 0;
+        flow->m_next = NULL;
+        m_TXFlows[priority].insert(key, flow);
     }
 
-    m_TXTail[priority]->m_next = wrapper;
-    m_TXTail[priority] = wrapper;
     wrapper->m_next = NULL;
+    m_TXQueuedBytes[priority] += wrapper->m_len;
+    flow->m_queuedBytes += wrapper->m_len;
+
+    if (flow->m_head != NULL) {                             // already active
+        flow->m_tail->m_next = wrapper;
+        flow->m_tail = wrapper;
+    } else {
+        flow->m_head = wrapper;
+        flow->m_tail = wrapper;
+
+        //  flow becomes active - add to the end of the round
+
+        flow->m_deficit = 0;
+        flow->m_next = NULL;
+        if (m_TXActiveHead[priority] == NULL)
+            m_TXActiveHead[priority] = flow;
+        else
+            m_TXActiveTail[priority]->m_next = flow;
+        m_TXActiveTail[priority] = flow;
+    }
+
+    if (m_TXQueuedBytes[priority] > m_TXLimit[priority])
+        applyTXPolicy(priority);
+}
+
+int SNCLink::TXPolicyFor(int cmd)
+{
+    if (cmd == SNCMSG_MULTICAST_MESSAGE)
+        return m_multicastPolicy;
+    if (cmd == SNCMSG_E2E)
+        return m_E2EPolicy;
+    return -1;                                              // control messages are never dropped
+}
+
+//  applyTXPolicy trims the priority back under its limit by taking messages from the flow
+//  with the most queued bytes, whichever flow the newest message arrived on. Anything left
+//  over the limit belongs to BLOCK or control flows and is held off by isTXBlocked.
+
+void SNCLink::applyTXPolicy(int priority)
+{
+    SNCLinkFlow *flow;
+
+    while (m_TXQueuedBytes[priority] > m_TXLimit[priority]) {
+        if ((flow = largestDroppableFlow(priority)) == NULL)
+            return;
+
+        if ((TXPolicyFor(flow->m_head->m_cmd) == SNCLINK_TXPOLICY_KEEP_LATEST) && (flow->m_head != flow->m_tail)) {
+            while (flow->m_head != flow->m_tail)
+                dropFlowHead(flow, priority);
+        } else {
+            dropFlowHead(flow, priority);
+        }
+    }
+}
+
+SNCLinkFlow *SNCLink::largestDroppableFlow(int priority)
+{
+    SNCLinkFlow *flow;
+    SNCLinkFlow *largest = NULL;
+    int policy;
+
+    for (flow = m_TXActiveHead[priority]; flow != NULL; flow = flow->m_next) {
+        policy = TXPolicyFor(flow->m_head->m_cmd);
+        if ((policy != SNCLINK_TXPOLICY_DROP_OLDEST) && (policy != SNCLINK_TXPOLICY_KEEP_LATEST))
+            continue;
+        if ((largest == NULL) || (flow->m_queuedBytes > largest->m_queuedBytes))
+            largest = flow;
+    }
+    return largest;
+}
+
+void SNCLink::dropFlowHead(SNCLinkFlow *flow, int priority)
+{
+    SNCMessageWrapper *wrapper;
+
+    wrapper = flow->m_head;
+    flow->m_head = wrapper->m_next;
+    flow->m_queuedBytes -= wrapper->m_len;
+    m_TXQueuedBytes[priority] -= wrapper->m_len;
+    m_TXDroppedMessages[priority]++;
+    m_TXDroppedBytes[priority] += wrapper->m_len;
+    delete wrapper;
+
+    if (flow->m_head == NULL)
+        deactivateFlow(flow, priority);
+}
+
+void SNCLink::deactivateFlow(SNCLinkFlow *flow, int priority)
+{
+    SNCLinkFlow *prev = NULL;
+    SNCLinkFlow *next;
+
+    for (next = m_TXActiveHead[priority]; (next != NULL) && (next != flow); next = next->m_next)
+        prev = next;
+    if (next == NULL)
+        return;                                             // not in the round
+
+    if (prev == NULL)
+        m_TXActiveHead[priority] = flow->m_next;
+    else
+        prev->m_next = flow->m_next;
+    if (m_TXActiveTail[priority] == flow)
+        m_TXActiveTail[priority] = prev;
+
+    flow->m_tail = NULL;
+    flow->m_deficit = 0;
+    flow->m_next = NULL;
+}
+
+SNCLinkFlowKey SNCLink::getFlowKey(SNC_MESSAGE *SNCMessage, int cmd, int len)
+{
+    SNC_EHEAD *ehead;
+    quint64 uid;
+
+    if (((cmd == SNCMSG_MULTICAST_MESSAGE) || (cmd == SNCMSG_E2E)) && (len >= (int)sizeof(SNC_EHEAD))) {
+        ehead = (SNC_EHEAD *)SNCMessage;
+        memcpy(&uid, &ehead->sourceUID, sizeof(quint64));
+        return SNCLinkFlowKey(uid, SNCUtils::convertUC2ToUInt(ehead->sourcePort));
+    }
+    return SNCLinkFlowKey(0, -1);                           // the control flow
+}
+
+int SNCLink::flowQuantum(const SNCLinkFlowKey& key)
+{
+    return SNCLINK_DRR_QUANTUM * m_flowWeights.value(key, SNCLINK_FLOW_WEIGHT_DEFAULT);
+}
+
+void SNCLink::pruneIdleFlows(int priority)
+{
+    QHash<SNCLinkFlowKey, SNCLinkFlow *>::iterator it = m_TXFlows[priority].begin();
+
+    while (it != m_TXFlows[priority].end()) {
+        if (it.value()->m_head == NULL) {
+            delete it.value();
+            it = m_TXFlows[priority].erase(it);
+        } else {
+            ++it;
+        }
+    }
 }
 
 
@@ -277,16 +559,46 @@ void	SNCLink::addToRXQueue(SNCMessageWrapper *wrapper, int priority)
 }
 
 
+//  getTXHead picks the next message to send at a priority using deficit round robin.
+//  The flow at the head of the active list sends while its deficit covers the next
+//  message. Otherwise it is credited with its quantum and moved to the end of the round.
+
 SNCMessageWrapper *SNCLink::getTXHead(int priority)
 {
     SNCMessageWrapper *wrapper;
+    SNCLinkFlow *flow;
+
+    while ((flow = m_TXActiveHead[priority]) != NULL) {
+        wrapper = flow->m_head;
+
+        if (wrapper->m_len > flow->m_deficit) {
+            flow->m_deficit += flow->m_quantum;
+            if (flow->m_next != NULL) {                     // move to end of the round
+                m_TXActiveHead[priority] = flow->m_next;
+                m_TXActiveTail[priority]->m_next = flow;
+                m_TXActiveTail[priority] = flow;
+                flow->m_next = NULL;
+            }
+            continue;
+        }
 
-    if (m_TXHead[priority] == NULL)
-        return NULL;
+        flow->m_deficit -= wrapper->m_len;
+        flow->m_queuedBytes -= wrapper->m_len;
+        m_TXQueuedBytes[priority] -= wrapper->m_len;
+        flow->m_head = wrapper->m_next;
+        wrapper->m_next = NULL;
 
-    wrapper = m_TXHead[priority];
-    m_TXHead[priority] = wrapper->m_next;
-    return wrapper;
+        if (flow->m_head == NULL) {                         // flow now idle - leave the round
+            flow->m_tail = NULL;
+            flow->m_deficit = 0;
+            m_TXActiveHead[priority] = flow->m_next;
+            if (m_TXActiveHead[priority] == NULL)
+                m_TXActiveTail[priority] = NULL;
+            flow->m_next = NULL;
+        }
+        return wrapper;
+    }
+    return NULL;
 }
 
 SNCMessageWrapper *SNCLink::getRXHead(int priority)
@@ -305,9 +617,13 @@ SNCMessageWrapper *SNCLink::getRXHead(int priority)
 void SNCLink::clearTXQueue()
 {
     for (int i = 0; i < SNCLINK_PRIORITIES; i++) {
-        while (m_TXHead[i] != NULL)
+        while (m_TXActiveHead[i] != NULL)
             delete getTXHead(i);
 
+        qDeleteAll(m_TXFlows[i]);
+        m_TXFlows[i].clear();
+        m_TXQueuedBytes[i] = 0;
+
         if (m_TXIP[i] != NULL)
             delete m_TXIP[i];
 
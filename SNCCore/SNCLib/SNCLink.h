@@ -25,6 +25,8 @@
 #define _SNCLINK_H_
 
 #include <qstring.h>
+#include <qhash.h>
+#include <qpair.h>
 
 #include "SNCSocket.h"
 
@@ -48,6 +50,65 @@ public:
 };
 
 
+//  Transmit scheduling
+//
+//  Priorities are strict - a queued message at a higher priority is always sent first.
+//  Within a priority, messages are queued per flow. A flow is keyed by the source service
+//  (sourceUID and sourcePort of the SNC_EHEAD) for multicast and E2E messages. Everything
+//  else at that priority shares a single control flow. Flows with queued messages are served
+//  by deficit round robin, each visit crediting SNCLINK_DRR_QUANTUM * weight bytes, so
+//  that one busy stream cannot monopolise a priority.
+
+#define SNCLINK_DRR_QUANTUM             16384               // bytes credited per round to a weight 1 flow
+#define SNCLINK_FLOW_WEIGHT_DEFAULT     1                   // weight of a flow unless set
+#define SNCLINK_FLOW_WEIGHT_MAX         64                  // largest allowed flow weight
+#define SNCLINK_MAX_IDLE_FLOWS          64                  // idle flows kept per priority before pruning
+
+//  Transmit queue bounds
+//
+//  trySending stops handing data to the socket once SNCLINK_SOCKET_HIGHWATER bytes are waiting
+//  to be written, so that a slow peer backs up into the SNCLink queues rather than the socket.
+//  Each priority's queue has a byte limit and each service type a policy that decides what
+//  happens once the priority is over its limit:
+//
+//  BLOCK - nothing is dropped. isTXBlocked() returns true for the service type until the
+//  queue drains below the limit and senders hold off until then: SNCEndpoint's clear to send
+//  goes false, and SNCControl withholds multicast acks from the source and stops reading from
+//  an E2E source whose destination is blocked.
+//  DROP_OLDEST - the oldest message of the flow with the most queued bytes is dropped, repeatedly,
+//  until back under the limit.
+//  KEEP_LATEST - the flow with the most queued bytes is cut back to its newest message, or that
+//  is dropped too if it is all the flow has left, until back under the limit.
+//
+//  Victims are only taken from flows whose own service type has a dropping policy. Control
+//  messages (not multicast or E2E) are never dropped or blocked.
+
+#define SNCLINK_SOCKET_HIGHWATER        (256 * 1024)        // max bytes waiting in the socket
+#define SNCLINK_TX_LIMIT_DEFAULT        (4 * 1024 * 1024)   // default byte limit of each priority queue
+
+#define SNCLINK_TXPOLICY_BLOCK          0                   // never drop, senders hold off while over limit
+#define SNCLINK_TXPOLICY_DROP_OLDEST    1                   // drop oldest of largest flow while over limit
+#define SNCLINK_TXPOLICY_KEEP_LATEST    2                   // when over limit only keep the most recent message of the largest flow
+
+#define SNCLINK_TXPOLICY_NAME_BLOCK         "block"
+#define SNCLINK_TXPOLICY_NAME_DROP_OLDEST   "dropOldest"
+#define SNCLINK_TXPOLICY_NAME_KEEP_LATEST   "keepLatest"
+
+typedef QPair<quint64, int> SNCLinkFlowKey;                 // source UID and source port
+
+class SNCLinkFlow
+{
+public:
+    SNCLinkFlowKey m_key;                                   // the flow key
+    int m_quantum;                                          // bytes credited each round
+    int m_deficit;                                          // bytes that may be sent this round
+    SNCMessageWrapper *m_head;                              // head of this flow's queue
+    SNCMessageWrapper *m_tail;                              // tail of this flow's queue
+    qint64 m_queuedBytes;                                   // bytes waiting in this flow
+    SNCLinkFlow *m_next;                                    // next flow in the active list
+};
+
+
 //	The SNCLink class itself
 
 class SNCLink
@@ -62,20 +123,69 @@ public:
     int tryReceiving(SNCSocket *sock);
     int trySending(SNCSocket *sock);
 
+//  setFlowWeight sets the DRR weight for messages from a source service. The weight
+//  scales the bytes the flow may send per round relative to other flows at the same priority.
+
+    void setFlowWeight(SNC_UID *sourceUID, int sourcePort, int weight);
+
+//  setTXLimit sets the byte limit of a priority's transmit queue
+
+    void setTXLimit(int priority, int limit);
+
+//  setTXPolicy sets the policy for messages of a service type (SERVICETYPE_MULTICAST or SERVICETYPE_E2E)
+
+    void setTXPolicy(int serviceType, int policy);
+
+//  isTXQueueFull returns true if the queue for priority is at or over its limit
+
+    bool isTXQueueFull(int priority);
+
+//  isTXBlocked returns true if messages of type cmd (SNCMSG_MULTICAST_MESSAGE or SNCMSG_E2E)
+//  use the BLOCK policy and the queue for priority is at or over its limit
+
+    bool isTXBlocked(int cmd, int priority);
+
+//  getTXStats returns the bytes queued and the totals dropped for a priority
+
+    void getTXStats(int priority, qint64& queuedBytes, qint64& droppedMessages, qint64& droppedBytes);
+
+//  TXPolicyFromName converts a policy name from settings to a policy code. Returns -1 if unknown.
+
+    static int TXPolicyFromName(const QString& name);
+
 protected:
     void clearTXQueue();
     void clearRXQueue();
     void resetReceive(int priority);
     void flushReceive(SNCSocket *sock);
+    bool processRXHeader();                                 // handles a complete header, false if bad
+    void completeRXMessage();                               // queues the in progress message
     SNCMessageWrapper *getTXHead(int priority);
     SNCMessageWrapper *getRXHead(int priority);
     void addToTXQueue(SNCMessageWrapper *wrapper, int nPri);
+    SNCLinkFlowKey getFlowKey(SNC_MESSAGE *SNCMessage, int cmd, int len);
+    int flowQuantum(const SNCLinkFlowKey& key);
+    void pruneIdleFlows(int priority);
+    int TXPolicyFor(int cmd);                               // policy for a message type, -1 if never dropped
+    void applyTXPolicy(int priority);
+    SNCLinkFlow *largestDroppableFlow(int priority);        // the active flow with the most bytes that may be dropped
+    void dropFlowHead(SNCLinkFlow *flow, int priority);
+    void deactivateFlow(SNCLinkFlow *flow, int priority);   // takes an emptied flow out of the round
     void addToRXQueue(SNCMessageWrapper *wrapper, int nPri);
     void computeChecksum(SNC_MESSAGE *SNCMessage);
     bool checkChecksum(SNC_MESSAGE *SNCMessage);
 
-    SNCMessageWrapper *m_TXHead[SNCLINK_PRIORITIES];        // head of transmit list
-    SNCMessageWrapper *m_TXTail[SNCLINK_PRIORITIES];        // tail of transmit list
+    QHash<SNCLinkFlowKey, SNCLinkFlow *> m_TXFlows[SNCLINK_PRIORITIES]; // transmit flows at each priority
+    SNCLinkFlow *m_TXActiveHead[SNCLINK_PRIORITIES];        // head of the flows with queued messages
+    SNCLinkFlow *m_TXActiveTail[SNCLINK_PRIORITIES];        // tail of the flows with queued messages
+    QHash<SNCLinkFlowKey, int> m_flowWeights;               // weights set by setFlowWeight
+
+    qint64 m_TXQueuedBytes[SNCLINK_PRIORITIES];             // bytes waiting in each priority's flows
+    qint64 m_TXLimit[SNCLINK_PRIORITIES];                   // byte limit of each priority
+    qint64 m_TXDroppedMessages[SNCLINK_PRIORITIES];         // messages dropped by policy
+    qint64 m_TXDroppedBytes[SNCLINK_PRIORITIES];            // bytes dropped by policy
+    int m_multicastPolicy;                                  // policy for multicast messages
+    int m_E2EPolicy;                                        // policy for E2E messages
     SNCMessageWrapper *m_RXHead[SNCLINK_PRIORITIES];        // head of receive list
     SNCMessageWrapper *m_RXTail[SNCLINK_PRIORITIES];        // tail of receive list
 
@@ -86,6 +196,7 @@ protected:
     int m_RXIPBytesLeft;
     SNC_MESSAGE m_SNCMessage;                               // for receive
     int m_RXIPPriority;                                     // the current priority being received
+    int m_captureID;                                        // identifies this link in capture files
 
     QMutex m_RXLock;
     QMutex m_TXLock;
@@ -0,0 +1,309 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "SNCMetrics.h"
+#include "SNCUtils.h"
+
+#include <qfile.h>
+#include <qtcpsocket.h>
+
+#define TAG "SNCMetrics"
+
+QMutex SNCMetrics::m_lock;
+QMap<QString, SNCMetric *> SNCMetrics::m_metrics;
+
+SNCMetric::SNCMetric(int type, const QString& name, const QString& help, const QString& labels)
+{
+    m_type = type;
+    m_name = name;
+    m_help = help;
+    m_labels = labels;
+    m_boundCount = 0;
+}
+
+void SNCMetric::setBounds(const qint64 *bounds, int boundCount)
+{
+    if (boundCount > SNCMETRIC_MAX_BUCKETS)
+        boundCount = SNCMETRIC_MAX_BUCKETS;
+    for (int i = 0; i < boundCount; i++)
+        m_bounds[i] = bounds[i];
+    m_boundCount = boundCount;
+}
+
+void SNCMetric::observe(qint64 value)
+{
+    int bucket;
+
+    for (bucket = 0; bucket < m_boundCount; bucket++) {
+        if (value <= m_bounds[bucket])
+            break;
+    }
+    m_buckets[bucket].fetchAndAddRelaxed(1);
+    m_value.fetchAndAddRelaxed(value);
+    m_count.fetchAndAddRelaxed(1);
+}
+
+SNCMetric *SNCMetrics::counter(const QString& name, const QString& help, const QString& labels)
+{
+    return getMetric(SNCMETRIC_TYPE_COUNTER, name, help, labels);
+}
+
+SNCMetric *SNCMetrics::gauge(const QString& name, const QString& help, const QString& labels)
+{
+    return getMetric(SNCMETRIC_TYPE_GAUGE, name, help, labels);
+}
+
+SNCMetric *SNCMetrics::histogram(const QString& name, const QString& help, const QString& labels,
+                                 const qint64 *bounds, int boundCount)
+{
+    QMutexLocker locker(&m_lock);
+
+    QString key = name + "{" + labels + "}";
+    SNCMetric *metric = m_metrics.value(key, NULL);
+
+    if (metric == NULL) {
+        metric = new SNCMetric(SNCMETRIC_TYPE_HISTOGRAM, name, help, labels);
+        metric->setBounds(bounds, boundCount);
+        m_metrics.insert(key, metric);
+    }
+    return metric;
+}
+
+SNCMetric *SNCMetrics::getMetric(int type, const QString& name, const QString& help, const QString& labels)
+{
+    QMutexLocker locker(&m_lock);
+
+    QString key = name + "{" + labels + "}";
+    SNCMetric *metric = m_metrics.value(key, NULL);
+
+    if (metric == NULL) {
+        metric = new SNCMetric(type, name, help, labels);
+        m_metrics.insert(key, metric);
+    } else if (metric->m_type != type) {
+        SNCUtils::logWarn(TAG, QString("Metric %1 requested with a different type").arg(key));
+    }
+    return metric;
+}
+
+void SNCMetrics::removeLabelled(const QString& labelPrefix)
+{
+    QMutexLocker locker(&m_lock);
+
+    QMap<QString, SNCMetric *>::iterator it = m_metrics.begin();
+    while (it != m_metrics.end()) {
+        if (it.value()->m_labels.startsWith(labelPrefix)) {
+            delete it.value();
+            it = m_metrics.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+QString SNCMetrics::label(const QString& name, const QString& value)
+{
+    QString escaped = value;
+
+    escaped.replace("\\", "\\\\");
+    escaped.replace("\"", "\\\"");
+    escaped.replace("\n", "\\n");
+    return name + "=\"" + escaped + "\"";
+}
+
+QByteArray SNCMetrics::prometheusText()
+{
+    QByteArray text;
+    QString family;
+    SNCMetric *metric;
+    QString sep;
+
+    QMutexLocker locker(&m_lock);
+
+    foreach (metric, m_metrics) {
+        if (metric->m_name != family) {
+            family = metric->m_name;
+            text += "# HELP " + family.toUtf8() + " " + metric->m_help.toUtf8() + "\n";
+            if (metric->m_type == SNCMETRIC_TYPE_COUNTER)
+                text += "# TYPE " + family.toUtf8() + " counter\n";
+            else if (metric->m_type == SNCMETRIC_TYPE_GAUGE)
+                text += "# TYPE " + family.toUtf8() + " gauge\n";
+            else
+                text += "# TYPE " + family.toUtf8() + " histogram\n";
+        }
+
+        if (metric->m_type != SNCMETRIC_TYPE_HISTOGRAM) {
+            if (metric->m_labels.isEmpty())
+                text += metric->m_name.toUtf8();
+            else
+                text += metric->m_name.toUtf8() + "{" + metric->m_labels.toUtf8() + "}";
+            text += " " + QByteArray::number(metric->value()) + "\n";
+            continue;
+        }
+
+        //  histogram buckets are cumulative in the exposition
+
+        sep = metric->m_labels.isEmpty() ? QString() : QString(",");
+        qint64 cumulative = 0;
+        for (int bucket = 0; bucket <= metric->m_boundCount; bucket++) {
+            cumulative += metric->m_buckets[bucket].load();
+            QString le = (bucket == metric->m_boundCount) ? QString("+Inf") : QString::number(metric->m_bounds[bucket]);
+            text += (metric->m_name + "_bucket{" + metric->m_labels + sep + "le=\"" + le + "\"} ").toUtf8()
+                    + QByteArray::number(cumulative) + "\n";
+        }
+        if (metric->m_labels.isEmpty()) {
+            text += metric->m_name.toUtf8() + "_sum " + QByteArray::number(metric->value()) + "\n";
+            text += metric->m_name.toUtf8() + "_count " + QByteArray::number(metric->m_count.load()) + "\n";
+        } else {
+            text += metric->m_name.toUtf8() + "_sum{" + metric->m_labels.toUtf8() + "} "
+                    + QByteArray::number(metric->value()) + "\n";
+            text += metric->m_name.toUtf8() + "_count{" + metric->m_labels.toUtf8() + "} "
+                    + QByteArray::number(metric->m_count.load()) + "\n";
+        }
+    }
+    return text;
+}
+
+QJsonObject SNCMetrics::toJson()
+{
+    QJsonObject json;
+    QMap<QString, SNCMetric *>::const_iterator it;
+
+    QMutexLocker locker(&m_lock);
+
+    for (it = m_metrics.constBegin(); it != m_metrics.constEnd(); ++it) {
+        SNCMetric *metric = it.value();
+
+        if (metric->m_type != SNCMETRIC_TYPE_HISTOGRAM) {
+            json[it.key()] = (double)metric->value();
+            continue;
+        }
+
+        QJsonObject histogram;
+        QJsonObject buckets;
+        qint64 cumulative = 0;
+
+        for (int bucket = 0; bucket <= metric->m_boundCount; bucket++) {
+            cumulative += metric->m_buckets[bucket].load();
+            QString le = (bucket == metric->m_boundCount) ? QString("+Inf") : QString::number(metric->m_bounds[bucket]);
+            buckets[le] = (double)cumulative;
+        }
+        histogram["buckets"] = buckets;
+        histogram["sum"] = (double)metric->value();
+        histogram["count"] = (double)metric->m_count.load();
+        json[it.key()] = histogram;
+    }
+    return json;
+}
+
+bool SNCMetrics::writeFile(const QString& path)
+{
+    QByteArray text = prometheusText();
+    QString tempPath = path + ".tmp";
+    QFile file(tempPath);
+
+    //  write to a temporary file and rename so that a reader never sees a partial file
+
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        SNCUtils::logWarn(TAG, QString("Failed to open metrics file %1").arg(tempPath));
+        return false;
+    }
+    if (file.write(text) != text.size()) {
+        SNCUtils::logWarn(TAG, QString("Failed to write metrics file %1").arg(tempPath));
+        file.close();
+        QFile::remove(tempPath);
+        return false;
+    }
+    file.close();
+
+    QFile::remove(path);
+    if (!QFile::rename(tempPath, path)) {
+        SNCUtils::logWarn(TAG, QString("Failed to rename metrics file to %1").arg(path));
+        return false;
+    }
+    return true;
+}
+
+
+//----------------------------------------------------------------------------
+//
+//  SNCMetricsServer
+
+SNCMetricsServer::SNCMetricsServer(QObject *parent) : QObject(parent)
+{
+    m_server = NULL;
+}
+
+bool SNCMetricsServer::start(int port, const QString& address)
+{
+    QHostAddress hostAddress;
+
+    if (!hostAddress.setAddress(address)) {
+        SNCUtils::logWarn(TAG, QString("Invalid metrics address %1").arg(address));
+        return false;
+    }
+
+    m_server = new QTcpServer(this);
+    connect(m_server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+
+    if (!m_server->listen(hostAddress, port)) {
+        SNCUtils::logWarn(TAG, QString("Failed to open metrics port %1 on %2").arg(port).arg(address));
+        return false;
+    }
+    SNCUtils::logInfo(TAG, QString("Serving metrics on %1 port %2").arg(address).arg(port));
+    return true;
+}
+
+void SNCMetricsServer::newConnection()
+{
+    QTcpSocket *sock;
+
+    while ((sock = m_server->nextPendingConnection()) != NULL) {
+        connect(sock, SIGNAL(readyRead()), this, SLOT(readyRead()));
+        connect(sock, SIGNAL(disconnected()), sock, SLOT(deleteLater()));
+    }
+}
+
+void SNCMetricsServer::readyRead()
+{
+    QTcpSocket *sock = qobject_cast<QTcpSocket *>(sender());
+
+    if (sock == NULL)
+        return;
+
+    //  the whole request doesn't matter - reply with the metrics once the request line is in
+
+    if (!sock->canReadLine())
+        return;
+    sock->readAll();
+    disconnect(sock, SIGNAL(readyRead()), this, SLOT(readyRead()));
+
+    QByteArray body = SNCMetrics::prometheusText();
+    QByteArray reply = "HTTP/1.0 200 OK\r\n"
+            "Content-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+            "Connection: close\r\n\r\n";
+
+    sock->write(reply);
+    sock->write(body);
+    sock->disconnectFromHost();
+}
@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _SNCMETRICS_H_
+#define _SNCMETRICS_H_
+
+#include <qstring.h>
+#include <qmap.h>
+#include <qmutex.h>
+#include <qatomic.h>
+#include <qjsonobject.h>
+#include <qtcpserver.h>
+
+//  SNCMetrics is a process wide registry of counters, gauges and histograms. Updates are
+//  relaxed atomic operations so they can be made from any thread without a lock. Creating,
+//  removing and exporting metrics takes the registry lock. A metric pointer stays valid
+//  until the metric is removed.
+//
+//  Labels are passed in Prometheus form (name="value",name="value") - use
+//  SNCMetrics::label() to build them. Metrics with the same name should always be given
+//  labels with the same names in the same order.
+
+#define SNCMETRIC_TYPE_COUNTER          0                   // monotonic count
+#define SNCMETRIC_TYPE_GAUGE            1                   // value that can go up and down
+#define SNCMETRIC_TYPE_HISTOGRAM        2                   // distribution of observed values
+
+#define SNCMETRIC_MAX_BUCKETS           16                  // max histogram bucket bounds (+Inf is extra)
+
+#define SNCMETRICS_INTERVAL_DEFAULT     0                   // metrics are off by default
+
+class SNCMetric
+{
+public:
+    SNCMetric(int type, const QString& name, const QString& help, const QString& labels);
+
+    inline void add(qint64 value = 1) { m_value.fetchAndAddRelaxed(value); }
+    inline void set(qint64 value) { m_value.store(value); }
+    inline qint64 value() const { return m_value.load(); }
+
+    void setBounds(const qint64 *bounds, int boundCount);   // sets histogram bucket bounds (ascending)
+    void observe(qint64 value);                             // adds a value to a histogram
+
+    int m_type;                                             // SNCMETRIC_TYPE code
+    QString m_name;                                         // metric family name
+    QString m_help;                                         // help string
+    QString m_labels;                                       // label string (may be empty)
+
+    QAtomicInteger<qint64> m_value;                         // counter or gauge value or histogram sum
+    QAtomicInteger<qint64> m_count;                         // histogram observation count
+    int m_boundCount;                                       // number of histogram bounds
+    qint64 m_bounds[SNCMETRIC_MAX_BUCKETS];                 // upper bound of each bucket
+    QAtomicInteger<qint64> m_buckets[SNCMETRIC_MAX_BUCKETS + 1]; // non-cumulative counts, last is +Inf
+};
+
+class SNCMetrics
+{
+public:
+
+//  These return the existing metric if there's one with the same name and labels
+
+    static SNCMetric *counter(const QString& name, const QString& help, const QString& labels = QString());
+    static SNCMetric *gauge(const QString& name, const QString& help, const QString& labels = QString());
+    static SNCMetric *histogram(const QString& name, const QString& help, const QString& labels,
+                                const qint64 *bounds, int boundCount);
+
+//  removeLabelled removes all metrics whose label string starts with labelPrefix. Any
+//  pointers to the removed metrics must not be used afterwards.
+
+    static void removeLabelled(const QString& labelPrefix);
+
+    static QString label(const QString& name, const QString& value); // returns name="value" with escapes
+
+    static QByteArray prometheusText();                     // the Prometheus text exposition of all metrics
+    static QJsonObject toJson();                            // all metrics as a JSON object keyed by series
+    static bool writeFile(const QString& path);             // writes the Prometheus text, replacing the file atomically
+
+private:
+    static SNCMetric *getMetric(int type, const QString& name, const QString& help, const QString& labels);
+
+    static QMutex m_lock;
+    static QMap<QString, SNCMetric *> m_metrics;            // keyed by name{labels} so families are contiguous
+};
+
+//  SNCMetricsServer answers any request on its port with the Prometheus text. It must be
+//  created in the thread that will service it. There is no authentication so by default
+//  it only listens on the loopback interface.
+
+#define SNCMETRICS_ADDRESS_DEFAULT  "127.0.0.1"             // default listen address for scrapes
+
+class SNCMetricsServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    SNCMetricsServer(QObject *parent = NULL);
+
+    bool start(int port, const QString& address = SNCMETRICS_ADDRESS_DEFAULT); // returns false if the port couldn't be opened
+
+private slots:
+    void newConnection();
+    void readyRead();
+
+private:
+    QTcpServer *m_server;
+};
+
+#endif // _SNCMETRICS_H_
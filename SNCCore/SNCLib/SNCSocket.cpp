@@ -276,6 +276,17 @@ int		SNCSocket::sockPendingDatagramSize()
     return m_UDPSocket->pendingDatagramSize();
 }
 
+qint64 SNCSocket::sockBytesToWrite()
+{
+    if (m_sockType != SOCK_STREAM) {
+        SNCUtils::logError(m_logTag, QString("Incorrect socket type for BytesToWrite %1").arg(m_sockType));
+        return 0;
+    }
+    if (m_state != QAbstractSocket::ConnectedState)
+        return 0;
+    return m_TCPSocket->bytesToWrite();
+}
+
 
 SNCSocket::~SNCSocket()
 {
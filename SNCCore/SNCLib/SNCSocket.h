@@ -106,6 +106,7 @@ public:
     int sockReceive(void *buf, int bufLen);
     int sockSend(void *buf, int bufLen);
     int sockPendingDatagramSize();
+    qint64 sockBytesToWrite();                              // bytes accepted by sockSend but not yet written
 #ifndef NO_SSL
     bool usingSSL() { return m_encrypt; }
 #else
@@ -0,0 +1,193 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "SNCTrace.h"
+#include "SNCUtils.h"
+#include "SNCMetrics.h"
+
+#include <qhostinfo.h>
+
+#include <chrono>
+
+#define TAG "SNCTrace"
+
+QMutex SNCTrace::m_lock;
+QFile *SNCTrace::m_file = NULL;
+
+static const char *traceStageNames[SNC_TRACE_STAGE_COUNT] = {
+    "capture", "sourceSend", "linkTX", "linkRX", "controlRX", "fanout", "endpointRX"
+};
+
+static const qint64 traceBounds[] = {50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000};
+
+qint64 SNCTrace::now()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+quint32 SNCTrace::hostID()
+{
+    static quint32 id = qHash(QHostInfo::localHostName());
+
+    return id;
+}
+
+SNC_TRACE *SNCTrace::getTrace(SNC_EHEAD *ehead, int length)
+{
+    SNC_TRACE *trace;
+
+    if ((ehead->par0 & SNC_EHEAD_PAR0_TRACE) == 0)
+        return NULL;
+    if (length < (int)(sizeof(SNC_EHEAD) + sizeof(SNC_TRACE)))
+        return NULL;
+
+    trace = (SNC_TRACE *)((unsigned char *)ehead + length - sizeof(SNC_TRACE));
+    if ((quint32)SNCUtils::convertUC4ToInt(trace->magic) != SNC_TRACE_MAGIC)
+        return NULL;
+    return trace;
+}
+
+SNC_EHEAD *SNCTrace::addTrace(SNC_EHEAD *ehead, int length, unsigned int traceID)
+{
+    SNC_EHEAD *traced;
+    SNC_TRACE *trace;
+
+    traced = (SNC_EHEAD *)realloc(ehead, length + sizeof(SNC_TRACE));
+    if (traced == NULL)
+        return NULL;
+
+    trace = (SNC_TRACE *)((unsigned char *)traced + length);
+    memset(trace, 0, sizeof(SNC_TRACE));
+    SNCUtils::convertIntToUC4(traceID, trace->traceID);
+    SNCUtils::convertIntToUC4(SNC_TRACE_MAGIC, trace->magic);
+    traced->par0 |= SNC_EHEAD_PAR0_TRACE;
+    return traced;
+}
+
+int SNCTrace::removeTrace(SNC_EHEAD *ehead, int length)
+{
+    if (getTrace(ehead, length) == NULL)
+        return length;
+
+    ehead->par0 &= ~SNC_EHEAD_PAR0_TRACE;
+    return length - sizeof(SNC_TRACE);
+}
+
+void SNCTrace::stamp(SNC_TRACE *trace, int stage, qint64 time)
+{
+    int count = SNCUtils::convertUC2ToUInt(trace->count);
+
+    if (count >= SNC_TRACE_MAX_STAMPS)
+        return;
+
+    SNC_TRACE_STAMP *traceStamp = trace->stamps + count;
+
+    SNCUtils::convertInt64ToUC8(time < 0 ? now() : time, traceStamp->time);
+    SNCUtils::convertIntToUC4(hostID(), traceStamp->host);
+    SNCUtils::convertIntToUC2(stage, traceStamp->stage);
+    SNCUtils::convertIntToUC2(count + 1, trace->count);
+}
+
+void SNCTrace::stampMessage(SNC_MESSAGE *message, int cmd, int length, int stage)
+{
+    SNC_TRACE *trace;
+
+    if (cmd != SNCMSG_MULTICAST_MESSAGE)
+        return;
+    if ((trace = getTrace((SNC_EHEAD *)message, length)) != NULL)
+        stamp(trace, stage);
+}
+
+void SNCTrace::record(const QString& servicePath, SNC_TRACE *trace)
+{
+    int count = SNCUtils::convertUC2ToUInt(trace->count);
+    SNC_TRACE_STAMP *traceStamp = trace->stamps;
+    qint64 time, lastTime = 0;
+    quint32 host, lastHost = 0;
+    int stage, lastStage = 0;
+
+    QString line = QString("trace %1 %2").arg((quint32)SNCUtils::convertUC4ToInt(trace->traceID)).arg(servicePath);
+
+    for (int i = 0; i < count; i++, traceStamp++) {
+        time = SNCUtils::convertUC8ToInt64(traceStamp->time);
+        host = (quint32)SNCUtils::convertUC4ToInt(traceStamp->host);
+        stage = SNCUtils::convertUC2ToUInt(traceStamp->stage);
+
+        line += QString(" %1:%2:%3").arg(stageName(stage)).arg(host, 8, 16, QChar('0')).arg(time);
+
+        //  only stamps from the same host can be compared
+
+        if ((i > 0) && (host == lastHost)) {
+            SNCMetrics::histogram("snc_trace_stage_us", "Latency between consecutive trace stamps",
+                    SNCMetrics::label("stage", stageName(lastStage) + "-" + stageName(stage)),
+                    traceBounds, sizeof(traceBounds) / sizeof(qint64))->observe(time - lastTime);
+        }
+        lastTime = time;
+        lastHost = host;
+        lastStage = stage;
+    }
+
+    QMutexLocker locker(&m_lock);
+
+    if (m_file == NULL)
+        return;
+    m_file->write(qPrintable(line + "\n"));
+    m_file->flush();
+}
+
+void SNCTrace::setTraceFile(const QString& path)
+{
+    QMutexLocker locker(&m_lock);
+
+    if (m_file != NULL) {
+        m_file->close();
+        delete m_file;
+        m_file = NULL;
+    }
+    if (path.isEmpty())
+        return;
+
+    m_file = new QFile(path);
+    if (!m_file->open(QIODevice::WriteOnly | QIODevice::Append)) {
+        SNCUtils::logWarn(TAG, QString("Failed to open trace file %1").arg(path));
+        delete m_file;
+        m_file = NULL;
+    }
+}
+
+QString SNCTrace::stageName(int stage)
+{
+    if ((stage < 0) || (stage >= SNC_TRACE_STAGE_COUNT))
+        return QString::number(stage);
+    return traceStageNames[stage];
+}
+
+int SNCTrace::stageFromName(const QString& name)
+{
+    for (int stage = 0; stage < SNC_TRACE_STAGE_COUNT; stage++) {
+        if (name == traceStageNames[stage])
+            return stage;
+    }
+    return -1;
+}
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef _SNCTRACE_H_
+#define _SNCTRACE_H_
+
+#include "SNCDefs.h"
+
+#include <qstring.h>
+#include <qmutex.h>
+#include <qfile.h>
+
+//  SNCTrace handles the SNC_TRACE trailer carried by sampled multicast messages.
+//  Lengths passed to these functions are total message lengths including the SNC_EHEAD.
+
+class SNCTrace
+{
+public:
+    static qint64 now();                                    // monotonic time in microseconds
+    static quint32 hostID();                                // ID used to tell which stamps are comparable
+
+//  getTrace returns a pointer to the trailer or NULL if there isn't one
+
+    static SNC_TRACE *getTrace(SNC_EHEAD *ehead, int length);
+
+//  addTrace reallocates the message with an empty trailer on the end. It returns the
+//  new message (the old pointer is no longer valid) or NULL if the message couldn't
+//  be extended, in which case the original message is unchanged.
+
+    static SNC_EHEAD *addTrace(SNC_EHEAD *ehead, int length, unsigned int traceID);
+
+//  removeTrace strips the trailer and returns the new length
+
+    static int removeTrace(SNC_EHEAD *ehead, int length);
+
+//  stamp adds a stamp if there's room. time < 0 means now.
+
+    static void stamp(SNC_TRACE *trace, int stage, qint64 time = -1);
+
+//  stampMessage stamps a multicast message if it has a trailer - used by SNCLink and SNCControl
+
+    static void stampMessage(SNC_MESSAGE *message, int cmd, int length, int stage);
+
+//  record writes a completed trace to the trace file (if set) and adds the stage
+//  latencies to the metrics registry.
+
+    static void record(const QString& servicePath, SNC_TRACE *trace);
+    static void setTraceFile(const QString& path);          // empty path means no file
+
+    static QString stageName(int stage);
+    static int stageFromName(const QString& name);          // returns -1 if not a stage name
+
+private:
+    static QMutex m_lock;
+    static QFile *m_file;                                   // the trace file or NULL
+};
+
+#endif // _SNCTRACE_H_
@@ -24,6 +24,8 @@
 #include "SNCUtils.h"
 #include "SNCSocket.h"
 #include "SNCEndpoint.h"
+#include "SNCMetrics.h"
+#include "SNCCapture.h"
 
 #include <qfileinfo.h>
 #include <qdir.h>
@@ -279,6 +281,7 @@ SNC_EHEAD *SNCUtils::createEHEAD(SNC_UID *sourceUID, int sourcePort, SNC_UID *de
     memcpy(&(ehead->destUID), destUID, sizeof(SNC_UID));
     convertIntToUC2(destPort, ehead->destPort);
     ehead->seq = seq;
+    ehead->par0 = ehead->par1 = ehead->par2 = 0;
 
     return ehead;
 }
@@ -313,6 +316,77 @@ bool SNCUtils::crackServicePath(QString servicePath, QString& regionName, QStrin
     return true;
 }
 
+/*
+    This version of crackServicePath does not allocate and is intended for SNCControl's lookup path.
+    \a regionName must be at least SNC_MAX_REGIONNAME, \a componentName SNC_MAX_APPNAME and
+    \a serviceName SNC_MAX_SERVNAME in size. The parts are split exactly as the QString version
+    does. Returns false if the path has too many parts or a part is too long for its buffer.
+*/
+
+bool SNCUtils::crackServicePath(const char *servicePath, char *regionName, char *componentName, char *serviceName)
+{
+    const char *part[3];
+    int partLength[3];
+    int maxLength[3];
+    char *dest[3];
+    int parts;
+    int i;
+    const char *ptr;
+
+    regionName[0] = 0;
+    componentName[0] = 0;
+    serviceName[0] = 0;
+
+    parts = 0;
+    part[0] = ptr = servicePath;
+    while (*ptr != 0) {
+        if (*ptr == SNC_SERVICEPATH_SEP) {
+            if (parts == 2) {
+                SNCUtils::logWarn(m_logTag, QString("Service path received has invalid format ") + servicePath);
+                return false;
+            }
+            partLength[parts] = (int)(ptr - part[parts]);
+            part[++parts] = ptr + 1;
+        }
+        ptr++;
+    }
+    partLength[parts] = (int)(ptr - part[parts]);
+    parts++;
+
+    switch (parts) {
+        case 1:
+            dest[0] = serviceName;
+            maxLength[0] = SNC_MAX_SERVNAME;
+            break;
+
+        case 2:
+            dest[0] = componentName;
+            maxLength[0] = SNC_MAX_APPNAME;
+            dest[1] = serviceName;
+            maxLength[1] = SNC_MAX_SERVNAME;
+            break;
+
+        default:
+            dest[0] = regionName;
+            maxLength[0] = SNC_MAX_REGIONNAME;
+            dest[1] = componentName;
+            maxLength[1] = SNC_MAX_APPNAME;
+            dest[2] = serviceName;
+            maxLength[2] = SNC_MAX_SERVNAME;
+            break;
+    }
+
+    for (i = 0; i < parts; i++) {
+        if (partLength[i] >= maxLength[i]) {
+            SNCUtils::logWarn(m_logTag, QString("Service path received has element that is too long ") + servicePath);
+            return false;
+        }
+        memcpy(dest[i], part[i], partLength[i]);
+        dest[i][partLength[i]] = 0;
+    }
+    return true;
+}
+
 /*
     This function is normally called from within main.cpp of a SNC app before the main code begins.
     It makes sure that settings common to all applications are set up correctly in the .ini file and
@@ -494,6 +568,28 @@ void SNCUtils::loadStandardSettings(const char *appType, QStringList arglist)
     if (!settings->contains(SNC_PARAMS_UID))
         settings->setValue(SNC_PARAMS_UID, "000000000000");
 
+    if (!settings->contains(SNC_PARAMS_METRICS_INTERVAL))
+        settings->setValue(SNC_PARAMS_METRICS_INTERVAL, SNCMETRICS_INTERVAL_DEFAULT);
+
+    if (!settings->contains(SNC_PARAMS_TRACE_SAMPLE))
+        settings->setValue(SNC_PARAMS_TRACE_SAMPLE, 0);
+
+    if (!settings->contains(SNC_PARAMS_TRACE_FILE))
+        settings->setValue(SNC_PARAMS_TRACE_FILE, "");
+
+    if (!settings->contains(SNC_PARAMS_CAPTURE_FILE))
+        settings->setValue(SNC_PARAMS_CAPTURE_FILE, "");
+
+    if (!settings->contains(SNC_PARAMS_CAPTURE_LIMIT))
+        settings->setValue(SNC_PARAMS_CAPTURE_LIMIT, SNC_CAPTURE_LIMIT_DEFAULT);
+
+    if (!settings->contains(SNC_PARAMS_CAPTURE_TX))
+        settings->setValue(SNC_PARAMS_CAPTURE_TX, false);
+
+    if (settings->value(SNC_PARAMS_CAPTURE_FILE).toString().length() > 0)
+        SNCCapture::setCaptureFile(settings->value(SNC_PARAMS_CAPTURE_FILE).toString(),
+                settings->value(SNC_PARAMS_CAPTURE_LIMIT).toInt(), settings->value(SNC_PARAMS_CAPTURE_TX).toBool());
+
     settings->sync();
     delete settings;
 }
@@ -508,6 +604,7 @@ bool SNCUtils::isReservedNameCharacter(char value)
     switch (value) {
         case SNCCFS_FILENAME_SEP:
         case SNC_SERVICEPATH_SEP:
+        case SNC_SERVICEPATH_RATE_SEP:
         case ' ' :
         case '\\':
             return true;
@@ -596,6 +693,74 @@ void SNCUtils::removeStreamNameFromPath(const QString& servicePath,
      streamName.remove(0, start + 1);
 }
 
+/*
+    A multicast subscriber can ask SNCControl to thin out a stream by adding a rate spec
+    to the end of the lookup path. "i<ms>" sets the minimum interval between delivered records
+    and "n<count>" delivers every nth record. For example "Camera/avmux@i1000" asks for
+    at most one record a second and "Camera/avmux@n5" for every fifth record.
+    "c0" asks SNCControl not to send the stream's cached record when the subscriber first
+    registers. Recorders use this as the cached record may already have been stored.
+*/
+
+QString SNCUtils::insertRateInPath(const QString& servicePath, int minInterval, int everyNth, bool noCache)
+{
+    QString result = servicePath;
+
+    if ((minInterval <= 0) && (everyNth <= 1) && !noCache)
+        return result;
+
+    result += SNC_SERVICEPATH_RATE_SEP;
+    if (minInterval > 0)
+        result += QString("i%1").arg(minInterval);
+    if (everyNth > 1)
+        result += QString("n%1").arg(everyNth);
+    if (noCache)
+        result += "c0";
+    return result;
+}
+
+bool SNCUtils::removeRateFromPath(char *servicePath, int *minInterval, int *everyNth, bool *noCache)
+{
+    char *spec;
+    char *end;
+    char code;
+    long value;
+
+    *minInterval = 0;
+    *everyNth = 0;
+    *noCache = false;
+
+    if ((spec = strchr(servicePath, SNC_SERVICEPATH_RATE_SEP)) == NULL)
+        return true;                                        // no rate spec
+
+    *spec++ = 0;                                            // remove it from the path
+
+    while (*spec != 0) {
+        code = *spec++;
+        if ((*spec < '0') || (*spec > '9'))
+            return false;
+        value = strtol(spec, &end, 10);
+        spec = end;
+        switch (code) {
+            case 'i':
+                *minInterval = (int)value;
+                break;
+
+            case 'n':
+                *everyNth = (int)value;
+                break;
+
+            case 'c':
+                *noCache = value == 0;
+                break;
+
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
 QHostAddress SNCUtils::getMyBroadcastAddress()
 {
     return m_platformBroadcastAddress;
@@ -624,6 +789,66 @@ bool SNCUtils::isInMySubnet(SNC_IPADDR IPAddr)
 }
 
 
+/*
+    Writes the batch entry form of \a serviceLookup to \a dest and returns the number of bytes used.
+    If \a withPath is true, the zero terminated service path follows the entry. \a dest must have space for
+    sizeof(SNC_SERVICE_LOOKUP_ENTRY) + SNC_MAX_SERVPATH bytes.
+*/
+
+int SNCUtils::putLookupBatchEntry(unsigned char *dest, SNC_SERVICE_LOOKUP *serviceLookup, bool withPath)
+{
+    SNC_SERVICE_LOOKUP_ENTRY *entry = (SNC_SERVICE_LOOKUP_ENTRY *)dest;
+    int pathLength = 0;
+
+    entry->lookupUID = serviceLookup->lookupUID;
+    memcpy(entry->ID, serviceLookup->ID, sizeof(SNC_UC4));
+    copyUC2(entry->remotePort, serviceLookup->remotePort);
+    copyUC2(entry->componentIndex, serviceLookup->componentIndex);
+    copyUC2(entry->localPort, serviceLookup->localPort);
+    entry->serviceType = serviceLookup->serviceType;
+    entry->response = serviceLookup->response;
+
+    if (withPath) {
+        serviceLookup->servicePath[SNC_MAX_SERVPATH - 1] = 0;
+        pathLength = (int)strlen(serviceLookup->servicePath) + 1;
+        memcpy(dest + sizeof(SNC_SERVICE_LOOKUP_ENTRY), serviceLookup->servicePath, pathLength);
+    }
+    entry->pathLength = pathLength;
+    return sizeof(SNC_SERVICE_LOOKUP_ENTRY) + pathLength;
+}
+
+/*
+    Reads the batch entry at \a src into \a serviceLookup. Only the fields carried by the entry are changed
+    so \a serviceLookup can be preset with the local copy of the lookup. \a length is the number of bytes
+    left in the message. Returns the length of the entry or -1 if it is malformed.
+*/
+
+int SNCUtils::getLookupBatchEntry(const unsigned char *src, int length, SNC_SERVICE_LOOKUP *serviceLookup)
+{
+    SNC_SERVICE_LOOKUP_ENTRY *entry = (SNC_SERVICE_LOOKUP_ENTRY *)src;
+    int pathLength;
+
+    if (length < (int)sizeof(SNC_SERVICE_LOOKUP_ENTRY))
+        return -1;
+    pathLength = entry->pathLength;
+    if ((pathLength > SNC_MAX_SERVPATH) || (length < (int)sizeof(SNC_SERVICE_LOOKUP_ENTRY) + pathLength))
+        return -1;
+
+    serviceLookup->lookupUID = entry->lookupUID;
+    memcpy(serviceLookup->ID, entry->ID, sizeof(SNC_UC4));
+    copyUC2(serviceLookup->remotePort, entry->remotePort);
+    copyUC2(serviceLookup->componentIndex, entry->componentIndex);
+    copyUC2(serviceLookup->localPort, entry->localPort);
+    serviceLookup->serviceType = entry->serviceType;
+    serviceLookup->response = entry->response;
+
+    if (pathLength > 0) {
+        memcpy(serviceLookup->servicePath, src + sizeof(SNC_SERVICE_LOOKUP_ENTRY), pathLength);
+        serviceLookup->servicePath[pathLength - 1] = 0;
+    }
+    return sizeof(SNC_SERVICE_LOOKUP_ENTRY) + pathLength;
+}
+
 /*
     Provides a convenient way of checking to see if a timer has expired. \a now is the current
     time. \a start is the start time of the timer, usually
@@ -799,6 +1024,47 @@ bool SNCUtils::avmuxHeaderValidate(SNC_RECORD_AVMUX *avmuxHead, int length,
     return true;
 }
 
+//  YUYV2RGB converts a YUYV 4:2:2 frame to packed RGB888. width must be even and
+//  rgb must have room for width * height * 3 bytes.
+
+void SNCUtils::YUYV2RGB(const unsigned char *yuyv, unsigned char *rgb, int width, int height)
+{
+    int r, g, b;
+    int y, u, v;
+
+    int stride = width * 3;
+
+    for (int i = 0; i < height; i++)	{
+        unsigned char *p = rgb + (i * stride);
+
+        for (int j = 0; j < width; j += 2) {
+            y = yuyv[0] << 8;
+            u = yuyv[1] - 128;
+            v = yuyv[3] - 128;
+
+            r = (y + (359 * v)) >> 8;
+            g = (y - (88 * u) - (183 * v)) >> 8;
+            b = (y + (454 * u)) >> 8;
+
+            *(p++) = (r > 255) ? 255 : ((r < 0) ? 0 : r);
+            *(p++) = (g > 255) ? 255 : ((g < 0) ? 0 : g);
+            *(p++) = (b > 255) ? 255 : ((b < 0) ? 0 : b);
+
+            y = yuyv[2] << 8;
+
+            r = (y + (359 * v)) >> 8;
+            g = (y - (88 * u) - (183 * v)) >> 8;
+            b = (y + (454 * u)) >> 8;
+
+            *(p++) = (r > 255) ? 255 : ((r < 0) ? 0 : r);
+            *(p++) = (g > 255) ? 255 : ((g < 0) ? 0 : g);
+            *(p++) = (b > 255) ? 255 : ((b < 0) ? 0 : b);
+
+            yuyv += 4;
+        }
+    }
+}
+
 
 
 //----------------------------------------------------------
@@ -64,6 +64,12 @@ class SNCSocket;
 #define SNC_PARAMS_ENCRYPT_LINK         "encryptLink"       // true if use SSL for links
 #define SNC_PARAMS_UID_USE_MAC          "UIDUseMAC"         // true if use MAC for UID, false means use configured
 #define SNC_PARAMS_UID                  "UID"               // configured UID
+#define SNC_PARAMS_METRICS_INTERVAL     "metricsInterval"   // seconds between metrics records (0 = off)
+#define SNC_PARAMS_TRACE_SAMPLE         "traceSampleInterval" // trace one in this many sent multicast records (0 = off)
+#define SNC_PARAMS_TRACE_FILE           "traceFile"         // file for traces of received multicast records
+#define SNC_PARAMS_CAPTURE_FILE         "captureFile"       // file for captured link traffic (empty = off)
+#define SNC_PARAMS_CAPTURE_LIMIT        "captureLimit"      // capture file size limit in MB
+#define SNC_PARAMS_CAPTURE_TX           "captureTX"         // true to capture sent as well as received messages
 
 #define	SNC_PARAMS_CONTROL_NAMES        "controlNames"      // ordered list of SNCControls as an array
 #define	SNC_PARAMS_CONTROL_NAME         "controlName"       // an entry in the array
@@ -132,6 +138,9 @@ public:
                     SNC_UID *destUID, int destPort, unsigned char seq, int len);
     static void swapEHead(SNC_EHEAD *ehead);		// swaps UIDs and port numbers
     static bool crackServicePath(QString servicePath, QString &regionName, QString& componentName, QString& serviceName); // breaks a service path into its constituent bits
+    static bool crackServicePath(const char *servicePath, char *regionName, char *componentName, char *serviceName); // same but into SNC_REGIONNAME, SNC_APPNAME and SNC_SERVNAME buffers
+    static int putLookupBatchEntry(unsigned char *dest, SNC_SERVICE_LOOKUP *serviceLookup, bool withPath); // adds a batch entry, returns its length
+    static int getLookupBatchEntry(const unsigned char *src, int length, SNC_SERVICE_LOOKUP *serviceLookup); // overlays a batch entry, returns its length or -1
     static bool timerExpired(qint64 now, qint64 start, qint64 interval);
 
     static qint64 clock() {	return QDateTime::currentMSecsSinceEpoch();}
@@ -151,6 +160,10 @@ public:
     static QString insertStreamNameInPath(const QString& streamSource, const QString& streamName); // adds in a stream name before any extension
     static void removeStreamNameFromPath(const QString& servicePath,
             QString& streamSource, QString& streamName);    // extracts a stream name before any extension
+    static QString insertRateInPath(const QString& servicePath, int minInterval, int everyNth,
+            bool noCache = false);                          // adds a multicast subscriber rate spec
+    static bool removeRateFromPath(char *servicePath, int *minInterval, int *everyNth,
+            bool *noCache);                                 // strips a rate spec, false if malformed
 
 //  IP Address functions
 
@@ -190,6 +203,7 @@ public:
             unsigned char **muxPtr, int& muxLength,
             unsigned char **videoPtr, int& videoLength,
             unsigned char **audioPtr, int& audioLength);
+    static void YUYV2RGB(const unsigned char *yuyv, unsigned char *rgb, int width, int height); // YUYV frame to packed RGB888
 
 //  SNC timestamp functions
 
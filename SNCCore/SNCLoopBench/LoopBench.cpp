@@ -0,0 +1,374 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "LoopBench.h"
+#include "LoopBenchProducer.h"
+#include "LoopBenchConsumer.h"
+#include "SNCServer.h"
+#include "SNCUtils.h"
+
+#include <qcoreapplication.h>
+#include <qtimer.h>
+#include <qfile.h>
+
+#include <stdio.h>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+#define TAG "LoopBench"
+
+//----------------------------------------------------------
+//  LoopBenchHistogram
+
+LoopBenchHistogram::LoopBenchHistogram()
+{
+    clear();
+}
+
+void LoopBenchHistogram::clear()
+{
+    memset(m_buckets, 0, sizeof(m_buckets));
+    m_count = 0;
+    m_min = 0;
+    m_max = 0;
+}
+
+int LoopBenchHistogram::index(qint64 value)
+{
+    int shift = 0;
+
+    if (value < 0)
+        value = 0;
+    if (value < LOOPBENCH_HIST_LINEAR)
+        return (int)value;
+
+    while ((value >> shift) >= (2 * LOOPBENCH_HIST_SUBBUCKETS))
+        shift++;
+    if (shift > LOOPBENCH_HIST_MAX_SHIFT)
+        return LOOPBENCH_HIST_SIZE - 1;
+
+    // value >> shift is now in [64, 128)
+
+    return LOOPBENCH_HIST_LINEAR + (shift - 1) * LOOPBENCH_HIST_SUBBUCKETS +
+            (int)(value >> shift) - LOOPBENCH_HIST_SUBBUCKETS;
+}
+
+qint64 LoopBenchHistogram::value(int index)
+{
+    if (index < LOOPBENCH_HIST_LINEAR)
+        return index;
+
+    index -= LOOPBENCH_HIST_LINEAR;
+    return (qint64)(index % LOOPBENCH_HIST_SUBBUCKETS + LOOPBENCH_HIST_SUBBUCKETS)
+            << (index / LOOPBENCH_HIST_SUBBUCKETS + 1);
+}
+
+void LoopBenchHistogram::add(qint64 value)
+{
+    if ((m_count == 0) || (value < m_min))
+        m_min = value;
+    if ((m_count == 0) || (value > m_max))
+        m_max = value;
+    m_buckets[index(value)]++;
+    m_count++;
+}
+
+void LoopBenchHistogram::merge(const LoopBenchHistogram& other)
+{
+    if (other.m_count == 0)
+        return;
+
+    if ((m_count == 0) || (other.m_min < m_min))
+        m_min = other.m_min;
+    if ((m_count == 0) || (other.m_max > m_max))
+        m_max = other.m_max;
+    for (int i = 0; i < LOOPBENCH_HIST_SIZE; i++)
+        m_buckets[i] += other.m_buckets[i];
+    m_count += other.m_count;
+}
+
+qint64 LoopBenchHistogram::percentile(double pc) const
+{
+    qint64 target;
+    qint64 total = 0;
+
+    if (m_count == 0)
+        return 0;
+
+    target = (qint64)((pc * m_count) / 100.0 + 0.5);
+    if (target < 1)
+        target = 1;
+
+    for (int i = 0; i < LOOPBENCH_HIST_SIZE; i++) {
+        total += m_buckets[i];
+        if (total >= target)
+            return qBound(m_min, value(i), m_max);
+    }
+    return m_max;
+}
+
+//----------------------------------------------------------
+//  LoopBench
+
+LoopBench::LoopBench(const LOOPBENCH_CONFIG& config)
+{
+    m_config = config;
+    m_server = NULL;
+    m_phase = LOOPBENCH_PHASE_CONNECT;
+    m_measuring = 0;
+    m_exitCode = 0;
+    m_startCPU = m_startSent = m_startBlocked = 0;
+    m_measuredNs = m_measuredCPU = m_measuredSent = m_measuredBlocked = 0;
+}
+
+LoopBench::~LoopBench()
+{
+}
+
+QString LoopBench::serviceName(int producer, int service)
+{
+    return QString("bench%1_%2").arg(producer).arg(service);
+}
+
+//  Service g = producer * services + service goes to consumers g, g+1, ... g+fanout-1 (mod consumers)
+//  so the subscriptions are spread evenly.
+
+bool LoopBench::consumerWantsService(int consumer, int producer, int service) const
+{
+    int g = producer * m_config.services + service;
+    int offset = (consumer - g % m_config.consumers + m_config.consumers) % m_config.consumers;
+
+    return offset < m_config.fanout;
+}
+
+//  start forces the settings that make every endpoint tunnel straight to the
+//  in-process SNCServer on loopback, so no hello beacons or real network are used.
+
+void LoopBench::start()
+{
+    QSettings *settings = SNCUtils::getSettings();
+
+    settings->setValue(SNC_PARAMS_USE_TUNNEL, true);
+    settings->setValue(SNC_PARAMS_TUNNEL_ADDR, "127.0.0.1");
+    settings->setValue(SNC_PARAMS_TUNNEL_PORT, m_config.port);
+    settings->setValue(SNC_PARAMS_ENCRYPT_LINK, false);
+
+    settings->beginGroup(SNCSERVER_PARAMS_GROUP);
+    settings->setValue(SNCSERVER_PARAMS_LISTEN_LOCAL_SOCKET, m_config.port);
+    settings->setValue(SNCSERVER_PARAMS_LISTEN_STATICTUNNEL_SOCKET, m_config.port + 1);
+    settings->setValue(SNCSERVER_PARAMS_ENCRYPT_LOCAL, false);
+    settings->setValue(SNCSERVER_PARAMS_ENCRYPT_STATICTUNNEL_SERVER, false);
+    settings->endGroup();
+
+    delete settings;
+
+    m_server = new SNCServer();
+    m_server->resumeThread();
+
+    for (int i = 0; i < m_config.producers; i++) {
+        m_producers.append(new LoopBenchProducer(this, i));
+        m_producers.last()->resumeThread();
+    }
+
+    for (int i = 0; i < m_config.consumers; i++) {
+        m_consumers.append(new LoopBenchConsumer(this, i));
+        m_consumers.last()->resumeThread();
+    }
+
+    printf("SNCLoopBench: %d producers x %d services, %d consumers, fan-out %d\n",
+           m_config.producers, m_config.services, m_config.consumers, m_config.fanout);
+    if (m_config.rate > 0)
+        printf("%d byte records at %d/s per service, priority %d\n", m_config.recordSize, m_config.rate, m_config.priority);
+    else
+        printf("%d byte records window limited, priority %d\n", m_config.recordSize, m_config.priority);
+    fflush(stdout);
+
+    m_phaseTimer.start();
+    QTimer *timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), this, SLOT(tick()));
+    timer->start(LOOPBENCH_TICK_INTERVAL);
+}
+
+void LoopBench::tick()
+{
+    switch (m_phase) {
+    case LOOPBENCH_PHASE_CONNECT:
+        for (int i = 0; i < m_consumers.count(); i++) {
+            if (!m_consumers.at(i)->allServicesActive()) {
+                if (m_phaseTimer.elapsed() > LOOPBENCH_CONNECT_TIMEOUT * 1000) {
+                    printf("Consumer %d subscriptions not active after %d seconds\n", i, LOOPBENCH_CONNECT_TIMEOUT);
+                    shutdown(1);
+                }
+                return;
+            }
+        }
+        printf("All subscriptions active after %lldms, warming up for %ds\n", m_phaseTimer.elapsed(), m_config.warmup);
+        fflush(stdout);
+        m_phase = LOOPBENCH_PHASE_WARMUP;
+        m_phaseTimer.start();
+        break;
+
+    case LOOPBENCH_PHASE_WARMUP:
+        if (m_phaseTimer.elapsed() >= m_config.warmup * 1000)
+            startMeasuring();
+        break;
+
+    case LOOPBENCH_PHASE_MEASURE:
+        if (m_phaseTimer.elapsed() >= m_config.duration * 1000) {
+            stopMeasuring();
+            report();
+            shutdown(m_exitCode);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+void LoopBench::startMeasuring()
+{
+    m_startSent = m_startBlocked = 0;
+    for (int i = 0; i < m_producers.count(); i++) {
+        m_startSent += m_producers.at(i)->sent();
+        m_startBlocked += m_producers.at(i)->blocked();
+    }
+    m_startCPU = cpuTime();
+    m_measuring.storeRelease(1);
+    m_phase = LOOPBENCH_PHASE_MEASURE;
+    m_phaseTimer.start();
+}
+
+void LoopBench::stopMeasuring()
+{
+    m_measuring.storeRelease(0);
+    m_measuredNs = m_phaseTimer.nsecsElapsed();
+    m_measuredCPU = (m_startCPU < 0) ? -1 : cpuTime() - m_startCPU;
+
+    m_measuredSent = -m_startSent;
+    m_measuredBlocked = -m_startBlocked;
+    for (int i = 0; i < m_producers.count(); i++) {
+        m_measuredSent += m_producers.at(i)->sent();
+        m_measuredBlocked += m_producers.at(i)->blocked();
+    }
+}
+
+void LoopBench::report()
+{
+    LoopBenchHistogram latency;
+    qint64 records = 0, bytes = 0, lost = 0;
+    double seconds = (double)m_measuredNs / 1e9;
+
+    for (int i = 0; i < m_consumers.count(); i++)
+        m_consumers.at(i)->takeStats(latency, records, bytes, lost);
+
+    printf("\nMeasured over %.2fs\n", seconds);
+    printf("sent             %12.0f records/s\n", (double)m_measuredSent / seconds);
+    printf("delivered        %12.0f records/s %10.2f MB/s\n",
+           (double)records / seconds, (double)bytes / seconds / 1e6);
+    printf("lost             %12lld records\n", lost);
+    printf("blocked          %12lld rate slots\n", m_measuredBlocked);
+
+    if (m_measuredCPU >= 0)
+        printf("cpu              %12.2f us/delivery %6.1f%% of a core\n",
+               records > 0 ? (double)m_measuredCPU / (double)records : 0.0,
+               (double)m_measuredCPU / 10000.0 / seconds);
+
+    printf("latency us       min %lld p50 %lld p90 %lld p99 %lld p99.9 %lld max %lld\n",
+           latency.min(), latency.percentile(50), latency.percentile(90),
+           latency.percentile(99), latency.percentile(99.9), latency.max());
+
+    qint64 rss = memoryKB("VmRSS:");
+    qint64 peak = memoryKB("VmHWM:");
+
+    if (rss >= 0)
+        printf("memory           rss %.1fMB peak %.1fMB\n", (double)rss / 1024.0, (double)peak / 1024.0);
+
+    if (records == 0) {
+        printf("FAIL: no records delivered\n");
+        m_exitCode = 1;
+    } else if ((m_config.maxP99 > 0) && (latency.percentile(99) > m_config.maxP99)) {
+        printf("FAIL: p99 latency %lldus exceeds %dus\n", latency.percentile(99), m_config.maxP99);
+        m_exitCode = 1;
+    }
+    fflush(stdout);
+}
+
+//  shutdown stops the endpoints before the server so they don't see the links drop
+//  and try to reconnect, then exits once the threads have had time to finish.
+
+void LoopBench::shutdown(int exitCode)
+{
+    m_phase = LOOPBENCH_PHASE_DONE;
+    m_exitCode = exitCode;
+
+    for (int i = 0; i < m_consumers.count(); i++)
+        m_consumers.at(i)->exitThread();
+    for (int i = 0; i < m_producers.count(); i++)
+        m_producers.at(i)->exitThread();
+    m_consumers.clear();
+    m_producers.clear();
+
+    if (m_server != NULL)
+        m_server->exitThread();
+    m_server = NULL;
+
+    QTimer::singleShot(LOOPBENCH_SHUTDOWN_WAIT, this, SLOT(exitApp()));
+}
+
+void LoopBench::exitApp()
+{
+    QCoreApplication::exit(m_exitCode);
+}
+
+qint64 LoopBench::cpuTime()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+    return (qint64)usage.ru_utime.tv_sec * 1000000 + usage.ru_utime.tv_usec +
+            (qint64)usage.ru_stime.tv_sec * 1000000 + usage.ru_stime.tv_usec;
+#else
+    return -1;
+#endif
+}
+
+qint64 LoopBench::memoryKB(const char *field)
+{
+    QFile file("/proc/self/status");
+
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+
+    while (!file.atEnd()) {
+        QByteArray line = file.readLine();
+
+        if (line.startsWith(field))
+            return line.mid((int)strlen(field)).trimmed().split(' ').at(0).toLongLong();
+    }
+    return -1;
+}
@@ -0,0 +1,165 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef LOOPBENCH_H
+#define LOOPBENCH_H
+
+#include "SNCDefs.h"
+
+#include <qobject.h>
+#include <qstring.h>
+#include <qlist.h>
+#include <qmutex.h>
+#include <qatomic.h>
+#include <qelapsedtimer.h>
+
+//  LoopBench runs an SNCServer and a set of synthetic producer and consumer endpoints in one
+//  process, all linked over loopback, and reports what the SNCControl data path delivers.
+
+#define LOOPBENCH_DEFAULT_PORT          16610               // local link port (static tunnel is +1)
+#define LOOPBENCH_CONNECT_TIMEOUT       30                  // seconds allowed for all subscriptions to come up
+#define LOOPBENCH_TICK_INTERVAL         100                 // ms between controller checks
+#define LOOPBENCH_SHUTDOWN_WAIT         1000                // ms allowed for the threads to exit
+
+#define LOOPBENCH_PRODUCER_INTERVAL     1                   // producer background interval in ms
+#define LOOPBENCH_CONSUMER_INTERVAL     10                  // consumer background interval in ms
+
+#define LOOPBENCH_RECORD_TYPE           SNC_RECORD_TYPE_USER
+
+//  The bench record. The send time is steady clock microseconds so latency is
+//  measured without wall clock steps. Any padding follows.
+
+typedef struct
+{
+    SNC_RECORD_HEADER header;
+    SNC_UC8 sendTime;                                       // SNCTrace::now() when the record was built
+} LOOPBENCH_RECORD;
+
+typedef struct
+{
+    int producers;                                          // number of producer endpoints
+    int consumers;                                          // number of consumer endpoints
+    int services;                                           // multicast services per producer
+    int fanout;                                             // consumers subscribed to each service
+    int recordSize;                                         // bytes per record including LOOPBENCH_RECORD
+    int rate;                                               // records per second per service (0 = window limited)
+    int priority;                                           // link priority for the records
+    int warmup;                                             // seconds before measurement starts
+    int duration;                                           // seconds measured
+    int port;                                               // local link port
+    int maxP99;                                             // fail if p99 latency exceeds this in us (0 = no check)
+} LOOPBENCH_CONFIG;
+
+//  LoopBenchHistogram is a log-linear latency histogram - exact below 128us, then 64
+//  sub-buckets per power of two (about 1.5% resolution) up to LOOPBENCH_HIST_MAX_SHIFT.
+
+#define LOOPBENCH_HIST_LINEAR           128
+#define LOOPBENCH_HIST_SUBBUCKETS       64
+#define LOOPBENCH_HIST_MAX_SHIFT        30
+#define LOOPBENCH_HIST_SIZE             (LOOPBENCH_HIST_LINEAR + LOOPBENCH_HIST_MAX_SHIFT * LOOPBENCH_HIST_SUBBUCKETS)
+
+class LoopBenchHistogram
+{
+public:
+    LoopBenchHistogram();
+
+    void clear();
+    void add(qint64 value);
+    void merge(const LoopBenchHistogram& other);
+    qint64 percentile(double pc) const;                     // pc is 0 to 100
+
+    qint64 count() const { return m_count; }
+    qint64 min() const { return m_min; }
+    qint64 max() const { return m_max; }
+
+private:
+    static int index(qint64 value);
+    static qint64 value(int index);                         // lower bound of the bucket
+
+    qint64 m_buckets[LOOPBENCH_HIST_SIZE];
+    qint64 m_count;
+    qint64 m_min;
+    qint64 m_max;
+};
+
+class SNCServer;
+class LoopBenchProducer;
+class LoopBenchConsumer;
+
+class LoopBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    LoopBench(const LOOPBENCH_CONFIG& config);
+    ~LoopBench();
+
+    void start();                                           // sets up settings, starts the threads and the controller
+
+    const LOOPBENCH_CONFIG& config() const { return m_config; }
+    bool measuring() const { return m_measuring.loadAcquire() != 0; }
+
+    static QString serviceName(int producer, int service);
+    bool consumerWantsService(int consumer, int producer, int service) const;
+
+public slots:
+    void tick();
+    void exitApp();
+
+private:
+    enum
+    {
+        LOOPBENCH_PHASE_CONNECT,
+        LOOPBENCH_PHASE_WARMUP,
+        LOOPBENCH_PHASE_MEASURE,
+        LOOPBENCH_PHASE_DONE
+    };
+
+    void startMeasuring();
+    void stopMeasuring();
+    void report();
+    void shutdown(int exitCode);
+
+    static qint64 cpuTime();                                // process user + system time in us
+    static qint64 memoryKB(const char *field);              // VmRSS etc from /proc/self/status
+
+    LOOPBENCH_CONFIG m_config;
+    SNCServer *m_server;
+    QList<LoopBenchProducer *> m_producers;
+    QList<LoopBenchConsumer *> m_consumers;
+
+    int m_phase;
+    QElapsedTimer m_phaseTimer;
+    QAtomicInt m_measuring;
+    int m_exitCode;
+
+    qint64 m_startCPU;                                      // cpu time at start of measurement
+    qint64 m_startSent;                                     // producer totals at start of measurement
+    qint64 m_startBlocked;
+    qint64 m_measuredNs;                                    // length of the measurement
+    qint64 m_measuredCPU;
+    qint64 m_measuredSent;
+    qint64 m_measuredBlocked;
+};
+
+#endif // LOOPBENCH_H
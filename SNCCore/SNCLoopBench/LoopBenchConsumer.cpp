@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "LoopBenchConsumer.h"
+#include "SNCTrace.h"
+#include "SNCUtils.h"
+
+#define TAG "LoopBenchConsumer"
+
+LoopBenchConsumer::LoopBenchConsumer(LoopBench *bench, int index)
+    : SNCEndpoint(LOOPBENCH_CONSUMER_INTERVAL, TAG)
+{
+    m_bench = bench;
+    m_index = index;
+    m_serviceCount = 0;
+    m_records = 0;
+    m_bytes = 0;
+    m_lost = 0;
+
+    for (int i = 0; i < SNC_MAX_SERVICESPERCOMPONENT; i++) {
+        m_servicePort[i] = -1;
+        m_lastIndex[i] = -1;
+    }
+}
+
+void LoopBenchConsumer::appClientInit()
+{
+    const LOOPBENCH_CONFIG& config = m_bench->config();
+
+    for (int producer = 0; producer < config.producers; producer++) {
+        for (int service = 0; service < config.services; service++) {
+            if (!m_bench->consumerWantsService(m_index, producer, service))
+                continue;
+
+            QString path = SNCUtils::getAppName() + SNC_SERVICEPATH_SEP + LoopBench::serviceName(producer, service);
+            int port = clientAddService(path, SERVICETYPE_MULTICAST, false);
+
+            if (port < 0) {
+                SNCUtils::logError(TAG, QString("Consumer %1 failed to subscribe to %2").arg(m_index).arg(path));
+                return;
+            }
+            m_servicePort[m_serviceCount++] = port;
+        }
+    }
+}
+
+bool LoopBenchConsumer::allServicesActive()
+{
+    for (int i = 0; i < m_serviceCount; i++) {
+        if (!clientIsServiceActive(m_servicePort[i]))
+            return false;
+    }
+    return true;
+}
+
+void LoopBenchConsumer::appClientReceiveMulticast(int servicePort, SNC_EHEAD *message, int length)
+{
+    qint64 now = SNCTrace::now();
+
+    if (length < (int)sizeof(LOOPBENCH_RECORD)) {
+        SNCUtils::logWarn(TAG, QString("Short record %1 on port %2").arg(length).arg(servicePort));
+        clientSendMulticastAck(servicePort);
+        free(message);
+        return;
+    }
+
+    LOOPBENCH_RECORD *record = (LOOPBENCH_RECORD *)(message + 1);
+    qint64 recordIndex = (quint32)SNCUtils::convertUC4ToInt(record->header.recordIndex);
+    qint64 latency = now - SNCUtils::convertUC8ToInt64(record->sendTime);
+
+    // ack first so the producer's window isn't held open by the accounting
+
+    clientSendMulticastAck(servicePort);
+
+    if (m_bench->measuring()) {
+        QMutexLocker locker(&m_statsLock);
+
+        m_latency.add(latency);
+        m_records++;
+        m_bytes += length;
+        if ((m_lastIndex[servicePort] >= 0) && (recordIndex > m_lastIndex[servicePort] + 1))
+            m_lost += recordIndex - m_lastIndex[servicePort] - 1;
+    }
+    m_lastIndex[servicePort] = recordIndex;
+    free(message);
+}
+
+void LoopBenchConsumer::takeStats(LoopBenchHistogram& latency, qint64& records, qint64& bytes, qint64& lost)
+{
+    QMutexLocker locker(&m_statsLock);
+
+    latency.merge(m_latency);
+    records += m_records;
+    bytes += m_bytes;
+    lost += m_lost;
+}
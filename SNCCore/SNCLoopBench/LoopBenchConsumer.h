@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef LOOPBENCHCONSUMER_H
+#define LOOPBENCHCONSUMER_H
+
+#include "SNCEndpoint.h"
+#include "LoopBench.h"
+
+#include <qmutex.h>
+
+//  LoopBenchConsumer subscribes to the services the fan-out assigns it and measures
+//  latency, delivered bytes and record index gaps while the bench is measuring.
+
+class LoopBenchConsumer : public SNCEndpoint
+{
+    Q_OBJECT
+
+public:
+    LoopBenchConsumer(LoopBench *bench, int index);
+
+    bool allServicesActive();                               // true when every subscription is registered
+    int serviceCount() const { return m_serviceCount; }
+
+//  takeStats adds this consumer's results to the totals
+
+    void takeStats(LoopBenchHistogram& latency, qint64& records, qint64& bytes, qint64& lost);
+
+protected:
+    void appClientInit();
+    void appClientReceiveMulticast(int servicePort, SNC_EHEAD *message, int length);
+
+private:
+    LoopBench *m_bench;
+    int m_index;
+    int m_serviceCount;
+    int m_servicePort[SNC_MAX_SERVICESPERCOMPONENT];
+    qint64 m_lastIndex[SNC_MAX_SERVICESPERCOMPONENT];       // last record index seen on each port, -1 if none
+
+    QMutex m_statsLock;
+    LoopBenchHistogram m_latency;
+    qint64 m_records;
+    qint64 m_bytes;
+    qint64 m_lost;                                          // records missing from the index sequence
+};
+
+#endif // LOOPBENCHCONSUMER_H
@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "LoopBenchProducer.h"
+#include "LoopBench.h"
+#include "SNCTrace.h"
+#include "SNCUtils.h"
+
+#define TAG "LoopBenchProducer"
+
+LoopBenchProducer::LoopBenchProducer(LoopBench *bench, int index)
+    : SNCEndpoint(LOOPBENCH_PRODUCER_INTERVAL, TAG)
+{
+    m_bench = bench;
+    m_index = index;
+    m_serviceCount = 0;
+    m_sendInterval = 0;
+    m_sent = 0;
+    m_blocked = 0;
+
+    if (m_bench->config().rate > 0)
+        m_sendInterval = 1000000 / m_bench->config().rate;
+    if ((m_bench->config().rate > 0) && (m_sendInterval == 0))
+        m_sendInterval = 1;
+
+    for (int i = 0; i < SNC_MAX_SERVICESPERCOMPONENT; i++) {
+        m_servicePort[i] = -1;
+        m_nextSend[i] = 0;
+        m_recordIndex[i] = 0;
+    }
+}
+
+void LoopBenchProducer::appClientInit()
+{
+    qint64 now = SNCTrace::now();
+
+    for (int service = 0; service < m_bench->config().services; service++) {
+        int port = clientAddService(LoopBench::serviceName(m_index, service), SERVICETYPE_MULTICAST, true);
+
+        if (port < 0) {
+            SNCUtils::logError(TAG, QString("Producer %1 failed to add service %2").arg(m_index).arg(service));
+            break;
+        }
+        m_servicePort[m_serviceCount] = port;
+
+        // spread the first records of each service across one interval
+
+        m_nextSend[m_serviceCount] = now + (m_sendInterval * service) / m_bench->config().services;
+        m_serviceCount++;
+    }
+}
+
+void LoopBenchProducer::appClientBackground()
+{
+    qint64 now = SNCTrace::now();
+
+    for (int service = 0; service < m_serviceCount; service++) {
+        if (m_sendInterval == 0) {
+            fillWindow(service);
+            continue;
+        }
+
+        if ((now - m_nextSend[service]) > 1000000)
+            m_nextSend[service] = now;                      // don't try to catch up after a stall
+
+        while (now >= m_nextSend[service]) {
+            int port = m_servicePort[service];
+
+            if (clientIsServiceActive(port) && clientClearToSend(port))
+                sendRecord(service);
+            else if (clientIsServiceActive(port))
+                m_blocked.fetchAndAddRelaxed(1);
+            m_nextSend[service] += m_sendInterval;
+        }
+    }
+}
+
+void LoopBenchProducer::appClientReceiveMulticastAck(int servicePort, SNC_EHEAD *message, int)
+{
+    free(message);
+
+    if (m_sendInterval != 0)
+        return;
+
+    // window limited - refill straight away rather than waiting for the next background
+
+    for (int service = 0; service < m_serviceCount; service++) {
+        if (m_servicePort[service] == servicePort) {
+            fillWindow(service);
+            break;
+        }
+    }
+}
+
+void LoopBenchProducer::fillWindow(int service)
+{
+    int port = m_servicePort[service];
+
+    if (!clientIsServiceActive(port))
+        return;
+
+    for (int i = 0; (i < SNC_MAX_WINDOW) && clientClearToSend(port); i++)
+        sendRecord(service);
+}
+
+void LoopBenchProducer::sendRecord(int service)
+{
+    int port = m_servicePort[service];
+    int length = m_bench->config().recordSize;
+    SNC_EHEAD *multiCast = clientBuildMessage(port, length);
+
+    if (multiCast == NULL)
+        return;
+
+    LOOPBENCH_RECORD *record = (LOOPBENCH_RECORD *)(multiCast + 1);
+
+    memset(record, 0, length);
+    SNCUtils::convertIntToUC2(LOOPBENCH_RECORD_TYPE, record->header.type);
+    SNCUtils::convertIntToUC2(sizeof(LOOPBENCH_RECORD), record->header.headerLength);
+    SNCUtils::convertIntToUC4(m_recordIndex[service]++, record->header.recordIndex);
+    SNCUtils::setTimestamp(record->header.timestamp);
+    SNCUtils::convertInt64ToUC8(SNCTrace::now(), record->sendTime);
+
+    if (clientSendMessage(port, multiCast, length, m_bench->config().priority))
+        m_sent.fetchAndAddRelaxed(1);
+}
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef LOOPBENCHPRODUCER_H
+#define LOOPBENCHPRODUCER_H
+
+#include "SNCEndpoint.h"
+
+#include <qatomic.h>
+
+class LoopBench;
+
+//  LoopBenchProducer sources records on its multicast services, either at a fixed rate per
+//  service or as fast as the send/ack window allows.
+
+class LoopBenchProducer : public SNCEndpoint
+{
+    Q_OBJECT
+
+public:
+    LoopBenchProducer(LoopBench *bench, int index);
+
+    qint64 sent() const { return m_sent.loadAcquire(); }    // records sent
+    qint64 blocked() const { return m_blocked.loadAcquire(); } // rate slots lost to a closed window
+
+protected:
+    void appClientInit();
+    void appClientBackground();
+    void appClientReceiveMulticastAck(int servicePort, SNC_EHEAD *message, int length);
+
+private:
+    void sendRecord(int service);
+    void fillWindow(int service);                           // sends until the window closes
+
+    LoopBench *m_bench;
+    int m_index;
+    int m_serviceCount;
+    int m_servicePort[SNC_MAX_SERVICESPERCOMPONENT];
+    qint64 m_nextSend[SNC_MAX_SERVICESPERCOMPONENT];        // next rate slot in us
+    qint64 m_sendInterval;                                  // us between records, 0 if window limited
+    unsigned int m_recordIndex[SNC_MAX_SERVICESPERCOMPONENT];
+
+    QAtomicInteger<qint64> m_sent;
+    QAtomicInteger<qint64> m_blocked;
+};
+
+#endif // LOOPBENCHPRODUCER_H
@@ -0,0 +1,197 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "LoopBench.h"
+#include <QCoreApplication>
+
+#include "SNCUtils.h"
+
+#include <stdio.h>
+
+//  SNCLoopBench starts an SNCServer plus synthetic producers and consumers in one process,
+//  all connected over loopback, and reports throughput, cpu, latency and memory. It exits
+//  with a non-zero code if nothing gets through or the p99 latency limit is exceeded so it
+//  can be run in CI.
+//
+//  Bench options are upper case so they don't clash with the standard ones:
+//
+//  -P<n>   producers (default 1)
+//  -S<n>   multicast services per producer (default 1)
+//  -M<n>   consumers (default 1)
+//  -F<n>   consumers subscribed to each service (default all)
+//  -B<n>   record size in bytes (default 1024)
+//  -R<n>   records per second per service, 0 for window limited (default 0)
+//  -Q<n>   link priority 0 (high) to 3 (low) (default 3)
+//  -W<n>   warm up seconds (default 2)
+//  -T<n>   measured seconds (default 10)
+//  -O<n>   local link port, the static tunnel port is one above (default 16610)
+//  -L<n>   fail if p99 latency exceeds this many us (default no check)
+
+static void usage()
+{
+    printf("Usage: SNCLoopBench [-P<producers>] [-S<services>] [-M<consumers>] [-F<fanout>]\n"
+           "                    [-B<bytes>] [-R<rate>] [-Q<priority>] [-W<secs>] [-T<secs>]\n"
+           "                    [-O<port>] [-L<p99 us>] [standard options]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList standardArgs;
+    LOOPBENCH_CONFIG config;
+    bool ok = true;
+
+    config.producers = 1;
+    config.services = 1;
+    config.consumers = 1;
+    config.fanout = -1;
+    config.recordSize = 1024;
+    config.rate = 0;
+    config.priority = SNCLINK_LOWPRI;
+    config.warmup = 2;
+    config.duration = 10;
+    config.port = LOOPBENCH_DEFAULT_PORT;
+    config.maxP99 = 0;
+
+    standardArgs.append(a.arguments().at(0));
+
+    for (int i = 1; i < a.arguments().count(); i++) {
+        QString opt = a.arguments().at(i);
+        bool valid = true;
+        int value;
+
+        if ((opt.length() < 2) || (opt.at(0) != '-') || !opt.at(1).isUpper()) {
+            standardArgs.append(opt);
+            continue;
+        }
+
+        value = opt.mid(2).toInt(&valid);
+
+        switch (opt.at(1).toLatin1()) {
+        case 'P':
+            config.producers = value;
+            break;
+
+        case 'S':
+            config.services = value;
+            break;
+
+        case 'M':
+            config.consumers = value;
+            break;
+
+        case 'F':
+            config.fanout = value;
+            break;
+
+        case 'B':
+            config.recordSize = value;
+            break;
+
+        case 'R':
+            config.rate = value;
+            break;
+
+        case 'Q':
+            config.priority = value;
+            break;
+
+        case 'W':
+            config.warmup = value;
+            break;
+
+        case 'T':
+            config.duration = value;
+            break;
+
+        case 'O':
+            config.port = value;
+            break;
+
+        case 'L':
+            config.maxP99 = value;
+            break;
+
+        default:
+            valid = false;
+            break;
+        }
+
+        if (!valid) {
+            printf("Invalid option %s\n", qPrintable(opt));
+            ok = false;
+        }
+    }
+
+    if (config.fanout < 0)
+        config.fanout = config.consumers;
+
+    if ((config.producers < 1) || (config.consumers < 1) || (config.warmup < 0) || (config.duration < 1)) {
+        printf("Need at least one producer, one consumer and a duration of at least 1 second\n");
+        ok = false;
+    }
+    if ((config.services < 1) || (config.services >= SNC_MAX_SERVICESPERCOMPONENT)) {
+        printf("Services per producer must be 1 to %d\n", SNC_MAX_SERVICESPERCOMPONENT - 1);
+        ok = false;
+    }
+    if ((config.fanout < 1) || (config.fanout > config.consumers)) {
+        printf("Fan-out must be 1 to the number of consumers\n");
+        ok = false;
+    }
+    if ((config.recordSize < (int)sizeof(LOOPBENCH_RECORD)) || (config.recordSize > SNC_MESSAGE_MAX / 2)) {
+        printf("Record size must be %d to %d\n", (int)sizeof(LOOPBENCH_RECORD), SNC_MESSAGE_MAX / 2);
+        ok = false;
+    }
+    if ((config.rate < 0) || (config.priority < SNCLINK_HIGHPRI) || (config.priority > SNCLINK_LOWPRI)) {
+        printf("Rate must not be negative and priority must be %d to %d\n", SNCLINK_HIGHPRI, SNCLINK_LOWPRI);
+        ok = false;
+    }
+    if ((config.port < 1) || (config.port > 65534)) {
+        printf("Port must be 1 to 65534\n");
+        ok = false;
+    }
+
+    // each consumer takes at most fanout * (services spread over the consumers) subscriptions
+
+    if (ok && (config.fanout * ((config.producers * config.services + config.consumers - 1) / config.consumers)
+               >= SNC_MAX_SERVICESPERCOMPONENT)) {
+        printf("Too many subscriptions per consumer - add consumers or reduce the fan-out\n");
+        ok = false;
+    }
+
+    if (!ok) {
+        usage();
+        return 1;
+    }
+
+    SNCUtils::loadStandardSettings("SNCLoopBench", standardArgs);
+
+    LoopBench *loopBench = new LoopBench(config);
+    loopBench->start();
+
+    int exitCode = a.exec();
+
+    delete loopBench;
+    return exitCode;
+}
@@ -0,0 +1,195 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "CaptureScan.h"
+#include "SNCHello.h"
+#include "SNCTrace.h"
+#include "SNCUtils.h"
+
+#include <qfile.h>
+#include <qregularexpression.h>
+
+CaptureScan::CaptureScan()
+{
+    m_firstTime = -1;
+    m_lastTime = -1;
+}
+
+quint64 CaptureScan::UIDKey(const SNC_UID *UID)
+{
+    quint64 key;
+
+    memcpy(&key, UID, sizeof(quint64));
+    return key;
+}
+
+bool CaptureScan::isReplayable(const SNC_CAPTURE_RECORD *record, const QByteArray& message)
+{
+    const SNC_MESSAGE *header = (const SNC_MESSAGE *)message.constData();
+
+    return (record->direction == SNC_CAPTURE_RX) && (header->cmd == SNCMSG_MULTICAST_MESSAGE) &&
+            (message.length() >= (int)sizeof(SNC_EHEAD));
+}
+
+int CaptureScan::payloadLength(const QByteArray& message)
+{
+    int length = message.length();
+
+    if (SNCTrace::getTrace((SNC_EHEAD *)message.constData(), length) != NULL)
+        length -= sizeof(SNC_TRACE);
+    return length - (int)sizeof(SNC_EHEAD);
+}
+
+int CaptureScan::findStream(const SNC_EHEAD *ehead) const
+{
+    return m_streamIndex.value(qMakePair(UIDKey(&ehead->sourceUID),
+                SNCUtils::convertUC2ToInt((unsigned char *)ehead->sourcePort)), -1);
+}
+
+bool CaptureScan::scan(const QString& path)
+{
+    QFile file(path);
+    SNC_CAPTURE_HEADER header;
+    SNC_CAPTURE_RECORD record;
+    QByteArray message;
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        m_error = QString("Can't open %1").arg(path);
+        return false;
+    }
+    if (!SNCCapture::readHeader(&file, &header)) {
+        m_error = QString("%1 is not a capture file").arg(path);
+        return false;
+    }
+
+    while (SNCCapture::readRecord(&file, &record, message)) {
+        const SNC_MESSAGE *SNCMessage = (const SNC_MESSAGE *)message.constData();
+
+        if ((SNCMessage->cmd == SNCMSG_HEARTBEAT) && (message.length() > (int)sizeof(SNC_HEARTBEAT))) {
+            processDE(message.constData() + sizeof(SNC_HEARTBEAT), message.length() - (int)sizeof(SNC_HEARTBEAT));
+            continue;
+        }
+
+        if (!isReplayable(&record, message))
+            continue;
+
+        const SNC_EHEAD *ehead = (const SNC_EHEAD *)message.constData();
+        int index = findStream(ehead);
+        qint64 time = SNCUtils::convertUC8ToInt64(record.time);
+
+        if (index < 0) {
+            REPLAY_STREAM stream;
+
+            stream.sourceUID = ehead->sourceUID;
+            stream.sourcePort = SNCUtils::convertUC2ToInt((unsigned char *)ehead->sourcePort);
+            stream.records = 0;
+            stream.bytes = 0;
+            index = m_streams.count();
+            m_streams.append(stream);
+            m_streamIndex.insert(qMakePair(UIDKey(&stream.sourceUID), stream.sourcePort), index);
+        }
+        m_streams[index].records++;
+        m_streams[index].bytes += payloadLength(message);
+
+        if (m_firstTime < 0)
+            m_firstTime = time;
+        m_lastTime = time;
+    }
+
+    nameStreams();
+    return true;
+}
+
+//  processDE records the app name and multicast service names of each component in a DE.
+//  The services are listed in port order with NSV or ESV entries filling the other ports.
+
+void CaptureScan::processDE(const char *DE, int length)
+{
+    static QRegularExpression componentRE("<" DETAG_COMP ">(.*?)</" DETAG_COMP ">");
+    static QRegularExpression tagRE("<(" DETAG_UID "|" DETAG_APPNAME "|" DETAG_MSERVICE "|"
+                DETAG_ESERVICE "|" DETAG_NOSERVICE ")>([^<]*)</\\1>");
+
+    QString directory = QString::fromLatin1(DE, (int)qstrnlen(DE, length));
+    QRegularExpressionMatchIterator components = componentRE.globalMatch(directory);
+
+    while (components.hasNext()) {
+        QRegularExpressionMatchIterator tags = tagRE.globalMatch(components.next().captured(1));
+        QString appName;
+        QStringList services;
+        SNC_UIDSTR UIDStr;
+        SNC_UID UID;
+        bool haveUID = false;
+
+        while (tags.hasNext()) {
+            QRegularExpressionMatch tag = tags.next();
+
+            if (tag.captured(1) == DETAG_UID) {
+                strncpy(UIDStr, qPrintable(tag.captured(2)), SNC_UIDSTR_LEN - 1);
+                UIDStr[SNC_UIDSTR_LEN - 1] = 0;
+                SNCUtils::UIDSTRtoUID(UIDStr, &UID);
+                haveUID = true;
+            } else if (tag.captured(1) == DETAG_APPNAME) {
+                appName = tag.captured(2);
+            } else if (tag.captured(1) == DETAG_MSERVICE) {
+                services.append(tag.captured(2));
+            } else {
+                services.append(QString());
+            }
+        }
+
+        if (haveUID) {
+            m_DEAppName.insert(UIDKey(&UID), appName);
+            m_DEServices.insert(UIDKey(&UID), services);
+        }
+    }
+}
+
+//  nameStreams uses the captured service names where possible. If two sources used the same
+//  service name, the app name is added to keep them apart. Streams with no DE are named from
+//  their UID and port.
+
+void CaptureScan::nameStreams()
+{
+    QHash<QString, int> nameCount;
+
+    for (int i = 0; i < m_streams.count(); i++) {
+        REPLAY_STREAM& stream = m_streams[i];
+        quint64 key = UIDKey(&stream.sourceUID);
+
+        stream.appName = m_DEAppName.value(key);
+        stream.serviceName = m_DEServices.value(key).value(stream.sourcePort);
+        if (stream.serviceName.isEmpty())
+            stream.replayName = QString("stream_%1_%2").arg(SNCUtils::displayUID(&stream.sourceUID)).arg(stream.sourcePort);
+        else
+            stream.replayName = stream.serviceName;
+        nameCount[stream.replayName]++;
+    }
+
+    for (int i = 0; i < m_streams.count(); i++) {
+        REPLAY_STREAM& stream = m_streams[i];
+
+        if (nameCount.value(stream.replayName) > 1)
+            stream.replayName = QString("%1_%2").arg(stream.appName.isEmpty() ?
+                        SNCUtils::displayUID(&stream.sourceUID) : stream.appName).arg(stream.replayName);
+    }
+}
@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef CAPTURESCAN_H
+#define CAPTURESCAN_H
+
+#include "SNCCapture.h"
+
+#include <qlist.h>
+#include <qhash.h>
+#include <qstringlist.h>
+
+//  A stream is the multicast traffic from one source service (UID and port) in a capture
+
+typedef struct
+{
+    SNC_UID sourceUID;                                      // the original source
+    int sourcePort;                                         // and its service port
+    QString appName;                                        // the source's app name if a DE was captured
+    QString serviceName;                                    // the service name from the DE or empty
+    QString replayName;                                     // the service name used when replaying
+    qint64 records;                                         // multicast records captured
+    qint64 bytes;                                           // total record bytes (excluding SNC_EHEAD)
+} REPLAY_STREAM;
+
+//  CaptureScan reads a capture file once to find the streams in it and the time span of
+//  the multicast records. Service names come from the DEs in captured heartbeats.
+
+class CaptureScan
+{
+public:
+    CaptureScan();
+
+    bool scan(const QString& path);                         // returns false if the file can't be read
+
+    const QList<REPLAY_STREAM>& streams() const { return m_streams; }
+    int findStream(const SNC_EHEAD *ehead) const;           // returns the stream index or -1
+    qint64 firstTime() const { return m_firstTime; }        // capture time of the first multicast record
+    qint64 lastTime() const { return m_lastTime; }          // and of the last one
+    const QString& error() const { return m_error; }
+
+//  isReplayable returns true for messages that are replayed - received multicast records
+
+    static bool isReplayable(const SNC_CAPTURE_RECORD *record, const QByteArray& message);
+
+//  payloadLength returns the length of the record in a replayable message, without
+//  the SNC_EHEAD or any trace trailer
+
+    static int payloadLength(const QByteArray& message);
+
+private:
+    static quint64 UIDKey(const SNC_UID *UID);
+    void processDE(const char *DE, int length);
+    void nameStreams();
+
+    QList<REPLAY_STREAM> m_streams;
+    QHash<QPair<quint64, int>, int> m_streamIndex;          // (UID, port) to index in m_streams
+    QHash<quint64, QString> m_DEAppName;                    // app names from DEs by UID
+    QHash<quint64, QStringList> m_DEServices;               // multicast service names by port, from DEs
+
+    qint64 m_firstTime;
+    qint64 m_lastTime;
+    QString m_error;
+};
+
+#endif // CAPTURESCAN_H
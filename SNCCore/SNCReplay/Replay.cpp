@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "Replay.h"
+#include "SNCUtils.h"
+
+#include <qcoreapplication.h>
+#include <qtimer.h>
+
+#include <stdio.h>
+
+#define TAG "Replay"
+
+Replay::Replay(const REPLAY_CONFIG& config)
+{
+    m_config = config;
+    m_lastSent = 0;
+    m_lastBytes = 0;
+}
+
+Replay::~Replay()
+{
+}
+
+bool Replay::start()
+{
+    QHash<QString, QList<int> > sources;
+    QStringList sourceOrder;
+
+    if (!m_scan.scan(m_config.path)) {
+        printf("%s\n", qPrintable(m_scan.error()));
+        return false;
+    }
+    if (m_scan.streams().count() == 0) {
+        printf("No multicast streams in %s\n", qPrintable(m_config.path));
+        return false;
+    }
+
+    // group streams by source component if required
+
+    for (int i = 0; i < m_scan.streams().count(); i++) {
+        QString key;
+
+        if (m_config.perSource)
+            key = SNCUtils::displayUID((SNC_UID *)&m_scan.streams().at(i).sourceUID);
+
+        if (!sources.contains(key))
+            sourceOrder.append(key);
+        sources[key].append(i);
+    }
+
+    for (int i = 0; i < sourceOrder.count(); i++)
+        addClients(sources.value(sourceOrder.at(i)));
+
+    printf("Replaying %d streams from %s with %d client(s)\n",
+           m_scan.streams().count(), qPrintable(m_config.path), m_clients.count());
+
+    for (int i = 0; i < m_clients.count(); i++)
+        m_clients.at(i)->resumeThread();
+
+    m_elapsed.start();
+    QTimer *timer = new QTimer(this);
+    connect(timer, SIGNAL(timeout()), this, SLOT(tick()));
+    timer->start(REPLAY_TICK_INTERVAL);
+    return true;
+}
+
+//  addClients creates the clients for a group of streams for each copy, splitting the
+//  group if it has more streams than a component can have services
+
+void Replay::addClients(const QList<int>& streams)
+{
+    int perClient = SNC_MAX_SERVICESPERCOMPONENT - 1;
+
+    for (int copy = 0; copy < m_config.copies; copy++) {
+        for (int first = 0; first < streams.count(); first += perClient)
+            m_clients.append(new ReplayClient(m_config, &m_scan, streams.mid(first, perClient), copy));
+    }
+}
+
+void Replay::listStreams()
+{
+    if (!m_scan.scan(m_config.path)) {
+        printf("%s\n", qPrintable(m_scan.error()));
+        return;
+    }
+
+    printf("%-30s %-20s %-6s %10s %14s\n", "Replay name", "Source UID", "Port", "Records", "Bytes");
+    for (int i = 0; i < m_scan.streams().count(); i++) {
+        const REPLAY_STREAM& stream = m_scan.streams().at(i);
+
+        printf("%-30s %-20s %-6d %10lld %14lld\n", qPrintable(stream.replayName),
+               qPrintable(SNCUtils::displayUID((SNC_UID *)&stream.sourceUID)), stream.sourcePort,
+               stream.records, stream.bytes);
+    }
+    printf("Capture span %.3f seconds\n", (double)(m_scan.lastTime() - m_scan.firstTime()) / 1000000.0);
+}
+
+void Replay::tick()
+{
+    qint64 sent = 0;
+    qint64 bytes = 0;
+    qint64 dropped = 0;
+    qint64 unsubscribed = 0;
+    bool done = true;
+
+    for (int i = 0; i < m_clients.count(); i++) {
+        ReplayClient *client = m_clients.at(i);
+
+        sent += client->sent();
+        bytes += client->bytes();
+        dropped += client->dropped();
+        unsubscribed += client->unsubscribed();
+        if (!client->finished())
+            done = false;
+    }
+
+    printf("%7.1fs  sent %lld (%lld/s, %.2f MB/s)  dropped %lld  unsubscribed %lld\n",
+           (double)m_elapsed.elapsed() / 1000.0, sent, sent - m_lastSent,
+           (double)(bytes - m_lastBytes) / 1000000.0, dropped, unsubscribed);
+    fflush(stdout);
+
+    m_lastSent = sent;
+    m_lastBytes = bytes;
+
+    if (done)
+        shutdown();
+}
+
+void Replay::shutdown()
+{
+    for (int i = 0; i < m_clients.count(); i++)
+        m_clients.at(i)->exitThread();
+    m_clients.clear();
+
+    QTimer::singleShot(REPLAY_SHUTDOWN_WAIT, this, SLOT(exitApp()));
+}
+
+void Replay::exitApp()
+{
+    QCoreApplication::exit(0);
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "ReplayClient.h"
+
+#include <qobject.h>
+#include <qelapsedtimer.h>
+
+#define REPLAY_TICK_INTERVAL            1000                // ms between stats reports
+#define REPLAY_SHUTDOWN_WAIT            1000                // ms allowed for the threads to exit
+
+//  Replay scans the capture, starts the replay clients and reports progress until they
+//  have all finished
+
+class Replay : public QObject
+{
+    Q_OBJECT
+
+public:
+    Replay(const REPLAY_CONFIG& config);
+    ~Replay();
+
+    bool start();                                           // returns false if the capture has nothing to replay
+    void listStreams();
+
+public slots:
+    void tick();
+    void exitApp();
+
+private:
+    void addClients(const QList<int>& streams);
+    void shutdown();
+
+    REPLAY_CONFIG m_config;
+    CaptureScan m_scan;
+    QList<ReplayClient *> m_clients;
+
+    QElapsedTimer m_elapsed;
+    qint64 m_lastSent;
+    qint64 m_lastBytes;
+};
+
+#endif // REPLAY_H
@@ -0,0 +1,177 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "ReplayClient.h"
+#include "SNCTrace.h"
+#include "SNCUtils.h"
+
+#define TAG "ReplayClient"
+
+ReplayClient::ReplayClient(const REPLAY_CONFIG& config, const CaptureScan *scan, const QList<int>& streams, int copy)
+    : SNCEndpoint(REPLAY_BACKGROUND_INTERVAL, TAG)
+{
+    m_config = config;
+    m_scan = scan;
+    m_streams = streams;
+    m_copy = copy;
+    m_messagePort = -1;
+    m_startTime = 0;
+    m_loop = 0;
+    m_finished = 0;
+    m_sent = 0;
+    m_bytes = 0;
+    m_dropped = 0;
+    m_unsubscribed = 0;
+}
+
+void ReplayClient::appClientInit()
+{
+    SNC_CAPTURE_HEADER header;
+
+    for (int i = 0; i < m_streams.count(); i++) {
+        QString name = m_scan->streams().at(m_streams.at(i)).replayName;
+
+        if (m_config.copies > 1)
+            name += QString("_%1").arg(m_copy);
+
+        int port = clientAddService(name, SERVICETYPE_MULTICAST, true);
+
+        if (port < 0) {
+            SNCUtils::logError(TAG, QString("Failed to add service %1").arg(name));
+            continue;
+        }
+        m_servicePort.insert(m_streams.at(i), port);
+    }
+
+    m_file.setFileName(m_config.path);
+    if (!m_file.open(QIODevice::ReadOnly) || !SNCCapture::readHeader(&m_file, &header)) {
+        SNCUtils::logError(TAG, QString("Failed to open capture file %1").arg(m_config.path));
+        m_finished = 1;
+        return;
+    }
+    m_startTime = SNCTrace::now();
+}
+
+void ReplayClient::appClientExit()
+{
+    m_file.close();
+}
+
+void ReplayClient::appClientBackground()
+{
+    replay();
+}
+
+void ReplayClient::appClientReceiveMulticastAck(int, SNC_EHEAD *message, int)
+{
+    free(message);
+
+    if (m_config.speed == 0)
+        replay();                                           // window has opened
+}
+
+//  readNext skips to the next replayable record for one of this client's streams, starting
+//  the next loop at the end of the file if there is one
+
+bool ReplayClient::readNext()
+{
+    SNC_CAPTURE_HEADER header;
+
+    while (true) {
+        if (!SNCCapture::readRecord(&m_file, &m_record, m_message)) {
+            if ((m_config.loops != 0) && (m_loop + 1 >= m_config.loops))
+                return false;
+            m_loop++;
+            m_file.seek(0);
+            if (!SNCCapture::readHeader(&m_file, &header))
+                return false;
+            continue;
+        }
+
+        if (!CaptureScan::isReplayable(&m_record, m_message))
+            continue;
+
+        m_messagePort = m_servicePort.value(m_scan->findStream((const SNC_EHEAD *)m_message.constData()), -1);
+        if (m_messagePort < 0)
+            continue;
+
+        //  a captured trace is stale - the replayed copy is traced afresh if the sampling says so
+
+        m_message.truncate(SNCTrace::removeTrace((SNC_EHEAD *)m_message.data(), m_message.length()));
+        return true;
+    }
+}
+
+//  Loops follow each other with the same gap as the average record interval would give
+
+qint64 ReplayClient::dueTime()
+{
+    qint64 span = m_scan->lastTime() - m_scan->firstTime() + 1;
+    qint64 captureTime = SNCUtils::convertUC8ToInt64(m_record.time) - m_scan->firstTime() + m_loop * span;
+
+    return m_startTime + (qint64)((double)captureTime / m_config.speed);
+}
+
+void ReplayClient::replay()
+{
+    qint64 now = SNCTrace::now();
+
+    if (finished())
+        return;
+
+    for (int count = 0; count < REPLAY_MAX_PER_BACKGROUND; count++) {
+        if ((m_messagePort < 0) && !readNext()) {
+            m_finished = 1;
+            SNCUtils::logInfo(TAG, QString("Replay %1 complete").arg(m_copy));
+            return;
+        }
+
+        if ((m_config.speed > 0) && (now < dueTime()))
+            return;                                         // not time for it yet
+
+        if (!clientIsServiceActive(m_messagePort)) {
+            m_unsubscribed.fetchAndAddRelaxed(1);
+            m_messagePort = -1;
+            continue;
+        }
+
+        if (!clientClearToSend(m_messagePort)) {
+            if (m_config.speed == 0)
+                return;                                     // wait for the ack
+            m_dropped.fetchAndAddRelaxed(1);
+            m_messagePort = -1;
+            continue;
+        }
+
+        int length = m_message.length() - (int)sizeof(SNC_EHEAD);
+        SNC_EHEAD *multiCast = clientBuildMessage(m_messagePort, length);
+
+        memcpy(multiCast + 1, m_message.constData() + sizeof(SNC_EHEAD), length);
+        if (clientSendMessage(m_messagePort, multiCast, length,
+                    ((const SNC_MESSAGE *)m_message.constData())->flags & SNCLINK_PRI)) {
+            m_sent.fetchAndAddRelaxed(1);
+            m_bytes.fetchAndAddRelaxed(length);
+        }
+        m_messagePort = -1;
+    }
+}
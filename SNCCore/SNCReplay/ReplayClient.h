@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef REPLAYCLIENT_H
+#define REPLAYCLIENT_H
+
+#include "SNCEndpoint.h"
+#include "CaptureScan.h"
+
+#include <qfile.h>
+#include <qatomic.h>
+
+#define REPLAY_BACKGROUND_INTERVAL      1                   // ms
+#define REPLAY_MAX_PER_BACKGROUND       1000                // records sent per background call at most
+
+typedef struct
+{
+    QString path;                                           // the capture file
+    double speed;                                           // 1 = as captured, 2 = twice as fast, 0 = as fast as possible
+    int copies;                                             // number of copies of the captured sources
+    int loops;                                              // times to replay the file (0 = forever)
+    bool perSource;                                         // an endpoint for each captured source component
+} REPLAY_CONFIG;
+
+//  ReplayClient re-sources some of the captured streams as local multicast services. It reads
+//  the capture file itself and sends each record at its captured time scaled by the speed.
+//  At timed speeds a record that finds the send window closed is dropped, as a camera would.
+//  At max speed the replay waits for the window instead.
+
+class ReplayClient : public SNCEndpoint
+{
+    Q_OBJECT
+
+public:
+    ReplayClient(const REPLAY_CONFIG& config, const CaptureScan *scan, const QList<int>& streams, int copy);
+
+    bool finished() const { return m_finished.loadAcquire() != 0; }
+    qint64 sent() const { return m_sent.loadAcquire(); }
+    qint64 bytes() const { return m_bytes.loadAcquire(); }
+    qint64 dropped() const { return m_dropped.loadAcquire(); } // window closed at a timed speed
+    qint64 unsubscribed() const { return m_unsubscribed.loadAcquire(); } // no subscribers when due
+
+protected:
+    void appClientInit();
+    void appClientExit();
+    void appClientBackground();
+    void appClientReceiveMulticastAck(int servicePort, SNC_EHEAD *message, int length);
+
+private:
+    void replay();
+    bool readNext();                                        // gets the next record for this client into m_message
+    qint64 dueTime();                                       // when m_message should be sent in SNCTrace::now() terms
+
+    REPLAY_CONFIG m_config;
+    const CaptureScan *m_scan;
+    QList<int> m_streams;                                   // indexes of the streams this client replays
+    int m_copy;
+    QHash<int, int> m_servicePort;                          // stream index to service port
+
+    QFile m_file;
+    SNC_CAPTURE_RECORD m_record;
+    QByteArray m_message;                                   // the pending message
+    int m_messagePort;                                      // and its service port, -1 if none pending
+    qint64 m_startTime;                                     // SNCTrace::now() at the start of the replay
+    int m_loop;                                             // current pass through the file
+
+    QAtomicInt m_finished;
+    QAtomicInteger<qint64> m_sent;
+    QAtomicInteger<qint64> m_bytes;
+    QAtomicInteger<qint64> m_dropped;
+    QAtomicInteger<qint64> m_unsubscribed;
+};
+
+#endif // REPLAYCLIENT_H
@@ -0,0 +1,144 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+#include "Replay.h"
+#include <QCoreApplication>
+
+#include "SNCUtils.h"
+
+#include <stdio.h>
+
+//  SNCReplay re-sources the multicast streams in a capture file written by SNCLink (see the
+//  captureFile setting) as local multicast services, so that load seen in the field can be
+//  reproduced against a test SNCControl. Services are named from the directory entries in
+//  the capture where possible.
+//
+//  Replay options are upper case so they don't clash with the standard ones:
+//
+//  -X<n>   speed - 1 is as captured, 2 twice as fast and so on, 0 as fast as possible (default 1)
+//  -C<n>   copies of the captured sources, services get _<copy> appended if more than 1 (default 1)
+//  -L<n>   times to replay the capture, 0 for forever (default 1)
+//  -E      use a separate endpoint for each captured source component
+//  -V      list the streams in the capture and exit
+
+static void usage()
+{
+    printf("Usage: SNCReplay <capture file> [-X<speed>] [-C<copies>] [-L<loops>] [-E] [-V]\n"
+           "                 [standard options]\n");
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList standardArgs;
+    REPLAY_CONFIG config;
+    bool list = false;
+    bool ok = true;
+
+    config.speed = 1;
+    config.copies = 1;
+    config.loops = 1;
+    config.perSource = false;
+
+    standardArgs.append(a.arguments().at(0));
+
+    for (int i = 1; i < a.arguments().count(); i++) {
+        QString opt = a.arguments().at(i);
+        bool valid = true;
+
+        if ((opt.length() > 0) && (opt.at(0) != '-')) {
+            if (!config.path.isEmpty())
+                valid = false;
+            config.path = opt;
+        } else if ((opt.length() < 2) || !opt.at(1).isUpper()) {
+            standardArgs.append(opt);
+            continue;
+        } else {
+            switch (opt.at(1).toLatin1()) {
+            case 'X':
+                config.speed = opt.mid(2).toDouble(&valid);
+                break;
+
+            case 'C':
+                config.copies = opt.mid(2).toInt(&valid);
+                break;
+
+            case 'L':
+                config.loops = opt.mid(2).toInt(&valid);
+                break;
+
+            case 'E':
+                config.perSource = true;
+                break;
+
+            case 'V':
+                list = true;
+                break;
+
+            default:
+                valid = false;
+                break;
+            }
+        }
+
+        if (!valid) {
+            printf("Invalid option %s\n", qPrintable(opt));
+            ok = false;
+        }
+    }
+
+    if (config.path.isEmpty()) {
+        printf("No capture file given\n");
+        ok = false;
+    }
+    if ((config.speed < 0) || (config.copies < 1) || (config.loops < 0)) {
+        printf("Speed and loops must not be negative and there must be at least one copy\n");
+        ok = false;
+    }
+
+    if (!ok) {
+        usage();
+        return 1;
+    }
+
+    Replay *replay = new Replay(config);
+
+    if (list) {
+        replay->listStreams();
+        delete replay;
+        return 0;
+    }
+
+    SNCUtils::loadStandardSettings("SNCReplay", standardArgs);
+
+    if (!replay->start()) {
+        delete replay;
+        return 1;
+    }
+
+    int exitCode = a.exec();
+
+    delete replay;
+    return exitCode;
+}
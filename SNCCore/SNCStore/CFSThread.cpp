@@ -151,6 +151,10 @@ void CFSThread::CFSProcessMessage(SNCThreadMsg *msg)
     case SNCCFS_TYPE_KEEPALIVE_REQ:
     case SNCCFS_TYPE_READ_INDEX_REQ:
     case SNCCFS_TYPE_WRITE_INDEX_REQ:
+    case SNCCFS_TYPE_READ_TIME_INTERVAL_REQ:
+    case SNCCFS_TYPE_READ_TIME_COUNT_REQ:
+    case SNCCFS_TYPE_READ_INDEX_RANGE_REQ:
+    case SNCCFS_TYPE_READ_MULTI_REQ:
         if (!CFSSanityCheck(message, cfsMsg)) {
             free(message);
             return;
@@ -186,6 +190,16 @@ void CFSThread::CFSProcessMessage(SNCThreadMsg *msg)
     case SNCCFS_TYPE_WRITE_INDEX_REQ:
         CFSWriteIndex(message, cfsMsg);
         break;
+    case SNCCFS_TYPE_READ_TIME_INTERVAL_REQ:
+    case SNCCFS_TYPE_READ_TIME_COUNT_REQ:
+        CFSReadTime(message, cfsMsg);
+        break;
+    case SNCCFS_TYPE_READ_INDEX_RANGE_REQ:
+        CFSReadIndexRange(message, cfsMsg);
+        break;
+    case SNCCFS_TYPE_READ_MULTI_REQ:
+        CFSReadMulti(message, cfsMsg);
+        break;
     }
 }
 
@@ -371,6 +385,57 @@ void CFSThread::CFSWriteIndex(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg)
     scs->agent->cfsWrite(ehead, cfsMsg, scs, requestedIndex);
 }
 
+void CFSThread::CFSReadTime(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg)
+{
+    int handle = SNCUtils::convertUC2ToUInt(cfsMsg->cfsStoreHandle);
+
+    STORECFS_STATE *scs = m_cfsState + handle;
+
+    int length = SNCUtils::convertUC4ToInt(cfsMsg->cfsLength);
+
+    // an absolute timestamp follows the header, otherwise cfsIndex is an offset from the first record
+    if (length == 0) {
+        scs->agent->cfsReadTime(ehead, cfsMsg, scs, (qint64)(unsigned int)SNCUtils::convertUC4ToInt(cfsMsg->cfsIndex), true);
+    } else if (length == (int)sizeof(SNC_UC8)) {
+        scs->agent->cfsReadTime(ehead, cfsMsg, scs, SNCUtils::convertUC8ToInt64(reinterpret_cast<unsigned char *>(cfsMsg + 1)), false);
+    } else {
+        SNCUtils::convertIntToUC2(SNCUtils::convertUC2ToInt(cfsMsg->cfsType) + 1, cfsMsg->cfsType);
+        CFSReturnError(ehead, cfsMsg, SNCCFS_ERROR_INVALID_REQUEST_TYPE);
+    }
+}
+
+void CFSThread::CFSReadIndexRange(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg)
+{
+    int handle = SNCUtils::convertUC2ToUInt(cfsMsg->cfsStoreHandle);
+
+    STORECFS_STATE *scs = m_cfsState + handle;
+
+    unsigned int requestedIndex = SNCUtils::convertUC4ToInt(cfsMsg->cfsIndex);
+
+    scs->agent->cfsReadIndexRange(ehead, cfsMsg, scs, requestedIndex);
+}
+
+void CFSThread::CFSReadMulti(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg)
+{
+    int handle = SNCUtils::convertUC2ToUInt(cfsMsg->cfsStoreHandle);
+
+    STORECFS_STATE *scs = m_cfsState + handle;
+
+    unsigned int requestedIndex = SNCUtils::convertUC4ToInt(cfsMsg->cfsIndex);
+
+    int length = SNCUtils::convertUC4ToInt(cfsMsg->cfsLength);
+
+    // an optional byte limit follows the header
+    if (length == 0) {
+        scs->agent->cfsReadMulti(ehead, cfsMsg, scs, requestedIndex, 0);
+    } else if (length == (int)sizeof(SNC_UC4)) {
+        scs->agent->cfsReadMulti(ehead, cfsMsg, scs, requestedIndex,
+                                 SNCUtils::convertUC4ToInt(reinterpret_cast<unsigned char *>(cfsMsg + 1)));
+    } else {
+        SNCUtils::convertIntToUC2(SNCCFS_TYPE_READ_MULTI_RES, cfsMsg->cfsType);
+        CFSReturnError(ehead, cfsMsg, SNCCFS_ERROR_INVALID_REQUEST_TYPE);
+    }
+}
 
 SNC_EHEAD *CFSThread::CFSBuildResponse(SNC_EHEAD *ehead, SNC_CFSHEADER *, int length)
 {
@@ -100,6 +100,9 @@ private:
     void CFSKeepAlive(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg);
     void CFSReadIndex(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg);
     void CFSWriteIndex(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg);
+    void CFSReadTime(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg);
+    void CFSReadIndexRange(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg);
+    void CFSReadMulti(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg);
 
     SNC_EHEAD *CFSBuildResponse(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, int length);
     bool CFSSanityCheck(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg);
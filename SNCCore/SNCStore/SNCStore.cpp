@@ -77,8 +77,8 @@ void SNCStore::showStatus()
 
 void SNCStore::showCounts()
 {
-    printf("\n\n%-15s %-12s %-16s %s", "Service", "RX records", "RX bytes", "Active File");
-    printf("\n%-15s %-12s %-16s %s", "-------", "----------", "--------", "------------------------");
+    printf("\n\n%-15s %-12s %-16s %-12s %s", "Service", "RX records", "RX bytes", "Dropped", "Active File");
+    printf("\n%-15s %-12s %-16s %-12s %s", "-------", "----------", "--------", "-------", "------------------------");
 
     StoreStream ss;
 
@@ -86,10 +86,11 @@ void SNCStore::showCounts()
         if (!m_storeClient->getStoreStream(i, &ss))
             continue;
 
-        printf("\n%-15s %-12s %-16s %s",
+        printf("\n%-15s %-12s %-16s %-12s %s",
             qPrintable(ss.streamName()),
             qPrintable(QString::number(ss.rxTotalRecords())),
             qPrintable(QString::number(ss.rxTotalBytes())),
+            qPrintable(QString::number(ss.rxDroppedRecords())),
             qPrintable(ss.currentFile()));
     }
     printf("\n");
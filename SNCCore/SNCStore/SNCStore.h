@@ -60,6 +60,18 @@
 #define SNCSTORE_PARAMS_DELETION_TIME_UNITS "deletionTimeUnits"
 #define SNCSTORE_PARAMS_DELETION_TIME   "deletionTime"
 #define SNCSTORE_PARAMS_DELETION_COUNT  "deletionCount"
+#define SNCSTORE_PARAMS_RETENTION_WEIGHT    "retentionWeight" // share of the quota relative to other streams
+#define SNCSTORE_PARAMS_RETENTION_MIN   "retentionMinMB"    // MB of closed files never evicted by the quota
+
+#define SNCSTORE_PARAMS_SYNC_POLICY     "syncPolicy"        // when written data is synced to disk
+#define SNCSTORE_PARAMS_SYNC_INTERVAL   "syncInterval"      // seconds between syncs for the interval policy
+#define SNCSTORE_PARAMS_IO_BACKEND      "ioBackend"         // how stream files are written
+#define SNCSTORE_PARAMS_IO_THREADS      "ioThreads"         // number of threads for the threads backend
+#define SNCSTORE_PARAMS_WORKERS         "storeWorkers"      // threads that flush stream queues
+#define SNCSTORE_PARAMS_FLUSH_KB        "flushKB"           // flush a stream when this much is queued
+#define SNCSTORE_PARAMS_FLUSH_AGE       "flushAge"          // or when its oldest block is this many ms old
+#define SNCSTORE_PARAMS_QUOTA           "quotaMB"           // total MB for all streams (0 = no quota)
+#define SNCSTORE_PARAMS_MIN_FREE        "minFreeMB"         // MB to keep free on the store's disk (0 = no check)
 
 //  magic strings used in the .ini file
 
@@ -76,8 +88,17 @@
 #define SNCSTORE_PARAMS_DELETION_POLICY_COUNT       "count"
 #define SNCSTORE_PARAMS_DELETION_POLICY_ANY         "any"
 
+#define SNCSTORE_PARAMS_SYNC_POLICY_NONE            "none"  // leave it to the OS
+#define SNCSTORE_PARAMS_SYNC_POLICY_FLUSH           "flush" // after every flush of the queue
+#define SNCSTORE_PARAMS_SYNC_POLICY_INTERVAL        "interval" // every syncInterval seconds
+
+#define SNCSTORE_PARAMS_IO_BACKEND_SYNC             "sync"  // each stream's own thread
+#define SNCSTORE_PARAMS_IO_BACKEND_THREADS          "threads" // a shared pool of I/O threads
+#define SNCSTORE_PARAMS_IO_BACKEND_URING            "uring" // io_uring if available, else threads
+
 #define SNCSTORE_PARAMS_DELETION_TIME_DEFAULT       "2"
 #define SNCSTORE_PARAMS_DELETION_COUNT_DEFAULT      "5"
+#define SNCSTORE_PARAMS_SYNC_INTERVAL_DEFAULT       5
 
 
 //  The CFS message
@@ -27,13 +27,20 @@ HEADERS += CFSClient.h \
     DirThread.h \
     StoreClient.h \
     StoreManager.h \
+    StoreWorkerPool.h \
     StoreStream.h \
+    StoreCatalog.h \
+    StoreRetention.h \
     StoreCFS.h \
     StoreCFSRaw.h \
     StoreCFSStructured.h \
     SNCStore.h \
     SNCStoreWindow.h \
     StoreStore.h \
+    StoreBlock.h \
+    StoreFile.h \
+    StoreIO.h \
+    StoreIndexRecovery.h \
     StoreBlocksRaw.h \
     StoreBlocksStructured.h \
     StoreStreamDlg.h \
@@ -46,13 +53,20 @@ SOURCES += CFSClient.cpp \
     main.cpp \
     StoreClient.cpp \
     StoreManager.cpp \
+    StoreWorkerPool.cpp \
     StoreStream.cpp \
+    StoreCatalog.cpp \
+    StoreRetention.cpp \
     StoreCFS.cpp \
     StoreCFSRaw.cpp \
     StoreCFSStructured.cpp \
     SNCStore.cpp \
     SNCStoreWindow.cpp \
     StoreStore.cpp \
+    StoreBlock.cpp \
+    StoreFile.cpp \
+    StoreIO.cpp \
+    StoreIndexRecovery.cpp \
     StoreBlocksRaw.cpp \
     StoreBlocksStructured.cpp \
     StoreStreamDlg.cpp \
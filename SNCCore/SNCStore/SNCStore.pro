@@ -55,6 +55,15 @@ Debug:MOC_DIR = debug/.moc
 Debug:RCC_DIR = debug/.rcc
 Debug:UI_DIR = debug/.ui
 
+linux {
+        packagesExist(liburing) {
+                message(Using io_uring)
+                DEFINES += USE_IO_URING
+                CONFIG += link_pkgconfig
+                PKGCONFIG += liburing
+        }
+}
+
 include(SNCStore.pri)
 include(../../SNCCore/SNCLib/SNCLib.pri)
 include(../../SNCCore/SNCJSON/SNCJSON.pri)
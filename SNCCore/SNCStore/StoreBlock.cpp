@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "SNCUtils.h"
+#include "StoreBlock.h"
+
+StoreBlock::StoreBlock(SNC_EHEAD *message, int length)
+{
+    m_message = message;
+    m_length = length;
+    m_queued = SNCUtils::clock();
+}
+
+StoreBlock::~StoreBlock()
+{
+    free(m_message);
+}
+
+StoreBlockQueue::StoreBlockQueue()
+{
+    m_head = 0;
+    m_tail = 0;
+    m_bytes = 0;
+}
+
+StoreBlockQueue::~StoreBlockQueue()
+{
+    QList<StoreBlock *> blocks;
+
+    dequeueAll(blocks);
+    qDeleteAll(blocks);
+}
+
+//  head and tail run freely (as unsigned so they wrap cleanly) and are masked to index
+//  the ring, so full is when they are STOREBLOCK_QUEUE_SIZE apart
+
+bool StoreBlockQueue::enqueue(StoreBlock *block)
+{
+    unsigned int head = m_head.load();
+
+    if (head - (unsigned int)m_tail.loadAcquire() >= STOREBLOCK_QUEUE_SIZE)
+        return false;
+
+    m_ring[head & (STOREBLOCK_QUEUE_SIZE - 1)] = block;
+    m_bytes.fetchAndAddRelaxed(block->length());
+    m_head.storeRelease((int)(head + 1));
+    return true;
+}
+
+void StoreBlockQueue::dequeueAll(QList<StoreBlock *>& blocks)
+{
+    unsigned int tail = m_tail.load();
+    unsigned int head = m_head.loadAcquire();
+    qint64 bytes = 0;
+
+    for (; tail != head; tail++) {
+        StoreBlock *block = m_ring[tail & (STOREBLOCK_QUEUE_SIZE - 1)];
+
+        blocks.append(block);
+        bytes += block->length();
+    }
+
+    m_bytes.fetchAndSubRelaxed(bytes);
+    m_tail.storeRelease((int)tail);
+}
+
+bool StoreBlockQueue::isEmpty() const
+{
+    return m_head.loadAcquire() == m_tail.loadAcquire();
+}
+
+qint64 StoreBlockQueue::oldest() const
+{
+    unsigned int tail = m_tail.load();
+
+    if ((unsigned int)m_head.loadAcquire() == tail)
+        return -1;
+
+    return m_ring[tail & (STOREBLOCK_QUEUE_SIZE - 1)]->queued();
+}
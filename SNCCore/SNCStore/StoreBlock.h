@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef STOREBLOCK_H
+#define STOREBLOCK_H
+
+#include <qatomic.h>
+#include <qlist.h>
+
+#include "SNCDefs.h"
+
+#define STOREBLOCK_QUEUE_SIZE           128                 // blocks queued per stream, must be a power of 2
+
+//  StoreBlock takes over a received message so the record can be written straight from
+//  the receive buffer. The message is freed when the block is deleted.
+
+class StoreBlock
+{
+public:
+    StoreBlock(SNC_EHEAD *message, int length);             // the record follows the SNC_EHEAD
+    ~StoreBlock();
+
+    const char *data() const { return reinterpret_cast<const char *>(m_message + 1); }
+    int length() const { return m_length; }
+    qint64 queued() const { return m_queued; }              // SNCUtils::clock() when the block was queued
+
+private:
+    SNC_EHEAD *m_message;
+    int m_length;
+    qint64 m_queued;
+};
+
+//  StoreBlockQueue is a lock free single producer, single consumer ring. The producer is
+//  the StoreClient thread. The consumer is whichever worker is flushing the stream - the
+//  worker pool makes sure there is only one at a time.
+
+class StoreBlockQueue
+{
+public:
+    StoreBlockQueue();
+    ~StoreBlockQueue();
+
+    bool enqueue(StoreBlock *block);                        // returns false (and doesn't take the block) if full
+    void dequeueAll(QList<StoreBlock *>& blocks);
+
+    bool isEmpty() const;
+    qint64 bytes() const { return m_bytes.loadAcquire(); }
+    qint64 oldest() const;                                  // queue time of the oldest block, only for the consumer side
+
+private:
+    StoreBlock *m_ring[STOREBLOCK_QUEUE_SIZE];
+    QAtomicInt m_head;                                      // next slot to write, only changed by the producer
+    QAtomicInt m_tail;                                      // next slot to read, only changed by the consumer
+    QAtomicInteger<qint64> m_bytes;
+};
+
+#endif // STOREBLOCK_H
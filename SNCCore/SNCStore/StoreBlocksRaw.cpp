@@ -22,6 +22,7 @@
 //  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <qfile.h>
+#include <qvector.h>
 #include "SNCUtils.h"
 #include "StoreBlocksRaw.h"
 
@@ -34,55 +35,81 @@ StoreBlocksRaw::StoreBlocksRaw(StoreStream *stream)
 
 StoreBlocksRaw::~StoreBlocksRaw()
 {
+    waitForIO();
+    closeFile(m_rawFile);
 }
 
 void StoreBlocksRaw::processQueue()
 {
+    if (ioBusy())
+        return;                                             // never overlap writes, the pool does not schedule a busy store
+
+    if (takeIOFailure())
+        closeFile(m_rawFile);
+
     if (m_stream->needRotation())
         m_stream->doRotation();
 
     writeBlocks();
 }
 
+//  writeBlocks writes the data part of all the queued records with one gathered write.
+//  The file is only reopened when rotation changes its name.
+
 void StoreBlocksRaw::writeBlocks()
 {
     SNC_RECORD_HEADER *record;
+    QList<StoreBlock *> blocks;
+    QVector<struct iovec> iov;
     int headerLen;
 
-    m_blockMutex.lock();
-    int blockCount = m_blocks.count();
-    m_blockMutex.unlock();
+    if (m_blocks.isEmpty())
+        return;
 
-    if (blockCount < 1)
+    if (!openFile(m_rawFile, m_stream->rawFileFullPath()))
         return;
 
-    QString dataFilename = m_stream->rawFileFullPath();
+    takeBlocks(blocks);
 
-    QFile rf(dataFilename);
+    // the request owns the blocks from here on and frees them when the write completes
 
-    if (!rf.open(QIODevice::Append)) {
-        SNCUtils::logWarn(TAG, QString("StoreBlocksRaw::writeBlocks - Failed opening file %1").arg(dataFilename));
-        return;
-    }
+    StoreIORequest *request = new StoreIORequest(this);
+
+    iov.reserve(blocks.count());
+
+    for (int i = 0; i < blocks.count(); i++) {
+        StoreBlock *block = blocks.at(i);
 
-    for (int i = 0; i < blockCount; i++) {
-        m_blockMutex.lock();
-        QByteArray block = m_blocks.dequeue();
-        m_blockMutex.unlock();
+        request->keep(block);
 
-        if (block.length() < (int)sizeof(SNC_RECORD_HEADER))
+        if (block->length() < (int)sizeof(SNC_RECORD_HEADER))
             continue;
 
-        record = reinterpret_cast<SNC_RECORD_HEADER *>(block.data());
+        record = reinterpret_cast<SNC_RECORD_HEADER *>(const_cast<char *>(block->data()));
         headerLen = SNCUtils::convertUC2ToInt(record->headerLength);
 
-        if (headerLen < 0 || headerLen > block.size()) {
+        if (headerLen < 0 || headerLen > block->length()) {
             SNCUtils::logWarn(TAG, QString("StoreBlocksRaw::writeBlocks - invalid header size %1").arg(headerLen));
             continue;
         }
 
-        rf.write((char *)record + headerLen, block.size() - headerLen);
+        if (headerLen == block->length())
+            continue;
+
+        iov.append(iovec());
+        iov.last().iov_base = (void *)(block->data() + headerLen);
+        iov.last().iov_len = block->length() - headerLen;
     }
 
-    rf.close();
+    if (iov.count() == 0) {
+        delete request;
+        return;
+    }
+
+    request->addWrite(&m_rawFile, iov.constData(), iov.count());
+
+    if (syncDue())
+        request->addSync(&m_rawFile);
+
+    submitRequest(request);
 }
@@ -36,6 +36,8 @@ public:
 
 private:
     void writeBlocks();
+
+    StoreFile m_rawFile;                                    // open across flushes
 };
 
 #endif // STOREBLOCKSRAW_H
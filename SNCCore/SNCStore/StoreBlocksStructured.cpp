@@ -22,89 +22,159 @@
 //  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <qfile.h>
+#include <qvector.h>
 #include "SNCUtils.h"
 #include "StoreBlocksStructured.h"
+#include "StoreIndexRecovery.h"
+
+#define TAG "StoreBlocksStructured"
 
 StoreBlocksStructured::StoreBlocksStructured(StoreStream *stream)
     : StoreStore(stream)
 {
+    m_recovered = false;
 }
 
 StoreBlocksStructured::~StoreBlocksStructured()
 {
+    waitForIO();
+    closeFile(m_indexFile);
+    closeFile(m_dataFile);
 }
 
 void StoreBlocksStructured::processQueue()
 {
+    if (ioBusy())
+        return;                                             // never overlap writes, the pool does not schedule a busy store
+
+    if (takeIOFailure()) {
+        closeFile(m_indexFile);
+        closeFile(m_dataFile);
+    }
+
+    if (!m_recovered) {
+        recoverFiles();
+        m_recovered = true;
+    }
+
     if (m_stream->needRotation())
         m_stream->doRotation();
 
     writeBlocks();
 }
 
-void StoreBlocksStructured::writeBlocks()
+//  recoverFiles repairs the stream's existing files before anything is appended. A crash
+//  can leave an index that doesn't match its data file and, with daily rotation, the
+//  current file can be one that was being written at the time.
+
+void StoreBlocksStructured::recoverFiles()
 {
-    SNC_RECORD_HEADER *record;
-    SNC_STORE_RECORD_HEADER storeRecHeader;
-    qint64 pos, headerLength, timestamp;
-    QList<qint64> posList;
-    QList<qint64> timestampList;
+    STORE_RECOVERY_RESULT result;
+    QStringList files = m_stream->srfFileList();
 
-    m_blockMutex.lock();
-    int blockCount = m_blocks.count();
-    m_blockMutex.unlock();
+    for (int i = 0; i < files.count(); i++) {
+        if (StoreFile::inUse(files.at(i))) {
+            SNCUtils::logWarn(TAG, QString("Not recovering %1 as it is in use").arg(files.at(i)));
+            continue;
+        }
 
-    if (blockCount < 1)
-        return;
+        if (!StoreIndexRecovery::check(files.at(i), true, &result)) {
+            SNCUtils::logWarn(TAG, result.error);
+            continue;
+        }
+
+        if (result.repaired)
+            SNCUtils::logInfo(TAG, QString("Recovered %1: kept %2 of %3 index entries, rebuilt %4, skipped %5 corrupt bytes, truncated %6 bytes")
+                    .arg(files.at(i)).arg(result.validEntries).arg(result.indexEntries)
+                    .arg(result.rebuiltEntries).arg(result.skippedBytes).arg(result.dataSize - result.validDataSize));
+    }
+}
 
-    QString dataFilename = m_stream->srfFileFullPath();
-    QString indexFilename = m_stream->srfIndexFullPath();
+//  writeBlocks writes all the queued records, each preceded by its store header, with
+//  one gathered write and then appends their index entries with another. The files
+//  are only reopened when rotation changes the file names. The index write is in the
+//  same request after the data so it is dropped if the data write fails.
 
-    QFile dataFile(dataFilename);
+void StoreBlocksStructured::writeBlocks()
+{
+    SNC_RECORD_HEADER *record;
+    SNC_STORE_RECORD_HEADER *storeRecHeader;
+    QList<StoreBlock *> blocks;
+    qint64 pos, timestamp;
 
-    if (!dataFile.open(QIODevice::Append))
+    if (m_blocks.isEmpty())
         return;
 
-    QFile indexFile(indexFilename);
+    if (!openFile(m_dataFile, m_stream->srfFileFullPath()))
+        return;
 
-    if (!indexFile.open(QIODevice::Append)) {
-        dataFile.close();
+    if (!openFile(m_indexFile, m_stream->srfIndexFullPath())) {
+        closeFile(m_dataFile);
         return;
     }
 
-    strncpy(storeRecHeader.sync, SYNC_STRINGV0, SYNC_LENGTH);
-    SNCUtils::convertIntToUC4(0, storeRecHeader.data);
+    takeBlocks(blocks);
+
+    // the request owns the blocks from here on and frees them when the writes complete
+
+    StoreIORequest *request = new StoreIORequest(this);
+    QByteArray headers(blocks.count() * sizeof(SNC_STORE_RECORD_HEADER), 0);
+    QByteArray index;
+    QVector<struct iovec> iov;
+
+    iov.reserve(2 * blocks.count());
+    index.reserve(blocks.count() * 2 * sizeof(qint64));
+
+    pos = m_dataFile.pos();
 
-    for (int i = 0; i < blockCount; i++) {
-        m_blockMutex.lock();
-        QByteArray block = m_blocks.dequeue();
-        m_blockMutex.unlock();
+    for (int i = 0; i < blocks.count(); i++) {
+        StoreBlock *block = blocks.at(i);
 
-        if (block.length() < (int)sizeof(SNC_RECORD_HEADER))
+        request->keep(block);
+
+        if (block->length() < (int)sizeof(SNC_RECORD_HEADER))
             continue;
 
-        SNCUtils::convertIntToUC4(block.size(), storeRecHeader.size);
+        storeRecHeader = reinterpret_cast<SNC_STORE_RECORD_HEADER *>(headers.data()) + i;
+        strncpy(storeRecHeader->sync, SYNC_STRINGV0, SYNC_LENGTH);
+        SNCUtils::convertIntToUC4(0, storeRecHeader->data);
+        SNCUtils::convertIntToUC4(block->length(), storeRecHeader->size);
+
+        record = reinterpret_cast<SNC_RECORD_HEADER *>(const_cast<char *>(block->data()));
+        timestamp = SNCUtils::convertUC8ToInt64(record->timestamp);
 
-        record = reinterpret_cast<SNC_RECORD_HEADER *>(block.data());
+        iov.append(iovec());
+        iov.last().iov_base = storeRecHeader;
+        iov.last().iov_len = sizeof(SNC_STORE_RECORD_HEADER);
+        iov.append(iovec());
+        iov.last().iov_base = (void *)block->data();
+        iov.last().iov_len = block->length();
 
-        dataFile.write((char *)(&storeRecHeader), sizeof(SNC_STORE_RECORD_HEADER));
-        headerLength = (qint64)sizeof(SNC_STORE_RECORD_HEADER);
+        index.append((const char *)&pos, sizeof(qint64));
+        index.append((const char *)&timestamp, sizeof(qint64));
 
-        pos = dataFile.pos();
-        pos -= headerLength;
+        pos += sizeof(SNC_STORE_RECORD_HEADER) + block->length();
+    }
 
-        dataFile.write((char *)record, block.size());
-        posList.append(pos);
-        timestampList.append(SNCUtils::convertUC8ToInt64(record->timestamp));
+    if (iov.count() == 0) {
+        delete request;
+        return;
     }
 
-    for (int i = 0; i < posList.count(); i++) {
-        pos = posList[i];
-        timestamp = timestampList[i];
-        indexFile.write((char *)&pos, sizeof(qint64));
-        indexFile.write((char *)&timestamp, sizeof(qint64));
+    request->keep(headers);
+    request->keep(index);
+    request->addWrite(&m_dataFile, iov.constData(), iov.count());
+
+    struct iovec indexIov;
+
+    indexIov.iov_base = (void *)index.constData();
+    indexIov.iov_len = index.length();
+    request->addWrite(&m_indexFile, &indexIov, 1);
+
+    if (syncDue()) {
+        request->addSync(&m_dataFile);
+        request->addSync(&m_indexFile);
     }
 
-    indexFile.close();
-    dataFile.close();
+    submitRequest(request);
 }
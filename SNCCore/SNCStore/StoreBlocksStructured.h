@@ -36,6 +36,12 @@ public:
 
 private:
     void writeBlocks();
+    void recoverFiles();
+
+    bool m_recovered;                                       // true once existing files have been checked
+
+    StoreFile m_dataFile;                                   // the .srf file, open across flushes
+    StoreFile m_indexFile;                                  // and its .srx index
 };
 
 #endif // STOREBLOCKSSTRUCTURED_H
@@ -24,15 +24,18 @@
 #include "CFSClient.h"
 #include "SNCCFSDefs.h"
 #include "StoreCFS.h"
+#include "StoreFile.h"
 
 
 StoreCFS::StoreCFS(CFSClient *client, QString filePath)
     : m_parent(client), m_filePath(filePath)
 {
+    StoreFile::addUser(m_filePath);
 }
 
 StoreCFS::~StoreCFS()
 {
+    StoreFile::removeUser(m_filePath);
 }
 
 bool StoreCFS::cfsOpen(SNC_CFSHEADER *)
@@ -56,6 +59,25 @@ void StoreCFS::cfsWrite(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE
     cfsReturnError(ehead, cfsMsg, SNCCFS_ERROR_INVALID_REQUEST_TYPE);
 }
 
+void StoreCFS::cfsReadTime(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *, qint64, bool)
+{
+    // the response type always follows the request type
+    SNCUtils::convertIntToUC2(SNCUtils::convertUC2ToInt(cfsMsg->cfsType) + 1, cfsMsg->cfsType);
+    cfsReturnError(ehead, cfsMsg, SNCCFS_ERROR_INVALID_REQUEST_TYPE);
+}
+
+void StoreCFS::cfsReadIndexRange(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *, unsigned int)
+{
+    SNCUtils::convertIntToUC2(SNCCFS_TYPE_READ_INDEX_RANGE_RES, cfsMsg->cfsType);
+    cfsReturnError(ehead, cfsMsg, SNCCFS_ERROR_INVALID_REQUEST_TYPE);
+}
+
+void StoreCFS::cfsReadMulti(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *, unsigned int, int)
+{
+    SNCUtils::convertIntToUC2(SNCCFS_TYPE_READ_MULTI_RES, cfsMsg->cfsType);
+    cfsReturnError(ehead, cfsMsg, SNCCFS_ERROR_INVALID_REQUEST_TYPE);
+}
+
 
 unsigned int StoreCFS::cfsGetRecordCount()
 {
@@ -78,6 +100,11 @@ SNC_EHEAD *StoreCFS::cfsBuildResponse(SNC_EHEAD *ehead, int length)
     return responseE2E;
 }
 
+SNC_EHEAD *StoreCFS::cfsGrowResponse(SNC_EHEAD *responseE2E, int length)
+{
+    return reinterpret_cast<SNC_EHEAD *>(realloc(responseE2E, sizeof(SNC_EHEAD) + sizeof(SNC_CFSHEADER) + length));
+}
+
 void StoreCFS::cfsReturnError(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, int responseCode)
 {
     SNCUtils::swapEHead(ehead);
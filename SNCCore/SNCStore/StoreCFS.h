@@ -41,10 +41,14 @@ public:
     virtual void cfsClose();
     virtual void cfsRead(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex);
     virtual void cfsWrite(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex);
+    virtual void cfsReadTime(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, qint64 requestedTime, bool isOffset);
+    virtual void cfsReadIndexRange(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex);
+    virtual void cfsReadMulti(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex, int maxBytes);
 
     virtual unsigned int cfsGetRecordCount();
 
     SNC_EHEAD *cfsBuildResponse(SNC_EHEAD *ehead, int length);
+    SNC_EHEAD *cfsGrowResponse(SNC_EHEAD *responseE2E, int length); // resizes a built response for length data bytes
 
     void cfsReturnError(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, int responseCode);
 
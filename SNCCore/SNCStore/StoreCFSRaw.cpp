@@ -79,21 +79,22 @@ void StoreCFSRaw::cfsRead(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STAT
     }
 
     length = m_blockSize * SNCUtils::convertUC2ToInt(cfsMsg->cfsParam);
+
+    // adjust for EOF if necessary so that a short read at the end is sized from what is there
+    if (((qint64)length + bpos) > m_fileLength)
+        length = m_fileLength - bpos;
+
     scs->txBytes += length;
 
     if (length == 0)
         goto sendResponse;
 
-    if (length > (SNC_MESSAGE_MAX - (int)sizeof(SNC_EHEAD) - (int)sizeof(SNC_CFSHEADER))) {
+    if (length > (SNC_MESSAGE_MAX_LENGTH - (int)sizeof(SNC_EHEAD) - (int)sizeof(SNC_CFSHEADER))) {
         responseCode = SNCCFS_ERROR_TRANSFER_TOO_LONG;
         ff.close();
         goto sendResponse;
     }
 
-    // adjust for EOF if necessary
-    if (((qint64)length + bpos) > m_fileLength)
-        length = m_fileLength - bpos;
-
     qDebug() << "Length: " << length;
     responseE2E = cfsBuildResponse(ehead, length);
 
@@ -22,9 +22,11 @@
 //  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <qfile.h>
+#include <qfileinfo.h>
 
 #include "CFSClient.h"
 #include "StoreCFSStructured.h"
+#include "StoreStream.h"
 
 StoreCFSStructured::StoreCFSStructured(CFSClient *client, QString filePath)
     : StoreCFS(client, filePath)
@@ -45,10 +47,398 @@ bool StoreCFSStructured::cfsOpen(SNC_CFSHEADER *)
 }
 
 void StoreCFSStructured::cfsRead(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex)
+{
+    sendRecord(ehead, cfsMsg, scs, requestedIndex, SNCCFS_TYPE_READ_INDEX_RES, SNCCFS_SUCCESS, true);
+}
+
+void StoreCFSStructured::cfsReadTime(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, qint64 requestedTime, bool isOffset)
+{
+    unsigned int index = 0;
+    qint64 recordTime = 0;
+    int cfsType = SNCUtils::convertUC2ToInt(cfsMsg->cfsType);
+    int param = SNCUtils::convertUC2ToInt(cfsMsg->cfsParam);
+    bool sendData = true;
+
+    int responseCode = findTime(requestedTime, isOffset, index, recordTime);
+
+    // an absolute time after this file, or before its first record, may be in another of the
+    // stream's files. The stream's catalogue says which one.
+
+    if (!isOffset && ((responseCode == SNCCFS_ERROR_TIME_NOT_FOUND) ||
+            ((responseCode == SNCCFS_SUCCESS) && (index == 0) && (recordTime > requestedTime)))) {
+        QString otherFile = QFileInfo(StoreStream::streamFileForTime(m_filePath, requestedTime)).fileName();
+
+        if (!otherFile.isEmpty() && (otherFile != QFileInfo(m_filePath).fileName())) {
+            sendOtherFile(ehead, cfsMsg, cfsType + 1, otherFile);
+            return;
+        }
+    }
+
+    if (cfsType == SNCCFS_TYPE_READ_TIME_INTERVAL_REQ) {
+        // the record has to lie within the interval if one was given
+        if ((responseCode == SNCCFS_SUCCESS) && (param != 0) && (recordTime - requestedTime > param))
+            responseCode = SNCCFS_ERROR_TIME_NOT_FOUND;
+    } else {
+        // a count of zero is just a seek
+        sendData = param != 0;
+    }
+
+    sendRecord(ehead, cfsMsg, scs, index, cfsType + 1, responseCode, sendData);
+}
+
+//  cfsReadIndexRange returns as many index entries as will fit in a message starting at
+//  requestedIndex. If cfsParam is non-zero, only the first entry in each interval of
+//  cfsParam seconds is returned so that a long file can be summarized in a single response.
+//  The returned next index is then always the first record of an interval.
+
+void StoreCFSStructured::cfsReadIndexRange(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex)
+{
+    int responseCode = SNCCFS_SUCCESS;
+    SNC_CFSHEADER *responseHdr = NULL;
+    SNC_EHEAD *responseE2E = NULL;
+    SNC_CFSRANGEENTRY *entry = NULL;
+    unsigned int count = 0;
+    unsigned int nextIndex = requestedIndex;
+    int maxEntries = 0;
+    int entryCount = 0;
+    int length = 0;
+    qint64 interval = (qint64)SNCUtils::convertUC2ToInt(cfsMsg->cfsParam) * 1000;
+    qint64 lastBucket = -1;
+    qint64 buffer[2 * STORE_CFS_RANGE_READ_ENTRIES];
+
+    QFile xf(m_indexPath);
+
+    if (!xf.open(QIODevice::ReadOnly)) {
+        responseCode = SNCCFS_ERROR_INDEX_FILE_NOT_FOUND;
+        goto sendResponse;
+    }
+
+    count = (unsigned int)(xf.size() / STORE_CFS_INDEX_ENTRY_SIZE);
+
+    if (requestedIndex > count) {
+        responseCode = SNCCFS_ERROR_INVALID_RECORD_INDEX;
+        goto sendResponse;
+    }
+
+    if (!xf.seek((qint64)requestedIndex * STORE_CFS_INDEX_ENTRY_SIZE)) {
+        responseCode = SNCCFS_ERROR_INDEX_SEEK;
+        goto sendResponse;
+    }
+
+    // decimation can only reduce the number of entries so this is an upper bound
+    maxEntries = (SNC_MESSAGE_MAX_LENGTH - (int)sizeof(SNC_EHEAD) - (int)sizeof(SNC_CFSHEADER)) / (int)sizeof(SNC_CFSRANGEENTRY);
+
+    if ((unsigned int)maxEntries > count - requestedIndex)
+        maxEntries = count - requestedIndex;
+
+    responseE2E = cfsBuildResponse(ehead, maxEntries * sizeof(SNC_CFSRANGEENTRY));
+    responseHdr = reinterpret_cast<SNC_CFSHEADER *>(responseE2E + 1);
+    entry = reinterpret_cast<SNC_CFSRANGEENTRY *>(responseHdr + 1);
+
+    while ((nextIndex < count) && (entryCount < maxEntries)) {
+        int readCount = qMin(count - nextIndex, (unsigned int)STORE_CFS_RANGE_READ_ENTRIES);
+        int readLength = readCount * STORE_CFS_INDEX_ENTRY_SIZE;
+
+        if (xf.read((char *)buffer, readLength) != readLength) {
+            responseCode = SNCCFS_ERROR_READING_INDEX_FILE;
+            break;
+        }
+
+        int i;
+
+        for (i = 0; (i < readCount) && (entryCount < maxEntries); i++) {
+            qint64 timestamp = buffer[2 * i + 1];
+
+            if (interval > 0) {
+                qint64 bucket = timestamp / interval;
+
+                if (bucket == lastBucket)
+                    continue;
+
+                lastBucket = bucket;
+            }
+
+            SNCUtils::convertIntToUC4(nextIndex + i, entry->cfsRecordIndex);
+            SNCUtils::convertInt64ToUC8(timestamp, entry->cfsTimestamp);
+            entry++;
+            entryCount++;
+        }
+
+        nextIndex += i;
+    }
+
+    // a full response can stop part way through a bucket. nextIndex skips the rest of it so
+    // that the next request starts with a new bucket rather than repeating this one.
+
+    if ((responseCode == SNCCFS_SUCCESS) && (interval > 0) && (entryCount == maxEntries) && (nextIndex < count)) {
+        if (!xf.seek((qint64)nextIndex * STORE_CFS_INDEX_ENTRY_SIZE))
+            responseCode = SNCCFS_ERROR_INDEX_SEEK;
+
+        while ((responseCode == SNCCFS_SUCCESS) && (nextIndex < count)) {
+            int readCount = qMin(count - nextIndex, (unsigned int)STORE_CFS_RANGE_READ_ENTRIES);
+            int readLength = readCount * STORE_CFS_INDEX_ENTRY_SIZE;
+
+            if (xf.read((char *)buffer, readLength) != readLength) {
+                responseCode = SNCCFS_ERROR_READING_INDEX_FILE;
+                break;
+            }
+
+            int i;
+
+            for (i = 0; (i < readCount) && ((buffer[2 * i + 1] / interval) == lastBucket); i++)
+                ;
+
+            nextIndex += i;
+
+            if (i < readCount)
+                break;
+        }
+    }
+
+    length = entryCount * sizeof(SNC_CFSRANGEENTRY);
+    scs->txBytes += length;
+
+sendResponse:
+
+    if (responseE2E == NULL) {
+        responseE2E = cfsBuildResponse(ehead, 0);
+        responseHdr = reinterpret_cast<SNC_CFSHEADER *>(responseE2E + 1);
+    }
+
+    if (responseCode != SNCCFS_SUCCESS)
+        length = 0;
+
+    SNCUtils::convertIntToUC2(SNCCFS_TYPE_READ_INDEX_RANGE_RES, responseHdr->cfsType);
+    SNCUtils::convertIntToUC2(responseCode, responseHdr->cfsParam);
+    SNCUtils::convertIntToUC4(nextIndex, responseHdr->cfsIndex);
+    SNCUtils::convertIntToUC4(length, responseHdr->cfsLength);
+    memcpy(responseHdr->cfsClientHandle, cfsMsg->cfsClientHandle, sizeof(SNC_UC2));
+
+    int totalLength = sizeof(SNC_CFSHEADER) + length;
+    m_parent->sendMessage(responseE2E, totalLength);
+
+#ifdef CFS_THREAD_TRACE
+    TRACE2("Sent index range to %s, length %d", qPrintable(SNCUtils::displayUID(&ehead->sourceUID)), totalLength);
+#endif
+
+    free(ehead);
+}
+
+//  cfsReadMulti returns up to cfsParam consecutive records starting at requestedIndex in one
+//  response, limited by maxBytes (if non-zero) and the maximum message size. Each record is
+//  preceded by its length. Consecutive records are normally contiguous in the record file so
+//  this turns into one sequential read.
+
+void StoreCFSStructured::cfsReadMulti(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex, int maxBytes)
+{
+    SNC_STORE_RECORD_HEADER cHead;
+    int responseCode = SNCCFS_SUCCESS;
+    SNC_CFSHEADER *responseHdr = NULL;
+    SNC_EHEAD *responseE2E = NULL;
+    unsigned char *data = NULL;
+    unsigned int count = 0;
+    int recordCount = 0;
+    int readCount = 0;
+    int length = 0;
+    int capacity = 0;
+    int maxLength = SNC_MESSAGE_MAX_LENGTH - (int)sizeof(SNC_EHEAD) - (int)sizeof(SNC_CFSHEADER);
+    qint64 buffer[2 * STORE_CFS_RANGE_READ_ENTRIES];
+
+    QFile xf(m_indexPath);
+    QFile rf(m_filePath);
+
+    if ((maxBytes > 0) && (maxBytes < maxLength))
+        maxLength = maxBytes;
+
+    recordCount = SNCUtils::convertUC2ToInt(cfsMsg->cfsParam);
+
+    if (recordCount <= 0)
+        recordCount = 1;
+
+    if (!xf.open(QIODevice::ReadOnly)) {
+        responseCode = SNCCFS_ERROR_INDEX_FILE_NOT_FOUND;
+        goto sendResponse;
+    }
+
+    count = (unsigned int)(xf.size() / STORE_CFS_INDEX_ENTRY_SIZE);
+
+    if (requestedIndex >= count) {
+        responseCode = SNCCFS_ERROR_INVALID_RECORD_INDEX;
+        goto sendResponse;
+    }
+
+    readCount = qMin(qMin(count - requestedIndex, (unsigned int)recordCount), (unsigned int)STORE_CFS_RANGE_READ_ENTRIES);
+
+    if (!xf.seek((qint64)requestedIndex * STORE_CFS_INDEX_ENTRY_SIZE)) {
+        responseCode = SNCCFS_ERROR_INDEX_SEEK;
+        goto sendResponse;
+    }
+
+    if (xf.read((char *)buffer, readCount * STORE_CFS_INDEX_ENTRY_SIZE) != (qint64)(readCount * STORE_CFS_INDEX_ENTRY_SIZE)) {
+        responseCode = SNCCFS_ERROR_READING_INDEX_FILE;
+        goto sendResponse;
+    }
+
+    xf.close();
+
+    if (!rf.open(QIODevice::ReadOnly)) {
+        responseCode = SNCCFS_ERROR_FILE_NOT_FOUND;
+        goto sendResponse;
+    }
+
+    for (int i = 0; i < readCount; i++) {
+        qint64 rpos = buffer[2 * i];
+
+        // only seek if the record isn't the next one in the file
+        if ((rf.pos() != rpos) && !rf.seek(rpos)) {
+            responseCode = SNCCFS_ERROR_RECORD_SEEK;
+            break;
+        }
+
+        if (rf.read((char *)&cHead, sizeof(SNC_STORE_RECORD_HEADER)) != sizeof(SNC_STORE_RECORD_HEADER)) {
+            responseCode = SNCCFS_ERROR_RECORD_READ;
+            break;
+        }
+
+        if (strncmp(SYNC_STRINGV0, cHead.sync, SYNC_LENGTH) != 0) {
+            responseCode = SNCCFS_ERROR_INVALID_HEADER;
+            break;
+        }
+
+        int recordLength = SNCUtils::convertUC4ToInt(cHead.size);
+
+        if (recordLength < 0) {
+            responseCode = SNCCFS_ERROR_INVALID_HEADER;
+            break;
+        }
+
+        if ((length + (int)sizeof(SNC_UC4) + recordLength) > maxLength) {
+            // always return at least one record if it fits in a message
+            if (i == 0)
+                responseCode = SNCCFS_ERROR_TRANSFER_TOO_LONG;
+            break;
+        }
+
+        // size the response from the records actually read. The first guess assumes the rest
+        // are like the first one, after that it doubles up to the message limit.
+
+        if ((length + (int)sizeof(SNC_UC4) + recordLength) > capacity) {
+            if (responseE2E == NULL) {
+                capacity = (int)qMin((qint64)maxLength, (qint64)(sizeof(SNC_UC4) + recordLength) * readCount);
+                responseE2E = cfsBuildResponse(ehead, capacity);
+            } else {
+                capacity = qMin(maxLength, qMax(length + (int)sizeof(SNC_UC4) + recordLength, 2 * capacity));
+                responseE2E = cfsGrowResponse(responseE2E, capacity);
+            }
+            responseHdr = reinterpret_cast<SNC_CFSHEADER *>(responseE2E + 1);
+            data = reinterpret_cast<unsigned char *>(responseHdr + 1);
+        }
+
+        SNCUtils::convertIntToUC4(recordLength, data + length);
+
+        if (rf.read((char *)(data + length + sizeof(SNC_UC4)), recordLength) != recordLength) {
+            responseCode = SNCCFS_ERROR_RECORD_READ;
+            break;
+        }
+
+        length += sizeof(SNC_UC4) + recordLength;
+    }
+
+    // return what was read before an error
+    if ((responseCode != SNCCFS_SUCCESS) && (length > 0))
+        responseCode = SNCCFS_SUCCESS;
+
+    scs->txBytes += length;
+
+sendResponse:
+
+    if (responseE2E == NULL) {
+        responseE2E = cfsBuildResponse(ehead, 0);
+        responseHdr = reinterpret_cast<SNC_CFSHEADER *>(responseE2E + 1);
+    }
+
+    if (responseCode != SNCCFS_SUCCESS)
+        length = 0;
+
+    SNCUtils::convertIntToUC2(SNCCFS_TYPE_READ_MULTI_RES, responseHdr->cfsType);
+    SNCUtils::convertIntToUC2(responseCode, responseHdr->cfsParam);
+    SNCUtils::convertIntToUC4(requestedIndex, responseHdr->cfsIndex);
+    SNCUtils::convertIntToUC4(length, responseHdr->cfsLength);
+    memcpy(responseHdr->cfsClientHandle, cfsMsg->cfsClientHandle, sizeof(SNC_UC2));
+
+    int totalLength = sizeof(SNC_CFSHEADER) + length;
+    m_parent->sendMessage(responseE2E, totalLength);
+
+#ifdef CFS_THREAD_TRACE
+    TRACE2("Sent records to %s, length %d", qPrintable(SNCUtils::displayUID(&ehead->sourceUID)), totalLength);
+#endif
+
+    free(ehead);
+}
+
+//  findTime does a binary search of the index file for the first record with a
+//  timestamp at or after requestedTime. The index is in record order and so in time order.
+//  If isOffset is true, requestedTime is converted from an offset from the first record
+//  to an absolute time which is passed back in requestedTime.
+
+int StoreCFSStructured::findTime(qint64& requestedTime, bool isOffset, unsigned int& index, qint64& recordTime)
+{
+    QFile xf(m_indexPath);
+
+    if (!xf.open(QIODevice::ReadOnly))
+        return SNCCFS_ERROR_INDEX_FILE_NOT_FOUND;
+
+    unsigned int count = (unsigned int)(xf.size() / STORE_CFS_INDEX_ENTRY_SIZE);
+
+    if (count == 0)
+        return SNCCFS_ERROR_TIME_NOT_FOUND;
+
+    if (isOffset) {
+        if (!readTimestamp(xf, 0, recordTime))
+            return SNCCFS_ERROR_READING_INDEX_FILE;
+
+        requestedTime += recordTime;
+    }
+
+    unsigned int low = 0;
+    unsigned int high = count;
+
+    while (low < high) {
+        unsigned int mid = low + (high - low) / 2;
+
+        if (!readTimestamp(xf, mid, recordTime))
+            return SNCCFS_ERROR_READING_INDEX_FILE;
+
+        if (recordTime < requestedTime)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    if (low >= count)
+        return SNCCFS_ERROR_TIME_NOT_FOUND;
+
+    if (!readTimestamp(xf, low, recordTime))
+        return SNCCFS_ERROR_READING_INDEX_FILE;
+
+    index = low;
+
+    return SNCCFS_SUCCESS;
+}
+
+bool StoreCFSStructured::readTimestamp(QFile& xf, unsigned int index, qint64& timestamp)
+{
+    if (!xf.seek((qint64)index * STORE_CFS_INDEX_ENTRY_SIZE + sizeof(qint64)))
+        return false;
+
+    return xf.read((char *)(&timestamp), sizeof(qint64)) == sizeof(qint64);
+}
+
+void StoreCFSStructured::sendRecord(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex,
+        int responseType, int responseCode, bool sendData)
 {
     qint64 rpos;
     SNC_STORE_RECORD_HEADER	cHead;
-    int responseCode = SNCCFS_SUCCESS;
     int recordLength = 0;
     SNC_CFSHEADER *responseHdr = NULL;
     SNC_EHEAD *responseE2E = NULL;
@@ -59,6 +449,9 @@ void StoreCFSStructured::cfsRead(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STOREC
     QFile xf(m_indexPath);
     QFile rf(m_filePath);
 
+    if ((responseCode != SNCCFS_SUCCESS) || !sendData)
+        goto sendResponse;
+
     if (!xf.open(QIODevice::ReadOnly)) {
         responseCode = SNCCFS_ERROR_INDEX_FILE_NOT_FOUND;
         goto sendResponse;
@@ -71,7 +464,7 @@ void StoreCFSStructured::cfsRead(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STOREC
         goto sendResponse;
     }
 
-    xf.seek(requestedIndex * STORE_CFS_INDEX_ENTRY_SIZE);
+    xf.seek((qint64)requestedIndex * STORE_CFS_INDEX_ENTRY_SIZE);
 
     if ((int)xf.read((char *)(&rpos), sizeof(qint64)) != sizeof(qint64)) {
         responseCode = SNCCFS_ERROR_READING_INDEX_FILE;
@@ -131,7 +524,7 @@ sendResponse:
         responseHdr = reinterpret_cast<SNC_CFSHEADER *>(responseE2E + 1);
     }
 
-    SNCUtils::convertIntToUC2(SNCCFS_TYPE_READ_INDEX_RES, responseHdr->cfsType);
+    SNCUtils::convertIntToUC2(responseType, responseHdr->cfsType);
     SNCUtils::convertIntToUC2(responseCode, responseHdr->cfsParam);
     SNCUtils::convertIntToUC4(requestedIndex, responseHdr->cfsIndex);
     memcpy(responseHdr->cfsClientHandle, cfsMsg->cfsClientHandle, sizeof(SNC_UC2));
@@ -146,6 +539,28 @@ sendResponse:
     free(ehead);
 }
 
+void StoreCFSStructured::sendOtherFile(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, int responseType, const QString& fileName)
+{
+    QByteArray name = fileName.toUtf8();
+    SNC_EHEAD *responseE2E = cfsBuildResponse(ehead, name.length());
+    SNC_CFSHEADER *responseHdr = reinterpret_cast<SNC_CFSHEADER *>(responseE2E + 1);
+
+    memcpy(responseHdr + 1, name.constData(), name.length());
+
+    SNCUtils::convertIntToUC2(responseType, responseHdr->cfsType);
+    SNCUtils::convertIntToUC2(SNCCFS_ERROR_TIME_IN_OTHER_FILE, responseHdr->cfsParam);
+    memcpy(responseHdr->cfsClientHandle, cfsMsg->cfsClientHandle, sizeof(SNC_UC2));
+
+    int totalLength = sizeof(SNC_CFSHEADER) + name.length();
+    m_parent->sendMessage(responseE2E, totalLength);
+
+#ifdef CFS_THREAD_TRACE
+    TRACE2("Sent other file %s to %s", qPrintable(fileName), qPrintable(SNCUtils::displayUID(&ehead->sourceUID)));
+#endif
+
+    free(ehead);
+}
+
 void StoreCFSStructured::cfsWrite(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex)
 {
     SNC_STORE_RECORD_HEADER cHeadV0;
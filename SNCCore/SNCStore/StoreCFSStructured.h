@@ -24,8 +24,12 @@
 #ifndef STORECFSSTRUCTURED_H
 #define STORECFSSTRUCTURED_H
 
+#include <qfile.h>
+
 #include "StoreCFS.h"
 
+#define STORE_CFS_RANGE_READ_ENTRIES    1024                // index entries read from disk at a time for a range request
+
 class StoreCFSStructured : public StoreCFS
 {
 public:
@@ -35,10 +39,19 @@ public:
     virtual bool cfsOpen(SNC_CFSHEADER *cfsMsg);
     virtual void cfsRead(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex);
     virtual void cfsWrite(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex);
+    virtual void cfsReadTime(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, qint64 requestedTime, bool isOffset);
+    virtual void cfsReadIndexRange(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex);
+    virtual void cfsReadMulti(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex, int maxBytes);
 
     virtual unsigned int cfsGetRecordCount();
 
 private:
+    void sendRecord(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, STORECFS_STATE *scs, unsigned int requestedIndex,
+        int responseType, int responseCode, bool sendData);
+    void sendOtherFile(SNC_EHEAD *ehead, SNC_CFSHEADER *cfsMsg, int responseType, const QString& fileName);
+    int findTime(qint64& requestedTime, bool isOffset, unsigned int& index, qint64& recordTime);
+    bool readTimestamp(QFile& xf, unsigned int index, qint64& timestamp);
+
     QString m_indexPath;
 };
 
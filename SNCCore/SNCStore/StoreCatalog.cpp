@@ -0,0 +1,199 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "SNCUtils.h"
+#include "StoreCatalog.h"
+
+#include <qdir.h>
+#include <qfile.h>
+#include <qfileinfo.h>
+
+#include <string.h>
+
+#define TAG "StoreCatalog"
+
+StoreCatalog::StoreCatalog()
+{
+    m_totalBytes = 0;
+    m_built = false;
+}
+
+//  build lists the stream's files once. The names carry the rotation time so name order
+//  is age order. The name filter is only a first cut - another stream whose name starts
+//  with this prefix would match it, so each name is checked against the exact pattern.
+
+void StoreCatalog::build(const QString& folder, const QString& prefix, const QString& extension, const QString& exclude)
+{
+    QDir dir(folder);
+    QRegularExpression pattern = fileNamePattern(prefix, extension);
+    STORE_CATALOG_ENTRY entry;
+
+    m_entries.clear();
+    m_totalBytes = 0;
+
+    dir.setFilter(QDir::Files | QDir::NoDotAndDotDot);
+    dir.setSorting(QDir::Name);
+    dir.setNameFilters(QStringList(prefix + "*." + extension));
+
+    QFileInfoList list = dir.entryInfoList();
+
+    for (int i = 0; i < list.count(); i++) {
+        QString path = list.at(i).absoluteFilePath();
+
+        if (!pattern.match(list.at(i).fileName()).hasMatch())
+            continue;
+
+        if (!exclude.isEmpty() && (path == QFileInfo(exclude).absoluteFilePath()))
+            continue;
+
+        if (readEntry(path, &entry)) {
+            m_entries.append(entry);
+            m_totalBytes += entry.size;
+        }
+    }
+
+    m_built = true;
+}
+
+void StoreCatalog::add(const QString& path)
+{
+    STORE_CATALOG_ENTRY entry;
+    QString absolutePath = QFileInfo(path).absoluteFilePath();
+
+    for (int i = 0; i < m_entries.count(); i++) {
+        if (m_entries.at(i).path == absolutePath)
+            return;                                         // reopened after a restart, already listed
+    }
+
+    if (!readEntry(absolutePath, &entry))
+        return;
+
+    m_entries.append(entry);
+    m_totalBytes += entry.size;
+}
+
+void StoreCatalog::remove(const QString& path)
+{
+    QString absolutePath = QFileInfo(path).absoluteFilePath();
+
+    for (int i = 0; i < m_entries.count(); i++) {
+        if (m_entries.at(i).path == absolutePath) {
+            m_totalBytes -= m_entries.takeAt(i).size;
+            return;
+        }
+    }
+}
+
+bool StoreCatalog::deleteOldest()
+{
+    if (m_entries.isEmpty())
+        return false;
+
+    STORE_CATALOG_ENTRY entry = m_entries.takeFirst();
+
+    m_totalBytes -= entry.size;
+
+    QFile::remove(entry.path);
+
+    QString index = indexPath(entry.path);
+
+    if (!index.isEmpty())
+        QFile::remove(index);
+
+    return true;
+}
+
+QRegularExpression StoreCatalog::fileNamePattern(const QString& prefix, const QString& extension)
+{
+    return QRegularExpression("^" + QRegularExpression::escape(prefix) + "\\d{8}_\\d{4}\\."
+                + QRegularExpression::escape(extension) + "$");
+}
+
+int StoreCatalog::findTime(qint64 time) const
+{
+    int low = 0;
+    int high = m_entries.count();
+
+    // first entry that ends at or after time
+
+    while (low < high) {
+        int mid = (low + high) / 2;
+
+        if ((m_entries.at(mid).endTime >= 0) && (m_entries.at(mid).endTime < time))
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return (low < m_entries.count()) ? low : -1;
+}
+
+QString StoreCatalog::indexPath(const QString& path)
+{
+    if (!path.endsWith(SNC_RECORD_SRF_RECORD_DOTEXT))
+        return QString();
+
+    return path.left(path.length() - (int)strlen(SNC_RECORD_SRF_RECORD_DOTEXT)) + SNC_RECORD_SRF_INDEX_DOTEXT;
+}
+
+//  readEntry counts the index with the data file as retention deletes both, and gets the
+//  record times from the first and last index entries
+
+bool StoreCatalog::readEntry(const QString& path, STORE_CATALOG_ENTRY *entry)
+{
+    QFileInfo info(path);
+    qint64 indexEntry[2];
+
+    if (!info.exists())
+        return false;
+
+    entry->path = info.absoluteFilePath();
+    entry->size = info.size();
+    entry->modified = info.lastModified();
+    entry->startTime = -1;
+    entry->endTime = -1;
+
+    QString index = indexPath(path);
+
+    if (index.isEmpty())
+        return true;
+
+    QFile indexFile(index);
+
+    if (!indexFile.open(QIODevice::ReadOnly))
+        return true;
+
+    entry->size += indexFile.size();
+
+    if (indexFile.size() >= (qint64)sizeof(indexEntry)) {
+        if (indexFile.read((char *)indexEntry, sizeof(indexEntry)) == sizeof(indexEntry))
+            entry->startTime = indexEntry[1];
+
+        qint64 last = (indexFile.size() / sizeof(indexEntry) - 1) * sizeof(indexEntry);
+
+        if (indexFile.seek(last) && (indexFile.read((char *)indexEntry, sizeof(indexEntry)) == sizeof(indexEntry)))
+            entry->endTime = indexEntry[1];
+    }
+
+    return true;
+}
@@ -0,0 +1,85 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef STORECATALOG_H
+#define STORECATALOG_H
+
+#include <qstring.h>
+#include <qlist.h>
+#include <qdatetime.h>
+#include <qregularexpression.h>
+
+//  A catalogue entry describes one closed file of a stream
+
+typedef struct
+{
+    QString path;                                           // full path of the data file
+    qint64 startTime;                                       // first record timestamp, -1 if not known
+    qint64 endTime;                                         // last record timestamp, -1 if not known
+    qint64 size;                                            // data plus index bytes
+    QDateTime modified;                                     // when the file was last written
+} STORE_CATALOG_ENTRY;
+
+//  StoreCatalog keeps a stream's closed files oldest first. It is built with one directory
+//  scan when the stream is loaded and added to on each rotation, so retention never needs to
+//  list the folder again. Record times come from the first and last .srx entries so raw
+//  files have none.
+
+class StoreCatalog
+{
+public:
+    StoreCatalog();
+
+    void build(const QString& folder, const QString& prefix, const QString& extension, const QString& exclude);
+    void add(const QString& path);                          // adds a file that has just been closed
+    void remove(const QString& path);                       // drops a file that is being written again
+
+    bool isBuilt() const { return m_built; }
+    int count() const { return m_entries.count(); }
+    qint64 totalBytes() const { return m_totalBytes; }
+    const STORE_CATALOG_ENTRY& oldest() const { return m_entries.first(); }
+
+    bool deleteOldest();                                    // deletes the oldest file and its index
+
+//  findTime returns the entry whose records cover time, or the first one after it. It
+//  returns -1 if there is no such entry.
+
+    int findTime(qint64 time) const;
+    const STORE_CATALOG_ENTRY& entry(int index) const { return m_entries.at(index); }
+
+//  fileNamePattern matches exactly the names a stream's rotation gives its files
+//  (prefix + yyyyMMdd_hhmm.extension), so that a stream whose name starts with another
+//  stream's name is never taken for it.
+
+    static QRegularExpression fileNamePattern(const QString& prefix, const QString& extension);
+
+private:
+    static bool readEntry(const QString& path, STORE_CATALOG_ENTRY *entry);
+    static QString indexPath(const QString& path);
+
+    QList<STORE_CATALOG_ENTRY> m_entries;
+    qint64 m_totalBytes;
+    bool m_built;
+};
+
+#endif // STORECATALOG_H
@@ -23,6 +23,9 @@
 
 #include "SNCStore.h"
 #include "StoreClient.h"
+#include "StoreIO.h"
+#include "StoreWorkerPool.h"
+#include "StoreRetention.h"
 #include "StoreManager.h"
 
 #include "SNCUtils.h"
@@ -36,6 +39,7 @@ StoreClient::StoreClient(QObject *parent)
         m_sources[i] = NULL;
         m_storeManagers[i] = NULL;
     }
+    m_retention = NULL;
     loadSettings();
 }
 
@@ -51,6 +55,36 @@ void StoreClient::loadSettings()
     if (!settings->contains(SNCSTORE_MAXAGE))
         settings->setValue(SNCSTORE_MAXAGE, 0);
 
+    if (!settings->contains(SNCSTORE_PARAMS_SYNC_POLICY))
+        settings->setValue(SNCSTORE_PARAMS_SYNC_POLICY, SNCSTORE_PARAMS_SYNC_POLICY_NONE);
+
+    if (!settings->contains(SNCSTORE_PARAMS_SYNC_INTERVAL))
+        settings->setValue(SNCSTORE_PARAMS_SYNC_INTERVAL, SNCSTORE_PARAMS_SYNC_INTERVAL_DEFAULT);
+
+    if (!settings->contains(SNCSTORE_PARAMS_IO_BACKEND))
+        settings->setValue(SNCSTORE_PARAMS_IO_BACKEND, SNCSTORE_PARAMS_IO_BACKEND_SYNC);
+
+    if (!settings->contains(SNCSTORE_PARAMS_IO_THREADS))
+        settings->setValue(SNCSTORE_PARAMS_IO_THREADS, STOREIO_DEFAULT_THREADS);
+
+    if (!settings->contains(SNCSTORE_PARAMS_WORKERS))
+        settings->setValue(SNCSTORE_PARAMS_WORKERS, STOREWORKERPOOL_DEFAULT_WORKERS);
+
+    if (!settings->contains(SNCSTORE_PARAMS_FLUSH_KB))
+        settings->setValue(SNCSTORE_PARAMS_FLUSH_KB, STOREWORKERPOOL_DEFAULT_FLUSH_KB);
+
+    if (!settings->contains(SNCSTORE_PARAMS_FLUSH_AGE))
+        settings->setValue(SNCSTORE_PARAMS_FLUSH_AGE, STOREWORKERPOOL_DEFAULT_FLUSH_AGE);
+
+    // Store wide limits. Files are deleted oldest first from the streams using the
+    // most space, adjusted for each stream's retentionWeight
+
+    if (!settings->contains(SNCSTORE_PARAMS_QUOTA))
+        settings->setValue(SNCSTORE_PARAMS_QUOTA, 0);
+
+    if (!settings->contains(SNCSTORE_PARAMS_MIN_FREE))
+        settings->setValue(SNCSTORE_PARAMS_MIN_FREE, 0);
+
     // The SNCStore component can save any type of stream.
     // Here you can list the SNC streams by name that it should look for.
     int	nSize = settings->beginReadArray(SNCSTORE_PARAMS_STREAM_SOURCES);
@@ -78,6 +112,8 @@ void StoreClient::loadSettings()
             settings->setValue(SNCSTORE_PARAMS_DELETION_TIME, 2);
             settings->setValue(SNCSTORE_PARAMS_DELETION_COUNT, 5);
             settings->setValue(SNCSTORE_PARAMS_CREATE_SUBFOLDER, true);
+            settings->setValue(SNCSTORE_PARAMS_RETENTION_WEIGHT, 1);
+            settings->setValue(SNCSTORE_PARAMS_RETENTION_MIN, 0);
         }
         settings->endArray();
     }
@@ -104,6 +140,9 @@ bool StoreClient::getStoreStream(int index, StoreStream *ss)
 
 void StoreClient::appClientInit()
 {
+    m_retention = new StoreRetention();
+    m_retention->resumeThread();
+
     for (int index = 0; index < SNCSTORE_MAX_STREAMS; index++)
         refreshStreamSource(index);
 }
@@ -113,6 +152,11 @@ void StoreClient::appClientExit()
     for (int i = 0; i < SNCSTORE_MAX_STREAMS; i++) {
         deleteStreamSource(i);
     }
+
+    if (m_retention != NULL) {
+        m_retention->exitThread();
+        m_retention = NULL;
+    }
 }
 
 void StoreClient::appClientReceiveMulticast(int servicePort, SNC_EHEAD *message, int len)
@@ -127,11 +171,13 @@ void StoreClient::appClientReceiveMulticast(int servicePort, SNC_EHEAD *message,
         return;
     }
 
-    if (m_storeManagers[sourceIndex] != NULL) {
-        m_storeManagers[sourceIndex]->queueBlock(QByteArray(reinterpret_cast<char *>(message + 1), len));
-        clientSendMulticastAck(servicePort);
+    if (m_storeManagers[sourceIndex] == NULL) {
+        free(message);
+        return;
     }
-    free(message);
+
+    m_storeManagers[sourceIndex]->queueBlock(message, len);
+    clientSendMulticastAck(servicePort);
 }
 
 void StoreClient::refreshStreamSource(int index)
@@ -156,16 +202,25 @@ void StoreClient::refreshStreamSource(int index)
         SNCUtils::logError(TAG, QString("Folder is not writable: %1").arg(m_sources[index]->pathOnly()));
         delete m_sources[index];
         m_sources[index] = NULL;
+        return;
     }
 
+    m_sources[index]->buildCatalog();
+
     m_storeManagers[index] = new StoreManager(m_sources[index]);
 
-    m_sources[index]->port = clientAddService(m_sources[index]->streamName(), SERVICETYPE_MULTICAST, false);
+    if (m_retention != NULL)
+        m_retention->addStream(m_sources[index]);
+
+    StoreStream::addLookup(m_sources[index]);
+
+    m_sources[index]->port = clientAddService(SNCUtils::insertRateInPath(m_sources[index]->streamName(), 0, 0, true),
+                SERVICETYPE_MULTICAST, false);
 
     // record index in service entry
     clientSetServiceData(m_sources[index]->port, index);
 
-    m_storeManagers[index]->resumeThread();
+    m_storeManagers[index]->start();
 }
 
 void StoreClient::deleteStreamSource(int index)
@@ -180,12 +235,15 @@ void StoreClient::deleteStreamSource(int index)
 
     clientRemoveService(m_sources[index]->port);
     StoreManager *dm = m_storeManagers[index];
-    dm->stop();
-
-    // deletes automatically, but don't want to reference it again
     m_storeManagers[index] = NULL;
 
-    dm->exitThread();
+    if (m_retention != NULL)
+        m_retention->removeStream(m_sources[index]);
+
+    StoreStream::removeLookup(m_sources[index]);
+
+    dm->stop();
+    delete dm;
 
     delete m_sources[index];
     m_sources[index] = NULL;
@@ -29,6 +29,7 @@
 #include "SNCStore.h"
 
 class StoreManager;
+class StoreRetention;
 
 class StoreClient : public SNCEndpoint
 {
@@ -56,6 +57,7 @@ private:
 
     StoreStream *m_sources[SNCSTORE_MAX_STREAMS];
     StoreManager *m_storeManagers[SNCSTORE_MAX_STREAMS];
+    StoreRetention *m_retention;
 };
 
 #endif // STORECLIENT_H
@@ -0,0 +1,236 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "StoreFile.h"
+
+#include <qfileinfo.h>
+
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#endif
+
+QMutex StoreFile::m_usersLock;
+QHash<QString, int> StoreFile::m_users;
+
+StoreFile::StoreFile()
+{
+    m_pos = 0;
+#ifdef Q_OS_UNIX
+    m_fd = -1;
+#endif
+}
+
+StoreFile::~StoreFile()
+{
+    close(false);
+}
+
+#ifdef Q_OS_UNIX
+
+bool StoreFile::open(const QString& path)
+{
+    close(false);
+
+    m_fd = ::open(QFile::encodeName(path).constData(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+
+    if (m_fd < 0)
+        return false;
+
+    m_path = path;
+    addUser(m_path);
+    m_pos = lseek(m_fd, 0, SEEK_END);
+    if (m_pos < 0)
+        m_pos = 0;
+    return true;
+}
+
+void StoreFile::close(bool syncFirst)
+{
+    if (m_fd < 0)
+        return;
+
+    if (syncFirst)
+        sync();
+
+    ::close(m_fd);
+    m_fd = -1;
+    removeUser(m_path);
+    m_path.clear();
+    m_pos = 0;
+}
+
+bool StoreFile::isOpen() const
+{
+    return m_fd >= 0;
+}
+
+//  write keeps going after short writes. The iovecs are copied because a short write
+//  means the partly written one has to be adjusted.
+
+bool StoreFile::write(const struct iovec *iov, int count)
+{
+    struct iovec vec[STOREFILE_MAX_IOV];
+
+    if (m_fd < 0)
+        return false;
+
+    while (count > 0) {
+        int batch = qMin(count, STOREFILE_MAX_IOV);
+
+        memcpy(vec, iov, batch * sizeof(struct iovec));
+
+        int first = 0;
+
+        while (first < batch) {
+            ssize_t written = ::writev(m_fd, vec + first, batch - first);
+
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+
+            m_pos += written;
+
+            while ((first < batch) && ((size_t)written >= vec[first].iov_len)) {
+                written -= vec[first].iov_len;
+                first++;
+            }
+
+            if (first < batch) {
+                vec[first].iov_base = (char *)vec[first].iov_base + written;
+                vec[first].iov_len -= written;
+            }
+        }
+
+        iov += batch;
+        count -= batch;
+    }
+
+    return true;
+}
+
+bool StoreFile::sync()
+{
+    if (m_fd < 0)
+        return false;
+
+#if defined(Q_OS_LINUX)
+    return fdatasync(m_fd) == 0;
+#else
+    return fsync(m_fd) == 0;
+#endif
+}
+
+#else
+
+bool StoreFile::open(const QString& path)
+{
+    close(false);
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::Append | QIODevice::Unbuffered))
+        return false;
+
+    m_path = path;
+    addUser(m_path);
+    m_pos = m_file.size();
+    return true;
+}
+
+void StoreFile::close(bool syncFirst)
+{
+    if (!m_file.isOpen())
+        return;
+
+    if (syncFirst)
+        sync();
+
+    m_file.close();
+    removeUser(m_path);
+    m_path.clear();
+    m_pos = 0;
+}
+
+bool StoreFile::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+bool StoreFile::write(const struct iovec *iov, int count)
+{
+    for (int i = 0; i < count; i++) {
+        qint64 written = m_file.write((const char *)iov[i].iov_base, iov[i].iov_len);
+
+        if (written > 0)
+            m_pos += written;
+
+        if (written != (qint64)iov[i].iov_len)
+            return false;
+    }
+    return true;
+}
+
+bool StoreFile::sync()
+{
+    return m_file.flush();
+}
+
+#endif
+
+bool StoreFile::write(const char *data, qint64 length)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void *)data;
+    iov.iov_len = length;
+    return write(&iov, 1);
+}
+
+void StoreFile::addUser(const QString& path)
+{
+    QMutexLocker lock(&m_usersLock);
+
+    m_users[QFileInfo(path).absoluteFilePath()]++;
+}
+
+void StoreFile::removeUser(const QString& path)
+{
+    QMutexLocker lock(&m_usersLock);
+    QString absolutePath = QFileInfo(path).absoluteFilePath();
+
+    if (--m_users[absolutePath] <= 0)
+        m_users.remove(absolutePath);
+}
+
+bool StoreFile::inUse(const QString& path)
+{
+    QMutexLocker lock(&m_usersLock);
+
+    return m_users.contains(QFileInfo(path).absoluteFilePath());
+}
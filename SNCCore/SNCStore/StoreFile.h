@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef STOREFILE_H
+#define STOREFILE_H
+
+#include <qstring.h>
+#include <qfile.h>
+#include <qhash.h>
+#include <qmutex.h>
+
+#ifdef Q_OS_UNIX
+#include <sys/uio.h>
+#else
+struct iovec
+{
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
+
+#define STOREFILE_MAX_IOV               1024                // iovecs per writev call
+
+//  StoreFile is an append-only file that the store keeps open across flushes. A batch
+//  of buffers is written with as few writev calls as possible. On platforms
+//  without writev it falls back to QFile.
+
+class StoreFile
+{
+public:
+    StoreFile();
+    ~StoreFile();
+
+    bool open(const QString& path);                         // opens for append, creating if necessary
+    void close(bool sync);
+    bool isOpen() const;
+    const QString& path() const { return m_path; }
+
+    qint64 pos() const { return m_pos; }                    // offset of the next byte to be written
+    void advance(qint64 bytes) { m_pos += bytes; }          // for data written by someone else
+
+#ifdef Q_OS_UNIX
+    int handle() const { return m_fd; }
+#endif
+
+    bool write(const struct iovec *iov, int count);         // returns false if not all the data was written
+    bool write(const char *data, qint64 length);
+    bool sync();                                            // data sync to the device
+
+//  The store keeps a count of the users of each file it has open, either for writing by a
+//  StoreFile or for a CFS session, so that recovery never repairs a file that is in use.
+
+    static void addUser(const QString& path);
+    static void removeUser(const QString& path);
+    static bool inUse(const QString& path);
+
+private:
+    static QMutex m_usersLock;
+    static QHash<QString, int> m_users;                     // user count keyed by absolute path
+
+    QString m_path;
+    qint64 m_pos;
+
+#ifdef Q_OS_UNIX
+    int m_fd;
+#else
+    QFile m_file;
+#endif
+};
+
+#endif // STOREFILE_H
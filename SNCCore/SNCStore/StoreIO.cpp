@@ -0,0 +1,318 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "SNCUtils.h"
+#include "SNCStore.h"
+#include "StoreIO.h"
+
+#define TAG "StoreIO"
+
+//----------------------------------------------------------
+//  StoreIORequest
+
+StoreIORequest::StoreIORequest(StoreIOClient *requestClient)
+{
+    client = requestClient;
+    failedOp = -1;
+    pendingOps = 0;
+}
+
+StoreIORequest::~StoreIORequest()
+{
+    qDeleteAll(blocks);
+}
+
+//  Writes with more buffers than one writev can take are split into several ops
+
+void StoreIORequest::addWrite(StoreFile *file, const struct iovec *buffers, int count)
+{
+    STOREIO_OP op;
+
+    while (count > 0) {
+        op.type = storeIOWrite;
+        op.file = file;
+        op.firstIov = iov.count();
+        op.iovCount = qMin(count, STOREFILE_MAX_IOV);
+        op.length = 0;
+
+        for (int i = 0; i < op.iovCount; i++) {
+            iov.append(buffers[i]);
+            op.length += buffers[i].iov_len;
+        }
+        ops.append(op);
+
+        buffers += op.iovCount;
+        count -= op.iovCount;
+    }
+}
+
+void StoreIORequest::addSync(StoreFile *file)
+{
+    STOREIO_OP op;
+
+    op.type = storeIOSync;
+    op.file = file;
+    op.firstIov = 0;
+    op.iovCount = 0;
+    op.length = 0;
+    ops.append(op);
+}
+
+//----------------------------------------------------------
+//  StoreIO
+
+QMutex StoreIO::m_instanceLock;
+StoreIO *StoreIO::m_instance = NULL;
+bool StoreIO::m_created = false;
+
+StoreIO *StoreIO::instance()
+{
+    QMutexLocker lock(&m_instanceLock);
+
+    if (!m_created) {
+        m_instance = create();
+        m_created = true;
+    }
+    return m_instance;
+}
+
+StoreIO *StoreIO::create()
+{
+    QSettings *settings = SNCUtils::getSettings();
+    QString backend = settings->value(SNCSTORE_PARAMS_IO_BACKEND).toString().toLower();
+    int threads = settings->value(SNCSTORE_PARAMS_IO_THREADS, STOREIO_DEFAULT_THREADS).toInt();
+
+    delete settings;
+
+    if (threads < 1)
+        threads = 1;
+    else if (threads > STOREIO_MAX_THREADS)
+        threads = STOREIO_MAX_THREADS;
+
+    if (backend == SNCSTORE_PARAMS_IO_BACKEND_URING) {
+#ifdef USE_IO_URING
+        StoreIOUring *uring = new StoreIOUring();
+
+        if (uring->init()) {
+            SNCUtils::logInfo(TAG, "Using io_uring for store I/O");
+            return uring;
+        }
+        delete uring;
+        SNCUtils::logWarn(TAG, "io_uring setup failed, using I/O threads");
+#else
+        SNCUtils::logWarn(TAG, "Built without io_uring support, using I/O threads");
+#endif
+        backend = SNCSTORE_PARAMS_IO_BACKEND_THREADS;
+    }
+
+    if (backend == SNCSTORE_PARAMS_IO_BACKEND_THREADS) {
+        SNCUtils::logInfo(TAG, QString("Using %1 I/O threads for store I/O").arg(threads));
+        return new StoreIOThreads(threads);
+    }
+
+    return NULL;
+}
+
+void StoreIO::execute(StoreIORequest *request)
+{
+    for (int i = 0; i < request->ops.count(); i++) {
+        const STOREIO_OP& op = request->ops.at(i);
+        bool ok;
+
+        if (op.type == storeIOWrite)
+            ok = op.file->write(request->iov.constData() + op.firstIov, op.iovCount);
+        else
+            ok = op.file->sync();
+
+        if (!ok) {
+            request->failedOp = i;
+            return;
+        }
+    }
+}
+
+//----------------------------------------------------------
+//  StoreIOThreads
+
+StoreIOWorker::StoreIOWorker(StoreIOThreads *pool)
+{
+    m_pool = pool;
+}
+
+void StoreIOWorker::run()
+{
+    while (true) {
+        StoreIORequest *request = m_pool->next();
+
+        StoreIO::execute(request);
+        request->client->ioComplete(request);
+    }
+}
+
+StoreIOThreads::StoreIOThreads(int threads)
+{
+    for (int i = 0; i < threads; i++) {
+        m_workers.append(new StoreIOWorker(this));
+        m_workers.last()->start();
+    }
+}
+
+void StoreIOThreads::submit(StoreIORequest *request)
+{
+    QMutexLocker lock(&m_lock);
+
+    m_requests.enqueue(request);
+    m_wake.wakeOne();
+}
+
+StoreIORequest *StoreIOThreads::next()
+{
+    QMutexLocker lock(&m_lock);
+
+    while (m_requests.isEmpty())
+        m_wake.wait(&m_lock);
+
+    return m_requests.dequeue();
+}
+
+#ifdef USE_IO_URING
+
+#include <errno.h>
+
+//----------------------------------------------------------
+//  StoreIOUring
+
+StoreIOReaper::StoreIOReaper(StoreIOUring *uring)
+{
+    m_uring = uring;
+}
+
+void StoreIOReaper::run()
+{
+    m_uring->reap();
+}
+
+StoreIOUring::StoreIOUring()
+{
+    m_reaper = NULL;
+}
+
+StoreIOUring::~StoreIOUring()
+{
+    if (m_reaper == NULL)
+        io_uring_queue_exit(&m_ring);
+}
+
+bool StoreIOUring::init()
+{
+    if (io_uring_queue_init(STOREIO_URING_ENTRIES, &m_ring, 0) < 0)
+        return false;
+
+    m_reaper = new StoreIOReaper(this);
+    m_reaper->start();
+    return true;
+}
+
+//  reserveSQEs waits until the submission queue has room for a whole chain. Submitting
+//  part of a chain would break the IOSQE_IO_LINK ordering between its ops.
+
+void StoreIOUring::reserveSQEs(unsigned count)
+{
+    while (io_uring_sq_space_left(&m_ring) < count) {
+        io_uring_submit(&m_ring);
+        QThread::usleep(100);
+    }
+}
+
+void StoreIOUring::submit(StoreIORequest *request)
+{
+    if (request->ops.count() > STOREIO_URING_ENTRIES) {
+        execute(request);                                   // the chain can never fit in the ring
+        request->client->ioComplete(request);
+        return;
+    }
+
+    QMutexLocker lock(&m_submitLock);
+
+    request->pendingOps = request->ops.count();
+    request->tags.resize(request->ops.count());
+    reserveSQEs(request->ops.count());
+
+    for (int i = 0; i < request->ops.count(); i++) {
+        const STOREIO_OP& op = request->ops.at(i);
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&m_ring);
+
+        if (op.type == storeIOWrite)
+            io_uring_prep_writev(sqe, op.file->handle(), request->iov.constData() + op.firstIov, op.iovCount, -1);
+        else
+            io_uring_prep_fsync(sqe, op.file->handle(), IORING_FSYNC_DATASYNC);
+
+        if (i < request->ops.count() - 1)
+            sqe->flags |= IOSQE_IO_LINK;
+
+        request->tags[i].request = request;
+        request->tags[i].op = i;
+        io_uring_sqe_set_data(sqe, &request->tags[i]);
+    }
+
+    io_uring_submit(&m_ring);
+}
+
+//  A short write counts as a failure. The kernel then cancels the rest of the chain, so
+//  every op still completes exactly once.
+
+void StoreIOUring::reap()
+{
+    struct io_uring_cqe *cqe;
+
+    while (true) {
+        int ret = io_uring_wait_cqe(&m_ring, &cqe);
+
+        if (ret == -EINTR)
+            continue;
+
+        if (ret < 0) {
+            SNCUtils::logError(TAG, QString("io_uring wait failed %1").arg(ret));
+            return;
+        }
+
+        STOREIO_TAG *tag = (STOREIO_TAG *)io_uring_cqe_get_data(cqe);
+        StoreIORequest *request = tag->request;
+        const STOREIO_OP& op = request->ops.at(tag->op);
+
+        bool failed = (cqe->res < 0) || ((op.type == storeIOWrite) && (cqe->res < op.length));
+
+        if ((op.type == storeIOWrite) && (cqe->res > 0))
+            op.file->advance(cqe->res);
+
+        if (failed && ((request->failedOp < 0) || (tag->op < request->failedOp)))
+            request->failedOp = tag->op;
+
+        io_uring_cqe_seen(&m_ring, cqe);
+
+        if (--request->pendingOps == 0)
+            request->client->ioComplete(request);
+    }
+}
+
+#endif
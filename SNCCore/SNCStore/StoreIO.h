@@ -0,0 +1,198 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef STOREIO_H
+#define STOREIO_H
+
+#include <qlist.h>
+#include <qvector.h>
+#include <qqueue.h>
+#include <qmutex.h>
+#include <qwaitcondition.h>
+#include <qthread.h>
+
+#include "StoreFile.h"
+#include "StoreBlock.h"
+
+#ifdef USE_IO_URING
+#include <liburing.h>
+#endif
+
+#define STOREIO_DEFAULT_THREADS         2                   // I/O threads shared by all streams
+#define STOREIO_MAX_THREADS             16
+#define STOREIO_URING_ENTRIES           256                 // submission queue size
+
+//  A StoreIORequest is a batch of writes and syncs for one stream. The ops are carried
+//  out in order and stop at the first one that fails. The request owns the buffers
+//  that its iovecs point into until it completes.
+
+enum StoreIOOpType { storeIOWrite, storeIOSync };
+
+typedef struct
+{
+    StoreIOOpType type;
+    StoreFile *file;
+    int firstIov;                                           // index into iov of the first buffer
+    int iovCount;                                           // number of buffers
+    qint64 length;                                          // total bytes to write
+} STOREIO_OP;
+
+class StoreIORequest;
+
+typedef struct
+{
+    StoreIORequest *request;
+    int op;
+} STOREIO_TAG;                                              // identifies an op's completion
+
+class StoreIOClient
+{
+public:
+    virtual ~StoreIOClient() {}
+
+//  ioComplete is called on an I/O thread, or on the submitting thread for synchronous I/O.
+//  The client must delete the request.
+
+    virtual void ioComplete(StoreIORequest *request) = 0;
+};
+
+class StoreIORequest
+{
+public:
+    StoreIORequest(StoreIOClient *client);
+    ~StoreIORequest();
+
+    void addWrite(StoreFile *file, const struct iovec *iov, int count);
+    void addSync(StoreFile *file);
+    void keep(const QByteArray& buffer) { buffers.append(buffer); }
+    void keep(StoreBlock *block) { blocks.append(block); }  // takes ownership
+    bool isEmpty() const { return ops.isEmpty(); }
+
+    StoreIOClient *client;
+    QList<STOREIO_OP> ops;
+    QVector<struct iovec> iov;
+    QList<QByteArray> buffers;                              // released when the request is deleted
+    QList<StoreBlock *> blocks;                             // deleted with the request
+    int failedOp;                                           // index of the op that failed, or -1
+    int pendingOps;                                         // used by the backends
+    QVector<STOREIO_TAG> tags;
+};
+
+//  StoreIO is the shared asynchronous I/O backend. There is at most one in the process,
+//  selected by the ioBackend setting. instance() returns NULL if the streams should do
+//  their own I/O synchronously.
+
+class StoreIO
+{
+public:
+    virtual ~StoreIO() {}
+
+    static StoreIO *instance();
+    static void execute(StoreIORequest *request);           // carries out a request on the calling thread
+
+    virtual void submit(StoreIORequest *request) = 0;
+    virtual const char *name() const = 0;
+
+private:
+    static StoreIO *create();
+
+    static QMutex m_instanceLock;
+    static StoreIO *m_instance;
+    static bool m_created;
+};
+
+//  StoreIOThreads runs requests on a small pool of threads
+
+class StoreIOThreads;
+
+class StoreIOWorker : public QThread
+{
+public:
+    StoreIOWorker(StoreIOThreads *pool);
+
+protected:
+    void run();
+
+private:
+    StoreIOThreads *m_pool;
+};
+
+class StoreIOThreads : public StoreIO
+{
+public:
+    StoreIOThreads(int threads);
+
+    void submit(StoreIORequest *request);
+    const char *name() const { return "threads"; }
+
+    StoreIORequest *next();                                 // waits for a request
+
+private:
+    QMutex m_lock;
+    QWaitCondition m_wake;
+    QQueue<StoreIORequest *> m_requests;
+    QList<StoreIOWorker *> m_workers;
+};
+
+#ifdef USE_IO_URING
+
+//  StoreIOUring submits the ops of a request as a linked chain so that a failed write
+//  cancels the rest. One thread reaps the completions for all streams.
+
+class StoreIOUring;
+
+class StoreIOReaper : public QThread
+{
+public:
+    StoreIOReaper(StoreIOUring *uring);
+
+protected:
+    void run();
+
+private:
+    StoreIOUring *m_uring;
+};
+
+class StoreIOUring : public StoreIO
+{
+public:
+    StoreIOUring();
+    ~StoreIOUring();
+
+    bool init();                                            // returns false if io_uring isn't available
+    void submit(StoreIORequest *request);
+    const char *name() const { return "uring"; }
+
+    void reap();                                            // the completion loop
+
+private:
+    void reserveSQEs(unsigned count);                       // waits for space for a whole chain
+
+    struct io_uring m_ring;
+    QMutex m_submitLock;
+    StoreIOReaper *m_reaper;
+};
+
+#endif
+
+#endif // STOREIO_H
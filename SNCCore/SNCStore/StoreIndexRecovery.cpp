@@ -0,0 +1,290 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "SNCUtils.h"
+#include "StoreIndexRecovery.h"
+
+#include <string.h>
+
+QString StoreIndexRecovery::indexPath(const QString& srfPath)
+{
+    QString path = srfPath;
+
+    if (path.endsWith(SNC_RECORD_SRF_RECORD_DOTEXT))
+        path.truncate(path.length() - (int)strlen(SNC_RECORD_SRF_RECORD_DOTEXT));
+
+    return path + SNC_RECORD_SRF_INDEX_DOTEXT;
+}
+
+bool StoreIndexRecovery::needsRepair(const STORE_RECOVERY_RESULT *result)
+{
+    return result->indexPartial || (result->validEntries < result->indexEntries) ||
+            (result->rebuiltEntries > 0) || (result->validDataSize < result->dataSize);
+}
+
+bool StoreIndexRecovery::check(const QString& srfPath, bool repair, STORE_RECOVERY_RESULT *result)
+{
+    QFile dataFile(srfPath);
+    QFile indexFile(indexPath(srfPath));
+    QByteArray newEntries;
+    qint64 dataEnd;
+
+    result->dataSize = 0;
+    result->indexEntries = 0;
+    result->validEntries = 0;
+    result->rebuiltEntries = 0;
+    result->validDataSize = 0;
+    result->skippedBytes = 0;
+    result->indexPartial = false;
+    result->repaired = false;
+    result->error.clear();
+
+    if (!dataFile.open(QIODevice::ReadOnly)) {
+        result->error = QString("Failed to open %1").arg(srfPath);
+        return false;
+    }
+    result->dataSize = dataFile.size();
+
+    if (indexFile.open(QIODevice::ReadOnly)) {
+        result->indexEntries = indexFile.size() / STORE_RECOVERY_INDEX_ENTRY_SIZE;
+        result->indexPartial = (indexFile.size() % STORE_RECOVERY_INDEX_ENTRY_SIZE) != 0;
+        result->validEntries = lastValidEntry(dataFile, indexFile, result->indexEntries, &dataEnd) + 1;
+        indexFile.close();
+    } else {
+        dataEnd = 0;                                        // no index so rebuild it all
+    }
+
+    if (!scanData(dataFile, dataEnd, newEntries, &result->validDataSize, &result->skippedBytes)) {
+        result->error = QString("Failed reading %1").arg(srfPath);
+        return false;
+    }
+    dataFile.close();
+
+    result->rebuiltEntries = newEntries.length() / STORE_RECOVERY_INDEX_ENTRY_SIZE;
+
+    if (!repair || !needsRepair(result))
+        return true;
+
+    if (!indexFile.open(QIODevice::ReadWrite)) {
+        result->error = QString("Failed to open %1 for writing").arg(indexFile.fileName());
+        return false;
+    }
+    if (!indexFile.resize(result->validEntries * STORE_RECOVERY_INDEX_ENTRY_SIZE) ||
+            !indexFile.seek(indexFile.size()) ||
+            (indexFile.write(newEntries) != newEntries.length())) {
+        result->error = QString("Failed to rebuild %1").arg(indexFile.fileName());
+        return false;
+    }
+    indexFile.close();
+
+    if ((result->validDataSize < result->dataSize) && !dataFile.resize(result->validDataSize)) {
+        result->error = QString("Failed to truncate %1").arg(srfPath);
+        return false;
+    }
+
+    result->repaired = true;
+    return true;
+}
+
+//  lastValidEntry walks back from the end of the index to the last entry that points at
+//  a complete record with a matching timestamp. Normally that is the last entry so this
+//  costs a couple of reads. Returns the entry or -1 if there isn't one.
+
+qint64 StoreIndexRecovery::lastValidEntry(QFile& dataFile, QFile& indexFile, qint64 entries, qint64 *dataEnd)
+{
+    SNC_STORE_RECORD_HEADER storeHeader;
+    SNC_RECORD_HEADER recordHeader;
+    qint64 entry[2];
+    qint64 dataSize = dataFile.size();
+
+    for (qint64 i = entries - 1; i >= 0; i--) {
+        if (!indexFile.seek(i * STORE_RECOVERY_INDEX_ENTRY_SIZE) ||
+                (indexFile.read((char *)entry, sizeof(entry)) != sizeof(entry)))
+            continue;
+
+        qint64 pos = entry[0];
+
+        if ((pos < 0) || (pos + (qint64)(sizeof(storeHeader) + sizeof(recordHeader)) > dataSize))
+            continue;
+
+        if (!dataFile.seek(pos) ||
+                (dataFile.read((char *)&storeHeader, sizeof(storeHeader)) != sizeof(storeHeader)) ||
+                (dataFile.read((char *)&recordHeader, sizeof(recordHeader)) != sizeof(recordHeader)))
+            continue;
+
+        if (strncmp(storeHeader.sync, SYNC_STRINGV0, SYNC_LENGTH) != 0)
+            continue;
+
+        qint64 end = pos + sizeof(storeHeader) + SNCUtils::convertUC4ToInt(storeHeader.size);
+
+        if ((end > dataSize) || (SNCUtils::convertUC8ToInt64(recordHeader.timestamp) != entry[1]))
+            continue;
+
+        *dataEnd = end;
+        return i;
+    }
+
+    *dataEnd = 0;
+    return -1;
+}
+
+//  scanData reads forward from start in large blocks, collecting an index entry for each
+//  complete record. A header that isn't a sync marker or a record that runs past the end
+//  of the file is either corruption or where an interrupted write ended. The scan carries
+//  on from the next good record if there is one, otherwise that is the torn tail.
+
+bool StoreIndexRecovery::scanData(QFile& dataFile, qint64 start, QByteArray& newEntries, qint64 *dataEnd, qint64 *skipped)
+{
+    const int headerLength = sizeof(SNC_STORE_RECORD_HEADER) + sizeof(SNC_RECORD_HEADER);
+    QByteArray buffer(STORE_RECOVERY_BUFFER_SIZE, 0);
+    qint64 dataSize = dataFile.size();
+    qint64 bufferStart = start;                             // file offset of buffer[0]
+    int bufferLength = 0;
+    qint64 pos = start;
+
+    *dataEnd = start;
+
+    if (!dataFile.seek(start))
+        return false;
+
+    while (pos + headerLength <= dataSize) {
+
+        // make sure the headers at pos are in the buffer
+
+        if (pos + headerLength > bufferStart + bufferLength) {
+            if (pos >= bufferStart + bufferLength) {
+                // the last record was bigger than what was left in the buffer
+
+                if (!dataFile.seek(pos))
+                    return false;
+                bufferLength = 0;
+            } else {
+                int keep = (int)(bufferStart + bufferLength - pos);
+
+                memmove(buffer.data(), buffer.constData() + (pos - bufferStart), keep);
+                bufferLength = keep;
+            }
+            bufferStart = pos;
+
+            qint64 bytes = dataFile.read(buffer.data() + bufferLength, buffer.length() - bufferLength);
+
+            if (bytes < 0)
+                return false;
+            bufferLength += bytes;
+
+            if (bufferLength < headerLength)
+                break;
+        }
+
+        const char *data = buffer.constData() + (pos - bufferStart);
+        const SNC_STORE_RECORD_HEADER *storeHeader = (const SNC_STORE_RECORD_HEADER *)data;
+        const SNC_RECORD_HEADER *recordHeader = (const SNC_RECORD_HEADER *)(storeHeader + 1);
+
+        int size = SNCUtils::convertUC4ToInt((unsigned char *)storeHeader->size);
+        qint64 end = pos + sizeof(SNC_STORE_RECORD_HEADER) + size;
+
+        if ((strncmp(storeHeader->sync, SYNC_STRINGV0, SYNC_LENGTH) != 0) ||
+                (size < (int)sizeof(SNC_RECORD_HEADER)) || (end > dataSize)) {
+            qint64 next = findNextRecord(dataFile, pos + 1, dataSize);
+
+            if (next < 0)
+                break;                                      // nothing good after it so it's the torn tail
+
+            *skipped += next - pos;
+            pos = next;
+            bufferStart = pos;                              // forces a reload at the new position
+            bufferLength = 0;
+            continue;
+        }
+
+        qint64 timestamp = SNCUtils::convertUC8ToInt64((unsigned char *)recordHeader->timestamp);
+
+        newEntries.append((const char *)&pos, sizeof(qint64));
+        newEntries.append((const char *)&timestamp, sizeof(qint64));
+
+        pos = end;
+        *dataEnd = end;
+    }
+
+    return true;
+}
+
+//  findNextRecord searches forward from from for a sync marker that starts a good record.
+//  Returns its position or -1 if there isn't one.
+
+qint64 StoreIndexRecovery::findNextRecord(QFile& dataFile, qint64 from, qint64 dataSize)
+{
+    QByteArray sync(SYNC_STRINGV0, SYNC_LENGTH);
+    QByteArray buffer;
+    qint64 bufferStart = from;
+
+    while (bufferStart + SYNC_LENGTH <= dataSize) {
+        if (!dataFile.seek(bufferStart))
+            return -1;
+
+        buffer = dataFile.read(STORE_RECOVERY_BUFFER_SIZE);
+        if (buffer.length() < SYNC_LENGTH)
+            return -1;
+
+        for (int offset = buffer.indexOf(sync); offset >= 0; offset = buffer.indexOf(sync, offset + 1)) {
+            if (isRecordAt(dataFile, bufferStart + offset, dataSize))
+                return bufferStart + offset;
+        }
+
+        bufferStart += buffer.length() - (SYNC_LENGTH - 1);  // a marker can straddle two blocks
+    }
+    return -1;
+}
+
+//  isRecordAt checks for a complete record at pos. As sync markers can turn up inside
+//  record data, the record must also be followed by another sync marker or the end of
+//  the file.
+
+bool StoreIndexRecovery::isRecordAt(QFile& dataFile, qint64 pos, qint64 dataSize)
+{
+    SNC_STORE_RECORD_HEADER storeHeader;
+    char nextSync[SYNC_LENGTH];
+
+    if (pos + (qint64)(sizeof(SNC_STORE_RECORD_HEADER) + sizeof(SNC_RECORD_HEADER)) > dataSize)
+        return false;
+
+    if (!dataFile.seek(pos) || (dataFile.read((char *)&storeHeader, sizeof(storeHeader)) != sizeof(storeHeader)))
+        return false;
+
+    if (strncmp(storeHeader.sync, SYNC_STRINGV0, SYNC_LENGTH) != 0)
+        return false;
+
+    int size = SNCUtils::convertUC4ToInt(storeHeader.size);
+    qint64 end = pos + sizeof(SNC_STORE_RECORD_HEADER) + size;
+
+    if ((size < (int)sizeof(SNC_RECORD_HEADER)) || (end > dataSize))
+        return false;
+
+    if (end + SYNC_LENGTH > dataSize)
+        return true;                                        // last record, maybe followed by a torn header
+
+    if (!dataFile.seek(end) || (dataFile.read(nextSync, SYNC_LENGTH) != SYNC_LENGTH))
+        return false;
+
+    return strncmp(nextSync, SYNC_STRINGV0, SYNC_LENGTH) == 0;
+}
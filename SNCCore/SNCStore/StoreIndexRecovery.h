@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef STOREINDEXRECOVERY_H
+#define STOREINDEXRECOVERY_H
+
+#include <qstring.h>
+#include <qfile.h>
+
+#include "SNCDefs.h"
+
+#define STORE_RECOVERY_INDEX_ENTRY_SIZE (2 * sizeof(qint64)) // position and timestamp
+#define STORE_RECOVERY_BUFFER_SIZE      (1024 * 1024)       // sequential read size for the scan
+
+typedef struct
+{
+    qint64 dataSize;                                        // original .srf size
+    qint64 indexEntries;                                    // original complete .srx entries
+    qint64 validEntries;                                    // index entries that were found to be good
+    qint64 rebuiltEntries;                                  // entries recovered from the data file
+    qint64 validDataSize;                                   // end of the last complete record
+    qint64 skippedBytes;                                    // corrupt bytes between good records that were not indexed
+    bool indexPartial;                                      // the index ended in a partial entry
+    bool repaired;                                          // files were changed
+    QString error;                                          // empty if the files could be checked
+} STORE_RECOVERY_RESULT;
+
+//  StoreIndexRecovery makes an .srx index consistent with its .srf data file after a
+//  crash. The tail of the index is checked against the record headers it points to. The
+//  data after the last good entry is then scanned sequentially for sync markers to
+//  rebuild the missing entries. A corrupt record is skipped by searching forward for the
+//  next good one, so only a torn tail with no good records after it is truncated.
+
+class StoreIndexRecovery
+{
+public:
+    static QString indexPath(const QString& srfPath);
+
+//  check returns false if the files could not be read or repaired. result->repaired is
+//  only set if repair is true and something needed fixing.
+
+    static bool check(const QString& srfPath, bool repair, STORE_RECOVERY_RESULT *result);
+
+    static bool needsRepair(const STORE_RECOVERY_RESULT *result);
+
+private:
+    static qint64 lastValidEntry(QFile& dataFile, QFile& indexFile, qint64 entries, qint64 *dataEnd);
+    static bool scanData(QFile& dataFile, qint64 start, QByteArray& newEntries, qint64 *dataEnd, qint64 *skipped);
+    static qint64 findNextRecord(QFile& dataFile, qint64 from, qint64 dataSize);
+    static bool isRecordAt(QFile& dataFile, qint64 pos, qint64 dataSize);
+};
+
+#endif // STOREINDEXRECOVERY_H
@@ -25,30 +25,18 @@
 
 #include "SNCStore.h"
 #include "StoreManager.h"
+#include "StoreWorkerPool.h"
 #include "StoreBlocksRaw.h"
 #include "StoreBlocksStructured.h"
 
 #define TAG "StoreManager"
 
 StoreManager::StoreManager(StoreStream *stream)
-    : SNCThread(QString(TAG))
 {
     m_stream = stream;
     m_store = NULL;
-    m_timerID = -1;
-}
-
-StoreManager::~StoreManager()
-{
-    if (m_store) {
-        delete m_store;
-        m_store = NULL;
-    }
-}
-
-void StoreManager::initThread()
-{
-    QMutexLocker lock(&m_workMutex);
+    m_started = false;
+    m_lastFlush = SNCUtils::clock();
 
     switch (m_stream->storeFormat()) {
     case structuredFileFormat:
@@ -64,17 +52,29 @@ void StoreManager::initThread()
         break;
     }
 
-    if (m_store)
-        m_timerID = startTimer(SNC_CLOCKS_PER_SEC);
+    if (m_store != NULL)
+        m_store->setManager(this);
 }
 
-void StoreManager::finishThread()
+StoreManager::~StoreManager()
 {
-    QMutexLocker lock(&m_workMutex);
+    stop();
+}
 
-    if (m_timerID > 0) {
-        killTimer(m_timerID);
-        m_timerID = -1;
+void StoreManager::start()
+{
+    if (m_store == NULL)
+        return;
+
+    m_started = true;
+    StoreWorkerPool::instance()->add(this);
+}
+
+void StoreManager::stop()
+{
+    if (m_started) {
+        StoreWorkerPool::instance()->remove(this);
+        m_started = false;
     }
 
     if (m_store) {
@@ -85,31 +85,57 @@ void StoreManager::finishThread()
     m_stream = NULL;
 }
 
-void StoreManager::stop()
+//  The record is written straight from the received message, there is no copy. If the
+//  stream's queue is full the record is dropped and counted apart from the records queued.
+
+void StoreManager::queueBlock(SNC_EHEAD *message, int length)
 {
-    QMutexLocker lock(&m_workMutex);
+    if (m_store == NULL) {
+        free(message);
+        return;
+    }
 
-    if (m_store) {
-        delete m_store;
-        m_store = NULL;
+    StoreBlock *block = new StoreBlock(message, length);
+
+    if (!m_store->queueBlock(block)) {
+        delete block;
+        m_stream->updateDrops(length);
+        return;
     }
 
-    m_stream = NULL;
+    m_stream->updateStats(length);
+
+    StoreWorkerPool::instance()->queued(this);
+}
+
+qint64 StoreManager::queuedBytes()
+{
+    return (m_store != NULL) ? m_store->queuedBytes() : 0;
 }
 
-void StoreManager::queueBlock(QByteArray block)
+bool StoreManager::ioBusy()
+{
+    return (m_store != NULL) && m_store->ioBusy();
+}
+
+//  Streams with nothing queued still get flushed now and then so that rotation and
+//  deletion happen on time. Nothing is due while the last flush is still being written -
+//  the I/O completion brings the stream back. The pool only calls this and flush between
+//  add and remove so m_store can't go away underneath them.
+
+bool StoreManager::flushDue(qint64 now, qint64 bytes, qint64 age, qint64 idle)
 {
-    if (m_store)
-        m_store->queueBlock(block);
+    if ((m_store == NULL) || m_store->ioBusy())
+        return false;
 
-    if (m_stream)
-        m_stream->updateStats(block.length());
+    return m_store->flushDue(now, bytes, age) || ((now - m_lastFlush) >= idle);
 }
 
-void StoreManager::timerEvent(QTimerEvent *)
+void StoreManager::flush()
 {
-    QMutexLocker lock(&m_workMutex);
+    if (m_store == NULL)
+        return;
 
-    if (m_store)
-        m_store->processQueue();
+    m_lastFlush = SNCUtils::clock();
+    m_store->processQueue();
 }
@@ -24,31 +24,32 @@
 #ifndef STOREDISKMANAGER_H
 #define STOREDISKMANAGER_H
 
-#include <qmutex.h>
-
 #include "StoreStore.h"
 
-class StoreManager : public SNCThread
+//  StoreManager owns the StoreStore for one stream. Its queue is flushed by the shared
+//  StoreWorkerPool rather than a thread of its own.
+
+class StoreManager
 {
 public:
     StoreManager(StoreStream *stream);
     ~StoreManager();
 
-    void queueBlock(QByteArray block);
-    void stop();
+    void start();                                           // registers with the worker pool
+    void queueBlock(SNC_EHEAD *message, int length);       // takes ownership of message
+    void stop();                                            // waits for a flush in progress to finish
 
-protected:
-    void initThread();
-    void timerEvent(QTimerEvent *event);
-    void finishThread();
+    qint64 queuedBytes();
+    bool ioBusy();                                          // true while the last flush is being written
+    bool flushDue(qint64 now, qint64 bytes, qint64 age, qint64 idle);
+    void flush();                                           // called on a worker thread
 
 private:
     StoreStream *m_stream;
     StoreStore *m_store;
+    bool m_started;
 
-    int m_timerID;
-
-    QMutex m_workMutex;
+    qint64 m_lastFlush;                                     // SNCUtils::clock() of the last flush
 };
 
 #endif // STOREDISKMANAGER_H
@@ -0,0 +1,154 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "SNCUtils.h"
+#include "SNCStore.h"
+#include "StoreRetention.h"
+
+#include <qstorageinfo.h>
+
+#define TAG "StoreRetention"
+
+StoreRetention::StoreRetention()
+    : SNCThread(QString(TAG))
+{
+    QSettings *settings = SNCUtils::getSettings();
+
+    m_rootDirectory = settings->value(SNCSTORE_PARAMS_ROOT_DIRECTORY).toString();
+    m_quota = settings->value(SNCSTORE_PARAMS_QUOTA).toLongLong() * 1000 * 1000;
+    m_minFree = settings->value(SNCSTORE_PARAMS_MIN_FREE).toLongLong() * 1000 * 1000;
+
+    delete settings;
+
+    if (m_rootDirectory.length() == 0)
+        m_rootDirectory = "./";
+    if (m_quota < 0)
+        m_quota = 0;
+    if (m_minFree < 0)
+        m_minFree = 0;
+
+    m_timerID = -1;
+}
+
+void StoreRetention::initThread()
+{
+    if ((m_quota > 0) || (m_minFree > 0)) {
+        SNCUtils::logInfo(TAG, QString("Quota %1 MB, minimum free %2 MB")
+                          .arg(m_quota / (1000 * 1000)).arg(m_minFree / (1000 * 1000)));
+        m_timerID = startTimer(STORERETENTION_INTERVAL);
+    }
+}
+
+void StoreRetention::finishThread()
+{
+    if (m_timerID > 0) {
+        killTimer(m_timerID);
+        m_timerID = -1;
+    }
+}
+
+void StoreRetention::addStream(StoreStream *stream)
+{
+    QMutexLocker lock(&m_lock);
+
+    m_streams.append(stream);
+}
+
+void StoreRetention::removeStream(StoreStream *stream)
+{
+    QMutexLocker lock(&m_lock);
+
+    m_streams.removeAll(stream);
+}
+
+bool StoreRetention::overLimit(qint64 used)
+{
+    if ((m_quota > 0) && (used > m_quota))
+        return true;
+
+    if (m_minFree > 0) {
+        QStorageInfo storage(m_rootDirectory);
+
+        if (storage.isValid() && (storage.bytesAvailable() < m_minFree))
+            return true;
+    }
+
+    return false;
+}
+
+//  pickVictim chooses the stream with the highest usage per unit of weight that still
+//  has a closed file it can give up without going below its minimum
+
+StoreStream *StoreRetention::pickVictim()
+{
+    STORE_CATALOG_ENTRY oldest;
+    StoreStream *victim = NULL;
+    double victimShare = 0;
+
+    for (int i = 0; i < m_streams.count(); i++) {
+        StoreStream *stream = m_streams.at(i);
+        qint64 retained = stream->retainedBytes();
+
+        if (!stream->oldestFile(&oldest))
+            continue;
+
+        if ((retained - oldest.size) < stream->retentionMinBytes())
+            continue;
+
+        double share = (double)(retained + stream->currentBytes()) / stream->retentionWeight();
+
+        if ((victim == NULL) || (share > victimShare)) {
+            victim = stream;
+            victimShare = share;
+        }
+    }
+
+    return victim;
+}
+
+void StoreRetention::timerEvent(QTimerEvent *)
+{
+    QMutexLocker lock(&m_lock);
+    qint64 used = 0;
+
+    for (int i = 0; i < m_streams.count(); i++)
+        used += m_streams.at(i)->retainedBytes() + m_streams.at(i)->currentBytes();
+
+    for (int deletes = 0; deletes < STORERETENTION_MAX_DELETES; deletes++) {
+        if (!overLimit(used))
+            return;
+
+        StoreStream *victim = pickVictim();
+        STORE_CATALOG_ENTRY oldest;
+
+        if ((victim == NULL) || !victim->oldestFile(&oldest)) {
+            SNCUtils::logWarn(TAG, "Over the storage limit but no file can be deleted");
+            return;
+        }
+
+        if (victim->deleteOldestFile(oldest.path)) {
+            SNCUtils::logInfo(TAG, QString("Deleted %1 based on store quota").arg(oldest.path));
+            used -= oldest.size;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef STORERETENTION_H
+#define STORERETENTION_H
+
+#include <qmutex.h>
+#include <qlist.h>
+
+#include "SNCThread.h"
+#include "StoreStream.h"
+
+#define STORERETENTION_INTERVAL         (SNC_CLOCKS_PER_SEC * 2)    // time between checks
+#define STORERETENTION_MAX_DELETES      8                   // files deleted per check at most
+
+//  StoreRetention enforces a byte quota across all streams and a minimum amount of free
+//  space on the store's disk. It runs on its own thread and deletes only a few files per
+//  check so the writers never wait on it.
+//
+//  When something has to go, the victim is the oldest closed file of the stream using the
+//  most space relative to its weight. A stream is never taken below its minimum.
+
+class StoreRetention : public SNCThread
+{
+public:
+    StoreRetention();
+
+    void addStream(StoreStream *stream);
+    void removeStream(StoreStream *stream);                 // waits if a check is running
+
+protected:
+    void initThread();
+    void timerEvent(QTimerEvent *event);
+    void finishThread();
+
+private:
+    bool overLimit(qint64 used);
+    StoreStream *pickVictim();
+
+    QMutex m_lock;
+    QList<StoreStream *> m_streams;
+
+    QString m_rootDirectory;
+    qint64 m_quota;                                         // bytes, 0 for none
+    qint64 m_minFree;                                       // bytes, 0 for none
+    int m_timerID;
+};
+
+#endif // STORERETENTION_H
@@ -37,8 +37,8 @@ void StoreStatus::getDialog(QJsonObject& newDialog)
     QStringList data;
     StoreStream ss;
 
-    headers << "" << "In use" << "Stream" << "Total recs" << "Total bytes" << "File recs" << "File bytes" << "Current file path";
-    widths << 80 << 60 << 140 << 80 << 100 << 80 << 100 << 400;
+    headers << "" << "In use" << "Stream" << "Total recs" << "Total bytes" << "File recs" << "File bytes" << "Dropped recs" << "Current file path";
+    widths << 80 << 60 << 140 << 80 << 100 << 80 << 100 << 80 << 400;
 
     for (int i = 0; i < SNCSTORE_MAX_STREAMS; i++) {
         if (!StoreStream::streamIndexInUse(i) || !m_storeClient->getStoreStream(i, &ss)) {
@@ -50,6 +50,7 @@ void StoreStatus::getDialog(QJsonObject& newDialog)
             data.append("");
             data.append("");
             data.append("");
+            data.append("");
         } else {
             data.append("Configure");
             data.append("yes");
@@ -58,6 +59,7 @@ void StoreStatus::getDialog(QJsonObject& newDialog)
             data.append(QString::number(ss.rxTotalBytes()));
             data.append(QString::number(ss.rxRecords()));
             data.append(QString::number(ss.rxBytes()));
+            data.append(QString::number(ss.rxDroppedRecords()));
             data.append(ss.currentFile());
         }
     }
@@ -21,21 +21,156 @@
 //  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
 //  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
+#include "SNCUtils.h"
+#include "SNCStore.h"
 #include "StoreStore.h"
+#include "StoreWorkerPool.h"
+
+#define TAG "StoreStore"
 
 StoreStore::StoreStore(StoreStream *stream)
 {
     m_stream = stream;
+    m_manager = NULL;
+    m_io = StoreIO::instance();
+    m_ioPending = 0;
+    m_ioFailed = 0;
+
+    QSettings *settings = SNCUtils::getSettings();
+    QString policy = settings->value(SNCSTORE_PARAMS_SYNC_POLICY).toString().toLower();
+
+    if (policy == SNCSTORE_PARAMS_SYNC_POLICY_FLUSH)
+        m_syncPolicy = flushSync;
+    else if (policy == SNCSTORE_PARAMS_SYNC_POLICY_INTERVAL)
+        m_syncPolicy = intervalSync;
+    else
+        m_syncPolicy = noSync;
+
+    m_syncInterval = settings->value(SNCSTORE_PARAMS_SYNC_INTERVAL, SNCSTORE_PARAMS_SYNC_INTERVAL_DEFAULT).toInt();
+    if (m_syncInterval < 1)
+        m_syncInterval = 1;
+    m_syncInterval *= 1000;
+
+    delete settings;
+
+    m_lastSync.start();
 }
 
 StoreStore::~StoreStore()
 {
 }
 
-void StoreStore::queueBlock(QByteArray block)
+void StoreStore::setManager(StoreManager *manager)
+{
+    m_manager = manager;
+}
+
+bool StoreStore::queueBlock(StoreBlock *block)
 {
-    QMutexLocker lock(&m_blockMutex);
+    return m_blocks.enqueue(block);
+}
 
-    if (m_blocks.count() < 128)
-        m_blocks.enqueue(block);
+qint64 StoreStore::queuedBytes()
+{
+    return m_blocks.bytes();
+}
+
+bool StoreStore::flushDue(qint64 now, qint64 bytes, qint64 age)
+{
+    qint64 oldest = m_blocks.oldest();
+
+    if (oldest < 0)
+        return false;
+
+    return (m_blocks.bytes() >= bytes) || ((now - oldest) >= age);
+}
+
+void StoreStore::takeBlocks(QList<StoreBlock *>& blocks)
+{
+    m_blocks.dequeueAll(blocks);
+}
+
+bool StoreStore::openFile(StoreFile& file, const QString& path)
+{
+    if (file.isOpen() && (file.path() == path))
+        return true;
+
+    closeFile(file);
+
+    if (!file.open(path)) {
+        SNCUtils::logWarn(TAG, QString("Failed opening file %1").arg(path));
+        return false;
+    }
+    return true;
+}
+
+void StoreStore::closeFile(StoreFile& file)
+{
+    file.close(m_syncPolicy != noSync);
+}
+
+bool StoreStore::syncDue()
+{
+    if (m_syncPolicy == noSync)
+        return false;
+
+    if ((m_syncPolicy == intervalSync) && (m_lastSync.elapsed() < m_syncInterval))
+        return false;
+
+    m_lastSync.restart();
+    return true;
+}
+
+bool StoreStore::ioBusy()
+{
+    return m_ioPending.loadAcquire() != 0;
+}
+
+bool StoreStore::takeIOFailure()
+{
+    return m_ioFailed.testAndSetOrdered(1, 0);
+}
+
+void StoreStore::submitRequest(StoreIORequest *request)
+{
+    if (request->isEmpty()) {
+        delete request;
+        return;
+    }
+
+    m_ioPending.storeRelease(1);
+
+    if (m_io != NULL) {
+        m_io->submit(request);
+    } else {
+        StoreIO::execute(request);
+        ioComplete(request);
+    }
+}
+
+//  ioComplete releases the request's buffers. A failure is picked up by the next
+//  processQueue which reopens the files. Once m_ioPending is clear the store may be
+//  deleted by the stream's owner so only the saved manager pointer is used after that,
+//  and the pool only uses it to look up a manager it still has.
+
+void StoreStore::ioComplete(StoreIORequest *request)
+{
+    StoreManager *manager = m_manager;
+
+    if (request->failedOp >= 0) {
+        SNCUtils::logWarn(TAG, QString("Failed writing %1").arg(request->ops.at(request->failedOp).file->path()));
+        m_ioFailed.storeRelease(1);
+    }
+
+    delete request;
+    m_ioPending.storeRelease(0);
+
+    if ((m_io != NULL) && (manager != NULL))
+        StoreWorkerPool::instance()->ioDone(manager);
+}
+
+void StoreStore::waitForIO()
+{
+    while (ioBusy())
+        QThread::msleep(1);
 }
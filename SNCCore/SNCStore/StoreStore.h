@@ -24,25 +24,61 @@
 #ifndef STORESTORE_H
 #define STORESTORE_H
 
-#include <qmutex.h>
-#include <qqueue.h>
+#include <qelapsedtimer.h>
+#include <qatomic.h>
 
 #include "StoreStream.h"
+#include "StoreFile.h"
+#include "StoreIO.h"
+#include "StoreBlock.h"
 
-class StoreStore
+enum StoreSyncPolicy { noSync, flushSync, intervalSync };
+
+class StoreManager;
+
+//  StoreStore writes a stream's queued blocks. Each flush becomes one StoreIORequest which
+//  is handed to the shared StoreIO backend, or carried out directly if there isn't one.
+//  Only one request per stream is in flight so the files are written in order. While it
+//  is, the worker pool leaves the stream alone and the request's completion hands the
+//  stream back to the pool.
+
+class StoreStore : public StoreIOClient
 {
 public:
     StoreStore(StoreStream *stream);
     virtual ~StoreStore();
 
-    virtual void queueBlock(QByteArray block);
+    void setManager(StoreManager *manager);                 // the manager the pool schedules for this store
+    bool queueBlock(StoreBlock *block);                     // takes the block unless the queue is full
     virtual void processQueue() = 0;
 
+    qint64 queuedBytes();
+    bool ioBusy();                                          // true while the last request is in flight
+    bool flushDue(qint64 now, qint64 bytes, qint64 age);   // true if the queue has reached either limit
+
+    void ioComplete(StoreIORequest *request);
+
 protected:
+    void takeBlocks(QList<StoreBlock *>& blocks);           // moves the queued blocks to blocks
+    bool openFile(StoreFile& file, const QString& path);    // keeps file open unless the path has changed
+    bool syncDue();                                         // true if the sync policy wants a sync with this flush
+    void closeFile(StoreFile& file);
+
+    bool takeIOFailure();                                   // true once after a request failed
+    void submitRequest(StoreIORequest *request);
+    void waitForIO();                                       // subclass destructors must call this first
+
     StoreStream *m_stream;
+    StoreManager *m_manager;
+    StoreIO *m_io;                                          // NULL for synchronous I/O
+    QAtomicInt m_ioPending;
+    QAtomicInt m_ioFailed;
+
+    StoreSyncPolicy m_syncPolicy;
+    qint64 m_syncInterval;                                  // in ms for intervalSync
+    QElapsedTimer m_lastSync;
 
-    QMutex m_blockMutex;
-    QQueue<QByteArray> m_blocks;
+    StoreBlockQueue m_blocks;
 };
 
 #endif // STORESTORE_H
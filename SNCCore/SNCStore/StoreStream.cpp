@@ -34,6 +34,9 @@
 
 #define TAG "StoreStream"
 
+QMutex StoreStream::m_lookupLock;
+QList<StoreStream *> StoreStream::m_lookup;
+
 // static function
 // This limitation based on static entries in the settings file
 // is going away. This is a temporary way to hide it.
@@ -98,6 +101,9 @@ StoreStream::StoreStream()
     m_deletionTime = 2;
     m_deletionCount = 5;
 
+    m_retentionWeight = 1;
+    m_retentionMinBytes = 0;
+
     setCurrentStart(QDateTime::currentDateTime());
 
     clearStats();
@@ -120,6 +126,9 @@ StoreStream::StoreStream(const QString& logTag)
     m_deletionTime = 2;
     m_deletionCount = 5;
 
+    m_retentionWeight = 1;
+    m_retentionMinBytes = 0;
+
     setCurrentStart(QDateTime::currentDateTime());
 
     clearStats();
@@ -151,6 +160,9 @@ StoreStream& StoreStream::operator=(const StoreStream &rhs)
         m_deletionTime = rhs.m_deletionTime;
         m_deletionCount = rhs.m_deletionCount;
 
+        m_retentionWeight = rhs.m_retentionWeight;
+        m_retentionMinBytes = rhs.m_retentionMinBytes;
+
         m_currentFile = rhs.m_currentFile;
         m_currentFileFullPath = rhs.m_currentFileFullPath;
         m_currentIndexFileFullPath = rhs.m_currentIndexFileFullPath;
@@ -162,6 +174,8 @@ StoreStream& StoreStream::operator=(const StoreStream &rhs)
         m_rxTotalBytes = rhs.m_rxTotalBytes;
         m_rxRecords = rhs.m_rxRecords;
         m_rxBytes = rhs.m_rxBytes;
+        m_rxDroppedRecords = rhs.m_rxDroppedRecords;
+        m_rxDroppedBytes = rhs.m_rxDroppedBytes;
     }
 
     return *this;
@@ -227,29 +241,30 @@ void StoreStream::doRotation()
     QDateTime now = QDateTime::currentDateTime();
     setCurrentStart(now);
 
-    if (m_storeFormat == rawFileFormat) {
-        m_fileMutex.lock();
-        m_currentFile = QString(m_filePrefix + m_current.toString("yyyyMMdd_hhmm.")
-            + SNC_RECORD_FLAT_EXT);
+    m_fileMutex.lock();
 
-        m_currentFileFullPath = m_storePath + m_currentFile;
+    QString previousFile = m_currentFileFullPath;
 
-        checkDeletion(now);
-        m_fileMutex.unlock();
-    } else if (m_storeFormat == structuredFileFormat) {
-        m_fileMutex.lock();
-
-        m_currentFile = QString(m_filePrefix + m_current.toString("yyyyMMdd_hhmm.")
-            + SNC_RECORD_SRF_RECORD_EXT);
-
-        m_currentFileFullPath = m_storePath + m_currentFile;
+    m_currentFile = QString(m_filePrefix + m_current.toString("yyyyMMdd_hhmm.") + fileExtension());
+    m_currentFileFullPath = m_storePath + m_currentFile;
 
+    if (m_storeFormat == structuredFileFormat)
         m_currentIndexFileFullPath = QString(m_storePath + m_filePrefix
             + m_current.toString("yyyyMMdd_hhmm.") + SNC_RECORD_SRF_INDEX_EXT);
 
-        checkDeletion(now);
-        m_fileMutex.unlock();
-    }
+    // the catalogue is normally built when the stream is loaded and then kept up to date here.
+    // A restart within the same minute reopens a catalogued file so that one is not closed yet.
+
+    if (!m_catalog.isBuilt())
+        m_catalog.build(m_storePath, m_filePrefix, fileExtension(), m_currentFileFullPath);
+    else
+        m_catalog.remove(m_currentFileFullPath);
+
+    if (!previousFile.isEmpty() && (previousFile != m_currentFileFullPath))
+        m_catalog.add(previousFile);
+
+    checkDeletion(now);
+    m_fileMutex.unlock();
 
     m_statMutex.lock();
     m_rxRecords = 0;
@@ -257,6 +272,11 @@ void StoreStream::doRotation()
     m_statMutex.unlock();
 }
 
+QString StoreStream::fileExtension()
+{
+    return (m_storeFormat == rawFileFormat) ? SNC_RECORD_FLAT_EXT : SNC_RECORD_SRF_RECORD_EXT;
+}
+
 void StoreStream::setCurrentStart(QDateTime now)
 {
     if (m_rotationPolicy != timeRotation && m_rotationPolicy != anyRotation) {
@@ -316,60 +336,88 @@ bool StoreStream::needSizeRotation()
     return false;
 }
 
+//  checkDeletion removes the oldest files until the retention policy is met. The catalogue
+//  is in age order so only its head is ever looked at.
+
 void StoreStream::checkDeletion(QDateTime now)
 {
-    QDir dir;
-
-    if (!dir.cd(m_storePath)) {
-        SNCUtils::logError(TAG, QString("Failed to open store path %1").arg(m_storePath));
-        return;
-    }
-    dir.setFilter(QDir::Files | QDir::NoDotAndDotDot);
-    dir.setSorting(QDir::Time | QDir::Reversed);
-
-    QStringList filters;
-
-    if (m_storeFormat == rawFileFormat)
-        filters << QString("*.") + SNC_RECORD_FLAT_EXT;
-    else if (m_storeFormat == structuredFileFormat)
-        filters << QString("*.") + SNC_RECORD_SRF_RECORD_EXT;
-
-    dir.setNameFilters(filters);
-
-    QFileInfoList list = dir.entryInfoList();
-    for (int i = 0; i < list.size(); i++) {
+    while (m_catalog.count() > 0) {
+        const STORE_CATALOG_ENTRY& oldest = m_catalog.oldest();
         bool deleteFile = false;
 
-        QFileInfo fileInfo = list.at(i);
-        QString fileName = fileInfo.absoluteFilePath();
-
         if ((m_deletionPolicy == countDeletion) || (m_deletionPolicy == anyDeletion)) {
-            if ((list.size() - i) > m_deletionCount) {
-                SNCUtils::logInfo(TAG, QString("Deleting %1 based on count").arg(fileName));
+            if (m_catalog.count() > m_deletionCount) {
+                SNCUtils::logInfo(TAG, QString("Deleting %1 based on count").arg(oldest.path));
                 deleteFile = true;
             }
         }
 
-        if ((m_deletionPolicy == timeDeletion) || (m_deletionPolicy == anyDeletion)) {
-            qint32 age = fileInfo.lastModified().secsTo(now);
+        if (!deleteFile && ((m_deletionPolicy == timeDeletion) || (m_deletionPolicy == anyDeletion))) {
+            qint32 age = oldest.modified.secsTo(now);
             if (age >= m_deletionSecs) {
-                SNCUtils::logInfo(TAG, QString("Deleting %1 based on age").arg(fileName));
+                SNCUtils::logInfo(TAG, QString("Deleting %1 based on age").arg(oldest.path));
                 deleteFile = true;
             }
         }
 
-        if (deleteFile) {
-            QFile file;
-            file.remove(fileName);
-            if (m_storeFormat == structuredFileFormat) {
-                fileName.truncate(fileName.length() - QString(SNC_RECORD_SRF_RECORD_EXT).length());
-                fileName += SNC_RECORD_SRF_INDEX_EXT;
-                file.remove(fileName);
-            }
-        }
+        if (!deleteFile)
+            break;
+
+        m_catalog.deleteOldest();
     }
 }
 
+qint64 StoreStream::retainedBytes()
+{
+    QMutexLocker lock(&m_fileMutex);
+
+    return m_catalog.totalBytes();
+}
+
+qint64 StoreStream::currentBytes()
+{
+    QMutexLocker lock(&m_fileMutex);
+    qint64 bytes = 0;
+
+    if (m_currentFileFullPath.length() > 0)
+        bytes += QFileInfo(m_currentFileFullPath).size();
+    if ((m_storeFormat == structuredFileFormat) && (m_currentIndexFileFullPath.length() > 0))
+        bytes += QFileInfo(m_currentIndexFileFullPath).size();
+
+    return bytes;
+}
+
+bool StoreStream::oldestFile(STORE_CATALOG_ENTRY *entry)
+{
+    QMutexLocker lock(&m_fileMutex);
+
+    if (m_catalog.count() == 0)
+        return false;
+
+    *entry = m_catalog.oldest();
+    return true;
+}
+
+bool StoreStream::deleteOldestFile(const QString& path)
+{
+    QMutexLocker lock(&m_fileMutex);
+
+    if ((m_catalog.count() == 0) || (m_catalog.oldest().path != path))
+        return false;
+
+    return m_catalog.deleteOldest();
+}
+
+int StoreStream::retentionWeight()
+{
+    return m_retentionWeight;
+}
+
+qint64 StoreStream::retentionMinBytes()
+{
+    return m_retentionMinBytes;
+}
+
 QString StoreStream::currentFile()
 {
     QMutexLocker lock(&m_fileMutex);
@@ -401,6 +449,88 @@ QString StoreStream::srfIndexFullPath()
     return m_currentIndexFileFullPath;
 }
 
+QStringList StoreStream::srfFileList()
+{
+    QStringList files;
+    QDir dir(m_storePath);
+    QRegularExpression pattern = StoreCatalog::fileNamePattern(m_filePrefix, SNC_RECORD_SRF_RECORD_EXT);
+
+    dir.setFilter(QDir::Files | QDir::NoDotAndDotDot);
+    dir.setSorting(QDir::Name);
+    dir.setNameFilters(QStringList(m_filePrefix + SNC_RECORD_SRF_RECORD_FILTER));
+
+    QFileInfoList list = dir.entryInfoList();
+
+    for (int i = 0; i < list.count(); i++) {
+        if (pattern.match(list.at(i).fileName()).hasMatch())
+            files.append(list.at(i).absoluteFilePath());
+    }
+
+    return files;
+}
+
+//  buildCatalog lists the stream's existing files when it is loaded so that retention and
+//  time lookups see them even if the stream never receives anything
+
+void StoreStream::buildCatalog()
+{
+    QMutexLocker lock(&m_fileMutex);
+
+    m_catalog.build(m_storePath, m_filePrefix, fileExtension(), m_currentFileFullPath);
+}
+
+bool StoreStream::ownsFile(const QString& path)
+{
+    QFileInfo info(path);
+
+    if (QDir::cleanPath(info.absolutePath()) != QDir::cleanPath(QDir(m_storePath).absolutePath()))
+        return false;
+
+    return StoreCatalog::fileNamePattern(m_filePrefix, fileExtension()).match(info.fileName()).hasMatch();
+}
+
+//  fileForTime looks through the closed files first. Anything later than those can only
+//  be in the file being written.
+
+QString StoreStream::fileForTime(qint64 time)
+{
+    QMutexLocker lock(&m_fileMutex);
+
+    int index = m_catalog.findTime(time);
+
+    if (index < 0)
+        return m_currentFileFullPath;
+
+    return m_catalog.entry(index).path;
+}
+
+void StoreStream::addLookup(StoreStream *stream)
+{
+    QMutexLocker lock(&m_lookupLock);
+
+    if (!m_lookup.contains(stream))
+        m_lookup.append(stream);
+}
+
+void StoreStream::removeLookup(StoreStream *stream)
+{
+    QMutexLocker lock(&m_lookupLock);
+
+    m_lookup.removeAll(stream);
+}
+
+QString StoreStream::streamFileForTime(const QString& path, qint64 time)
+{
+    QMutexLocker lock(&m_lookupLock);
+
+    for (int i = 0; i < m_lookup.count(); i++) {
+        if (m_lookup.at(i)->ownsFile(path))
+            return m_lookup.at(i)->fileForTime(time);
+    }
+
+    return QString();
+}
+
 void StoreStream::updateStats(int recordLength)
 {
     QMutexLocker lock(&m_statMutex);
@@ -411,6 +541,14 @@ void StoreStream::updateStats(int recordLength)
     m_rxBytes += recordLength;
 }
 
+void StoreStream::updateDrops(int recordLength)
+{
+    QMutexLocker lock(&m_statMutex);
+
+    m_rxDroppedRecords++;
+    m_rxDroppedBytes += recordLength;
+}
+
 qint64 StoreStream::rxTotalRecords()
 {
     QMutexLocker lock(&m_statMutex);
@@ -439,6 +577,20 @@ qint64 StoreStream::rxBytes()
     return m_rxBytes;
 }
 
+qint64 StoreStream::rxDroppedRecords()
+{
+    QMutexLocker lock(&m_statMutex);
+
+    return m_rxDroppedRecords;
+}
+
+qint64 StoreStream::rxDroppedBytes()
+{
+    QMutexLocker lock(&m_statMutex);
+
+    return m_rxDroppedBytes;
+}
+
 void StoreStream::clearStats()
 {
     QMutexLocker lock(&m_statMutex);
@@ -447,6 +599,8 @@ void StoreStream::clearStats()
     m_rxTotalBytes = 0;
     m_rxRecords = 0;
     m_rxBytes = 0;
+    m_rxDroppedRecords = 0;
+    m_rxDroppedBytes = 0;
 }
 
 bool StoreStream::folderWritable()
@@ -620,5 +774,16 @@ bool StoreStream::load(QSettings *settings, const QString& rootDirectory)
             m_deletionCount = 2;
     }
 
+    //  Share of the store wide quota
+
+    m_retentionWeight = settings->value(SNCSTORE_PARAMS_RETENTION_WEIGHT, 1).toInt();
+    if (m_retentionWeight < 1)
+        m_retentionWeight = 1;
+
+    m_retentionMinBytes = settings->value(SNCSTORE_PARAMS_RETENTION_MIN, 0).toLongLong();
+    if (m_retentionMinBytes < 0)
+        m_retentionMinBytes = 0;
+    m_retentionMinBytes *= 1000 * 1000;
+
     return true;
 }
@@ -28,8 +28,11 @@
 #include <qmutex.h>
 #include <qdatetime.h>
 #include <qqueue.h>
+#include <qstringlist.h>
 #include <qlabel.h>
 
+#include "StoreCatalog.h"
+
 
 enum StoreFileFormat { structuredFileFormat, rawFileFormat };
 
@@ -51,6 +54,14 @@ public:
     static bool streamIndexValid(int index);
     static bool streamIndexInUse(int index);
 
+//  The running streams are listed so that a CFS time seek can find which of a stream's
+//  files holds a time. streamFileForTime returns the file of the stream that owns path
+//  that holds records at or after time, or an empty string if no stream owns path.
+
+    static void addLookup(StoreStream *stream);
+    static void removeLookup(StoreStream *stream);          // must be called before the stream is deleted
+    static QString streamFileForTime(const QString& path, qint64 time);
+
     QString pathOnly();
     QString streamName();
     StoreFileFormat storeFormat();
@@ -70,12 +81,25 @@ public:
     QString rawFileFullPath();
     QString srfFileFullPath();
     QString srfIndexFullPath();
+    QStringList srfFileList();                              // this stream's existing .srf files
+    void buildCatalog();                                    // lists the files already on disk
+    bool ownsFile(const QString& path);                     // true if path is one of this stream's files
+    QString fileForTime(qint64 time);                       // file holding records at or after time
+    qint64 retainedBytes();                                 // size of the closed files
+    qint64 currentBytes();                                  // size of the file being written
+    bool oldestFile(STORE_CATALOG_ENTRY *entry);            // returns false if there are no closed files
+    bool deleteOldestFile(const QString& path);             // only if path is still the oldest
+    int retentionWeight();
+    qint64 retentionMinBytes();
 
     void updateStats(int recordLength);
+    void updateDrops(int recordLength);                     // a record that didn't fit in the queue
     qint64 rxTotalRecords();
     qint64 rxTotalBytes();
     qint64 rxRecords();
     qint64 rxBytes();
+    qint64 rxDroppedRecords();
+    qint64 rxDroppedBytes();
     void clearStats();
 
     bool load(QSettings *settings, const QString& rootDirectory);
@@ -89,6 +113,7 @@ private:
     bool checkFolderPermissions();
 
     void checkDeletion(QDateTime now);
+    QString fileExtension();
     void setCurrentStart(QDateTime now);
 
     bool m_folderWritable;
@@ -110,6 +135,9 @@ private:
     qint32 m_deletionTime;
     qint64 m_deletionCount;
 
+    int m_retentionWeight;
+    qint64 m_retentionMinBytes;
+
     QString m_currentFile;
     QString m_currentFileFullPath;
     QString m_currentIndexFileFullPath;
@@ -121,14 +149,20 @@ private:
 
     QMutex m_fileMutex;
     QDateTime m_current;
+    StoreCatalog m_catalog;                                 // closed files, guarded by m_fileMutex
 
     QMutex m_statMutex;
     qint64 m_rxTotalRecords;
     qint64 m_rxTotalBytes;
     qint64 m_rxRecords;
     qint64 m_rxBytes;
+    qint64 m_rxDroppedRecords;
+    qint64 m_rxDroppedBytes;
 
     QString m_logTag;
+
+    static QMutex m_lookupLock;
+    static QList<StoreStream *> m_lookup;
 };
 
 #endif // STORESTREAM
@@ -0,0 +1,189 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "SNCUtils.h"
+#include "SNCStore.h"
+#include "StoreWorkerPool.h"
+#include "StoreManager.h"
+
+#define TAG "StoreWorkerPool"
+
+StoreWorker::StoreWorker(StoreWorkerPool *pool)
+{
+    m_pool = pool;
+}
+
+void StoreWorker::run()
+{
+    while (true) {
+        StoreManager *manager = m_pool->next();
+
+        manager->flush();
+        m_pool->done(manager);
+    }
+}
+
+QMutex StoreWorkerPool::m_instanceLock;
+StoreWorkerPool *StoreWorkerPool::m_instance = NULL;
+
+StoreWorkerPool *StoreWorkerPool::instance()
+{
+    QMutexLocker lock(&m_instanceLock);
+
+    if (m_instance == NULL)
+        m_instance = new StoreWorkerPool();
+    return m_instance;
+}
+
+StoreWorkerPool::StoreWorkerPool()
+{
+    QSettings *settings = SNCUtils::getSettings();
+
+    int workers = settings->value(SNCSTORE_PARAMS_WORKERS, STOREWORKERPOOL_DEFAULT_WORKERS).toInt();
+    m_flushBytes = settings->value(SNCSTORE_PARAMS_FLUSH_KB, STOREWORKERPOOL_DEFAULT_FLUSH_KB).toLongLong() * 1000;
+    m_flushAge = settings->value(SNCSTORE_PARAMS_FLUSH_AGE, STOREWORKERPOOL_DEFAULT_FLUSH_AGE).toLongLong();
+
+    delete settings;
+
+    if (workers < 1)
+        workers = 1;
+    else if (workers > STOREWORKERPOOL_MAX_WORKERS)
+        workers = STOREWORKERPOOL_MAX_WORKERS;
+
+    if (m_flushBytes < 1)
+        m_flushBytes = 1;
+    if (m_flushAge < 0)
+        m_flushAge = 0;
+
+    m_lastScan = SNCUtils::clock();
+
+    SNCUtils::logInfo(TAG, QString("%1 store workers, flushing at %2 bytes or %3 ms")
+                      .arg(workers).arg(m_flushBytes).arg(m_flushAge));
+
+    for (int i = 0; i < workers; i++) {
+        m_workers.append(new StoreWorker(this));
+        m_workers.last()->start();
+    }
+}
+
+void StoreWorkerPool::add(StoreManager *manager)
+{
+    QMutexLocker lock(&m_lock);
+
+    m_managers.append(manager);
+}
+
+void StoreWorkerPool::remove(StoreManager *manager)
+{
+    QMutexLocker lock(&m_lock);
+
+    m_managers.removeAll(manager);
+    m_ready.removeAll(manager);
+
+    while (m_active.contains(manager))
+        m_idle.wait(&m_lock);
+
+    m_scheduled.remove(manager);
+}
+
+void StoreWorkerPool::queued(StoreManager *manager)
+{
+    if (manager->queuedBytes() < m_flushBytes)
+        return;
+
+    QMutexLocker lock(&m_lock);
+
+    if (m_managers.contains(manager) && !manager->ioBusy())
+        schedule(manager);
+}
+
+//  ioDone is called on an I/O thread. The manager may already have been removed, so it
+//  is only looked at if it is still in m_managers.
+
+void StoreWorkerPool::ioDone(StoreManager *manager)
+{
+    QMutexLocker lock(&m_lock);
+
+    if (!m_managers.contains(manager) || m_scheduled.contains(manager))
+        return;
+
+    if (manager->flushDue(SNCUtils::clock(), m_flushBytes, m_flushAge, STOREWORKERPOOL_IDLE_INTERVAL))
+        schedule(manager);
+}
+
+void StoreWorkerPool::schedule(StoreManager *manager)
+{
+    if (m_scheduled.contains(manager))
+        return;
+
+    m_scheduled.insert(manager);
+    m_ready.enqueue(manager);
+    m_wake.wakeOne();
+}
+
+void StoreWorkerPool::scan(qint64 now)
+{
+    for (int i = 0; i < m_managers.count(); i++) {
+        StoreManager *manager = m_managers.at(i);
+
+        // a manager being flushed is left alone as only its worker may look at the queue
+
+        if (m_scheduled.contains(manager))
+            continue;
+
+        if (manager->flushDue(now, m_flushBytes, m_flushAge, STOREWORKERPOOL_IDLE_INTERVAL))
+            schedule(manager);
+    }
+    m_lastScan = now;
+}
+
+StoreManager *StoreWorkerPool::next()
+{
+    QMutexLocker lock(&m_lock);
+
+    while (true) {
+        if (!m_ready.isEmpty()) {
+            StoreManager *manager = m_ready.dequeue();
+
+            m_active.insert(manager);
+            return manager;
+        }
+
+        qint64 now = SNCUtils::clock();
+        qint64 wait = m_lastScan + STOREWORKERPOOL_SCAN_INTERVAL - now;
+
+        if (wait <= 0)
+            scan(now);
+        else
+            m_wake.wait(&m_lock, wait);
+    }
+}
+
+void StoreWorkerPool::done(StoreManager *manager)
+{
+    QMutexLocker lock(&m_lock);
+
+    m_active.remove(manager);
+    m_scheduled.remove(manager);
+    m_idle.wakeAll();
+}
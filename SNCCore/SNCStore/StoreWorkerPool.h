@@ -0,0 +1,99 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef STOREWORKERPOOL_H
+#define STOREWORKERPOOL_H
+
+#include <qthread.h>
+#include <qmutex.h>
+#include <qwaitcondition.h>
+#include <qlist.h>
+#include <qqueue.h>
+#include <qset.h>
+
+#define STOREWORKERPOOL_DEFAULT_WORKERS 4                   // threads shared by all streams
+#define STOREWORKERPOOL_MAX_WORKERS     32
+#define STOREWORKERPOOL_DEFAULT_FLUSH_KB    1000            // flush a stream once this much is queued
+#define STOREWORKERPOOL_DEFAULT_FLUSH_AGE   250             // or its oldest block is this many ms old
+#define STOREWORKERPOOL_SCAN_INTERVAL   20                  // ms between checks for aged queues
+#define STOREWORKERPOOL_IDLE_INTERVAL   1000                // ms between flushes of idle streams (for rotation)
+
+class StoreManager;
+class StoreWorkerPool;
+
+class StoreWorker : public QThread
+{
+public:
+    StoreWorker(StoreWorkerPool *pool);
+
+protected:
+    void run();
+
+private:
+    StoreWorkerPool *m_pool;
+};
+
+//  StoreWorkerPool flushes the queues of all streams with a fixed number of threads. A
+//  stream is flushed as soon as its queue reaches the size limit, otherwise when its
+//  oldest block reaches the age limit. Since each stream's age runs from its own first
+//  block, the flushes of different streams are not aligned to a common timer. A stream
+//  whose last flush is still being written is not scheduled. ioDone puts it back as soon
+//  as the write completes if it is due by then.
+
+class StoreWorkerPool
+{
+public:
+    static StoreWorkerPool *instance();
+
+    void add(StoreManager *manager);
+    void remove(StoreManager *manager);                     // waits if a worker is flushing the manager
+    void queued(StoreManager *manager);                     // called when a block has been queued
+    void ioDone(StoreManager *manager);                     // called when a manager's write has completed
+
+    StoreManager *next();                                   // waits for a manager to flush
+    void done(StoreManager *manager);                       // the worker has finished with it
+
+private:
+    StoreWorkerPool();
+
+    void schedule(StoreManager *manager);                   // must be called with m_lock held
+    void scan(qint64 now);                                  // must be called with m_lock held
+
+    static QMutex m_instanceLock;
+    static StoreWorkerPool *m_instance;
+
+    QMutex m_lock;
+    QWaitCondition m_wake;                                  // for the workers
+    QWaitCondition m_idle;                                  // for remove
+    QList<StoreManager *> m_managers;
+    QQueue<StoreManager *> m_ready;
+    QSet<StoreManager *> m_scheduled;                       // in m_ready or being flushed
+    QSet<StoreManager *> m_active;                          // being flushed
+    QList<StoreWorker *> m_workers;
+
+    qint64 m_flushBytes;
+    qint64 m_flushAge;
+    qint64 m_lastScan;
+};
+
+#endif // STOREWORKERPOOL_H
@@ -0,0 +1,332 @@
+'''
+
+  This file is part of SNC
+
+  Copyright (c) 2014-2021, Richard Barnett
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+  Software, and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+'''
+
+#  retention_check.py runs SNCStore against a root directory that already holds more
+#  closed files than the store quota allows and checks what StoreRetention deletes:
+#
+#  - each stream loses its oldest files first
+#  - the stream with three times the retentionWeight keeps about three times the space
+#  - a stream is never taken below its retentionMinMB
+#  - only closed rotation files are deleted, never the file being written or other files
+#
+#  The second case has a quota that can't be met so the streams run out of closed files.
+#
+#  SNCLoopBench provides the SNCServer and the streams.
+#
+#  It needs a built SNCStore and SNCLoopBench and has not been run against them yet. The
+#  timings (TIMEOUT and SETTLE) and the byte counts are estimates that may need adjusting
+#  the first time it is run.
+#
+#  Usage: python3 retention_check.py [path to SNCStore] [path to SNCLoopBench]
+#
+#  The exit code is 0 if every case passed.
+
+import os
+import signal
+import struct
+import subprocess
+import sys
+import tempfile
+import time
+
+SYNC = b'SpRSHdV0'
+MB = 1000 * 1000
+PORT = 16640                                            # away from the SNCLoopBench default
+
+APP_NAME = 'RetentionBench'
+SEEDED_FILES = 10                                       # closed files per stream at the start
+FILE_RECORDS = 10
+RECORD_PAYLOAD = 100000 - 16 - 24                       # so each record is 100000 bytes
+SEEDED_BYTES = FILE_RECORDS * (100000 + 16)             # data plus index of a seeded file
+
+#  (stream, retentionWeight, retentionMinMB)
+
+STREAMS = [
+    ('bench0_0', 3, 0),
+    ('bench1_0', 1, 0),
+    ('bench2_0', 1, 6),
+]
+
+TIMEOUT = 30                                            # seconds to wait for the deletes
+SETTLE = 5                                              # and then to check nothing else goes
+
+
+def makeFile(dataPath, timestamp):
+    data = b''
+    index = b''
+    for i in range(FILE_RECORDS):
+        recordHeader = struct.pack('>HHHHHHIq', 0, 0, 24, 0, 0, 0, i, timestamp + i)
+        body = recordHeader + bytes([i]) * RECORD_PAYLOAD
+        index += struct.pack('<qq', len(data), timestamp + i)
+        data += SYNC + struct.pack('>II', len(body), 0) + body
+    with open(dataPath, 'wb') as f:
+        f.write(data)
+    with open(dataPath[:-4] + '.srx', 'wb') as f:
+        f.write(index)
+
+
+def streamFolder(root, stream):
+    return os.path.join(root, APP_NAME + '_' + stream)
+
+
+def seedStream(root, stream):
+    folder = streamFolder(root, stream)
+    os.makedirs(folder)
+    names = []
+    for i in range(SEEDED_FILES):
+        name = '20200101_%02d%02d.srf' % (i // 60, i % 60)
+        makeFile(os.path.join(folder, name), 1577836800000 + i * 60000)
+        names.append(name)
+    return names
+
+
+#  Files that are not a stream's rotation files must never be touched. The first one
+#  matches *.srf and sorts before the stream's own files.
+
+def seedDecoys(root):
+    decoys = [os.path.join(streamFolder(root, STREAMS[0][0]), '0notes.srf'),
+              os.path.join(root, 'other', '20200101_0000.srf')]
+    os.makedirs(os.path.join(root, 'other'))
+    for path in decoys:
+        makeFile(path, 1577836800000)
+    return decoys
+
+
+def isRotationName(name):
+    return (len(name) == 17) and name.endswith('.srf') and name[:8].isdigit() \
+        and (name[8] == '_') and name[9:13].isdigit()
+
+
+def fileBytes(path):
+    index = path[:-4] + '.srx'
+    size = os.path.getsize(path)
+    if os.path.exists(index):
+        size += os.path.getsize(index)
+    return size
+
+
+def streamFiles(root, stream):
+    folder = streamFolder(root, stream)
+    return sorted(name for name in os.listdir(folder) if isRotationName(name))
+
+
+def streamBytes(root, stream):
+    folder = streamFolder(root, stream)
+    return sum(fileBytes(os.path.join(folder, name)) for name in streamFiles(root, stream))
+
+
+def totalBytes(root):
+    return sum(streamBytes(root, stream) for stream, weight, minMB in STREAMS)
+
+
+def writeSettings(root, path, quotaMB):
+    with open(path, 'w') as f:
+        f.write('[General]\n')
+        f.write('useTunnel=true\n')
+        f.write('tunnelAddr=127.0.0.1\n')
+        f.write('tunnelPort=%d\n' % PORT)
+        f.write('encryptLink=false\n')
+        f.write('UIDUseMAC=false\n')
+        f.write('UID=000000000047\n')
+        f.write('RootDirectory=%s\n' % root)
+        f.write('quotaMB=%d\n' % quotaMB)
+        f.write('minFreeMB=0\n')
+        f.write('\n[Streams]\n')
+        for i, (stream, weight, minMB) in enumerate(STREAMS):
+            prefix = '%d\\' % (i + 1)
+            f.write(prefix + 'inUse=true\n')
+            f.write(prefix + 'stream=%s/%s\n' % (APP_NAME, stream))
+            f.write(prefix + 'storeFormat=srf\n')
+            f.write(prefix + 'createSubFolder=true\n')
+            f.write(prefix + 'rotationPolicy=time\n')
+            f.write(prefix + 'rotationTimeUnits=days\n')
+            f.write(prefix + 'rotationTime=1\n')
+            f.write(prefix + 'deletionPolicy=time\n')
+            f.write(prefix + 'deletionTimeUnits=days\n')
+            f.write(prefix + 'deletionTime=1000\n')
+            f.write(prefix + 'retentionWeight=%d\n' % weight)
+            f.write(prefix + 'retentionMinMB=%d\n' % minMB)
+        f.write('size=%d\n' % len(STREAMS))
+
+
+def runStore(store, loopBench, root, folder, quotaMB, done):
+    settingsPath = os.path.join(folder, 'SNCStore.ini')
+    writeSettings(root, settingsPath, quotaMB)
+
+    bench = subprocess.Popen([loopBench, '-P%d' % len(STREAMS), '-R20', '-B1000', '-W1', '-T%d' % (TIMEOUT + SETTLE + 10),
+                              '-O%d' % PORT, '-n' + APP_NAME, '-s' + os.path.join(folder, 'SNCLoopBench.ini')],
+                             stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+    time.sleep(2)
+
+    # stdin is kept open so that the console doesn't see end of file
+
+    storeProcess = subprocess.Popen([store, '-c', '-s' + settingsPath], stdin=subprocess.PIPE,
+                                    stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+    deadline = time.time() + TIMEOUT
+    while (time.time() < deadline) and not done(root):
+        time.sleep(1)
+    time.sleep(SETTLE)
+
+    storeProcess.send_signal(signal.SIGINT)
+    try:
+        storeProcess.wait(10)
+    except subprocess.TimeoutExpired:
+        storeProcess.kill()
+    bench.kill()
+    bench.wait()
+
+
+#  checkCommon looks at what every case must get right and returns the closed bytes kept
+#  and all the bytes used for each stream
+
+def checkCommon(root, seeded, decoys, errors):
+    kept = {}
+    used = {}
+
+    for stream, weight, minMB in STREAMS:
+        names = streamFiles(root, stream)
+        closed = [name for name in seeded[stream] if name in names]
+        written = [name for name in names if name not in seeded[stream]]
+
+        # oldest first - what is left must be the newest of the seeded files
+
+        if closed != seeded[stream][len(seeded[stream]) - len(closed):]:
+            errors.append('%s: files not deleted oldest first, kept %s' % (stream, ' '.join(closed)))
+
+        # the file being written is not closed so must still be there
+
+        if len(written) == 0:
+            errors.append('%s: the file being written is missing (or no data was received)' % stream)
+
+        kept[stream] = len(closed) * SEEDED_BYTES
+        used[stream] = streamBytes(root, stream)
+
+        if kept[stream] < minMB * MB:
+            errors.append('%s: %d bytes of closed files kept, below retentionMinMB %d' % (stream, kept[stream], minMB))
+
+        if (minMB > 0) and (kept[stream] - SEEDED_BYTES >= minMB * MB):
+            errors.append('%s: %d bytes of closed files kept, it should have been taken down to retentionMinMB %d'
+                          % (stream, kept[stream], minMB))
+
+        print('    %-12s weight %d, min %2d MB: kept %2d of %d closed files, %d bytes in all'
+              % (stream, weight, minMB, len(closed), len(seeded[stream]), used[stream]))
+
+    for path in decoys:
+        if not os.path.exists(path):
+            errors.append('%s was deleted but is not a rotation file of the stream' % path)
+
+    return kept, used
+
+
+#  share - the quota can be met. The two streams without a minimum should share the space
+#  in proportion to their weights, give or take the last file deleted.
+
+SHARE_QUOTA_MB = 15
+
+
+def shareDone(root):
+    return totalBytes(root) <= SHARE_QUOTA_MB * MB
+
+
+def checkShare(root, seeded, decoys):
+    errors = []
+    kept, used = checkCommon(root, seeded, decoys, errors)
+
+    total = sum(used.values())
+    if total > SHARE_QUOTA_MB * MB:
+        errors.append('%d bytes used, over the quota of %d MB' % (total, SHARE_QUOTA_MB))
+
+    weighted = [used[stream] / weight for stream, weight, minMB in STREAMS if minMB == 0]
+    if max(weighted) - min(weighted) > SEEDED_BYTES:
+        errors.append('space is not shared by weight: %s' % ', '.join('%.0f' % w for w in weighted))
+
+    return errors
+
+
+#  exhausted - the quota is less than the files being written so everything that can go
+#  does, but nothing more
+
+EXHAUSTED_QUOTA_MB = 1
+
+
+def exhaustedDone(root):
+    for stream, weight, minMB in STREAMS:
+        if (minMB == 0) and (len(streamFiles(root, stream)) > 1):
+            return False
+    return True
+
+
+def checkExhausted(root, seeded, decoys):
+    errors = []
+    kept, used = checkCommon(root, seeded, decoys, errors)
+
+    for stream, weight, minMB in STREAMS:
+        if (minMB == 0) and (kept[stream] > 0):
+            errors.append('%s: %d bytes of closed files kept, over the quota' % (stream, kept[stream]))
+
+    return errors
+
+
+CASES = [
+    ('share', SHARE_QUOTA_MB, shareDone, checkShare),
+    ('exhausted', EXHAUSTED_QUOTA_MB, exhaustedDone, checkExhausted),
+]
+
+
+def runCase(store, loopBench, name, quotaMB, done, check):
+    print('%s (quota %d MB)' % (name, quotaMB))
+
+    with tempfile.TemporaryDirectory() as folder:
+        root = os.path.join(folder, 'store')
+        os.makedirs(root)
+        seeded = {}
+        for stream, weight, minMB in STREAMS:
+            seeded[stream] = seedStream(root, stream)
+        decoys = seedDecoys(root)
+
+        runStore(store, loopBench, root, folder, quotaMB, done)
+        errors = check(root, seeded, decoys)
+
+    print('%-24s %s' % (name, 'ok' if not errors else 'FAILED'))
+    for error in errors:
+        print('    ' + error)
+    return not errors
+
+
+def main():
+    store = sys.argv[1] if len(sys.argv) > 1 else 'SNCStore'
+    loopBench = sys.argv[2] if len(sys.argv) > 2 else 'SNCLoopBench'
+    passed = True
+
+    for name, quotaMB, done, check in CASES:
+        if not runCase(store, loopBench, name, quotaMB, done, check):
+            passed = False
+
+    return 0 if passed else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "StoreIndexRecovery.h"
+
+#include <QCoreApplication>
+#include <qfileinfo.h>
+#include <qdir.h>
+
+#include <stdio.h>
+
+//  SNCStoreCheck checks .srf files and their .srx indexes, for example after a crash or
+//  before copying a store, and can repair them the same way SNCStore does at startup.
+//
+//  Usage: SNCStoreCheck [-r] path...
+//
+//      -r  repair - rebuild indexes and truncate an incomplete last record
+//
+//  A path can be an .srf file or a directory, which is searched recursively. The exit
+//  code is 0 if everything is consistent (or was repaired), 2 if something needs repair
+//  and 1 for errors.
+
+static int checkFile(const QString& path, bool repair)
+{
+    STORE_RECOVERY_RESULT result;
+
+    if (!StoreIndexRecovery::check(path, repair, &result)) {
+        printf("%s: %s\n", qPrintable(path), qPrintable(result.error));
+        return 1;
+    }
+
+    if (!StoreIndexRecovery::needsRepair(&result)) {
+        printf("%s: ok, %lld records\n", qPrintable(path), result.indexEntries);
+        return 0;
+    }
+
+    printf("%s: %s - %lld of %lld index entries good%s, %lld records to index, %lld corrupt bytes skipped, %lld bytes incomplete\n",
+           qPrintable(path), result.repaired ? "repaired" : "needs repair",
+           result.validEntries, result.indexEntries, result.indexPartial ? " (partial entry at end)" : "",
+           result.rebuiltEntries, result.skippedBytes, result.dataSize - result.validDataSize);
+
+    return result.repaired ? 0 : 2;
+}
+
+static int checkPath(const QString& path, bool repair)
+{
+    QFileInfo info(path);
+    int ret = 0;
+
+    if (!info.isDir())
+        return checkFile(path, repair);
+
+    QDir dir(path);
+    QFileInfoList list = dir.entryInfoList(QStringList(SNC_RECORD_SRF_RECORD_FILTER),
+                            QDir::Files | QDir::AllDirs | QDir::NoDotAndDotDot, QDir::Name);
+
+    for (int i = 0; i < list.count(); i++) {
+        int fileRet;
+
+        if (list.at(i).isDir())
+            fileRet = checkPath(list.at(i).absoluteFilePath(), repair);
+        else
+            fileRet = checkFile(list.at(i).absoluteFilePath(), repair);
+
+        if ((fileRet == 1) || (ret == 0))
+            ret = fileRet;
+    }
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    bool repair = false;
+    QStringList paths;
+    int ret = 0;
+
+    for (int i = 1; i < args.count(); i++) {
+        QString arg = args.at(i);
+
+        if (arg == "-r") {
+            repair = true;
+        } else if (arg.startsWith("-")) {
+            fprintf(stderr, "Unrecognized option %s\n", qPrintable(arg));
+            return 1;
+        } else {
+            paths.append(arg);
+        }
+    }
+
+    if (paths.count() == 0) {
+        fprintf(stderr, "Usage: SNCStoreCheck [-r] path...\n");
+        return 1;
+    }
+
+    for (int i = 0; i < paths.count(); i++) {
+        int pathRet = checkPath(paths.at(i), repair);
+
+        if ((pathRet == 1) || (ret == 0))
+            ret = pathRet;
+    }
+
+    return ret;
+}
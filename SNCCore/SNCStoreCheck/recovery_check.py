@@ -0,0 +1,209 @@
+'''
+
+  This file is part of SNC
+
+  Copyright (c) 2014-2021, Richard Barnett
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of
+  this software and associated documentation files (the "Software"), to deal in
+  the Software without restriction, including without limitation the rights to use,
+  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+  Software, and to permit persons to whom the Software is furnished to do so,
+  subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all
+  copies or substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+'''
+
+#  recovery_check.py runs SNCStoreCheck over generated .srf/.srx pairs that have been
+#  damaged in the ways a crash or bad media can, and checks what it reports and repairs.
+#
+#  The expected results were only worked out against a Python model of the recovery scan.
+#  The script has not been run against a built SNCStoreCheck yet, so treat it as a harness
+#  to run by hand after building rather than as a known passing check.
+#
+#  Usage: python3 recovery_check.py [path to SNCStoreCheck]
+#
+#  The exit code is 0 if every case passed.
+
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+SYNC = b'SpRSHdV0'
+RECORD_COUNT = 20
+CORRUPT = 10                                            # the record damaged by the corrupt cases
+
+
+def makeRecord(index):
+    payload = bytes([index & 0xff]) * (100 + index * 37)
+    timestamp = 1000000 + index * 40
+    recordHeader = struct.pack('>HHHHHHIq', 0, 0, 24, 0, 0, 0, index, timestamp)
+    body = recordHeader + payload
+    return SYNC + struct.pack('>II', len(body), 0) + body, timestamp
+
+
+def makeFiles():
+    data = b''
+    entries = []
+    for i in range(RECORD_COUNT):
+        record, timestamp = makeRecord(i)
+        entries.append((len(data), timestamp))
+        data += record
+    return bytearray(data), entries
+
+
+def packIndex(entries):
+    return b''.join(struct.pack('<qq', pos, timestamp) for pos, timestamp in entries)
+
+
+def recordEnd(entries, data, i):
+    return entries[i + 1][0] if i + 1 < len(entries) else len(data)
+
+
+#  Each case returns the damaged data, index (None for no index), the entries the repaired
+#  index should hold and the size the repaired data file should have.
+
+def caseGood(data, entries):
+    return data, packIndex(entries), entries, len(data)
+
+
+def caseNoIndex(data, entries):
+    return data, None, entries, len(data)
+
+
+def casePartialIndexEntry(data, entries):
+    return data, packIndex(entries) + b'\0' * 8, entries, len(data)
+
+
+def caseTornTail(data, entries):
+    cut = entries[-1][0] + 30
+    return data[:cut], packIndex(entries[:-1]), entries[:-1], entries[-1][0]
+
+
+def caseTornTailIndexed(data, entries):
+    cut = entries[-1][0] + 30
+    return data[:cut], packIndex(entries), entries[:-1], entries[-1][0]
+
+
+def caseTornHeader(data, entries):
+    return data + SYNC[:5], packIndex(entries), entries, len(data)
+
+
+def caseCorruptSync(data, entries):
+    pos = entries[CORRUPT][0]
+    data[pos:pos + 8] = b'XXXXXXXX'
+    good = entries[:CORRUPT] + entries[CORRUPT + 1:]
+    return data, packIndex(entries[:5]), good, len(data)
+
+
+def caseCorruptSize(data, entries):
+    pos = entries[CORRUPT][0]
+    data[pos + 8:pos + 12] = struct.pack('>I', 0x7fffffff)
+    good = entries[:CORRUPT] + entries[CORRUPT + 1:]
+    return data, packIndex(entries[:5]), good, len(data)
+
+
+def caseCorruptThenTorn(data, entries):
+    pos = entries[CORRUPT][0]
+    data[pos:pos + 8] = b'XXXXXXXX'
+    cut = entries[-1][0] + 30
+    good = entries[:CORRUPT] + entries[CORRUPT + 1:-1]
+    return data[:cut], packIndex(entries[:5]), good, entries[-1][0]
+
+
+def caseSyncInPayload(data, entries):
+    # a sync marker inside a corrupt record's data must not be taken for a record
+
+    pos = entries[CORRUPT][0]
+    data[pos:pos + 8] = b'XXXXXXXX'
+    fake = pos + 16 + 24 + 10
+    data[fake:fake + 16] = SYNC + struct.pack('>II', 30, 0)
+    good = entries[:CORRUPT] + entries[CORRUPT + 1:]
+    return data, packIndex(entries[:5]), good, len(data)
+
+
+CASES = [
+    ('good', caseGood, 0),
+    ('no_index', caseNoIndex, 2),
+    ('partial_index_entry', casePartialIndexEntry, 2),
+    ('torn_tail', caseTornTail, 2),
+    ('torn_tail_indexed', caseTornTailIndexed, 2),
+    ('torn_header', caseTornHeader, 2),
+    ('corrupt_sync', caseCorruptSync, 2),
+    ('corrupt_size', caseCorruptSize, 2),
+    ('corrupt_then_torn', caseCorruptThenTorn, 2),
+    ('sync_in_payload', caseSyncInPayload, 2),
+]
+
+
+def runCheck(storeCheck, path, repair):
+    args = [storeCheck] + (['-r'] if repair else []) + [path]
+    result = subprocess.run(args, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    return result.returncode, result.stdout.strip()
+
+
+def runCase(storeCheck, folder, name, build, expectedCode):
+    data, entries = makeFiles()
+    damaged, index, goodEntries, goodSize = build(data, entries)
+
+    srfPath = os.path.join(folder, name + '.srf')
+    srxPath = os.path.join(folder, name + '.srx')
+    with open(srfPath, 'wb') as f:
+        f.write(damaged)
+    if index is not None:
+        with open(srxPath, 'wb') as f:
+            f.write(index)
+
+    errors = []
+
+    code, output = runCheck(storeCheck, srfPath, False)
+    if code != expectedCode:
+        errors.append('check returned %d, expected %d: %s' % (code, expectedCode, output))
+
+    code, output = runCheck(storeCheck, srfPath, True)
+    if code != 0:
+        errors.append('repair returned %d: %s' % (code, output))
+
+    if os.path.getsize(srfPath) != goodSize:
+        errors.append('data size %d, expected %d' % (os.path.getsize(srfPath), goodSize))
+
+    with open(srxPath, 'rb') as f:
+        repaired = f.read()
+    if repaired != packIndex(goodEntries):
+        errors.append('index has %d entries, expected %d' % (len(repaired) // 16, len(goodEntries)))
+
+    code, output = runCheck(storeCheck, srfPath, False)
+    if code != 0:
+        errors.append('check after repair returned %d: %s' % (code, output))
+
+    print('%-24s %s' % (name, 'ok' if not errors else 'FAILED'))
+    for error in errors:
+        print('    ' + error)
+    return not errors
+
+
+def main():
+    storeCheck = sys.argv[1] if len(sys.argv) > 1 else 'SNCStoreCheck'
+    passed = True
+
+    with tempfile.TemporaryDirectory() as folder:
+        for name, build, expectedCode in CASES:
+            if not runCase(storeCheck, folder, name, build, expectedCode):
+                passed = False
+
+    return 0 if passed else 1
+
+
+if __name__ == '__main__':
+    sys.exit(main())
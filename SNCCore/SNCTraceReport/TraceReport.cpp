@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "TraceReport.h"
+
+#include <qfile.h>
+#include <qtextstream.h>
+
+#include <stdio.h>
+#include <algorithm>
+
+TraceReport::TraceReport()
+{
+    m_traceCount = 0;
+    m_crossHostCount = 0;
+    m_badLineCount = 0;
+}
+
+void TraceReport::setServiceFilter(const QString& servicePath)
+{
+    m_serviceFilter = servicePath;
+}
+
+bool TraceReport::readFile(const QString& path)
+{
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        fprintf(stderr, "Failed to open %s\n", qPrintable(path));
+        return false;
+    }
+
+    QTextStream stream(&file);
+    while (!stream.atEnd())
+        processLine(stream.readLine());
+    return true;
+}
+
+//  A line is: trace <traceID> <servicePath> <stage>:<host>:<time> ...
+
+void TraceReport::processLine(const QString& line)
+{
+    QStringList fields = line.split(' ', QString::SkipEmptyParts);
+    QString lastStage, firstStage, lastHost, firstHost;
+    qint64 lastTime = 0, firstTime = 0;
+    bool ok;
+
+    if (fields.count() < 3 || fields.at(0) != "trace") {
+        if (!line.trimmed().isEmpty())
+            m_badLineCount++;
+        return;
+    }
+    if (!m_serviceFilter.isEmpty() && (fields.at(2) != m_serviceFilter))
+        return;
+
+    for (int i = 3; i < fields.count(); i++) {
+        QStringList stamp = fields.at(i).split(':');
+        if (stamp.count() != 3) {
+            m_badLineCount++;
+            return;
+        }
+        qint64 time = stamp.at(2).toLongLong(&ok);
+        if (!ok) {
+            m_badLineCount++;
+            return;
+        }
+        if (i == 3) {
+            firstStage = stamp.at(0);
+            firstHost = stamp.at(1);
+            firstTime = time;
+        } else if (stamp.at(1) == lastHost) {
+            addSample(lastStage + "-" + stamp.at(0), time - lastTime);
+        } else {
+            m_crossHostCount++;
+        }
+        lastStage = stamp.at(0);
+        lastHost = stamp.at(1);
+        lastTime = time;
+    }
+
+    if ((fields.count() > 4) && (firstHost == lastHost))
+        addSample(QString("total (%1-%2)").arg(firstStage).arg(lastStage), lastTime - firstTime);
+    m_traceCount++;
+}
+
+void TraceReport::addSample(const QString& stage, qint64 latency)
+{
+    if (!m_samples.contains(stage))
+        m_stageOrder.append(stage);
+    m_samples[stage].append(latency);
+}
+
+qint64 TraceReport::percentile(const QList<qint64>& sorted, int percent)
+{
+    int index = (sorted.count() * percent) / 100;
+
+    if (index >= sorted.count())
+        index = sorted.count() - 1;
+    return sorted.at(index);
+}
+
+//  checkStages compares the stages seen, in order, with an expected list. It's used by
+//  loopback_trace.sh to check that every hop of a traced record was stamped.
+
+bool TraceReport::checkStages(const QStringList& expected)
+{
+    if (m_traceCount == 0) {
+        fprintf(stderr, "No traces found\n");
+        return false;
+    }
+    if (m_badLineCount > 0) {
+        fprintf(stderr, "%d bad lines\n", m_badLineCount);
+        return false;
+    }
+    if (m_stageOrder != expected) {
+        fprintf(stderr, "Expected stages: %s\n", qPrintable(expected.join(",")));
+        fprintf(stderr, "Found stages:    %s\n", qPrintable(m_stageOrder.join(",")));
+        return false;
+    }
+    return true;
+}
+
+void TraceReport::print(bool csv)
+{
+    if (csv)
+        printf("stage,count,min,p50,p90,p99,max\n");
+    else
+        printf("%-36s %8s %10s %10s %10s %10s %10s\n", "stage (us)", "count", "min", "p50", "p90", "p99", "max");
+
+    foreach (const QString& stage, m_stageOrder) {
+        QList<qint64> sorted = m_samples.value(stage);
+        std::sort(sorted.begin(), sorted.end());
+
+        if (csv)
+            printf("%s,%d,%lld,%lld,%lld,%lld,%lld\n", qPrintable(stage), sorted.count(),
+                sorted.first(), percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99), sorted.last());
+        else
+            printf("%-36s %8d %10lld %10lld %10lld %10lld %10lld\n", qPrintable(stage), sorted.count(),
+                sorted.first(), percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99), sorted.last());
+    }
+
+    if (!csv) {
+        printf("\n%d traces", m_traceCount);
+        if (m_crossHostCount > 0)
+            printf(", %d stages skipped as they crossed hosts", m_crossHostCount);
+        if (m_badLineCount > 0)
+            printf(", %d bad lines", m_badLineCount);
+        printf("\n");
+    }
+}
@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef TRACEREPORT_H
+#define TRACEREPORT_H
+
+#include <qstring.h>
+#include <qstringlist.h>
+#include <qmap.h>
+#include <qlist.h>
+
+//  TraceReport reads the trace files written by SNCEndpoints (see the traceFile setting)
+//  and prints the latency distribution of each stage. A stage is the time between two
+//  consecutive stamps and is only counted when both stamps came from the same host, so
+//  a loopback run (SNCControl, source and sink all on one host) reports every stage.
+
+class TraceReport
+{
+public:
+    TraceReport();
+
+    void setServiceFilter(const QString& servicePath);      // only use traces for this service
+    bool readFile(const QString& path);                     // returns false if the file can't be read
+    void print(bool csv);                                   // prints the report
+    bool checkStages(const QStringList& expected);          // false if the stages seen are not exactly expected
+
+protected:
+    void processLine(const QString& line);
+    void addSample(const QString& stage, qint64 latency);
+    qint64 percentile(const QList<qint64>& sorted, int percent);
+
+    QString m_serviceFilter;
+    QStringList m_stageOrder;                               // stages in the order first seen
+    QMap<QString, QList<qint64> > m_samples;                // latencies in microseconds for each stage
+    int m_traceCount;                                       // traces used
+    int m_crossHostCount;                                   // stage pairs skipped as not comparable
+    int m_badLineCount;                                     // lines that couldn't be parsed
+};
+
+#endif // TRACEREPORT_H
@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////
+//
+//  This file is part of SNC
+//
+//  Copyright (c) 2014-2021, Richard Barnett
+//
+//  Permission is hereby granted, free of charge, to any person obtaining a copy of
+//  this software and associated documentation files (the "Software"), to deal in
+//  the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the
+//  Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+//  The above copyright notice and this permission notice shall be included in all
+//  copies or substantial portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+//  INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A
+//  PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+//  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+//  OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+//  SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include "TraceReport.h"
+
+#include <QCoreApplication>
+
+#include <stdio.h>
+
+//  SNCTraceReport prints per stage latency distributions from SNCEndpoint trace files.
+//
+//  Usage: SNCTraceReport [-c] [-p<servicePath>] [-e<stage,stage...>] traceFile...
+//
+//      -c  print CSV instead of a table
+//      -p  only use traces for the service path
+//      -e  exit with 2 unless the stages seen are exactly these, in this order
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    TraceReport report;
+    bool csv = false;
+    bool check = false;
+    QStringList expected;
+    int files = 0;
+
+    for (int i = 1; i < args.count(); i++) {
+        QString arg = args.at(i);
+
+        if (arg == "-c") {
+            csv = true;
+        } else if (arg.startsWith("-p")) {
+            report.setServiceFilter(arg.mid(2));
+        } else if (arg.startsWith("-e")) {
+            expected = arg.mid(2).split(',', QString::SkipEmptyParts);
+            check = true;
+        } else if (arg.startsWith("-")) {
+            fprintf(stderr, "Unrecognized option %s\n", qPrintable(arg));
+            return 1;
+        } else {
+            if (!report.readFile(arg))
+                return 1;
+            files++;
+        }
+    }
+
+    if (files == 0) {
+        fprintf(stderr, "Usage: SNCTraceReport [-c] [-p<servicePath>] [-e<stage,stage...>] traceFile...\n");
+        return 1;
+    }
+
+    report.print(csv);
+
+    if (check && !report.checkStages(expected))
+        return 2;
+    return 0;
+}
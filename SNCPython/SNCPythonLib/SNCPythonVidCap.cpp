@@ -264,42 +264,7 @@ bool SNCPythonVidCap::handleYUYV(quint32 index, quint32)
 
 QByteArray SNCPythonVidCap::YUYV2RGB(quint32 index)
 {
-    int r, g, b;
-    int y, u, v;
-
-    const uchar *yuyv = reinterpret_cast<const uchar *>(m_mmBuff[index]);
-
-    int stride = m_width * 3;
-
-    for (int i = 0; i < m_height; i++)	{
-        uchar *p = m_rgbBuff + (i * stride);
-
-        for (int j = 0; j < m_width; j += 2) {
-            y = yuyv[0] << 8;
-            u = yuyv[1] - 128;
-            v = yuyv[3] - 128;
-
-            r = (y + (359 * v)) >> 8;
-            g = (y - (88 * u) - (183 * v)) >> 8;
-            b = (y + (454 * u)) >> 8;
-
-            *(p++) = (r > 255) ? 255 : ((r < 0) ? 0 : r);
-            *(p++) = (g > 255) ? 255 : ((g < 0) ? 0 : g);
-            *(p++) = (b > 255) ? 255 : ((b < 0) ? 0 : b);
-
-            y = yuyv[2] << 8;
-
-            r = (y + (359 * v)) >> 8;
-            g = (y - (88 * u) - (183 * v)) >> 8;
-            b = (y + (454 * u)) >> 8;
-
-            *(p++) = (r > 255) ? 255 : ((r < 0) ? 0 : r);
-            *(p++) = (g > 255) ? 255 : ((g < 0) ? 0 : g);
-            *(p++) = (b > 255) ? 255 : ((b < 0) ? 0 : b);
-
-            yuyv += 4;
-        }
-    }
+    SNCUtils::YUYV2RGB(reinterpret_cast<const uchar *>(m_mmBuff[index]), m_rgbBuff, m_width, m_height);
 
     return QByteArray((const char *)m_rgbBuff, m_width * m_height * 3);
 }